@@ -22,10 +22,42 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <vector>
 #include <gv/gvsoc.hpp>
 
 using namespace std;
 
+
+/*
+ * Wrapper to run GVSOC inside a SystemVerilog simulator.
+ *
+ * Functions imported from SV, which the SV side must export:
+ * - dpi_create_task(callback, arg): starts a task calling back dpi_start_task(callback, arg).
+ * - dpi_wait_event_timeout_ps, dpi_wait_event, dpi_raise_event, dpi_time_ps: time and event
+ *   handling of the SV task running GVSOC.
+ * - dpi_set_status(status): called with the GVSOC status when it is over.
+ * - dpi_external_edge(handle, value): edge generated by GVSOC on the SV wire of this handle,
+ *   only used when synchronizing at each edge.
+ * - dpi_external_edges(nb_edges): optional, only used in quantum mode, notifies SV at the end
+ *   of a quantum that nb_edges edges generated by GVSOC must be popped with dpi_pop_edge. SV
+ *   must pop all of them before the end of the next quantum. A testbench which does not export
+ *   it can instead poll dpi_pending_edges.
+ *
+ * Functions exported to SV:
+ * - dpi_open(config_path): opens GVSOC and returns the instance handle, which is given to the
+ *   other functions. This is an opaque handle, not a gv::Gvsoc pointer.
+ * - dpi_set_quantum(instance, quantum): switches to quantum mode, with a quantum in ps. Must
+ *   be called before dpi_start.
+ * - dpi_start(instance): starts GVSOC and the SV task running it.
+ * - dpi_bind(instance, name, sv_handle): binds the GVSOC wire of this name to the SV wire of
+ *   this handle, and returns the wire handle given to dpi_edge.
+ * - dpi_edge(wire, timestamp, value): edge generated by SV on a wire.
+ * - dpi_pending_edges(instance): returns the number of edges generated by GVSOC in quantum
+ *   mode which are not yet popped.
+ * - dpi_pop_edge(instance, &handle, &timestamp, &value): pops the next edge generated by
+ *   GVSOC in quantum mode, returns 0 once there is no more edge.
+ */
+
 extern "C" void dpi_create_task(void *arg0, void *arg1);
 extern "C" void dpi_wait_event_timeout_ps(long long int delay);
 extern "C" long long int dpi_time_ps();
@@ -33,8 +65,44 @@ extern "C" void dpi_wait_event();
 extern "C" void dpi_raise_event();
 extern "C" void dpi_set_status(int status);
 extern "C" void dpi_external_edge(int handle, uint32_t value);
+// Weak so that testbenches which only synchronize at each edge do not need to export it
+extern "C" void dpi_external_edges(int nb_edges) __attribute__((weak));
+
+
+
+class Dpi_wire_binding;
 
+// Edge buffered in quantum mode
+class Dpi_edge
+{
+    public:
+        Dpi_edge(int64_t timestamp, int value, int dpi_handle, Dpi_wire_binding *binding)
+            : timestamp(timestamp), value(value), dpi_handle(dpi_handle), binding(binding) {}
+
+        int64_t timestamp;
+        int value;
+        // Handle of the SV wire, for edges going to SV
+        int dpi_handle;
+        // Binding of the GVSOC wire, for edges coming from SV
+        Dpi_wire_binding *binding;
+};
+
+class Dpi_instance
+{
+    public:
+        Dpi_instance(gv::Gvsoc *gvsoc) : gvsoc(gvsoc) {}
 
+        gv::Gvsoc *gvsoc;
+        // Quantum in picoseconds at which GVSOC and SV are synchronized, or 0 to synchronize
+        // them at each edge
+        int64_t quantum = 0;
+        // Edges received from SV during the current quantum, replayed in GVSOC at the end of it
+        std::vector<Dpi_edge> rx_edges;
+        // Edges generated by GVSOC during the current quantum, popped by SV at the end of it
+        std::vector<Dpi_edge> tx_edges;
+        // Index of the next edge to be popped by SV
+        size_t tx_index = 0;
+};
 
 class Dpi_launcher : public gv::Gvsoc_user
 {
@@ -50,19 +118,22 @@ class Dpi_launcher : public gv::Gvsoc_user
 class Dpi_wire : public gv::Wire_user
 {
     public:
-        Dpi_wire(int dpi_handle) : dpi_handle(dpi_handle) {}
+        Dpi_wire(Dpi_instance *instance, int dpi_handle) : instance(instance), dpi_handle(dpi_handle) {}
         void update(int value);
 
     private:
+        Dpi_instance *instance;
         int dpi_handle;
+        // Last value sent to SV in quantum mode, to drop updates which do not change the wire
+        int value = -1;
 };
 
 class Dpi_wire_binding
 {
     public:
-        Dpi_wire_binding(gv::Gvsoc *gvsoc, gv::Wire_binding *binding) : gvsoc(gvsoc), binding(binding) {}
+        Dpi_wire_binding(Dpi_instance *instance, gv::Wire_binding *binding) : instance(instance), binding(binding) {}
 
-        gv::Gvsoc *gvsoc;
+        Dpi_instance *instance;
         gv::Wire_binding *binding;
 };
 
@@ -79,7 +150,17 @@ void Dpi_launcher::has_ended()
 
 void Dpi_wire::update(int value)
 {
-    dpi_external_edge(this->dpi_handle, value);
+    if (this->instance->quantum == 0)
+    {
+        dpi_external_edge(this->dpi_handle, value);
+    }
+    else if (value != this->value)
+    {
+        // Pad models often update all their pads on each clock edge, only the ones which
+        // change are worth sending
+        this->value = value;
+        this->instance->tx_edges.push_back(Dpi_edge(this->instance->gvsoc->get_time(), value, this->dpi_handle, NULL));
+    }
 }
 
 
@@ -96,12 +177,69 @@ extern "C" void *dpi_open(char *config_path)
         fprintf(stderr, "Opened proxy on socket %d\n", conf.proxy_socket);
     }
 
-  return (void *)gvsoc;
+  return (void *)new Dpi_instance(gvsoc);
+}
+
+// Synchronization used in quantum mode. Instead of synchronizing at each edge, GVSOC and SV
+// are only synchronized at the end of each quantum, where the edges buffered on both sides are
+// exchanged.
+// Edges from SV are replayed in GVSOC at their exact timestamp, since GVSOC is late by one
+// quantum, while edges from GVSOC are replayed by SV one quantum after their timestamp.
+static void gvsoc_quantum_task(Dpi_instance *instance)
+{
+    gv::Gvsoc *gvsoc = instance->gvsoc;
+
+    while(1)
+    {
+        int64_t time = dpi_time_ps();
+
+        // Edges still not popped by SV from the previous quantum are dropped, since SV must pop
+        // all of them when it is notified
+        if (instance->tx_index != instance->tx_edges.size())
+        {
+            fprintf(stderr, "Dropping %ld edges not popped by SV at time %ld\n",
+                instance->tx_edges.size() - instance->tx_index, time);
+        }
+        instance->tx_edges.clear();
+        instance->tx_index = 0;
+
+        for (Dpi_edge &edge: instance->rx_edges)
+        {
+            gvsoc->step_until(edge.timestamp);
+            gvsoc->update(edge.timestamp);
+            if (edge.binding->binding)
+            {
+                edge.binding->binding->update(edge.value);
+            }
+        }
+        instance->rx_edges.clear();
+
+        gvsoc->step_until(time);
+
+        if (instance->tx_edges.size() > 0 && dpi_external_edges)
+        {
+            dpi_external_edges(instance->tx_edges.size());
+        }
+
+        // Same as for the other mode, if someone else is retaining the engine, we must not let
+        // SV update the time
+        if (gvsoc->retain_count() == 1)
+        {
+            dpi_wait_event_timeout_ps(instance->quantum);
+        }
+    }
 }
 
 static void gvsoc_sync_task(void *arg)
 {
-    gv::Gvsoc *gvsoc = (gv::Gvsoc *)arg;
+    Dpi_instance *instance = (Dpi_instance *)arg;
+    gv::Gvsoc *gvsoc = instance->gvsoc;
+
+    if (instance->quantum != 0)
+    {
+        gvsoc_quantum_task(instance);
+        return;
+    }
 
     while(1)
     {
@@ -130,10 +268,10 @@ static void gvsoc_sync_task(void *arg)
 
 extern "C" int dpi_start(void *instance)
 {
-  gv::Gvsoc *gvsoc = (gv::Gvsoc *)instance;
-  gvsoc->start();
+  Dpi_instance *dpi_instance = (Dpi_instance *)instance;
+  dpi_instance->gvsoc->start();
 
-  dpi_create_task((void *)gvsoc_sync_task, gvsoc);
+  dpi_create_task((void *)gvsoc_sync_task, dpi_instance);
 
 
   return 0;
@@ -147,10 +285,10 @@ extern "C" void dpi_start_task(void *arg0, void *arg1)
 
 extern "C" void *dpi_bind(void *handle, char *name, int sv_handle)
 {
-    gv::Gvsoc *gvsoc = (gv::Gvsoc *)handle;
-    Dpi_wire *wire = new Dpi_wire(sv_handle);
-    gv::Wire_binding *binding = gvsoc->wire_bind(wire, name, "");
-    void *result = (void *)new Dpi_wire_binding(gvsoc, binding);
+    Dpi_instance *instance = (Dpi_instance *)handle;
+    Dpi_wire *wire = new Dpi_wire(instance, sv_handle);
+    gv::Wire_binding *binding = instance->gvsoc->wire_bind(wire, name, "");
+    void *result = (void *)new Dpi_wire_binding(instance, binding);
 
     return result;
 }
@@ -158,9 +296,49 @@ extern "C" void *dpi_bind(void *handle, char *name, int sv_handle)
 extern "C" void dpi_edge(void *handle, int64_t timestamp, int data)
 {
     Dpi_wire_binding *binding = (Dpi_wire_binding *)handle;
-    binding->gvsoc->update(timestamp);
+    Dpi_instance *instance = binding->instance;
+
+    if (instance->quantum != 0)
+    {
+        instance->rx_edges.push_back(Dpi_edge(timestamp, data, -1, binding));
+        return;
+    }
+
+    instance->gvsoc->update(timestamp);
     if (binding->binding)
     {
         binding->binding->update(data);
     }
+}
+
+// Switch to quantum mode, where edges are exchanged by streams at the end of each quantum
+// instead of one by one. Must be called before dpi_start.
+extern "C" void dpi_set_quantum(void *instance, int64_t quantum)
+{
+    ((Dpi_instance *)instance)->quantum = quantum;
+}
+
+// Called by SV to know how many edges generated by GVSOC during the last quantum must be popped
+extern "C" int dpi_pending_edges(void *instance)
+{
+    Dpi_instance *dpi_instance = (Dpi_instance *)instance;
+    return dpi_instance->tx_edges.size() - dpi_instance->tx_index;
+}
+
+// Called by SV once notified through dpi_external_edges to get the edges generated by GVSOC
+// during the last quantum, in timestamp order. Returns 0 once there is no more edge.
+extern "C" int dpi_pop_edge(void *instance, int *handle, int64_t *timestamp, int *value)
+{
+    Dpi_instance *dpi_instance = (Dpi_instance *)instance;
+
+    if (dpi_instance->tx_index == dpi_instance->tx_edges.size())
+    {
+        return 0;
+    }
+
+    Dpi_edge &edge = dpi_instance->tx_edges[dpi_instance->tx_index++];
+    *handle = edge.dpi_handle;
+    *timestamp = edge.timestamp;
+    *value = edge.value;
+    return 1;
 }
\ No newline at end of file
@@ -232,6 +232,22 @@ namespace gv {
     };
 
 
+    /**
+     * Value of a VCD event, as delivered in batches.
+     */
+    struct Vcd_event
+    {
+        // Timestamp of the new value in picoseconds.
+        int64_t timestamp;
+        // ID of the VCD event.
+        int32_t id;
+        // Flags of the value, 1 if the value is in high impedance.
+        int32_t flags;
+        // The new value. For real events, this contains the bits of the double value.
+        uint64_t value;
+    };
+
+
     /**
      * Class required for receiving VCD events.
      *
@@ -276,6 +292,7 @@ namespace gv {
          * @param timestamp Timestamp of the new value in picoseconds.
          * @param id ID of the VCD event.
          * @param value The new value.
+         * @param flags The bits of the value which are in high impedance, or NULL if none is.
          */
         virtual void event_update_bitfield(int64_t timestamp, int id, uint8_t *value, uint8_t *flags) = 0;
 
@@ -302,6 +319,38 @@ namespace gv {
          * @param value The new value.
          */
         virtual void event_update_string(int64_t timestamp, int id, const char *value, int flags) = 0;
+
+        /**
+         * Called by GVSOC to get the maximum number of values delivered in a batch.
+         *
+         * When this returns a value greater than 0, the values of logical events, bitfield events
+         * up to 64 bits and real events are delivered through event_update_batch instead of one
+         * call per value. The values of other events are still delivered through the per-event
+         * methods, after the values of the pending batch.
+         * A batch is delivered when it is full, when GVSOC has no more value to deliver, and
+         * at each timestamp if event_batch_per_timestamp returns true.
+         *
+         * @return The maximum number of values in a batch, or 0 to get one call per value.
+         */
+        virtual int event_batch_size() { return 0; }
+
+        /**
+         * Called by GVSOC to know if batches must be delivered at each timestamp.
+         *
+         * @return True if a batch must be delivered for each timestamp.
+         */
+        virtual bool event_batch_per_timestamp() { return false; }
+
+        /**
+         * Called by GVSOC to deliver a batch of values.
+         *
+         * The values are sorted by timestamp.
+         * No GVSOC API can be called from this callback.
+         *
+         * @param events The array of values.
+         * @param nb_events The number of values in the array.
+         */
+        virtual void event_update_batch(Vcd_event *events, int nb_events) {}
     };
 
 
@@ -436,6 +485,36 @@ namespace gv {
 
 
 
+    /**
+     * Configuration of the power sampler.
+     *
+     * The sampler periodically appends to a file the dynamic and leakage energy consumed by a set
+     * of blocks since the beginning of the report window.
+     */
+    class PowerSamplerConfig
+    {
+    public:
+        /** Path of the file where the samples are written. */
+        std::string path = "power_samples.csv";
+        /**
+         * Format of the file, "csv" or "bin".
+         *
+         * The binary file starts with the magic "GVPWRSMP", a 32 bits version, and the 32 bits
+         * number of blocks, each one followed by its path, as a 32 bits size and the characters.
+         * Each sample is then a 64 bits timestamp, followed for each block by the dynamic and
+         * leakage energy, as doubles. All fields are little-endian.
+         */
+        std::string format = "csv";
+        /** Sampling period, in cycles of the clock domain if clock is set, in picoseconds otherwise. */
+        int64_t period = 0;
+        /** Path of the block whose clock domain is used for the period. Can be empty. */
+        std::string clock;
+        /** Paths of the blocks to be sampled. The whole system is sampled if it is empty. */
+        std::vector<std::string> blocks;
+    };
+
+
+
     /**
      * GVSOC interface for power aspects.
      *
@@ -499,6 +578,79 @@ namespace gv {
          */
         virtual PowerReport *report_get() = 0;
 
+        /**
+         * Start the power sampler.
+         *
+         * Every period, the dynamic and leakage energy consumed by the specified blocks since the
+         * call to report_start() is appended to a CSV or binary file, to get the power over time
+         * without dumping power VCD traces. The energy is in picojoules.
+         * Calling it again restarts the sampler with the new configuration.
+         *
+         * @param config The sampler configuration.
+         */
+        virtual void sampler_start(PowerSamplerConfig &config) = 0;
+
+        /**
+         * Stop the power sampler.
+         *
+         * The file is closed after a last sample is taken.
+         */
+        virtual void sampler_stop() = 0;
+
+    };
+
+
+
+    /**
+     * Stop condition type.
+     */
+    enum Stop_condition_type {
+        // The PC of a core reaches a value
+        Stop_condition_pc,
+        // A core has executed a number of instructions
+        Stop_condition_insn,
+        // A word of a memory matches a value
+        Stop_condition_mem,
+        // A wire port of a component changes its value
+        Stop_condition_wire,
+        // A duration has elapsed
+        Stop_condition_timeout
+    };
+
+
+
+    /**
+     * Condition stopping the execution started with Gvsoc::run_until.
+     *
+     * The condition is evaluated by the engine or by the component it targets, which stops
+     * the execution at the end of the timestamp where it is met, so that the caller does not
+     * need to step the execution and poll the system.
+     */
+    class StopCondition
+    {
+    public:
+        /** Type of the condition. */
+        Stop_condition_type type;
+        /**
+         * Path of the component evaluating the condition, which is the core for PC and
+         * instruction conditions, the memory for memory conditions, and the component owning the
+         * wire port for wire conditions. Not used for timeouts.
+         */
+        std::string path;
+        /** Name of the master wire port, for wire conditions. */
+        std::string port;
+        /**
+         * Value of the condition, which is the PC for PC conditions, the number of instructions
+         * for instruction conditions, the value of the word for memory conditions, and the
+         * duration in picoseconds for timeouts.
+         */
+        uint64_t value = 0;
+        /** Offset of the word in the memory, for memory conditions. */
+        uint64_t addr = 0;
+        /** Mask applied to the word before it is compared to the value, for memory conditions. */
+        uint64_t mask = -1;
+        /** Size in bytes of the word, up to 8, for memory conditions. */
+        int size = 4;
     };
 
 
@@ -638,6 +790,21 @@ namespace gv {
          */
         virtual int64_t step_until(int64_t timestamp) = 0;
 
+        /**
+         * Run execution until a condition is met
+         *
+         * Start execution and run until one of the specified conditions is met, or until
+         * execution is stopped for another reason, like the end of simulation. The conditions
+         * are only evaluated during this call.
+         * This blocks the caller until execution is stopped.
+         *
+         * @param conditions The conditions stopping the execution.
+         *
+         * @returns The index of the condition which stopped the execution, or -1 if it was
+         *     stopped for another reason.
+         */
+        virtual int run_until(std::vector<StopCondition> &conditions) = 0;
+
         /**
          * Wait end of execution.
          *
@@ -690,6 +857,15 @@ namespace gv {
          */
         virtual int retain_count() { return 0; }
 
+        /**
+         * Return the current time of the engine.
+         *
+         * This can be called from wire or IO callbacks to get the timestamp of the update.
+         *
+         * @returns The current time in picoseconds, or -1 if it is not available.
+         */
+        virtual int64_t get_time() { return -1; }
+
     };
 
 
@@ -711,6 +887,14 @@ namespace gv {
          */
         std::string config_path = "";
 
+        /**
+         * Path to the binary configuration cache
+         *
+         * When specified, the parsed configuration is stored in binary form to this file, and
+         * loaded from it on next runs as long as the JSON configuration has not changed.
+         */
+        std::string config_cache_path = "";
+
         /**
          * Socket of a GVSOC proxy.
          *
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "gv/gvsoc.hpp"
+
+/**
+ * @file io_shm.hpp
+ *
+ * Layout of the shared memory through which another process can inject memory-mapped requests
+ * into GVSOC, when the shm property of a router proxy is set, and a client which can be used by
+ * this process.
+ * This header does not need any GVSOC library.
+ */
+
+namespace gv {
+
+    #define GV_IO_SHM_MAGIC "GVIOSHM"
+    #define GV_IO_SHM_VERSION 1
+
+    /**
+     * Entry of the request and response rings.
+     */
+    struct Io_shm_entry
+    {
+        // Chosen by the client for requests, and given back in the response
+        uint64_t id;
+        uint64_t addr;
+        uint64_t size;
+        // Offset in the data area of the data read or written by the request. The area belongs
+        // to GVSOC until the response is received.
+        uint64_t offset;
+        // For requests, time in picoseconds before which the request is not injected, or -1 to
+        // inject it as soon as possible. For responses, time at which the request was over.
+        int64_t timestamp;
+        // Io_request_type
+        uint32_t type;
+        // Io_request_status, only for responses
+        uint32_t status;
+    };
+
+    /**
+     * Single producer single consumer ring of entries.
+     *
+     * Head and tail are counted in entries since the beginning. The consumer sleeps on the seq
+     * futex, which the producer increments every time it pushes entries.
+     */
+    struct alignas(64) Io_shm_ring
+    {
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        std::atomic<uint32_t> seq;
+        // Number of threads sleeping on seq, so that the producer only does a system call when
+        // needed
+        std::atomic<uint32_t> nb_waiting;
+    };
+
+    /**
+     * Header of the shared memory.
+     *
+     * The header is followed by the request ring entries, the response ring entries, and the
+     * data area, all aligned on 64 bytes.
+     */
+    struct Io_shm_header
+    {
+        char magic[8];
+        uint32_t version;
+        // Number of entries of each ring, which is also the maximum number of pending requests
+        uint32_t nb_entries;
+        // Size in bytes of the data area
+        uint64_t data_size;
+        // Set by GVSOC once the simulation is over
+        std::atomic<uint32_t> closed;
+        // Requests from the client to GVSOC
+        Io_shm_ring req;
+        // Responses from GVSOC to the client
+        Io_shm_ring rsp;
+    };
+
+    static inline size_t io_shm_entries_offset()
+    {
+        return sizeof(Io_shm_header);
+    }
+
+    static inline size_t io_shm_data_offset(uint32_t nb_entries)
+    {
+        return (sizeof(Io_shm_header) + 2 * nb_entries * sizeof(Io_shm_entry) + 63) & ~63;
+    }
+
+    static inline size_t io_shm_size(uint32_t nb_entries, uint64_t data_size)
+    {
+        return io_shm_data_offset(nb_entries) + data_size;
+    }
+
+    /**
+     * Wait until the seq of a ring is different from the specified value.
+     */
+    static inline void io_shm_ring_wait(Io_shm_ring *ring, uint32_t seq)
+    {
+        ring->nb_waiting.fetch_add(1);
+        // The futex is shared between processes, the private flavor can not be used
+        syscall(SYS_futex, &ring->seq, FUTEX_WAIT, seq, NULL, NULL, 0);
+        ring->nb_waiting.fetch_sub(1);
+    }
+
+    /**
+     * Wake up the threads waiting on a ring after entries were pushed.
+     */
+    static inline void io_shm_ring_notify(Io_shm_ring *ring)
+    {
+        ring->seq.fetch_add(1);
+        if (ring->nb_waiting.load() != 0)
+        {
+            syscall(SYS_futex, &ring->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+        }
+    }
+
+    /**
+     * Client injecting memory-mapped requests into GVSOC through shared memory.
+     *
+     * Requests are pushed to the request ring and refer to data in the data area, which is
+     * directly accessed by GVSOC, so no copy is done.
+     * A client must be used by a single thread.
+     */
+    class Io_shm_client
+    {
+    public:
+        ~Io_shm_client()
+        {
+            if (this->header)
+            {
+                munmap(this->header, this->map_size);
+            }
+        }
+
+        /**
+         * Open the shared memory created by GVSOC.
+         *
+         * @param name The name given to GVSOC with the router proxy shm property.
+         * @return 0 if it succeeded, -1 otherwise.
+         */
+        int open(std::string name)
+        {
+            int fd = shm_open(name.c_str(), O_RDWR, 0);
+            if (fd == -1)
+            {
+                return -1;
+            }
+
+            Io_shm_header header;
+            if (read(fd, (void *)&header, sizeof(header)) != sizeof(header) ||
+                memcmp(header.magic, GV_IO_SHM_MAGIC, 8) != 0 || header.version != GV_IO_SHM_VERSION)
+            {
+                ::close(fd);
+                return -1;
+            }
+
+            this->map_size = io_shm_size(header.nb_entries, header.data_size);
+            void *map = mmap(NULL, this->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (map == MAP_FAILED)
+            {
+                return -1;
+            }
+
+            this->header = (Io_shm_header *)map;
+            Io_shm_entry *entries = (Io_shm_entry *)((uint8_t *)map + io_shm_entries_offset());
+            this->req_entries = entries;
+            this->rsp_entries = entries + header.nb_entries;
+            this->data = (uint8_t *)map + io_shm_data_offset(header.nb_entries);
+            return 0;
+        }
+
+        /**
+         * Get the data area, where the data of the requests must be put.
+         */
+        uint8_t *get_data() { return this->data; }
+
+        /**
+         * Get the size in bytes of the data area.
+         */
+        uint64_t get_data_size() { return this->header->data_size; }
+
+        /**
+         * Inject a memory-mapped request.
+         *
+         * For writes, the data must be in the data area before this is called. For reads, the
+         * data is in the data area once the response is received.
+         *
+         * @param req The request. Only id, addr, size, offset, timestamp and type are used.
+         * @return 0 if it succeeded, -1 if too many requests are pending, in which case a
+         *     response must first be received.
+         */
+        int access(Io_shm_entry *req)
+        {
+            // Limiting pending requests to the ring size guarantees there is always room for
+            // responses, so that GVSOC never waits for us
+            if (this->nb_pending == this->header->nb_entries)
+            {
+                return -1;
+            }
+
+            uint64_t head = this->header->req.head.load(std::memory_order_relaxed);
+            this->req_entries[head % this->header->nb_entries] = *req;
+            this->header->req.head.store(head + 1, std::memory_order_release);
+            io_shm_ring_notify(&this->header->req);
+            this->nb_pending++;
+            return 0;
+        }
+
+        /**
+         * Get the next response, if any.
+         *
+         * @param rsp Where the response is copied.
+         * @return True if a response was received.
+         */
+        bool get_response(Io_shm_entry *rsp)
+        {
+            uint64_t tail = this->header->rsp.tail.load(std::memory_order_relaxed);
+            if (tail == this->header->rsp.head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            *rsp = this->rsp_entries[tail % this->header->nb_entries];
+            this->header->rsp.tail.store(tail + 1, std::memory_order_release);
+            this->nb_pending--;
+            return true;
+        }
+
+        /**
+         * Wait for the next response.
+         *
+         * @param rsp Where the response is copied.
+         * @return 0 if a response was received, -1 if the simulation is over.
+         */
+        int wait_response(Io_shm_entry *rsp)
+        {
+            while (1)
+            {
+                uint32_t seq = this->header->rsp.seq.load();
+                if (this->get_response(rsp))
+                {
+                    return 0;
+                }
+                if (this->is_closed())
+                {
+                    return -1;
+                }
+                io_shm_ring_wait(&this->header->rsp, seq);
+            }
+        }
+
+        /**
+         * Get the number of requests which have not yet been responded.
+         */
+        uint32_t get_nb_pending() { return this->nb_pending; }
+
+        /**
+         * Tell if GVSOC is done with the shared memory.
+         */
+        bool is_closed()
+        {
+            return this->header->closed.load(std::memory_order_acquire);
+        }
+
+    private:
+        Io_shm_header *header = NULL;
+        Io_shm_entry *req_entries;
+        Io_shm_entry *rsp_entries;
+        uint8_t *data;
+        size_t map_size;
+        uint32_t nb_pending = 0;
+    };
+};
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "gv/gvsoc.hpp"
+
+/**
+ * @file vcd_shm.hpp
+ *
+ * Layout of the shared memory through which GVSOC sends VCD events to another process, when the
+ * GVSOC property events/shm is set, and a reader which can be used by this process.
+ * This header does not need any GVSOC library.
+ */
+
+namespace gv {
+
+    #define GV_VCD_SHM_MAGIC "GVVCDSHM"
+    #define GV_VCD_SHM_VERSION 2
+
+    /**
+     * Type of the records of the shared memory ring.
+     */
+    enum Vcd_shm_record_type {
+        // Padding up to the end of the ring, to be skipped
+        Vcd_shm_record_pad = 0,
+        // Registration of a VCD event, payload is a Vcd_shm_register followed by the path
+        Vcd_shm_record_register = 1,
+        // Values of VCD events, payload is an array of Vcd_event
+        Vcd_shm_record_events = 2,
+        // Value of a string VCD event, payload is a Vcd_event, whose value is the string size,
+        // followed by the string
+        Vcd_shm_record_string = 3,
+        // Value of a VCD event wider than 64 bits, or having some bits in high impedance.
+        // Payload is a Vcd_event, whose value is the number of bytes of the value, followed by
+        // the value bytes, and, if the event flags are 1, by the same number of bytes giving the
+        // bits in high impedance.
+        Vcd_shm_record_bitfield = 4,
+    };
+
+    /**
+     * Header of the shared memory.
+     *
+     * The header is followed by the ring. GVSOC writes records at head and the reader
+     * consumes them at tail, both counted in bytes since the beginning. GVSOC waits when the
+     * ring is full, so that no event is lost.
+     */
+    struct Vcd_shm_header
+    {
+        char magic[8];
+        uint32_t version;
+        // Size in bytes of the ring following this header
+        uint32_t size;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        // Set by GVSOC once the simulation is over and all the records are written
+        std::atomic<uint32_t> closed;
+        // Set by the reader once it does not read records anymore
+        std::atomic<uint32_t> reader_closed;
+        // Process ID of the reader, so that GVSOC stops waiting for room if it dies, or 0
+        // if no reader opened the shared memory yet
+        std::atomic<int32_t> reader_pid;
+    };
+
+    /**
+     * Header of each record of the ring. Records are aligned on 8 bytes.
+     */
+    struct Vcd_shm_record
+    {
+        uint32_t type;
+        // Size in bytes of the payload following this header
+        uint32_t size;
+    };
+
+    /**
+     * Payload of a registration record.
+     */
+    struct Vcd_shm_register
+    {
+        int32_t id;
+        int32_t type;
+        int32_t width;
+        int32_t path_len;
+    };
+
+    /**
+     * Reader of the VCD events sent by GVSOC through shared memory.
+     */
+    class Vcd_shm_reader
+    {
+    public:
+        ~Vcd_shm_reader()
+        {
+            if (this->header)
+            {
+                this->header->reader_closed.store(1, std::memory_order_release);
+                munmap(this->header, this->map_size);
+            }
+        }
+
+        /**
+         * Open the shared memory created by GVSOC.
+         *
+         * @param name The name given to GVSOC with the property events/shm.
+         * @return 0 if it succeeded, -1 otherwise.
+         */
+        int open(std::string name)
+        {
+            int fd = shm_open(name.c_str(), O_RDWR, 0);
+            if (fd == -1)
+            {
+                return -1;
+            }
+
+            Vcd_shm_header header;
+            if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+                memcmp(header.magic, GV_VCD_SHM_MAGIC, 8) != 0 || header.version != GV_VCD_SHM_VERSION)
+            {
+                ::close(fd);
+                return -1;
+            }
+
+            this->map_size = sizeof(Vcd_shm_header) + header.size;
+            void *map = mmap(NULL, this->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (map == MAP_FAILED)
+            {
+                return -1;
+            }
+
+            this->header = (Vcd_shm_header *)map;
+            this->ring = (uint8_t *)map + sizeof(Vcd_shm_header);
+            this->header->reader_pid.store(getpid(), std::memory_order_release);
+            return 0;
+        }
+
+        /**
+         * Get the next record.
+         *
+         * The record stays valid until release_record is called.
+         *
+         * @return The record, or NULL if there is currently no record.
+         */
+        Vcd_shm_record *get_record()
+        {
+            while (1)
+            {
+                uint64_t tail = this->header->tail.load(std::memory_order_relaxed);
+                if (tail == this->header->head.load(std::memory_order_acquire))
+                {
+                    return NULL;
+                }
+
+                Vcd_shm_record *record = (Vcd_shm_record *)&this->ring[tail % this->header->size];
+                if (record->type != Vcd_shm_record_pad)
+                {
+                    return record;
+                }
+
+                this->header->tail.store(tail + sizeof(Vcd_shm_record) + record->size,
+                    std::memory_order_release);
+            }
+        }
+
+        /**
+         * Release the record returned by the last call to get_record, so that GVSOC can reuse
+         * its space.
+         */
+        void release_record(Vcd_shm_record *record)
+        {
+            uint64_t tail = this->header->tail.load(std::memory_order_relaxed);
+            this->header->tail.store(tail + sizeof(Vcd_shm_record) + ((record->size + 7) & ~7),
+                std::memory_order_release);
+        }
+
+        /**
+         * Tell if GVSOC is done with the shared memory.
+         *
+         * @return True if the simulation is over. There can still be records to read.
+         */
+        bool is_closed()
+        {
+            return this->header->closed.load(std::memory_order_acquire);
+        }
+
+    private:
+        Vcd_shm_header *header = NULL;
+        uint8_t *ring;
+        size_t map_size;
+    };
+};
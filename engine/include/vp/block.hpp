@@ -27,6 +27,7 @@
 #include <vp/power/block_power.hpp>
 #include <vp/trace/block_trace.hpp>
 #include <vp/clock/clock_event.hpp>
+#include <vp/pool.hpp>
 
 namespace gv {
     class GvProxy;
@@ -38,6 +39,9 @@ namespace vp {
     class SignalCommon;
     class RegisterCommon;
     class TraceEngine;
+    class PowerSampler;
+    class StopCondition;
+    class StopConditions;
     class reg;
 
     /**
@@ -58,10 +62,12 @@ namespace vp {
         friend class vp::BlockTrace;
         friend class vp::PowerTrace;
         friend class vp::CompPowerReport;
+        friend class vp::PowerSampler;
         friend class vp::ClockEngine;
         friend class vp::TraceEngine;
         friend class vp::Component;
         friend class vp::TimeEngine;
+        friend class vp::StopConditions;
 
     public:
         /**
@@ -188,6 +194,45 @@ namespace vp {
         virtual std::string handle_command(gv::GvProxy *proxy, FILE *req_file, FILE *reply_file,
             std::vector<std::string> args, std::string req) { return ""; }
 
+        /**
+         * @brief Handle a memory access coming from the proxy
+         *
+         * This virtual method can be overloaded by blocks which can inject memory accesses into
+         * the system, so that the proxy can do bulk memory accesses through its binary protocol.
+         *
+         * @note This should never be called directly, the proxy calls it with the engine locked.
+         *
+         * @param is_write True if the access is a write.
+         * @param addr Address of the access.
+         * @param size Size of the access.
+         * @param data Data to be written, or where to store the data read.
+         * @return 0 if the access succeeded, -1 if it failed or is not supported.
+         */
+        virtual int handle_proxy_mem_access(bool is_write, uint64_t addr, uint64_t size,
+            uint8_t *data) { return -1; }
+
+        /**
+         * @brief Arm a stop condition
+         *
+         * This virtual method can be overloaded by blocks which can evaluate stop conditions of
+         * run-until requests, like cores for PC conditions. The block must call hit on the
+         * condition each time it is met, until the condition is disarmed, and should only
+         * evaluate it while it is armed, so that there is no cost when no condition is armed.
+         *
+         * @note This should never be called directly, the engine calls it from its own thread.
+         *
+         * @param condition The condition.
+         * @return True if the block supports this condition, false otherwise.
+         */
+        virtual bool stop_condition_arm(vp::StopCondition *condition) { return false; }
+
+        /**
+         * @brief Disarm a stop condition
+         *
+         * @param condition The condition, which was previously armed on this block.
+         */
+        virtual void stop_condition_disarm(vp::StopCondition *condition) {}
+
         /**
          * @brief Power supply method method
          *
@@ -232,6 +277,30 @@ namespace vp {
          */
         inline Trace *get_trace() { return &this->block_trace; }
 
+        /**
+         * @brief Tell if the block is instrumented
+         *
+         * A block is instrumented when one of its system traces or VCD traces is active, or when
+         * its power trace is active. The child blocks which are not components are also taken
+         * into account.
+         *
+         * @return True if the block is instrumented
+         */
+        bool is_instrumented();
+
+        /**
+         * @brief Register a callback for instrumentation changes
+         *
+         * The callback is called each time one of the traces taken into account by
+         * is_instrumented is enabled or disabled. It can be used to switch between
+         * instrumented and fast implementations.
+         * This must be called once all the traces of the block are declared, for example from the
+         * start method.
+         *
+         * @param callback The callback.
+         */
+        void register_instrumentation_callback(std::function<void()> callback);
+
         /**
          * @brief Reset the hierarchy of the block
          *
@@ -318,10 +387,6 @@ namespace vp {
         // Used by clock domain to register the clocks
         virtual void pre_start() {}
 
-        // Used by the trace engine to get a trace from the full path by going through
-        // the whole hierarchy
-        void get_trace_from_path(std::vector<vp::Trace *> &traces, std::string path);
-
         // Used by external controllers (launcher or proxy)
         vp::Block *get_block_from_path(std::vector<std::string> path_list);
 
@@ -392,5 +457,7 @@ namespace vp {
         Trace block_trace;
         // Tells if the reset is connected to an interface or is coming from parent
         bool reset_is_bound = false;
+        // Clock events allocated with event_new, created when the first one is allocated
+        vp::Pool<ClockEvent> *clock_event_pool = NULL;
     };
 };
@@ -135,7 +135,11 @@ namespace vp
 
         void event_del(Block *comp, ClockEvent *event)
         {
-            delete event;
+            if (event->is_enqueued())
+            {
+                this->cancel(event);
+            }
+            comp->clock_event_pool->free(event);
         }
 
         void disable(ClockEvent *event);
@@ -65,14 +65,17 @@ inline void vp::Block::event_reenqueue_ext(vp::ClockEvent *event, int64_t cycles
 
 inline vp::ClockEvent *vp::Block::event_new(vp::ClockEventMeth *meth)
 {
-    ClockEvent *event = new vp::ClockEvent(this);
-    event->set_callback(meth);
-    return event;
+    return this->event_new(this, meth);
 }
 
 inline vp::ClockEvent *vp::Block::event_new(vp::Block *_this, vp::ClockEventMeth *meth)
 {
-    ClockEvent *event = new vp::ClockEvent(this);
+    if (this->clock_event_pool == NULL)
+    {
+        this->clock_event_pool = new vp::Pool<ClockEvent>(this->get_path() + "/clock_events");
+    }
+    // Events given back by event_del are reused, they are already registered to this block
+    ClockEvent *event = this->clock_event_pool->alloc(this);
     event->_this = (vp::Block *)_this;
     event->set_callback(meth);
     return event;
@@ -46,6 +46,7 @@ namespace vp
     class signal;
     class TraceEngine;
     class Top;
+    class StopConditions;
     class reg_1;
     class reg_8;
     class reg_16;
@@ -87,6 +88,7 @@ namespace vp
         friend class vp::MasterPort;
         friend class vp::Top;
         friend class vp::TimeEngine;
+        friend class vp::StopConditions;
         friend class gv::GvsocLauncher;
 
     public:
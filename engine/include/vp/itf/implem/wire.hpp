@@ -124,6 +124,47 @@ namespace vp {
   }
 
 
+  template<class T>
+  inline void WireMaster<T>::sync_watch_stub(WireMaster<T> *_this, T value)
+  {
+    // Updates which do not change the value are not reported. The stub is called before the
+    // value is saved by sync
+    if (value != _this->value)
+    {
+      _this->watch_hit();
+    }
+    return _this->sync_meth_watched((vp::Block *)_this->remote_context_watched, value);
+  }
+
+  template<class T>
+  inline bool WireMaster<T>::watch(vp::StopCondition *condition)
+  {
+    if (!this->is_bound() || this->watch_condition != NULL)
+    {
+      return false;
+    }
+
+    // Like for frequency crossings, the normal handler is saved and replaced by a stub, so that
+    // there is no cost when the port is not watched
+    this->watch_condition = condition;
+    this->sync_meth_watched = this->sync_meth;
+    this->remote_context_watched = this->get_remote_context();
+    this->sync_meth = (void (*)(vp::Block *, T))&WireMaster<T>::sync_watch_stub;
+    this->set_remote_context(this);
+    return true;
+  }
+
+  template<class T>
+  inline void WireMaster<T>::unwatch()
+  {
+    if (this->watch_condition != NULL)
+    {
+      this->watch_condition = NULL;
+      this->sync_meth = this->sync_meth_watched;
+      this->set_remote_context(this->remote_context_watched);
+    }
+  }
+
   template<class T>
   inline void WireSlave<T>::sync_muxed(WireSlave<T> *_this, T value)
   {
@@ -47,6 +47,7 @@ namespace vp {
     {
       if (next) next->sync(value);
       sync_meth((vp::Block *)this->get_remote_context(), value);
+      this->value = value;
     }
 
     inline void sync_back(T *value)
@@ -61,8 +62,12 @@ namespace vp {
 
     void finalize();
 
+    bool watch(vp::StopCondition *condition) override;
+    void unwatch() override;
+
   private:
     static inline void sync_muxed(WireMaster *_this, T value);
+    static inline void sync_watch_stub(WireMaster *_this, T value);
     static inline void sync_freq_cross_stub(WireMaster *_this, T value);
     static inline void sync_back_freq_cross_stub(WireMaster *_this, T *value);
     static inline void sync_back_muxed(WireMaster *_this, T *value);
@@ -74,6 +79,12 @@ namespace vp {
     void (*sync_meth_freq_cross)(vp::Block *, T value);
     void (*sync_back_meth_freq_cross)(vp::Block *, T *value);
 
+    // Handler and context replaced by the watch stub while the port is watched
+    void (*sync_meth_watched)(vp::Block *, T value);
+    void *remote_context_watched;
+    // Last value sent through this port, so that the watch stub only reports changes
+    T value = T();
+
     void (*master_sync_meth)(vp::Block *comp, T value);
     void (*master_sync_meth_mux)(vp::Block *comp, T value, int id);
 
@@ -24,6 +24,8 @@
 
 #include "vp/vp.hpp"
 #include "vp/queue.hpp"
+#include "vp/pool.hpp"
+#include <stddef.h>
 
 namespace vp {
 
@@ -57,6 +59,9 @@ namespace vp {
 
   #define IO_REQ_PAYLOAD_SIZE 64
   #define IO_REQ_NB_ARGS 16
+  // Number of arguments stored inside the request. Requests going through more components
+  // pushing arguments get an extension from the arena.
+  #define IO_REQ_NB_INLINE_ARGS 4
 
   typedef IoReqStatus (IoReqMeth)(vp::Block *, vp::IoReq *);
   typedef IoReqStatus (IoReqMethMuxed)(vp::Block *, IoReq *, int id);
@@ -64,6 +69,29 @@ namespace vp {
   typedef void (IoRespMeth)(vp::Block *, vp::IoReq *);
   typedef void (IoGrantMeth)(vp::Block *, vp::IoReq *);
 
+  /*
+   * Storage for the request fields which are rarely used, allocated from a per-thread arena
+   * only when a component needs them.
+   */
+  class IoReqExtension
+  {
+  public:
+    void *args[IO_REQ_NB_ARGS];
+    uint8_t payload[IO_REQ_PAYLOAD_SIZE];
+    uint8_t *second_data;
+    uint64_t actual_size;
+    // Link used by components to chain requests in their own lists
+    IoReq *req_next;
+    uint64_t burst_chunk;
+    int64_t burst_addr_stride;
+    int64_t burst_data_stride;
+    // Free list link, must be the last field since the ones before are copied with requests
+    IoReqExtension *next;
+
+    static IoReqExtension *alloc();
+    static void free(IoReqExtension *ext);
+  };
+
   class IoReq : public vp::QueueElem
   {
     friend class IoMaster;
@@ -78,9 +106,13 @@ namespace vp {
       init();
     }
 
+    inline IoReq(const IoReq &other);
+    inline IoReq &operator=(const IoReq &other);
+    inline ~IoReq();
+
     IoSlave *get_resp_port() { return resp_port;}
-    void set_next(IoReq *req) { next = req; }
-    IoReq *get_next() { return next; }
+    void set_next(IoReq *req) { if (req != NULL || ext != NULL) get_ext()->req_next = req; }
+    IoReq *get_next() { return ext ? ext->req_next : NULL; }
 
     inline void save();
     inline void restore();
@@ -97,8 +129,8 @@ namespace vp {
     void set_size(uint64_t size) { this->size = size; }
     uint64_t get_size() { return size; }
 
-    void set_actual_size(uint64_t actual_size) { this->actual_size = actual_size; }
-    uint64_t get_actual_size() { return actual_size; }
+    void set_actual_size(uint64_t actual_size) { get_ext()->actual_size = actual_size; }
+    uint64_t get_actual_size() { return ext ? ext->actual_size : 0; }
 
     inline void set_latency(uint64_t latency) { this->latency = latency; }
     inline uint64_t get_latency() { return this->latency; }
@@ -112,14 +144,15 @@ namespace vp {
     uint8_t *get_data() { return data; }
     void set_data(uint8_t *data) { this->data = data; }
 
-    uint8_t *get_second_data() { return this->second_data; }
-    void set_second_data(uint8_t *data) { this->second_data = data; }
+    uint8_t *get_second_data() { return ext ? ext->second_data : NULL; }
+    void set_second_data(uint8_t *data) { get_ext()->second_data = data; }
 
+    // The payload is taken from the extension, it is lost when the request is initialized
     inline int get_payload_size() { return IO_REQ_PAYLOAD_SIZE; }
-    inline uint8_t *get_payload() { return payload; }
+    inline uint8_t *get_payload() { return get_ext()->payload; }
 
     inline int get_nb_args() { return IO_REQ_NB_ARGS; }
-    inline void **get_args() { return args; }
+    inline void **get_args() { return get_ext()->args; }
 
     inline void set_int(int index, int value) { *(int *)&get_args()[index] = value; }
     inline int get_int(int index) { return *(int *)&get_args()[index]; }
@@ -127,27 +160,59 @@ namespace vp {
     inline bool is_debug() { return false; }
     inline void set_debug(bool debug) {}
 
-    inline int arg_alloc() { return current_arg++; }
+    inline int arg_alloc() { if (unlikely(current_arg == IO_REQ_NB_INLINE_ARGS)) get_ext(); return current_arg++; }
     inline void arg_free() { current_arg--; }
 
-    inline void arg_push(void *arg) { this->args[this->current_arg++] = arg; }
-    inline void *arg_pop() { return this->args[--this->current_arg];}
+    inline void arg_push(void *arg) { if (unlikely(current_arg == IO_REQ_NB_INLINE_ARGS)) get_ext(); this->arg_stack()[this->current_arg++] = arg; }
+    inline void *arg_pop() { return this->arg_stack()[--this->current_arg];}
 
-    inline void **arg_get() { return &args[current_arg-1]; }
-    inline void **arg_get(int index) { return &args[index]; }
-    inline void **arg_get_last() { return &args[current_arg]; }
+    inline void **arg_get() { return &arg_stack()[current_arg-1]; }
+    inline void **arg_get(int index) { if (unlikely(index >= IO_REQ_NB_INLINE_ARGS)) get_ext(); return &arg_stack()[index]; }
+    inline void **arg_get_last() { if (unlikely(current_arg >= IO_REQ_NB_INLINE_ARGS)) get_ext(); return &arg_stack()[current_arg]; }
 
     inline void prepare() { latency = 0; duration=0;}
-    inline void init() { prepare(); current_arg=0; }
+    inline void init() { prepare(); current_arg=0; if (unlikely(ext != NULL)) release_ext(); }
 
     inline void set_initiator(int initiator) { this->initiator = initiator; }
     inline int get_initiator() { return this->initiator; }
 
+    /*
+     * Burst requests
+     *
+     * A burst request is made of chunks of burst_chunk bytes, except the last one which gets
+     * the remaining bytes of the request size. Chunk i is at address addr + i * addr_stride
+     * and its data at data + i * data_stride.
+     * Bursts can only be sent to slave ports which declared that they support them (see
+     * IoSlave::set_burst_support). A burst is handled synchronously as a whole.
+     */
+    inline void set_burst(uint64_t chunk, int64_t addr_stride, int64_t data_stride)
+    {
+      IoReqExtension *ext = this->get_ext();
+      ext->burst_chunk = chunk;
+      ext->burst_addr_stride = addr_stride;
+      ext->burst_data_stride = data_stride;
+    }
+    inline void clear_burst() { if (ext) ext->burst_chunk = 0; }
+    inline bool is_burst() { return ext != NULL && ext->burst_chunk != 0; }
+    inline uint64_t get_burst_chunk() { return ext ? ext->burst_chunk : 0; }
+    inline int64_t get_burst_addr_stride() { return ext->burst_addr_stride; }
+    inline int64_t get_burst_data_stride() { return ext->burst_data_stride; }
+    inline uint64_t get_burst_nb_chunks() { return (this->size + ext->burst_chunk - 1) / ext->burst_chunk; }
+    // Size of the address range from the first byte of the first chunk to the last byte of
+    // the last chunk
+    inline uint64_t get_burst_span();
+
+    // Handle a burst request as a sequence of normal requests, one per chunk, by calling the
+    // specified method on each chunk. This can be used by components which receive bursts
+    // but can not handle them directly.
+    // A chunk can be pending only if it is the last one.
+    inline IoReqStatus burst_split(vp::Block *context, IoReqMeth *meth);
+
+    // Fields accessed on every request come first, so that they share the same cache line.
+    // The other ones are in the extension, so that the request fits in 2 cache lines.
     uint64_t addr;
     uint8_t *data;
-    uint8_t *second_data;
     uint64_t size;
-    uint64_t actual_size;
     IoReqOpcode is_write;
     IoReqStatus status;
     IoSlave *resp_port;
@@ -155,14 +220,21 @@ namespace vp {
 
 
   private:
-    IoReq *next;
+    // Get the extension, allocate it and move the arguments there if needed
+    inline IoReqExtension *get_ext();
+    inline void release_ext();
+    // Argument stack, either inline_args or the arguments of the extension
+    inline void **arg_stack() { return this->ext ? this->ext->args : this->inline_args; }
+
+    int current_arg = 0;
     int64_t latency;
     int64_t duration;
-    uint8_t payload[IO_REQ_PAYLOAD_SIZE];
-    void *args[IO_REQ_NB_ARGS];
-    int current_arg = 0;
+    void *inline_args[IO_REQ_NB_INLINE_ARGS];
+    IoReqExtension *ext = NULL;
   };
 
+  static_assert(sizeof(IoReq) <= 128, "IoReq must fit in 2 cache lines");
+
 
   /*
    * Class for IO master ports
@@ -177,7 +249,8 @@ namespace vp {
      * Master binding methods
      */
 
-    // Can be called to allocate an IO request.
+    // Can be called to allocate an IO request. Requests are taken from a pool owned by this
+    // port and must be given back with req_del.
     inline IoReq *req_new(uint64_t addr, uint8_t *data, uint64_t size, bool is_write);
 
     // Can be called to deallocate an IO request.
@@ -186,6 +259,16 @@ namespace vp {
     // Return if this master port is bound.
     bool is_bound();
 
+    // Return if the slave port bound to this port can handle burst requests.
+    inline bool is_burst_supported() { return this->burst_support; }
+
+    // Return if the specified slave port can handle burst requests, for requests sent with
+    // the req method taking a slave port.
+    inline bool is_burst_supported(IoSlave *port);
+
+    // Called by the slave port to change the request callback after the binding is done.
+    inline void set_slave_req_meth(IoReqMeth *meth);
+
     // Can be called by master component to send an IO request.  
     inline IoReqStatus req(IoReq *req);
 
@@ -312,6 +395,12 @@ namespace vp {
     // For that, a slave port is associated to each master port and can
     // be used by the real slave port to reply to a specific master port.
     IoSlave *SlavePort = NULL;
+
+    // Requests allocated with req_new
+    vp::Pool<IoReq> req_pool;
+
+    // True if the slave port can handle burst requests
+    bool burst_support = false;
   };
 
 
@@ -358,6 +447,17 @@ namespace vp {
     // when calling the callback, and can be used to multiplex a slave port
     inline void set_req_meth_muxed(IoReqMethMuxed *meth, int id);
 
+    // Set the request callback to be used instead of the one set with set_req_meth, while
+    // the component owning this port is instrumented (see vp::Block::is_instrumented).
+    // The callback set with set_req_meth can then skip all trace and power checks. The master
+    // ports bound to this port are rebound each time the instrumentation changes.
+    // This can not be used with multiplexed ports.
+    inline void set_req_meth_instrumented(IoReqMeth *meth);
+
+    // Declare that the request callback can handle burst requests. This must be set before
+    // the port is bound.
+    inline void set_burst_support(bool support) { this->burst_support = support; }
+
 
 
     /*
@@ -388,6 +488,17 @@ namespace vp {
     // Default request callback, just do nothing.
     static inline IoReqStatus req_default(IoSlave *, IoReq *);
 
+    // Request callbacks for the fast and instrumented cases, when they are different
+    IoReqMeth *req_meth_fast = NULL;
+    IoReqMeth *req_meth_instrumented = NULL;
+
+    // Master ports bound to this port, for rebinding them
+    std::vector<IoMaster *> masters;
+
+    // Select the request callback depending on the owner instrumentation and rebind the
+    // masters if it changed
+    inline void update_req_meth();
+
     // Multiplexed request callback set by the user.
     // Similar to the req callback but with an associated data.
     // This one gets called instead of the normal once in case it is not NULL
@@ -446,6 +557,9 @@ namespace vp {
     // so that the stub is working well.
     vp::Block *master_context_for_freq_cross;
 
+    // True if the request callback can handle burst requests
+    bool burst_support = false;
+
   };
 
 
@@ -490,8 +604,13 @@ namespace vp {
 
   inline IoReq *IoMaster::req_new(uint64_t addr, uint8_t *data, uint64_t size, bool is_write)
   {
-    // For now we allocate new requests but this would be better to manage a pool of requests
-    IoReq *req = new IoReq(addr, data, size, is_write);
+    IoReq *req = this->req_pool.alloc();
+    req->addr = addr;
+    req->data = data;
+    req->size = size;
+    req->is_write = (IoReqOpcode)is_write;
+    req->initiator = -1;
+    req->init();
 
     return req;
   }
@@ -500,7 +619,7 @@ namespace vp {
 
   inline void IoMaster::req_del(IoReq *req)
   {
-    delete req;
+    this->req_pool.free(req);
   }
 
 
@@ -539,6 +658,8 @@ namespace vp {
     vp_assert(port != NULL, this->get_owner()->get_trace(),
       "Binding to NULL slave port\n");
 
+    this->burst_support = port->burst_support;
+
     if (port->req_meth_mux == NULL)
     {
       // Normal binding, just register the method and context into the master
@@ -628,6 +749,7 @@ namespace vp {
     // to the correct master port
     SlavePort::bind_to(_port, config);
     IoMaster *port = (IoMaster *)_port;
+    this->masters.push_back(port);
     port->SlavePort = new IoSlave();
     port->SlavePort->remote_port = port;
     port->SlavePort->set_owner(this->get_owner());
@@ -700,6 +822,39 @@ namespace vp {
   }
 
 
+  inline void IoMaster::set_slave_req_meth(IoReqMeth *meth)
+  {
+    // The slave method is hidden behind the stub when crossing frequency domains
+    if (this->req_meth == (IoReqMeth *)&IoMaster::req_freq_cross_stub)
+    {
+      this->req_meth_freq_cross = meth;
+    }
+    else
+    {
+      this->req_meth = meth;
+    }
+  }
+
+  inline void IoSlave::set_req_meth_instrumented(IoReqMeth *meth)
+  {
+    this->req_meth_instrumented = meth;
+  }
+
+  inline void IoSlave::update_req_meth()
+  {
+    IoReqMeth *meth = this->get_owner()->is_instrumented() ? this->req_meth_instrumented :
+      this->req_meth_fast;
+
+    if (meth != this->req_meth)
+    {
+      this->req_meth = meth;
+      for (IoMaster *master : this->masters)
+      {
+        master->set_slave_req_meth(meth);
+      }
+    }
+  }
+
   inline void IoSlave::finalize()
   {
     // We have to instantiate a stub in case the binding is crossing different
@@ -713,6 +868,156 @@ namespace vp {
         ((IoMaster *)this->remote_port)->SlavePort->set_freq_stub();
       }
     }
+
+    if (this->req_meth_instrumented && this->req_meth_fast == NULL)
+    {
+      this->req_meth_fast = this->req_meth;
+      this->get_owner()->register_instrumentation_callback([this]() { this->update_req_meth(); });
+      this->update_req_meth();
+    }
+  }
+
+  inline IoReq::IoReq(const IoReq &other)
+  {
+    *this = other;
+  }
+
+  inline IoReq &IoReq::operator=(const IoReq &other)
+  {
+    if (this == &other)
+    {
+      return *this;
+    }
+
+    // The argument stack must not be shared, only its content is copied
+    vp::QueueElem::operator=(other);
+    this->addr = other.addr;
+    this->data = other.data;
+    this->size = other.size;
+    this->is_write = other.is_write;
+    this->status = other.status;
+    this->resp_port = other.resp_port;
+    this->initiator = other.initiator;
+    this->latency = other.latency;
+    this->duration = other.duration;
+    this->current_arg = other.current_arg;
+
+    if (other.ext)
+    {
+      IoReqExtension *ext = this->get_ext();
+      memcpy(ext, other.ext, offsetof(IoReqExtension, next));
+    }
+    else
+    {
+      if (this->ext)
+      {
+        this->release_ext();
+      }
+      memcpy(this->inline_args, other.inline_args, sizeof(this->inline_args));
+    }
+
+    return *this;
+  }
+
+  inline IoReq::~IoReq()
+  {
+    if (this->ext)
+    {
+      IoReqExtension::free(this->ext);
+    }
+  }
+
+  inline IoReqExtension *IoReq::get_ext()
+  {
+    if (this->ext == NULL)
+    {
+      this->ext = IoReqExtension::alloc();
+      memcpy(this->ext->args, this->inline_args, sizeof(this->inline_args));
+      this->ext->second_data = NULL;
+      this->ext->actual_size = 0;
+      this->ext->req_next = NULL;
+      this->ext->burst_chunk = 0;
+    }
+    return this->ext;
+  }
+
+  inline void IoReq::release_ext()
+  {
+    IoReqExtension::free(this->ext);
+    this->ext = NULL;
+  }
+
+  inline bool IoMaster::is_burst_supported(IoSlave *port)
+  {
+    return port->burst_support;
+  }
+
+  inline uint64_t IoReq::get_burst_span()
+  {
+    uint64_t last = this->get_burst_nb_chunks() - 1;
+    return last * this->ext->burst_addr_stride + this->size - last * this->ext->burst_chunk;
+  }
+
+  inline IoReqStatus IoReq::burst_split(vp::Block *context, IoReqMeth *meth)
+  {
+    uint64_t init_addr = this->addr;
+    uint8_t *init_data = this->data;
+    uint64_t addr = this->addr;
+    uint64_t size = this->size;
+    uint8_t *data = this->data;
+    uint64_t chunk = this->ext->burst_chunk;
+    int64_t addr_stride = this->ext->burst_addr_stride;
+    int64_t data_stride = this->ext->burst_data_stride;
+    int64_t latency = this->latency;
+    int64_t max_latency = latency;
+    IoReqStatus status = IO_REQ_OK;
+
+    this->ext->burst_chunk = 0;
+
+    uint64_t remaining = size;
+    while (remaining)
+    {
+      uint64_t chunk_size = remaining < chunk ? remaining : chunk;
+      remaining -= chunk_size;
+
+      this->addr = addr;
+      this->size = chunk_size;
+      this->data = data;
+      this->latency = latency;
+
+      status = meth(context, this);
+      if (status != IO_REQ_OK)
+      {
+        if (status == IO_REQ_PENDING && remaining == 0)
+        {
+          return status;
+        }
+        if (status == IO_REQ_PENDING)
+        {
+          status = IO_REQ_INVALID;
+        }
+        break;
+      }
+
+      if (this->latency > max_latency)
+      {
+        max_latency = this->latency;
+      }
+
+      addr += addr_stride;
+      if (data)
+      {
+        data += data_stride;
+      }
+    }
+
+    this->addr = init_addr;
+    this->size = size;
+    this->data = init_data;
+    this->latency = max_latency;
+    this->get_ext()->burst_chunk = chunk;
+
+    return status;
   }
 
   inline void IoReq::save()
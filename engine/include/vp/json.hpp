@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "string.h"
 
 namespace js {
@@ -52,8 +53,12 @@ namespace js {
     virtual Config *get_elem(int) { return NULL; }
     virtual size_t get_size() { return 0; }
     virtual bool get_bool() { return false; }
-    virtual Config *get_from_list(std::vector<std::string>) {
-      return NULL;
+    virtual Config *get_from_list(std::vector<std::string> name_list) {
+      return this->get_from_path(name_list, 0);
+    }
+    // Resolve the path starting at element index without copying the path.
+    virtual Config *get_from_path(const std::vector<std::string> &path, size_t index) {
+      return index == path.size() ? this : NULL;
     }
 
     virtual int get_child_int(std::string) { return 0; }
@@ -68,6 +73,9 @@ namespace js {
     }
     Config *create_config(jsmntok_t *tokens, int *_size);
 
+    // Serialize this node and its sub-tree into the binary cache format
+    virtual void dump_binary(std::string &buffer) {}
+
     std::map<std::string, Config *> childs;
   };
 
@@ -76,9 +84,10 @@ namespace js {
 
   public:
     ConfigObject(jsmntok_t *tokens, int *size=NULL);
+    ConfigObject() {}
 
     Config *get(std::string name);
-    Config *get_from_list(std::vector<std::string> name_list);
+    Config *get_from_path(const std::vector<std::string> &path, size_t index);
     std::map<std::string, Config *> get_childs() { return childs; }
 
     int get_child_int(std::string name);
@@ -86,7 +95,16 @@ namespace js {
     std::string get_child_str(std::string name);
 
     void dump(std::string indent="");
+    void dump_binary(std::string &buffer);
+
+  private:
+    // Build the descendant index used to resolve "**/<name>" paths
+    void build_index();
+    void build_index_from(ConfigObject *object, std::unordered_map<std::string, int> &blocked);
 
+    // For each key, the objects of the sub-tree having a child with this key, in the order
+    // in which a recursive walk would find them. Built lazily on the first "**" lookup.
+    std::unordered_map<std::string, std::vector<ConfigObject *>> *descendants = NULL;
   };
 
   class ConfigArray : public Config
@@ -94,7 +112,7 @@ namespace js {
 
   public:
     ConfigArray(jsmntok_t *tokens, int *size=NULL);
-    Config *get_from_list(std::vector<std::string> name_list);
+    ConfigArray(std::vector<Config *> elems) : elems(elems) {}
 
     std::vector<Config *> get_elems() { return elems; }
     Config *get_elem(int index) { return elems[index]; }
@@ -102,6 +120,7 @@ namespace js {
     size_t get_size() { return elems.size(); }
 
     void dump(std::string indent="");
+    void dump_binary(std::string &buffer);
 
   private:
     std::vector<Config *> elems;
@@ -113,12 +132,13 @@ namespace js {
 
   public:
     ConfigString(jsmntok_t *tokens);
-    Config *get_from_list(std::vector<std::string> name_list);
+    ConfigString(std::string value) : value(value) {}
     std::string get_str() { return value; }
     long long int get_int() { return strtoll(value.c_str(), NULL, 0); }
     bool get_bool() { return strcmp(value.c_str(), "True") == 0 ||  strcmp(value.c_str(), "true") == 0; }
 
     void dump(std::string indent="");
+    void dump_binary(std::string &buffer);
 
   private:
     std::string value;
@@ -130,11 +150,12 @@ namespace js {
 
   public:
     ConfigNumber(jsmntok_t *tokens);
+    ConfigNumber(double value) : value(value) {}
     long long int get_int() { return (long long int)value; }
     double get_double() { return value; }
-    Config *get_from_list(std::vector<std::string> name_list);
 
     void dump(std::string indent="");
+    void dump_binary(std::string &buffer);
 
   private:
     double value;
@@ -146,10 +167,11 @@ namespace js {
 
   public:
     ConfigBool(jsmntok_t *tokens);
+    ConfigBool(bool value) : value(value) {}
     bool get_bool() { return (bool)value; }
-    Config *get_from_list(std::vector<std::string> name_list);
 
     void dump(std::string indent="");
+    void dump_binary(std::string &buffer);
 
   private:
     bool value;
@@ -157,7 +179,14 @@ namespace js {
 
   Config *import_config_from_string(std::string ConfigString);
 
-  Config *import_config_from_file(std::string config_path);
+  /**
+   * @brief Import a JSON configuration from a file
+   *
+   * If a cache path is given, a binary image of the parsed tree is stored there, tagged with a
+   * hash of the JSON content. Next imports of the same content are then loaded from this image,
+   * which skips tokenizing and number parsing.
+   */
+  Config *import_config_from_file(std::string config_path, std::string cache_path="");
 
 }
 
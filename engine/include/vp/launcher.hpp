@@ -59,9 +59,12 @@ class GvsocLauncher : public gv::Gvsoc
         void report_start() override;
         void report_stop() override;
         gv::PowerReport *report_get() override;
+        void sampler_start(gv::PowerSamplerConfig &config) override;
+        void sampler_stop() override;
 
         int64_t step(int64_t duration) override;
         int64_t step_until(int64_t timestamp) override;
+        int run_until(std::vector<gv::StopCondition> &conditions) override;
 
         int join() override;
 
@@ -71,6 +74,8 @@ class GvsocLauncher : public gv::Gvsoc
 
         void release() override;
 
+        int64_t get_time() override;
+
         void update(int64_t timestamp);
 
         gv::Io_binding *io_bind(gv::Io_user *user, std::string comp_name, std::string itf_name) override;
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <unordered_set>
+
+namespace vp
+{
+    /**
+     * @brief Pool of objects
+     *
+     * Objects given back to the pool are kept in a free list and returned by the next
+     * allocations instead of being deleted, so that objects allocated on hot paths do not
+     * go through new and delete in steady state.
+     * A reused object is returned as it was given back, it is up to the caller to initialize it.
+     * A pool is not thread-safe, it must be owned by a component, which accesses it with the
+     * engine locked, or by a thread.
+     *
+     * In debug mode (VP_TRACE_ACTIVE), the pool tracks the objects which are allocated, reports
+     * objects freed twice or not coming from the pool, and reports leaked objects when it is
+     * destroyed.
+     */
+    template<class T>
+    class Pool
+    {
+    public:
+        /**
+         * @brief Construct a new pool
+         *
+         * @param name Name of the pool, used for reporting leaks.
+         */
+        Pool(std::string name="") : name(name) {}
+
+        // The pool owns the objects of its free list, copying it would delete them twice
+        Pool(const Pool &) = delete;
+        Pool &operator=(const Pool &) = delete;
+
+        ~Pool()
+        {
+#ifdef VP_TRACE_ACTIVE
+            if (this->used.size() != 0)
+            {
+                fprintf(stderr, "Pool %s destroyed with %ld objects not freed\n", this->name.c_str(),
+                    this->used.size());
+            }
+#endif
+            for (T *object : this->free_list)
+            {
+                delete object;
+            }
+        }
+
+        /**
+         * @brief Allocate an object
+         *
+         * The arguments are only used if a new object has to be constructed.
+         *
+         * @return The object
+         */
+        template<typename... Args>
+        inline T *alloc(Args... args)
+        {
+            T *object;
+            if (this->free_list.size() != 0)
+            {
+                object = this->free_list.back();
+                this->free_list.pop_back();
+            }
+            else
+            {
+                object = new T(args...);
+            }
+#ifdef VP_TRACE_ACTIVE
+            this->used.insert(object);
+#endif
+            return object;
+        }
+
+        /**
+         * @brief Give back an object
+         *
+         * @param object The object, which must have been allocated from this pool.
+         */
+        inline void free(T *object)
+        {
+#ifdef VP_TRACE_ACTIVE
+            if (this->used.erase(object) == 0)
+            {
+                fprintf(stderr, "Pool %s: freeing object %p which is not allocated\n",
+                    this->name.c_str(), object);
+                abort();
+            }
+#endif
+            this->free_list.push_back(object);
+        }
+
+    private:
+        std::string name;
+        std::vector<T *> free_list;
+        // Objects currently allocated, only maintained in debug mode
+        std::unordered_set<T *> used;
+    };
+};
@@ -30,6 +30,7 @@ namespace vp
 
 class SlavePort;
 class Component;
+class StopCondition;
 
 class Port
 {
@@ -114,9 +115,19 @@ public:
 
     std::vector<vp::SlavePort *> get_final_ports();
 
+    // Tell the condition each time an update changing the value is sent through this port,
+    // until unwatch is called. Returns false if the port does not support it.
+    virtual bool watch(vp::StopCondition *condition) { return false; }
+    virtual void unwatch() {}
+
 protected:
+    // Tell the watching condition that an update was sent
+    void watch_hit();
+
     // Tell if the port is bound to a final slave port
     bool is_bound_to_port = false;
+    // Condition watching this port, if any
+    vp::StopCondition *watch_condition = NULL;
 
 private:
     // Slave ports to which this one is connected. This may be virtual ports
@@ -119,6 +119,17 @@ namespace vp
 
         double get_instant_power(double &dynamic_power, double &static_power);
 
+        /**
+         * @brief Get the energy of the report window
+         *
+         * Get the dynamic and leakage energy consumed by this component since the begining of the
+         * current report window (since report_start was called).
+         *
+         * @param dynamic Report dynamic energy here
+         * @param leakage Report leakage energy here
+         */
+        void get_report_energy(double &dynamic, double &leakage);
+
         gv::PowerReport *get_report() { return &this->report; }
 
         virtual void dump_traces(FILE *file);
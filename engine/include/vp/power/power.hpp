@@ -61,6 +61,7 @@ namespace vp
 #define VP_POWER_DEFAULT_FREQ 50000000
 
     class PowerLinearTable;
+    class PowerSampler;
     class PowerEngine;
     class PowerSource;
     class PowerTrace;
@@ -73,6 +74,19 @@ namespace vp
         ON=1
     };
 
+    // How quantums of energy are accounted, given by the property power/quantum_mode
+    enum PowerQuantumMode
+    {
+        // Quantums are only counted while no VCD power trace is active, and their energy
+        // is computed when it is read
+        POWER_QUANTUM_COUNT,
+        // Quantums are always accounted immediately to the trace and its parents
+        POWER_QUANTUM_IMMEDIATE,
+        // Quantums are accounted immediately and also counted, and reports check that both
+        // give the same energy
+        POWER_QUANTUM_CHECK
+    };
+
     /**
      * @brief Used to model a power source
      *
@@ -91,6 +105,7 @@ namespace vp
     class PowerSource
     {
         friend class vp::BlockPower;
+        friend class vp::PowerTrace;
 
     public:
         /**
@@ -187,6 +202,16 @@ namespace vp
     private:
         void check();
 
+        // Energy of all the quantums accounted since the beginning of the simulation
+        inline double get_quantum_energy();
+
+        // Same as get_quantum_energy but excluding the quantums accounted during the current
+        // cycle
+        inline double get_quantum_energy_before_cycle();
+
+        // Energy of the quantums accounted at the timestamp of the last quantum
+        inline double get_quantum_energy_last_cycle();
+
         PowerLinearTable *dyn_table = NULL;  // Table of power values for all supported temperatures and voltages
                                     // imported from the json configuration given when trace was initialized.
         PowerLinearTable *leakage_table = NULL;  // Table of power values for all supported temperatures and voltages
@@ -210,6 +235,16 @@ namespace vp
         double current_temp;
         double current_volt;
         double current_freq;
+
+        // When VCD power traces are not active, quantums of energy are only counted and the
+        // energy is computed when it is needed, from the count and the current quantum.
+        // The energy of the quantums of the last cycle is the difference between the current
+        // values and the ones before the cycle.
+        uint64_t quantum_count = 0;         // Number of quantums accounted with the current quantum
+        double quantum_count_energy = 0;    // Energy of quantums accounted with previous quantums
+        int64_t quantum_cycle_timestamp = -1; // Timestamp of the last quantum accounted
+        uint64_t quantum_cycle_count = 0;   // Value of quantum_count before the current cycle
+        double quantum_cycle_energy = 0;    // Value of quantum_count_energy before the current cycle
     };
 
 
@@ -251,6 +286,16 @@ namespace vp
          */
         inline bool get_active() { return trace.get_event_active(); }
 
+        /**
+         * @brief Register a callback called when the trace is enabled or disabled
+         *
+         * This can be used by models to select a faster implementation while the trace is
+         * inactive.
+         *
+         * @param callback Callback to be called.
+         */
+        void register_callback(std::function<void()> callback) { this->trace.register_callback(callback); }
+
         /**
          * @brief Dump the trace
          *
@@ -386,6 +431,38 @@ namespace vp
         // of the report windows (since report_start was called)
         inline double get_report_leakage_energy();
 
+        // Return the energy of the quantums counted by the power sources of this trace and
+        // of its child traces, as it would have been accounted to this trace immediately,
+        // including or not the current cycle.
+        double get_counted_energy(bool before_cycle=false);
+
+        // Return the energy of the quantums counted by the power sources of this trace and
+        // of its child traces, as it would have been accounted to a parent trace. A quantum is
+        // accounted to parents as a power over the cycle following it, so part of the last
+        // cycle may not be accounted yet.
+        double get_counted_parent_energy();
+
+        // Return the instant power of the quantums counted by the power sources of this trace
+        // and of its child traces, which is their power over the cycle following them.
+        double get_counted_power();
+
+        // Set how quantums of energy are accounted
+        void set_quantum_mode(PowerQuantumMode mode);
+
+        // Check if this trace or one of its parents is dumping VCD traces, in which case
+        // quantums of energy must be accounted immediately to get the instant power.
+        void check_vcd_active();
+
+        // Account the power of quantums accounted immediately by child traces, in check mode
+        void check_inc_quantum_power(double power_incr);
+
+        // Account the energy of the power of quantums accounted immediately by child traces,
+        // in check mode
+        void check_account_quantum_power();
+
+        // Compare the energy of quantums accounted immediately and counted, in check mode
+        void check_counted_energy(double counted_energy);
+
         // Dump VCD trace reporting the power consumption
         // This should be called everytime the energy consumed in the current cycle
         // or the current background or leakage power is modified.
@@ -445,6 +522,21 @@ namespace vp
         double instant_static_power;// Instant static power of the current cycle. This is updated everytime
                                     // background or leakage power is updated and also when a quantum of energy is 
                                     // accounted, in order to proerly update the VCD trace
+
+        bool vcd_active = false;          // True if this trace or one of its parents is dumping VCD traces
+        PowerQuantumMode quantum_mode = POWER_QUANTUM_COUNT; // How quantums of energy are accounted
+        bool quantum_immediate = false;   // True if quantums are accounted immediately
+        bool quantum_counted = true;      // True if quantums are counted by the power sources
+        std::vector<PowerSource *> sources; // Power sources reporting to this trace
+        std::vector<PowerTrace *> childs;   // Traces whose power is also accounted to this trace
+        double report_counted_energy = 0; // Energy of counted quantums when the report was started
+
+        double check_quantum_energy = 0;  // In check mode, energy of the quantums accounted immediately
+                                            // since the report was started
+        double check_quantum_power = 0;   // In check mode, part of current_dynamic_power coming from
+                                            // the quantums of child traces
+        int64_t check_quantum_power_timestamp = 0; // In check mode, time where check_quantum_power
+                                                    // was last converted to energy
     };
 
 
@@ -469,7 +561,7 @@ namespace vp
 
         ~PowerEngine();
 
-        void init(vp::Block *top);
+        void init(vp::Block *top, js::Config *config);
 
         /**
          * @brief Start power report generation
@@ -487,6 +579,23 @@ namespace vp
 
         double get_average_power(double &dynamic_power, double &static_power);
 
+        /**
+         * @brief Start the power sampler
+         *
+         * The energy of the specified blocks is periodically dumped to a file.
+         *
+         * @param config Sampler configuration.
+         * @param error If not NULL, an invalid configuration is reported here instead of
+         *     being fatal.
+         * @return 0 if the sampler was started, -1 if the configuration is invalid.
+         */
+        int sampler_start(gv::PowerSamplerConfig &config, std::string *error=NULL);
+
+        /**
+         * @brief Stop the power sampler
+         */
+        void sampler_stop();
+
     protected:
         /**
          * @brief Register a new trace
@@ -500,9 +609,13 @@ namespace vp
     private:
         std::vector<vp::PowerTrace *> traces; // Vector of all traces.
 
+        PowerQuantumMode quantum_mode = POWER_QUANTUM_COUNT; // How quantums of energy are accounted
+
         vp::Block *top;  // Top component of the simulated architecture
 
         FILE *file; // File where the power reports are dumped
+
+        PowerSampler *sampler = NULL; // Sampler of the energy over time, created when first used
     };
 
     vp::PowerEngine *get_power_engine();
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#pragma once
+
+#include <vp/vp.hpp>
+#include <gv/gvsoc.hpp>
+
+#define VP_POWER_SAMPLER_MAGIC "GVPWRSMP"
+#define VP_POWER_SAMPLER_VERSION 1
+
+namespace vp
+{
+    /**
+     * @brief Periodic sampler of the energy consumed by a set of blocks
+     *
+     * A single event, either a time event or a clock event of the chosen clock domain, reads at
+     * each period the energy of the report window of the sampled blocks and appends it to a
+     * CSV or binary file. Power traces are not involved, so that sampling does not need VCD
+     * power traces to be enabled.
+     */
+    class PowerSampler : public vp::Block
+    {
+    public:
+        /**
+         * @brief Construct a new sampler
+         *
+         * @param top    Top block of the simulated system, where sampled blocks are looked up.
+         * @param config Optional configuration. If it is given, sampling starts at reset.
+         */
+        PowerSampler(vp::Block *top, gv::PowerSamplerConfig *config=NULL);
+        ~PowerSampler();
+
+        void reset(bool active) override;
+
+        /**
+         * @brief Start sampling
+         *
+         * If the sampler is already started, it is first stopped.
+         *
+         * @param config Sampler configuration.
+         * @param error If not NULL, an invalid configuration is reported here instead of
+         *     being fatal.
+         * @return 0 if the sampler was started, -1 if the configuration is invalid.
+         */
+        int start(gv::PowerSamplerConfig &config, std::string *error=NULL);
+
+        /**
+         * @brief Stop sampling
+         *
+         * A last sample is taken and the file is closed.
+         */
+        void stop();
+
+    private:
+        // Report an invalid configuration, either to the caller or as a fatal error
+        int config_error(std::string *error, const char *fmt, ...);
+        // Read the energy of all the sampled blocks and write it to the file
+        void sample();
+        // Schedule the next sample
+        void enqueue();
+        static void time_handler(vp::Block *__this, vp::TimeEvent *event);
+        static void clock_handler(vp::Block *__this, vp::ClockEvent *event);
+
+        vp::Block *top;
+        gv::PowerSamplerConfig config;
+        // True if the sampler was configured from the GVSOC configuration, and must be started
+        // at reset
+        bool start_on_reset = false;
+        bool started = false;
+        bool is_binary;
+        FILE *file = NULL;
+        std::vector<vp::Block *> blocks;
+        vp::TimeEvent *time_event = NULL;
+        vp::ClockEvent *clock_event = NULL;
+        int64_t last_timestamp = -1;
+        // Energies of the current sample, for binary files
+        std::vector<double> energies;
+    };
+};
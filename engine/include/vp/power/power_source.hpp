@@ -103,7 +103,51 @@ inline void vp::PowerSource::account_energy_quantum()
     // Only account energy is a quantum is defined
     if (this->is_on && this->quantum != -1)
     {
-        this->trace->inc_dynamic_energy(this->quantum);
+        // The instant power is only needed for VCD traces, otherwise just count the quantum,
+        // the energy is computed when reports are requested
+        if (this->trace->quantum_immediate)
+        {
+            this->trace->inc_dynamic_energy(this->quantum);
+        }
+
+        if (this->trace->quantum_counted && this->trace->top->clock.get_period() != 0)
+        {
+            int64_t timestamp = this->top->time.get_time();
+            if (timestamp != this->quantum_cycle_timestamp)
+            {
+                this->quantum_cycle_timestamp = timestamp;
+                this->quantum_cycle_count = this->quantum_count;
+                this->quantum_cycle_energy = this->quantum_count_energy;
+            }
+            this->quantum_count++;
+        }
     }
 #endif
 }
+
+
+
+inline double vp::PowerSource::get_quantum_energy()
+{
+    return this->quantum_count_energy + this->quantum_count * this->quantum;
+}
+
+
+
+inline double vp::PowerSource::get_quantum_energy_before_cycle()
+{
+    if (this->quantum_cycle_timestamp == this->top->time.get_time())
+    {
+        return this->quantum_cycle_energy + this->quantum_cycle_count * this->quantum;
+    }
+
+    return this->get_quantum_energy();
+}
+
+
+
+inline double vp::PowerSource::get_quantum_energy_last_cycle()
+{
+    return this->get_quantum_energy() -
+        (this->quantum_cycle_energy + this->quantum_cycle_count * this->quantum);
+}
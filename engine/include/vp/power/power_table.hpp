@@ -25,16 +25,16 @@
 
 namespace vp
 {
-    class PowerLinearTempTable;
-    class PowerLinearVoltTable;
-    class PowerLinearFreqTable;
-
     /**
      * @brief Power values of a power characteristic
      * 
      * This manages the actual power value of a power characteristic, depending on current
      * temperature, voltage and frequency.
      * The value is interpolated, based on power numbers at various voltages, temperatures and frequencies.
+     *
+     * The JSON tables are flattened at construction into sorted arrays of temperatures, voltages
+     * and frequencies, and the last resolved operating points are cached, since DVFS usually goes
+     * through a few operating points.
      */
     class PowerLinearTable
     {
@@ -59,99 +59,36 @@ namespace vp
         double get(double temp, double volt, double frequency);
 
     private:
-        // Vector of power tables at supported temperatures
-        std::vector<PowerLinearTempTable *> temp_tables;
-    };
-
-    /**
-     * @brief Power values of a power characteristic at a given temperature
-     */
-    class PowerLinearTempTable
-    {
-    public:
-        /**
-         * @brief Construct a new PowerLinearTempTable object
-         * 
-         * @param temp   Temperature for which this table is valid
-         * @param config JSON config containing the power numbers
-         */
-        PowerLinearTempTable(double temp, js::Config *config);
-
-        /**
-         * @brief Get the power value at specified voltage and frequency
-         * 
-         * The value is interpolated from the tables extracted from JSON tables.
-         * These tables contains the power values at different voltages and frequencies
-         * at the temperature for which this class has been created.
-         * 
-         * @param volt         Voltage
-         * @param frequency    Frequency
-         * @return double      The estimated power value
-         */
-        double get(double volt, double frequency);
-
-        /**
-         * @brief Get temperature for which this class has been created
-         * 
-         * @return double Temperature
-         */
-        inline double get_temp() { return this->temp; }
-
-    private:
-        std::vector<PowerLinearVoltTable *> volt_tables;   // Power tables at various voltages
-        double temp;           // Temperature for which this table has been created
-    };
-
-    /**
-     * @brief Power values of a power characteristic at a given temperature and voltage
-     */
-    class PowerLinearVoltTable
-    {
-    public:
-        /**
-         * @brief Construct a new PowerLinearVoltTable object
-         * 
-         * @param volt      Voltage for which the power numbers are defined.
-         * @param config    JSON config giving the power numbers for various frequencies at the specified voltage
-         */
-        PowerLinearVoltTable(double volt, js::Config *config);
-
-        /**
-         * @brief Get the power number at the specified frequency
-         * 
-         * The value is interpolated from the tables extracted from JSON tables.
-         * These tables contains the power values at different frequencies
-         * at the voltage and temperature for which this class has been created.
-         * 
-         * @param frequency Frequency at which the power number should be given
-         * @return double 
-         */
-        double get(double frequency);
-
-        /**
-         * @brief Get voltage for which this class has been created
-         * 
-         * @return double Voltage
-         */
-        inline double get_volt() { return this->volt; }
-
-    private:
-        std::vector<PowerLinearFreqTable *> freq_tables;   // Power tables at various frequencies
-        PowerLinearFreqTable *any=NULL;
-        double volt;     // Voltage for which this class has been instantiated
-    };
-
-    class PowerLinearFreqTable
-    {
-    public:
-        PowerLinearFreqTable(double freq, js::Config *config);
-
-        inline double get_freq() { return this->freq; }
-        inline double get() { return this->value; }
-
-    private:
-        double freq;
-        double value;
+        // Value interpolated from the tables, without the cache
+        double compute(double temp, double volt, double frequency);
+        // Value interpolated from the voltage tables of the specified temperature
+        double get_at_temp(int temp_index, double volt, double frequency);
+        // Value interpolated from the frequency table of the specified voltage
+        double get_at_volt(int volt_index, double frequency);
+
+        // Supported temperatures, sorted
+        std::vector<double> temps;
+        // Index in volts of the first voltage of each temperature, plus the end index
+        std::vector<int> temp_volts;
+        // Supported voltages of all temperatures, sorted for each temperature
+        std::vector<double> volts;
+        // Index in freqs of the first frequency of each voltage, plus the end index
+        std::vector<int> volt_freqs;
+        // Supported frequencies of all voltages, sorted for each voltage
+        std::vector<double> freqs;
+        // Power values for each frequency
+        std::vector<double> values;
+
+        // Cache of the last resolved operating points
+        class OperatingPoint
+        {
+        public:
+            double temp;
+            double volt;
+            double frequency;
+            double value;
+        };
+        std::vector<OperatingPoint> cache;
+        int cache_next = 0;
     };
 };
-
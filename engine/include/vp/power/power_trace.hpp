@@ -25,7 +25,7 @@
 
 inline double vp::PowerTrace::get_power()
 {
-    return this->current_power;
+    return this->current_power + this->get_counted_power();
 }
 
 
@@ -62,6 +62,10 @@ inline void vp::PowerTrace::flush_quantum_power_for_cycle()
         if (this->parent)
         {
             this->parent->inc_dynamic_power(-this->quantum_power_for_cycle);
+            if (this->quantum_mode == vp::POWER_QUANTUM_CHECK)
+            {
+                this->parent->check_inc_quantum_power(-this->quantum_power_for_cycle);
+            }
         }
         this->quantum_power_for_cycle = 0;
     }
@@ -76,8 +80,15 @@ inline double vp::PowerTrace::get_report_dynamic_energy()
     // First convert background power to energy
     this->account_dynamic_power();
     
-    // And return the current total
-    return this->report_dynamic_energy;
+    // And return the current total, including the quantums which were only counted
+    double counted_energy = this->get_counted_energy() - this->report_counted_energy;
+    if (this->quantum_mode == vp::POWER_QUANTUM_CHECK)
+    {
+        // Quantums were also accounted immediately, just check that both agree
+        this->check_counted_energy(counted_energy);
+        return this->report_dynamic_energy;
+    }
+    return this->report_dynamic_energy + counted_energy;
 }
 
 
@@ -19,10 +19,110 @@
 #define __VP_PROXY_HPP__
 
 #include <mutex>
+#include <functional>
 #include <vp/launcher.hpp>
 
+// Version of the binary protocol, which a client enters by sending the text command
+// "binary <version>"
+#define GV_PROXY_BINARY_VERSION 1
+
+// Maximum size of a memory access whose data goes through the frame payload. Bigger
+// accesses must be split or go through the shared memory window.
+#define GV_PROXY_MAX_MEM_ACCESS (16*1024*1024)
+
 namespace gv {
 
+/*
+ * Binary protocol
+ *
+ * Each frame is made of a header followed by size bytes of payload. All fields are
+ * little-endian. The client can send several frames without waiting for the replies, each
+ * command frame gets a reply frame with the same request identifier, in the same order.
+ */
+typedef struct __attribute__((packed))
+{
+    // Size of the payload following the header
+    uint32_t size;
+    // Request identifier, given back in the reply
+    uint32_t req;
+    // Command, see ProxyCmd
+    uint16_t cmd;
+    // Command flags, see PROXY_FLAG_*
+    uint16_t flags;
+    // Reply status, 0 if the command succeeded
+    int32_t status;
+} ProxyFrame;
+
+typedef enum
+{
+    // Text command, with the same syntax as in text mode. The command can be followed by a null
+    // character and data, which the command can read like in text mode. The reply payload is
+    // the reply message.
+    PROXY_CMD_TEXT = 1,
+    // Memory read through a component, the payload is a ProxyMemAccess. The reply payload is
+    // the data read, unless it is read into the shared memory window. Reads bigger than
+    // GV_PROXY_MAX_MEM_ACCESS which do not use the window fail.
+    PROXY_CMD_MEM_READ = 2,
+    // Memory write through a component, the payload is a ProxyMemAccess followed by the data
+    // to write, unless it is in the shared memory window.
+    PROXY_CMD_MEM_WRITE = 3,
+    // Map a shared memory window, the payload is its size on 64 bits followed by the path of
+    // the file to be mapped, e.g. in /dev/shm. A size of 0 unmaps the current window.
+    PROXY_CMD_SHM_MAP = 4,
+    // Batch of command frames, which is the payload. They are executed in order and the
+    // reply is a batch of their reply frames.
+    PROXY_CMD_BATCH = 5,
+    // Reply to a command frame
+    PROXY_CMD_REPLY = 16,
+    // Payload pushed by a component, with the request identifier it was given
+    PROXY_CMD_PAYLOAD = 17,
+    // Notification of an engine state change, the flags is a ProxyNotify and the payload
+    // is the timestamp on 64 bits, or the index of the stop condition which was met, or
+    // nothing when exiting, with the status in the header
+    PROXY_CMD_NOTIFY = 18,
+} ProxyCmd;
+
+typedef enum
+{
+    PROXY_NOTIFY_STOPPED = 0,
+    PROXY_NOTIFY_RUNNING = 1,
+    PROXY_NOTIFY_EXIT = 2,
+    // End of a run_until command, sent before the stop notification
+    PROXY_NOTIFY_CONDITION = 3,
+} ProxyNotify;
+
+// The data of the memory access is in the shared memory window
+#define PROXY_FLAG_SHM 1
+
+typedef struct __attribute__((packed))
+{
+    // Component handling the access, as returned by the get_component command
+    uint64_t component;
+    uint64_t addr;
+    uint64_t size;
+    // Offset of the data in the shared memory window, if PROXY_FLAG_SHM is set
+    uint64_t shm_offset;
+} ProxyMemAccess;
+
+// Connection of a client to the proxy
+class ProxyConnection
+{
+  public:
+    int req_fd;
+    int reply_fd;
+    FILE *req_file;
+    FILE *reply_file;
+    // True if the connection is a socket, which receives notifications
+    bool is_socket;
+    // True once the client has switched to the binary protocol
+    bool is_binary = false;
+    // Shared memory window for bulk memory accesses
+    uint8_t *shm = NULL;
+    uint64_t shm_size = 0;
+    // Buffer for the data of memory reads
+    std::vector<uint8_t> buffer;
+};
+
 class GvProxy : GvsocLauncher_notifier
 {
   public:
@@ -31,14 +131,33 @@ class GvProxy : GvsocLauncher_notifier
     void stop(int status);
     void notify_stop(int64_t time);
     void notify_run(int64_t time);
+    // Return true if the payload could not be sent, including when the connection of reply_file
+    // was closed
     bool send_payload(FILE *reply_file, std::string req, uint8_t *payload, int size);
     
   private:
  
 
     void listener(void);
-    void proxy_loop(int, int);
-    void send_reply(std::string msg);
+    void proxy_loop(ProxyConnection *conn);
+    // Handle text commands until the connection is closed or switches to binary mode
+    void text_loop(ProxyConnection *conn);
+    // Handle binary frames until the connection is closed
+    void binary_loop(ProxyConnection *conn);
+    // Execute a binary frame. The reply is sent, or appended to batch_reply if it is not NULL
+    void handle_frame(ProxyConnection *conn, ProxyFrame *frame, uint8_t *payload,
+        std::vector<uint8_t> *batch_reply);
+    // Execute a text command. Returns false if the command is invalid
+    bool exec_cmd(ProxyConnection *conn, std::vector<std::string> &words, FILE *req_file,
+        std::string req, std::string &msg);
+    int shm_map(ProxyConnection *conn, uint64_t size, std::string path);
+    void send_frame(ProxyConnection *conn, ProxyFrame *frame, uint8_t *payload);
+    void send_notify(ProxyNotify notify, int64_t value);
+    // Disarm the conditions of a run_until command once the engine is stopped, and notify the
+    // condition which was met
+    void run_until_end();
+    // Execute a callback from the engine thread, and wait until it is done
+    void engine_exec(std::function<void()> callback);
     
     int telnet_socket;
     int socket_port;
@@ -46,8 +165,9 @@ class GvProxy : GvsocLauncher_notifier
     std::thread *loop_thread;
     std::thread *listener_thread;
 
-    std::vector<int> sockets;
+    std::vector<ProxyConnection *> connections;
 
+    vp::TimeEngine *engine;
     vp::Component *top;
     int req_pipe;
     int reply_pipe;
@@ -55,6 +175,8 @@ class GvProxy : GvsocLauncher_notifier
     std::mutex mutex;
     gv::GvsocLauncher *launcher;
     bool is_async;
+    // True while stop conditions armed by a run_until command are pending
+    bool run_until_armed = false;
 };
 }
 
@@ -44,12 +44,15 @@ public:
     void report_start() override;
     void report_stop() override;
     gv::PowerReport *report_get() override;
+    void sampler_start(gv::PowerSamplerConfig &config) override;
+    void sampler_stop() override;
 
     void wait_stopped() override;
     void update(int64_t timestamp) override;
 
     int64_t step(int64_t duration) override;
     int64_t step_until(int64_t timestamp) override;
+    int run_until(std::vector<gv::StopCondition> &conditions) override;
 
     int join() override;
 
@@ -60,6 +60,14 @@ inline void vp::TimeEngine::unlock()
     pthread_mutex_unlock(&mutex);
 }
 
+inline void vp::TimeEngine::handle_commands()
+{
+    if (this->commands.load(std::memory_order_relaxed) != NULL)
+    {
+        this->exec_commands();
+    }
+}
+
 inline void vp::TimeEngine::critical_enter()
 {
     pthread_mutex_lock(&mutex);
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#pragma once
+
+#include <vp/vp.hpp>
+#include <gv/gvsoc.hpp>
+
+namespace vp
+{
+    class StopConditions;
+
+    /**
+     * @brief Condition stopping the execution, armed by a run-until request
+     *
+     * Timeouts are handled by the engine. The other conditions are given to the block they
+     * target with Block::stop_condition_arm, and the block calls hit when the condition is
+     * met, until it is disarmed. The engine then stops at the end of the current timestamp.
+     */
+    class StopCondition
+    {
+    public:
+        StopCondition(StopConditions *engine, gv::StopCondition &config, int index);
+
+        /**
+         * @brief Tell the engine the condition is met
+         *
+         * This can be called several times, only the first condition which is met is
+         * reported.
+         */
+        void hit();
+
+        // Description of the condition
+        gv::StopCondition config;
+        // Index of the condition in the run-until request
+        int index;
+
+    private:
+        StopConditions *engine;
+    };
+
+    /**
+     * @brief Set of stop conditions armed by a run-until request
+     */
+    class StopConditions : public vp::Block
+    {
+        friend class StopCondition;
+
+    public:
+        StopConditions(vp::Component *top);
+
+        /**
+         * @brief Arm stop conditions
+         *
+         * Conditions previously armed are first disarmed. A condition may be met as soon as it
+         * is armed, for example if a memory word already has the expected value, in which case
+         * is_hit returns true and the execution should not be started.
+         *
+         * @param conditions The conditions.
+         * @return 0 if all conditions are armed, -1 if one of them is invalid, in which case
+         *     none of them is armed.
+         */
+        int arm(std::vector<gv::StopCondition> &conditions);
+
+        /**
+         * @brief Disarm all stop conditions
+         *
+         * @return The index of the condition which was met, or -1 if none was met.
+         */
+        int disarm();
+
+        /**
+         * @brief Tell if one of the armed conditions was met
+         */
+        bool is_hit() { return this->hit_index != -1; }
+
+    private:
+        // Called by a condition when it is met
+        void condition_hit(StopCondition *condition);
+        static void timeout_handler(vp::Block *__this, vp::TimeEvent *event);
+
+        vp::Component *top;
+        std::vector<StopCondition *> conditions;
+        // Block evaluating each condition, NULL for timeouts
+        std::vector<vp::Block *> blocks;
+        // Master port watched by each wire condition, NULL for the other ones
+        std::vector<vp::MasterPort *> ports;
+        // Event executing the earliest timeout
+        vp::TimeEvent timeout_event;
+        int hit_index = -1;
+    };
+};
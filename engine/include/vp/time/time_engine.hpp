@@ -21,6 +21,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <thread>
 #include "vp/json.hpp"
 
 namespace vp
@@ -28,6 +31,30 @@ namespace vp
     class BlockTime;
     class Component;
     class Time_engine_stop_event;
+    class StopConditions;
+    class TimeEngine;
+
+    /**
+     * @brief Command posted to the time engine by an external thread
+     *
+     * Commands are queued without locking and executed by the engine thread between two
+     * events, where it is safe to interact with the models.
+     */
+    class EngineCommand
+    {
+        friend class vp::TimeEngine;
+
+    public:
+        EngineCommand(std::function<void()> callback) : callback(callback) {}
+
+    private:
+        std::function<void()> callback;
+        EngineCommand *next = NULL;
+        // Set to 1 once the command is executed, used as a futex by the posting thread
+        std::atomic<uint32_t> done{0};
+        // True if the command was allocated by the engine and must be deleted once executed
+        bool is_allocated = false;
+    };
 
     class TimeEngine
     {
@@ -66,6 +93,51 @@ namespace vp
          */
         inline void unlock();
 
+        /**
+         * @brief Post a command to the engine
+         *
+         * The command is pushed to a lock-free queue, which the engine drains between events,
+         * so that the engine does not have to stop and hand over its lock like with lock().
+         * This returns immediately and the callback is executed later by the engine thread.
+         * If it is called from the engine thread, or if the engine has no thread of its own
+         * (synchronous mode), the callback is directly executed with the engine locked.
+         *
+         * @param callback Function to be executed by the engine.
+         */
+        void post(std::function<void()> callback);
+
+        /**
+         * @brief Post a command to the engine without ever waiting for it
+         *
+         * Same as post, except that in synchronous mode, the command is also pushed to the
+         * queue instead of being executed with the engine locked, and is executed the next
+         * time the engine runs. This is for threads which must never wait for the engine
+         * lock, like threads which are joined by models while the engine is locked.
+         *
+         * @param callback Function to be executed by the engine.
+         */
+        void post_async(std::function<void()> callback);
+
+        /**
+         * @brief Post a command to the engine and wait until it is executed
+         *
+         * Same as post, except that the calling thread sleeps until the engine has executed
+         * the callback, so that it can get results from it.
+         *
+         * @param callback Function to be executed by the engine.
+         */
+        void post_sync(std::function<void()> callback);
+
+        /**
+         * @brief Execute the posted commands
+         *
+         * All the commands posted so far are executed, in posting order. The engine does it
+         * between events, but a model which blocks the engine thread while waiting for
+         * something external must also call it regularly, otherwise threads posting commands
+         * wait until the model is done.
+         */
+        inline void handle_commands();
+
         /**
          * @brief Quit simulation
          *
@@ -113,6 +185,13 @@ namespace vp
 
         void handle_locks();
 
+        void exec_commands();
+        // Push a command to the queue and make the engine handle it
+        void push_command(EngineCommand *command);
+        // Wait on the engine condition like critical_wait, unless commands were posted, and
+        // execute the posted commands
+        void critical_wait_commands();
+
         inline int64_t get_next_event_time();
 
         void bind_to_launcher(gv::Gvsoc_user *launcher);
@@ -120,6 +199,9 @@ namespace vp
         int status_get() { return this->stop_status; }
         bool finished_get() { return this->finished; }
 
+        // Stop conditions of run-until requests
+        vp::StopConditions *stop_conditions_get() { return this->stop_conditions; }
+
         gv::Gvsoc_user *launcher_get() { return this->launcher; }
 
         int64_t exec();
@@ -186,8 +268,25 @@ namespace vp
         // simulation at a specific timestamp corresponding to the step
         Time_engine_stop_event *stop_event;
 
+        // Conditions armed by run-until requests, which pause simulation when they are met
+        StopConditions *stop_conditions;
+
         // In synchronous mode, since several threads can control the time, there is a retain
         // mechanism which makes sure time is progressing only if all threads ask for it.
         int retain = 0;
+
+        // True if the engine is run by its own thread (asynchronous mode)
+        bool is_async = false;
+
+        // Thread executing the engine in asynchronous mode
+        std::thread::id engine_thread;
+
+        // Commands posted by external threads. This is a lock-free stack, the engine takes all
+        // of them at once and reverses them to get them in posting order.
+        std::atomic<EngineCommand *> commands{NULL};
+
+        // True while the engine is waiting on its condition, in which case posting a command
+        // must wake it up
+        std::atomic<bool> idle{false};
     };
 };
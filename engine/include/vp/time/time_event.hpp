@@ -127,6 +127,13 @@ namespace vp
          */
         void enqueue(int64_t time);
 
+        /**
+         * @brief Cancel the event
+         *
+         * The event is removed from the time engine queue if it is enqueued.
+         */
+        void cancel();
+
     private:
         // Can be called to set the event as enqueued or not
         inline void set_enqueued(bool enqueued) { this->enqueued = enqueued; }
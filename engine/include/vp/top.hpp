@@ -29,7 +29,7 @@ namespace vp {
   class Top
   {
   public:
-      Top(std::string config_path, bool is_async);
+      Top(std::string config_path, bool is_async, std::string config_cache_path="");
       ~Top();
 
       Component *top_instance;
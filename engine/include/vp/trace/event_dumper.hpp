@@ -63,6 +63,8 @@ namespace vp {
     uint8_t *buffer;
     uint8_t flags;
     void set_vcd_user(gv::Vcd_user *user);
+    // Bits of the value which are in high impedance, only valid if flags is 1
+    uint8_t *get_flags_mask() { return this->flags_mask; }
 
   private:
     Event_file *file;
@@ -79,6 +81,7 @@ namespace vp {
     Event_trace *get_trace_string(std::string trace_name, std::string file_name);
     void close();
     void set_vcd_user(gv::Vcd_user *user);
+    js::Config *get_config() { return this->config; }
 
   private:
     std::map<std::string, Event_trace *> event_traces;
@@ -122,10 +125,28 @@ namespace vp {
     void dump(int64_t timestamp, int id, uint8_t *event, int width, bool is_real, bool is_string, uint8_t flags, uint8_t *flag_mask);
 
   private:
+    // Trace registered before the header is dumped, so that the scope tree is built only once
+    class Fst_var
+    {
+    public:
+      std::string path;
+      int id;
+      int width;
+      bool is_real;
+      bool is_string;
+    };
+
+    void create_var(std::string name, int id, int width, bool is_real, bool is_string);
+    void dump_header();
     std::string parse_path(std::string path, bool begin);
 
     void *writer;
     std::vector<uint32_t> vars;
+    // Last value dumped for each trace, used to drop the value changes which do not change
+    // anything
+    std::vector<std::vector<uint8_t>> values;
+    std::vector<bool> has_value;
+    std::vector<Fst_var> pending_vars;
   };
 
 
@@ -159,10 +159,17 @@ namespace vp {
   #ifdef VP_TRACE_ACTIVE
   	if (is_active && comp->traces.get_trace_engine()->get_trace_level() >= this->level)
     {
-      dump_header();
       va_list ap;
       va_start(ap, fmt);
-      if (vfprintf(this->trace_file, fmt, ap) < 0) {}
+      if (comp->traces.get_trace_engine()->get_logger())
+      {
+        this->msg_deferred(-1, fmt, ap);
+      }
+      else
+      {
+        dump_header();
+        if (vfprintf(this->trace_file, fmt, ap) < 0) {}
+      }
       va_end(ap);  
     }
   #endif
@@ -173,6 +180,15 @@ namespace vp {
   #ifdef VP_TRACE_ACTIVE
     if (is_active && comp->traces.get_trace_engine()->get_trace_level() >= level)
     {
+      if (comp->traces.get_trace_engine()->get_logger())
+      {
+        va_list ap;
+        va_start(ap, fmt);
+        this->msg_deferred(level, fmt, ap);
+        va_end(ap);
+        return;
+      }
+
       dump_header();
       if (level == vp::Trace::LEVEL_ERROR)
       {
@@ -39,6 +39,7 @@ namespace vp {
 
     friend class BlockTrace;
     friend class TraceEngine;
+    friend class TraceLogger;
 
   public:
 
@@ -105,6 +106,9 @@ namespace vp {
     int is_event;
 
   protected:
+    // Hand over the message to the deferred backend of the trace engine
+    void msg_deferred(int level, const char *fmt, va_list ap);
+
     int level;
     Component *comp;
     bool is_event_active = false;
@@ -24,6 +24,7 @@
 
 #include "vp/component.hpp"
 #include "vp/trace/trace.hpp"
+#include "vp/trace/trace_logger.hpp"
 #include "gv/gvsoc.hpp"
 #include <pthread.h>
 #include <thread>
@@ -41,16 +42,124 @@ namespace vp {
     class trace_regex
     {
     public:
-        trace_regex(std::string path, regex_t *regex, std::string file_path, bool is_path=false) : is_path(is_path), path(path), regex(regex), file_path(file_path) {}
+        trace_regex(std::string path, std::string file_path, bool is_path=false);
+        ~trace_regex();
+
+        // Tell if the specified trace path is matched by this regular expression
+        bool match(const std::string &full_path);
 
         bool is_path;
+        // True if the expression has no special character, in which case it matches any path
+        // containing it and can be checked without the regex engine.
+        bool is_literal;
         std::string path;
         regex_t *regex;
         std::string file_path;
     };
 
+    class TracePathNode
+    {
+    public:
+        std::map<std::string, TracePathNode *> childs;
+        std::vector<vp::Trace *> traces;
+    };
+
+    /**
+     * Tree of the registered traces, where each node is a component of the trace paths.
+     *
+     * This is used to get the traces matching a path by walking only the concerned sub-trees,
+     * instead of checking all the traces.
+     */
+    class TracePathTree
+    {
+    public:
+        void add(vp::Trace *trace);
+
+        // Get the traces whose full path starts with the specified path
+        void get_prefixed(std::string path, std::vector<vp::Trace *> &traces);
+
+        // Get the traces whose full path contains the specified path, which must start with '/'
+        void get_containing(std::string path, std::vector<vp::Trace *> &traces);
+
+    private:
+        void get_all(TracePathNode *node, std::vector<vp::Trace *> &traces);
+        void get_from_node(TracePathNode *node, std::vector<std::string> &names, size_t index,
+            std::vector<vp::Trace *> &traces);
+
+        TracePathNode root;
+        // Nodes which are preceded by a '/' in the trace paths, sorted by name
+        std::map<std::string, std::vector<TracePathNode *>> nodes;
+    };
+
+    class TraceWindow;
+    class TraceTriggerTimer;
+    class VcdShmUser;
+
+    /**
+     * Condition opening or closing a trace window.
+     *
+     * A trigger is described by a string "<type>:<value>" for engine triggers, or
+     * "<type>:<component path>:<value>" for triggers evaluated by a component.
+     * Time triggers ("time:<timestamp in ps>") are handled by the engine. The other ones are
+     * retrieved by the component with TraceEngine::get_triggers when it is built, and the
+     * component calls fire when the condition is met. Components must only evaluate triggers
+     * while they have some, so that there is no cost when no trigger is armed.
+     */
+    class TraceTrigger
+    {
+    public:
+        TraceTrigger(TraceWindow *window, bool is_start, std::string desc);
+
+        // Tell the trigger its condition was met. Returns true if the trigger is over and does
+        // not need to be evaluated anymore, or false if it must still be evaluated, which is the
+        // case of a stop trigger whose window has not been opened yet.
+        bool fire();
+
+        // Type of trigger, for example "time", "pc", "insn" or "write"
+        std::string type;
+        // Path of the component evaluating the trigger, empty for engine triggers
+        std::string path;
+        // Value of the condition, whose meaning depends on the type
+        std::string value;
+        // True once the trigger has fired
+        bool done = false;
+
+    private:
+        TraceWindow *window;
+        bool is_start;
+    };
+
+    /**
+     * Set of traces and events enabled only between a start and a stop trigger.
+     * Without start trigger, the window is opened at the beginning of the simulation, and
+     * without stop trigger, it stays opened until the end.
+     */
+    class TraceWindow
+    {
+    public:
+        TraceWindow(TraceEngine *engine, js::Config *config);
+
+        void open();
+        void close();
+
+        TraceTrigger *start = NULL;
+        TraceTrigger *stop = NULL;
+        bool is_open = false;
+
+    private:
+        TraceEngine *engine;
+        // Trace and event paths, with the same syntax as the include_regex options
+        std::vector<std::string> traces;
+        std::vector<std::string> events;
+        // Paths added when the window was opened, which excludes the ones which were already
+        // enabled by other means, so that only these ones are removed when it is closed
+        std::vector<std::string> added_traces;
+        std::vector<std::string> added_events;
+    };
+
     class TraceEngine
     {
+        friend class TraceTriggerTimer;
 
     public:
         TraceEngine(js::Config *config);
@@ -60,6 +169,9 @@ namespace vp {
         
         void set_vcd_user(gv::Vcd_user *user)
         {
+            this->vcd_batch_size = user ? user->event_batch_size() : 0;
+            this->vcd_batch_per_timestamp = user && user->event_batch_per_timestamp();
+            this->vcd_batch.reserve(this->vcd_batch_size);
             this->event_dumper.set_vcd_user(user);
             this->vcd_user = user;
         }
@@ -91,6 +203,10 @@ namespace vp {
         void add_trace_path(int events, std::string path);
         void conf_trace(int event, std::string path, bool enabled);
         void add_exclude_trace_path(int events, std::string path);
+        // Tell if a path was added with add_trace_path
+        bool has_trace_path(int events, std::string path);
+        // Remove a path added with add_trace_path, without excluding the traces it matches
+        void remove_trace_path(int events, std::string path);
         void reg_trace(vp::Trace *trace, int event, string path, string name);
 
         void start();
@@ -107,6 +223,23 @@ namespace vp {
 
         int get_trace_level() { return this->trace_level; }
 
+        // Deferred backend for trace messages, NULL if messages are directly written
+        inline TraceLogger *get_logger() { return this->logger; }
+
+        // Write all the trace messages captured by the deferred backend
+        void flush_messages();
+
+        // Write the trace messages and events kept in memory by the flight recorder.
+        // If final is true, the event files are also closed, which is needed when the process
+        // is about to exit without closing the engine.
+        void dump_recorder(bool final=false);
+
+        // Ask for the flight recorder to be dumped when the engine is closed
+        void request_recorder_dump() { this->recorder_dump_req = true; }
+
+        // Return the triggers which must be evaluated by the component with the specified path
+        std::vector<TraceTrigger *> get_triggers(std::string path);
+
     protected:
         std::map<std::string, Trace *> traces_map;
         std::vector<Trace *> traces_array;
@@ -116,11 +249,18 @@ namespace vp {
 
     private:
         void check_trace_active(vp::Trace *trace, int event = 0);
+        void get_matching_traces(trace_regex *regex, std::vector<vp::Trace *> &traces);
+        void add_pending_path(std::string path, bool is_path=false);
+        void init_triggers();
 
         std::unordered_map<std::string, trace_regex *> trace_regexs;
         std::unordered_map<std::string, trace_regex *> trace_exclude_regexs;
         std::unordered_map<std::string, trace_regex *> events_path_regex;
         std::unordered_map<std::string, trace_regex *> events_exclude_path_regex;
+        // Paths added or removed since the last check of the traces. Only the traces matching
+        // them need to be checked again.
+        std::vector<trace_regex *> pending_paths;
+        TracePathTree traces_tree;
         int max_path_len = 0;
         vp::TraceLevel trace_level = vp::TRACE;
         std::vector<vp::Trace *> init_traces;
@@ -128,6 +268,11 @@ namespace vp {
         std::unordered_map<std::string, std::string> active_events;
 
         FILE *trace_file;
+        TraceLogger *logger = NULL;
+        // Trace windows activated by triggers
+        std::vector<TraceWindow *> windows;
+        // Block executing time triggers, only created if there is at least one
+        TraceTriggerTimer *trigger_timer = NULL;
         vp::Component *top;
         js::Config *config;
 
@@ -143,9 +288,17 @@ namespace vp {
         // This mechanism is used to merged different values of the same trace dumped during
         // the same timestamp.
         void flush_event_traces(int64_t timestamp);
+        void flush_vcd_batch();
+
+        void push_event_buffer();
 
         vector<char *> event_buffers;
         vector<char *> ready_event_buffers;
+        // Full buffers of events kept in memory by the flight recorder, from oldest to newest
+        vector<char *> recorded_event_buffers;
+        // True if trace messages and events are kept in memory until the recorder is dumped
+        bool recorder = false;
+        bool recorder_dump_req = false;
         char *current_buffer;
         int current_buffer_size;
         pthread_mutex_t mutex;
@@ -157,6 +310,12 @@ namespace vp {
         Event_trace *first_trace_to_dump;
         bool global_enable = true;
         gv::Vcd_user *vcd_user;
+        // Values waiting to be delivered to the VCD user when it asked for batches
+        std::vector<gv::Vcd_event> vcd_batch;
+        int vcd_batch_size = 0;
+        bool vcd_batch_per_timestamp = false;
+        // VCD user created by the engine to forward events to another process
+        VcdShmUser *vcd_shm = NULL;
     };
 };
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#ifndef __VP_TRACE_LOGGER_HPP__
+#define __VP_TRACE_LOGGER_HPP__
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+
+namespace vp {
+
+    class Trace;
+    class TraceEngine;
+
+    // Messages are formatted and written from the simulation thread
+    #define TRACE_BACKEND_DIRECT   0
+    // Messages are captured in binary form and formatted by a dedicated thread
+    #define TRACE_BACKEND_DEFERRED 1
+    // Messages are captured in binary form and written unformatted to a binary log
+    #define TRACE_BACKEND_BINARY   2
+    // Messages are captured in binary form and kept in memory until the recorder is dumped
+    #define TRACE_BACKEND_RECORDER 3
+
+    #define TRACE_LOGGER_CHUNK_SIZE (1<<20)
+    #define TRACE_LOGGER_NB_CHUNKS  8
+
+    /**
+     * Deferred backend for trace messages.
+     *
+     * Instead of formatting the message, the simulation thread only copies the trace, the
+     * timestamps, the format pointer and the raw arguments into chunks of memory.
+     * Full chunks are handed over to a dedicated thread which either formats them into the
+     * trace files, or writes them into a binary log which can be decoded offline with
+     * gvsoc-trace-decode.
+     *
+     * In recorder mode, there is no writer thread and the chunks are kept in memory as a ring,
+     * the oldest chunk being recycled when all of them are full. The recorded messages are only
+     * formatted when the recorder is dumped.
+     *
+     * Since the format string is only read afterwards, it must stay valid until the end of the
+     * simulation, which is the case of string literals.
+     */
+    class TraceLogger
+    {
+    public:
+        TraceLogger(TraceEngine *engine, int backend, std::string binary_path,
+            int nb_chunks=TRACE_LOGGER_NB_CHUNKS);
+        ~TraceLogger();
+
+        // Capture a message. Level is -1 for messages which are not colored.
+        void log(vp::Trace *trace, int level, int64_t time, int64_t cycles, const char *fmt,
+            va_list ap);
+
+        // Block until all captured messages have been written. Does nothing in recorder mode.
+        void flush();
+
+        // Format all the messages kept by the recorder and release them
+        void dump();
+
+    private:
+        typedef struct
+        {
+            char *data;
+            size_t size;
+        } chunk_t;
+
+        chunk_t *get_chunk();
+        char *alloc(size_t size);
+        void push_chunk();
+        void writer_routine();
+        void write_chunk(chunk_t *chunk);
+        void format_record(char *record);
+        void write_binary_record(char *record);
+
+        TraceEngine *engine;
+        int backend;
+        std::string binary_path;
+        FILE *binary_file = NULL;
+        bool binary_header_done = false;
+
+        // Chunk being filled by the simulation thread
+        chunk_t *current = NULL;
+        // Chunks available for capturing messages
+        std::vector<chunk_t *> free_chunks;
+        // Chunks filled and waiting to be written
+        std::vector<chunk_t *> ready_chunks;
+        // Number of chunks being written by the writer thread
+        int nb_writing = 0;
+        // Number of chunks recycled by the recorder since the last dump
+        int nb_dropped = 0;
+
+        // Guards the current chunk in case messages are emitted from several threads
+        std::atomic_flag current_lock = ATOMIC_FLAG_INIT;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        bool end = false;
+        std::thread *thread = NULL;
+
+        // Identifiers of the format strings already written to the binary log
+        std::unordered_map<const char *, uint32_t> binary_formats;
+        // Traces already written to the binary log
+        std::vector<bool> binary_traces;
+        // Line being formatted by the writer thread
+        std::string line;
+    };
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#ifndef __VP_TRACE_VCD_SHM_HPP__
+#define __VP_TRACE_VCD_SHM_HPP__
+
+#include <string>
+#include <vector>
+#include "gv/gvsoc.hpp"
+#include "gv/vcd_shm.hpp"
+
+namespace vp {
+
+    /**
+     * VCD user forwarding all the VCD events to another process through a shared memory ring.
+     *
+     * Values are received in batches from the trace engine and copied as a single record, so
+     * that the reader gets packed arrays of values. See gv/vcd_shm.hpp for the layout.
+     */
+    class VcdShmUser final : public gv::Vcd_user
+    {
+    public:
+        VcdShmUser(std::string name, size_t size, int batch_size);
+        ~VcdShmUser();
+
+        // Tell the reader that no more record will be written
+        void close();
+
+        void event_register(int id, std::string path, gv::Vcd_event_type type, int width) override;
+        void event_update_logical(int64_t timestamp, int id, uint64_t value, int flags) override;
+        void event_update_bitfield(int64_t timestamp, int id, uint8_t *value, uint8_t *flags) override;
+        void event_update_real(int64_t timestamp, int id, double value) override;
+        void event_update_string(int64_t timestamp, int id, const char *value, int flags) override;
+        int event_batch_size() override { return this->batch_size; }
+        void event_update_batch(gv::Vcd_event *events, int nb_events) override;
+
+    private:
+        void write_record(gv::Vcd_shm_record_type type, void *data0, size_t size0,
+            void *data1=NULL, size_t size1=0);
+        bool wait_space(size_t size);
+
+        std::string name;
+        gv::Vcd_shm_header *header;
+        uint8_t *ring;
+        size_t map_size;
+        int batch_size;
+        // Width of each registered event, indexed by ID
+        std::vector<int> widths;
+        // Value and flag bytes of bitfield records
+        std::vector<uint8_t> bitfield;
+        // Set once the reader is gone, after which records are dropped
+        bool reader_gone = false;
+    };
+};
+
+#endif
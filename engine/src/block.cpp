@@ -53,6 +53,65 @@ vp::Block::~Block()
     {
         this->parent->remove_block(this);
     }
+
+    delete this->clock_event_pool;
+}
+
+bool vp::Block::is_instrumented()
+{
+    for (auto &x : this->traces.traces)
+    {
+        if (x.second->get_active())
+        {
+            return true;
+        }
+    }
+
+    for (auto &x : this->traces.trace_events)
+    {
+        if (x.second->get_event_active())
+        {
+            return true;
+        }
+    }
+
+    if (this->power.get_power_trace()->get_active())
+    {
+        return true;
+    }
+
+    for (vp::Block *child : this->childs)
+    {
+        if (!child->is_component() && child->is_instrumented())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void vp::Block::register_instrumentation_callback(std::function<void()> callback)
+{
+    for (auto &x : this->traces.traces)
+    {
+        x.second->register_callback(callback);
+    }
+
+    for (auto &x : this->traces.trace_events)
+    {
+        x.second->register_callback(callback);
+    }
+
+    this->power.get_power_trace()->register_callback(callback);
+
+    for (vp::Block *child : this->childs)
+    {
+        if (!child->is_component())
+        {
+            child->register_instrumentation_callback(callback);
+        }
+    }
 }
 
 std::string vp::Block::get_path_from_parents()
@@ -189,7 +248,7 @@ vp::Block *vp::Block::get_block_from_path(std::vector<std::string> path_list)
 
     for (auto x:this->get_childs())
     {
-        vp::Block *comp;
+        vp::Block *comp = NULL;
         if (name == x->get_name())
         {
             comp = x->get_block_from_path({ path_list.begin() + name_pos + 1, path_list.end() });
@@ -223,35 +282,6 @@ void *vp::Block::external_bind(std::string comp_name, std::string itf_name, void
     return NULL;
 }
 
-void vp::Block::get_trace_from_path(std::vector<vp::Trace *> &traces, std::string path)
-{
-    if (this->get_path() != "" && path.find(this->get_path()) != 0)
-    {
-        return;
-    }
-
-    for (vp::Block *component: this->get_childs())
-    {
-        component->get_trace_from_path(traces, path);
-    }
-
-    for (auto x: this->traces.traces)
-    {
-        if (x.second->get_full_path().find(path) == 0)
-        {
-            traces.push_back(x.second);
-        }
-    }
-
-    for (auto x: this->traces.trace_events)
-    {
-        if (x.second->get_full_path().find(path) == 0)
-        {
-            traces.push_back(x.second);
-        }
-    }
-}
-
 string vp::Block::get_path()
 {
     return this->path;
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+// Synthetic IoReq hop benchmark. No component is instantiated: each request goes through a
+// chain of function calls which push and pop an argument like routers and interleavers do, and
+// the last one accounts a latency like a memory does. This only measures the cost of the request
+// structure itself, in particular when the number of hops exceeds the arguments stored inside
+// the request and the extension is needed. Port binding, component callbacks and the timing
+// models of the real router, interleaver and memory are not part of the measure, which must be
+// done on a simulated system.
+
+#include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --requests=<nb>  number of requests in flight, default 1024\n"
+        "  --iter=<nb>      number of times each request is sent, default 10000\n"
+        "  --hops=<nb>      number of components crossed by each request, default 3\n"
+        "  --duration       also set a duration on each request, like bandwidth-limited\n"
+        "                   components do\n", name);
+}
+
+
+// Router-like hop, which pushes its state on the request, forwards it and pops it back
+static void hop(vp::IoReq *req, int remaining, bool duration)
+{
+    if (remaining == 0)
+    {
+        req->inc_latency(2);
+        if (duration)
+        {
+            req->set_duration(4);
+        }
+        req->status = vp::IO_REQ_OK;
+        return;
+    }
+
+    req->arg_push((void *)(long)req->get_addr());
+    req->set_addr(req->get_addr() & 0xffffff);
+    hop(req, remaining - 1, duration);
+    req->set_addr((uint64_t)(long)req->arg_pop());
+    req->inc_latency(1);
+}
+
+
+int main(int argc, char **argv)
+{
+    int nb_requests = 1024;
+    int64_t nb_iter = 10000;
+    int nb_hops = 3;
+    bool duration = false;
+
+    static struct option long_options[] = {
+        {"requests", required_argument, 0, 'r'},
+        {"iter",     required_argument, 0, 'i'},
+        {"hops",     required_argument, 0, 'o'},
+        {"duration", no_argument,       0, 'd'},
+        {"help",     no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'r': nb_requests = atoi(optarg); break;
+            case 'i': nb_iter = atoll(optarg); break;
+            case 'o': nb_hops = atoi(optarg); break;
+            case 'd': duration = true; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if (nb_requests <= 0 || nb_iter <= 0 || nb_hops < 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    std::vector<vp::IoReq> reqs(nb_requests);
+    std::vector<uint8_t> data(nb_requests * 8);
+    uint64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int64_t iter = 0; iter < nb_iter; iter++)
+    {
+        for (int i = 0; i < nb_requests; i++)
+        {
+            vp::IoReq *req = &reqs[i];
+            req->init();
+            req->set_addr(0x10000000 + i * 8);
+            req->set_data(&data[i * 8]);
+            req->set_size(8);
+            req->set_is_write(i & 1);
+            hop(req, nb_hops, duration);
+            checksum += req->get_full_latency();
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double nb_total = (double)nb_iter * nb_requests;
+
+    printf("sizeof(IoReq): %zu bytes\n", sizeof(vp::IoReq));
+    printf("Requests: %.0f, hops: %d, duration: %d\n", nb_total, nb_hops, duration);
+    printf("Time: %.3f s, %.2f ns/request, %.2f Mrequests/s (checksum: %lu)\n",
+        elapsed.count(), elapsed.count() * 1e9 / nb_total, nb_total / elapsed.count() / 1e6,
+        checksum);
+
+    return 0;
+}
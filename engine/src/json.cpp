@@ -27,6 +27,9 @@
 #include "string.h"
 #include <streambuf>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
 
 std::vector<std::string> split(const std::string& s, char delimiter)
 {
@@ -95,34 +98,16 @@ void js::Config::dump(std::string)
 {
 }
 
-js::Config *js::ConfigString::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
 void js::ConfigString::dump(std::string)
 {
   fprintf(stderr, "\"%s\"", this->value.c_str());
 }
 
-js::Config *js::ConfigNumber::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
 void js::ConfigNumber::dump(std::string)
 {
   fprintf(stderr, "\"%f\"", this->value);
 }
 
-js::Config *js::ConfigArray::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
 void js::ConfigArray::dump(std::string indent)
 {
   bool is_first = true;
@@ -137,12 +122,6 @@ void js::ConfigArray::dump(std::string indent)
   fprintf(stderr, "\n%s]\n", indent.c_str());
 }
 
-js::Config *js::ConfigBool::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
 void js::ConfigBool::dump(std::string)
 {
   fprintf(stderr, "\"%s\"", this->value ? "true" : "false");
@@ -164,39 +143,58 @@ void js::ConfigObject::dump(std::string indent)
   fprintf(stderr, "\n%s}\n", indent.c_str());
 }
 
-js::Config *js::ConfigObject::get_from_list(std::vector<std::string> name_list)
+js::Config *js::ConfigObject::get_from_path(const std::vector<std::string> &path, size_t index)
 {
-  if (name_list.size() == 0) return this;
+  if (index == path.size()) return this;
 
   js::Config *result = NULL;
-  std::string name;
-  int name_pos = 0;
+  size_t name_pos = index;
+
+  while (name_pos < path.size() && (path[name_pos] == "*" || path[name_pos] == "**"))
+  {
+    name_pos++;
+  }
 
-  for (auto& x: name_list) {
-    if (x != "*" && x != "**")
+  static const std::string empty_name;
+  const std::string &name = name_pos < path.size() ? path[name_pos] : empty_name;
+
+  // Recursive lookups of a single name are resolved from the descendant index, which gives
+  // the same candidates in the same order as the walk below.
+  if (name_pos == index + 1 && path[index] == "**")
+  {
+    if (this->descendants == NULL)
     {
-      name = x;
-      break;
+      this->build_index();
     }
-    name_pos++;
+
+    auto it = this->descendants->find(name);
+    if (it != this->descendants->end())
+    {
+      for (ConfigObject *object: it->second)
+      {
+        result = object->childs[name]->get_from_path(path, name_pos + 1);
+        if (result != NULL) return result;
+      }
+    }
+    return NULL;
   }
 
   for (auto& x: childs) {
 
     if (name == x.first)
     {
-      result = x.second->get_from_list(std::vector<std::string>(name_list.begin () + name_pos + 1, name_list.begin () + name_list.size()));
-      if (name_pos == 0 || result != NULL) return result;
+      result = x.second->get_from_path(path, name_pos + 1);
+      if (name_pos == index || result != NULL) return result;
 
     }
-    else if (name_list[0] == "*")
+    else if (path[index] == "*")
     {
-      result = x.second->get_from_list(std::vector<std::string>(name_list.begin () + 1, name_list.begin () + name_list.size()));
+      result = x.second->get_from_path(path, index + 1);
       if (result != NULL) return result;
     }
-    else if (name_list[0] == "**")
+    else if (path[index] == "**")
     {
-      result = x.second->get_from_list(name_list);
+      result = x.second->get_from_path(path, index);
       if (result != NULL) return result;
     }
   }
@@ -204,6 +202,35 @@ js::Config *js::ConfigObject::get_from_list(std::vector<std::string> name_list)
   return result;
 }
 
+void js::ConfigObject::build_index()
+{
+  std::unordered_map<std::string, int> blocked;
+  this->descendants = new std::unordered_map<std::string, std::vector<ConfigObject *>>();
+  this->build_index_from(this, blocked);
+}
+
+void js::ConfigObject::build_index_from(ConfigObject *object, std::unordered_map<std::string, int> &blocked)
+{
+  for (auto& x: object->childs)
+  {
+    // A recursive walk does not go through a child having the searched name, so objects below
+    // such a child must not be registered for this name.
+    auto it = blocked.find(x.first);
+    if (it == blocked.end() || it->second == 0)
+    {
+      (*this->descendants)[x.first].push_back(object);
+    }
+
+    ConfigObject *child = dynamic_cast<ConfigObject *>(x.second);
+    if (child)
+    {
+      blocked[x.first]++;
+      this->build_index_from(child, blocked);
+      blocked[x.first]--;
+    }
+  }
+}
+
 js::Config *js::ConfigObject::get(std::string name)
 {
   return get_from_list(split(name, '/'));
@@ -215,6 +242,22 @@ js::ConfigString::ConfigString(jsmntok_t *tokens)
 }
 
 double json_my_stod (std::string const& s) {
+    // Most numbers in configurations are integers, which can be converted without going
+    // through a stream.
+    const char *str = s.c_str();
+    const char *digits = *str == '-' ? str + 1 : str;
+    if (*digits >= '0' && *digits <= '9' && strpbrk(digits, ".eE") == NULL &&
+        (digits[0] != '0' || (digits[1] != 'x' && digits[1] != 'X')))
+    {
+      char *end;
+      errno = 0;
+      long long value = strtoll(str, &end, 10);
+      if (*end == 0 && errno == 0)
+      {
+        return (double)value;
+      }
+    }
+
     std::istringstream iss (s);
     iss.imbue (std::locale("C"));
     double d;
@@ -275,7 +318,229 @@ js::ConfigObject::ConfigObject(jsmntok_t *tokens, int *_size)
   }
 }
 
-js::Config *js::import_config_from_file(std::string config_path)
+/*
+ * Binary cache format
+ *
+ * The file starts with a header giving a magic, the format version, and the hash and size of
+ * the JSON content it was generated from. It is followed by the tree, where each node starts
+ * with its type and is followed by:
+ * - object: number of children, then for each child its key and the child node
+ * - array: number of elements, then the element nodes
+ * - string: the string
+ * - number: the double value
+ * - bool: one byte
+ * Strings are stored as a 32bits length followed by the characters.
+ */
+
+#define JS_CACHE_MAGIC   0x48434a5356475f31ULL
+#define JS_CACHE_VERSION 1
+
+enum js_cache_type {
+  JS_CACHE_OBJECT,
+  JS_CACHE_ARRAY,
+  JS_CACHE_STRING,
+  JS_CACHE_NUMBER,
+  JS_CACHE_BOOL
+};
+
+typedef struct {
+  uint64_t magic;
+  uint64_t version;
+  uint64_t hash;
+  uint64_t size;
+} js_cache_header_t;
+
+static void js_cache_put(std::string &buffer, const void *data, size_t size)
+{
+  buffer.append((const char *)data, size);
+}
+
+static void js_cache_put_u32(std::string &buffer, uint32_t value)
+{
+  js_cache_put(buffer, &value, sizeof(value));
+}
+
+static void js_cache_put_str(std::string &buffer, const std::string &str)
+{
+  js_cache_put_u32(buffer, str.size());
+  buffer.append(str);
+}
+
+void js::ConfigObject::dump_binary(std::string &buffer)
+{
+  buffer.push_back(JS_CACHE_OBJECT);
+  js_cache_put_u32(buffer, this->childs.size());
+  for (auto& x: this->childs)
+  {
+    js_cache_put_str(buffer, x.first);
+    x.second->dump_binary(buffer);
+  }
+}
+
+void js::ConfigArray::dump_binary(std::string &buffer)
+{
+  buffer.push_back(JS_CACHE_ARRAY);
+  js_cache_put_u32(buffer, this->elems.size());
+  for (auto x: this->elems)
+  {
+    x->dump_binary(buffer);
+  }
+}
+
+void js::ConfigString::dump_binary(std::string &buffer)
+{
+  buffer.push_back(JS_CACHE_STRING);
+  js_cache_put_str(buffer, this->value);
+}
+
+void js::ConfigNumber::dump_binary(std::string &buffer)
+{
+  buffer.push_back(JS_CACHE_NUMBER);
+  js_cache_put(buffer, &this->value, sizeof(this->value));
+}
+
+void js::ConfigBool::dump_binary(std::string &buffer)
+{
+  buffer.push_back(JS_CACHE_BOOL);
+  buffer.push_back(this->value);
+}
+
+class JsCacheReader
+{
+public:
+  JsCacheReader(const std::string &buffer, size_t pos) : buffer(buffer), pos(pos) {}
+
+  bool get(void *data, size_t size)
+  {
+    if (this->pos + size > this->buffer.size()) return false;
+    memcpy(data, &this->buffer[this->pos], size);
+    this->pos += size;
+    return true;
+  }
+
+  bool get_str(std::string &str)
+  {
+    uint32_t size;
+    if (!this->get(&size, sizeof(size)) || this->pos + size > this->buffer.size()) return false;
+    str.assign(&this->buffer[this->pos], size);
+    this->pos += size;
+    return true;
+  }
+
+  js::Config *get_config()
+  {
+    uint8_t type;
+    if (!this->get(&type, 1)) return NULL;
+
+    switch (type)
+    {
+      case JS_CACHE_OBJECT: {
+        uint32_t nb_childs;
+        if (!this->get(&nb_childs, sizeof(nb_childs))) return NULL;
+        js::ConfigObject *config = new js::ConfigObject();
+        for (uint32_t i=0; i<nb_childs; i++)
+        {
+          std::string name;
+          if (!this->get_str(name)) return NULL;
+          js::Config *child = this->get_config();
+          if (child == NULL) return NULL;
+          config->childs.emplace_hint(config->childs.end(), std::move(name), child);
+        }
+        return config;
+      }
+
+      case JS_CACHE_ARRAY: {
+        uint32_t nb_elems;
+        if (!this->get(&nb_elems, sizeof(nb_elems))) return NULL;
+        std::vector<js::Config *> elems(nb_elems);
+        for (uint32_t i=0; i<nb_elems; i++)
+        {
+          elems[i] = this->get_config();
+          if (elems[i] == NULL) return NULL;
+        }
+        return new js::ConfigArray(elems);
+      }
+
+      case JS_CACHE_STRING: {
+        std::string value;
+        if (!this->get_str(value)) return NULL;
+        return new js::ConfigString(value);
+      }
+
+      case JS_CACHE_NUMBER: {
+        double value;
+        if (!this->get(&value, sizeof(value))) return NULL;
+        return new js::ConfigNumber(value);
+      }
+
+      case JS_CACHE_BOOL: {
+        uint8_t value;
+        if (!this->get(&value, 1)) return NULL;
+        return new js::ConfigBool(value);
+      }
+    }
+
+    return NULL;
+  }
+
+private:
+  const std::string &buffer;
+  size_t pos;
+};
+
+// FNV-1a hash of the JSON content, used to check that the cache matches the configuration
+static uint64_t js_cache_hash(const std::string &str)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c: str)
+  {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static js::Config *js_cache_load(std::string cache_path, const std::string &content)
+{
+  std::ifstream file(cache_path, std::ios::binary);
+  if (!file.is_open()) return NULL;
+
+  std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  js_cache_header_t header;
+  JsCacheReader reader(buffer, 0);
+  if (!reader.get(&header, sizeof(header)) || header.magic != JS_CACHE_MAGIC ||
+    header.version != JS_CACHE_VERSION || header.size != content.size() ||
+    header.hash != js_cache_hash(content))
+  {
+    return NULL;
+  }
+
+  return reader.get_config();
+}
+
+static void js_cache_store(std::string cache_path, const std::string &content, js::Config *config)
+{
+  js_cache_header_t header = {
+    .magic=JS_CACHE_MAGIC, .version=JS_CACHE_VERSION, .hash=js_cache_hash(content),
+    .size=content.size()
+  };
+  std::string buffer;
+  js_cache_put(buffer, &header, sizeof(header));
+  config->dump_binary(buffer);
+
+  // Write to a temporary file first so that concurrent runs never see a partial cache
+  std::string tmp_path = cache_path + ".tmp" + std::to_string(getpid());
+  std::ofstream file(tmp_path, std::ios::binary);
+  if (!file.is_open()) return;
+  file.write(buffer.data(), buffer.size());
+  file.close();
+  if (file.fail() || rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+  {
+    remove(tmp_path.c_str());
+  }
+}
+
+js::Config *js::import_config_from_file(std::string config_path, std::string cache_path)
 {
   std::ifstream t(config_path);
   if(!t.is_open())
@@ -285,8 +550,20 @@ js::Config *js::import_config_from_file(std::string config_path)
   }
   std::string str((std::istreambuf_iterator<char>(t)),
                    std::istreambuf_iterator<char>());
-  return import_config_from_string(str);
 
+  if (cache_path == "")
+  {
+    return import_config_from_string(str);
+  }
+
+  js::Config *config = js_cache_load(cache_path, str);
+  if (config == NULL)
+  {
+    config = import_config_from_string(str);
+    js_cache_store(cache_path, str, config);
+  }
+
+  return config;
 }
 
 js::Config *js::import_config_from_string(std::string config_str)
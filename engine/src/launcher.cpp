@@ -26,6 +26,7 @@
 #include <gv/gvsoc.hpp>
 #include <vp/proxy.hpp>
 #include <vp/launcher.hpp>
+#include <vp/time/stop_condition.hpp>
 #include <vp/proxy_client.hpp>
 #include "vp/top.hpp"
 
@@ -41,7 +42,8 @@ static void sigint_handler(int s)
 }
 
 // This thread takes care of properly stopping the engine when ctrl C is hit
-// so that the python world can properly close everything
+// so that the python world can properly close everything.
+// It also dumps the trace flight recorder when SIGUSR1 is received.
 void *gv::GvsocLauncher::signal_routine(void *__this)
 {
     GvsocLauncher *launcher = (GvsocLauncher *)__this;
@@ -49,10 +51,20 @@ void *gv::GvsocLauncher::signal_routine(void *__this)
     int caught;
     sigemptyset(&sigs_to_catch);
     sigaddset(&sigs_to_catch, SIGINT);
+    sigaddset(&sigs_to_catch, SIGUSR1);
     do
     {
         sigwait(&sigs_to_catch, &caught);
-        launcher->handler->get_time_engine()->quit(-1);
+        if (caught == SIGUSR1)
+        {
+            launcher->handler->get_time_engine()->post_sync([launcher]() {
+                launcher->handler->top_instance->traces.get_trace_engine()->dump_recorder();
+            });
+        }
+        else
+        {
+            launcher->handler->get_time_engine()->quit(-1);
+        }
     } while (1);
     return NULL;
 }
@@ -65,7 +77,7 @@ gv::GvsocLauncher::GvsocLauncher(gv::GvsocConf *conf)
 
 void gv::GvsocLauncher::open()
 {
-    this->handler = new vp::Top(conf->config_path, this->is_async);
+    this->handler = new vp::Top(conf->config_path, this->is_async, conf->config_cache_path);
 
     this->instance = this->handler->top_instance;
     this->instance->set_launcher(this);
@@ -96,6 +108,7 @@ void gv::GvsocLauncher::open()
         sigset_t sigs_to_block;
         sigemptyset(&sigs_to_block);
         sigaddset(&sigs_to_block, SIGINT);
+        sigaddset(&sigs_to_block, SIGUSR1);
         pthread_sigmask(SIG_BLOCK, &sigs_to_block, NULL);
         pthread_create(&sigint_thread, NULL, signal_routine, (void *)this);
 
@@ -140,10 +153,15 @@ void gv::GvsocLauncher::run()
 {
     if (this->is_async)
     {
-        this->handler->get_time_engine()->lock();
-        this->running = true;
-        this->run_req = true;
-        this->handler->get_time_engine()->unlock();
+        this->handler->get_time_engine()->post_sync([this]() {
+            // A run request is only needed if the engine is stopped or about to stop, otherwise
+            // it would cancel the next pause, like the one from a stop condition.
+            if (!this->running || this->handler->get_time_engine()->pause_req)
+            {
+                this->running = true;
+                this->run_req = true;
+            }
+        });
     }
     else
     {
@@ -172,10 +190,10 @@ int64_t gv::GvsocLauncher::stop()
 {
     if (this->is_async)
     {
-        this->handler->get_time_engine()->lock();
-        this->run_req = false;
-        this->handler->get_time_engine()->pause();
-        this->handler->get_time_engine()->unlock();
+        this->handler->get_time_engine()->post_sync([this]() {
+            this->run_req = false;
+            this->handler->get_time_engine()->pause();
+        });
 
         return this->handler->get_time_engine()->get_time();
     }
@@ -205,10 +223,10 @@ int64_t gv::GvsocLauncher::step_until(int64_t end_time)
     int64_t time;
     if (this->is_async)
     {
-        this->handler->get_time_engine()->lock();
-        this->handler->get_time_engine()->step_register(end_time);
-        this->run_req = true;
-        this->handler->get_time_engine()->unlock();
+        this->handler->get_time_engine()->post_sync([this, end_time]() {
+            this->handler->get_time_engine()->step_register(end_time);
+            this->run_req = true;
+        });
 
         return end_time;
     }
@@ -229,6 +247,60 @@ int64_t gv::GvsocLauncher::step_until(int64_t end_time)
     return time;
 }
 
+int gv::GvsocLauncher::run_until(std::vector<gv::StopCondition> &conditions)
+{
+    vp::TimeEngine *engine = this->handler->get_time_engine();
+    vp::StopConditions *stop_conditions = engine->stop_conditions_get();
+    int err = 0;
+    int index;
+
+    if (this->is_async)
+    {
+        // The conditions are armed and the execution started in the same command, so that
+        // the engine does not execute anything in between
+        engine->post_sync([this, engine, stop_conditions, &conditions, &err]() {
+            err = stop_conditions->arm(conditions);
+            if (err == 0 && !stop_conditions->is_hit())
+            {
+                this->running = true;
+                this->run_req = true;
+            }
+        });
+
+        this->wait_stopped();
+
+        engine->post_sync([stop_conditions, &index]() {
+            index = stop_conditions->disarm();
+        });
+    }
+    else
+    {
+        err = stop_conditions->arm(conditions);
+        if (err == 0 && !stop_conditions->is_hit())
+        {
+            for (auto x: this->exec_notifiers)
+            {
+                x->notify_run(engine->get_time());
+            }
+
+            engine->run();
+
+            for (auto x: this->exec_notifiers)
+            {
+                x->notify_stop(engine->get_time());
+            }
+        }
+        index = stop_conditions->disarm();
+    }
+
+    if (err)
+    {
+        throw std::invalid_argument("Invalid stop condition");
+    }
+
+    return index;
+}
+
 gv::Io_binding *gv::GvsocLauncher::io_bind(gv::Io_user *user, std::string comp_name, std::string itf_name)
 {
     return (gv::Io_binding *)this->instance->external_bind(comp_name, itf_name, (void *)user);
@@ -246,12 +318,30 @@ void gv::GvsocLauncher::vcd_bind(gv::Vcd_user *user)
 
 void gv::GvsocLauncher::event_add(std::string path, bool is_regex)
 {
-    this->instance->traces.get_trace_engine()->conf_trace(1, path, 1);
+    vp::TraceEngine *engine = this->instance->traces.get_trace_engine();
+    if (is_regex)
+    {
+        engine->add_trace_path(1, path);
+        engine->check_traces();
+    }
+    else
+    {
+        engine->conf_trace(1, path, 1);
+    }
 }
 
 void gv::GvsocLauncher::event_exclude(std::string path, bool is_regex)
 {
-    this->instance->traces.get_trace_engine()->conf_trace(1, path, 0);
+    vp::TraceEngine *engine = this->instance->traces.get_trace_engine();
+    if (is_regex)
+    {
+        engine->add_exclude_trace_path(1, path);
+        engine->check_traces();
+    }
+    else
+    {
+        engine->conf_trace(1, path, 0);
+    }
 }
 
 
@@ -285,12 +375,15 @@ void *gv::GvsocLauncher::get_component(std::string path)
 
 void gv::GvsocLauncher::engine_routine()
 {
+    // Commands posted from this thread must be directly executed
+    this->handler->get_time_engine()->engine_thread = std::this_thread::get_id();
+
     while(1)
     {
         // Wait until we receive a run request
         while (!this->run_req)
         {
-            this->handler->get_time_engine()->critical_wait();
+            this->handler->get_time_engine()->critical_wait_commands();
             this->handler->get_time_engine()->handle_locks();
         }
 
@@ -332,7 +425,7 @@ void gv::GvsocLauncher::engine_routine()
 
             while(1)
             {
-                this->handler->get_time_engine()->critical_wait();
+                this->handler->get_time_engine()->critical_wait_commands();
                 this->handler->get_time_engine()->handle_locks();
             }
         }
@@ -357,6 +450,11 @@ int gv::GvsocLauncher::retain_count()
     return this->handler->get_time_engine()->retain_count();
 }
 
+int64_t gv::GvsocLauncher::get_time()
+{
+    return this->handler->get_time_engine()->get_time();
+}
+
 void gv::GvsocLauncher::release()
 {
     this->handler->get_time_engine()->retain_inc(-1);
@@ -387,6 +485,16 @@ gv::PowerReport *gv::GvsocLauncher::report_get()
     return this->instance->power.get_report();
 }
 
+void gv::GvsocLauncher::sampler_start(gv::PowerSamplerConfig &config)
+{
+    this->instance->power.get_engine()->sampler_start(config);
+}
+
+void gv::GvsocLauncher::sampler_stop()
+{
+    this->instance->power.get_engine()->sampler_stop();
+}
+
 
 
 gv::Gvsoc *gv::gvsoc_new(gv::GvsocConf *conf)
@@ -33,6 +33,7 @@
 int main(int argc, char *argv[])
 {
     char *config_path = NULL;
+    char *config_cache_path = NULL;
     bool open_proxy = false;
 
     for (int i=1; i<argc; i++)
@@ -41,6 +42,10 @@ int main(int argc, char *argv[])
         {
             config_path = &argv[i][9];
         }
+        else if (strncmp(argv[i], "--config-cache=", 15) == 0)
+        {
+            config_cache_path = &argv[i][15];
+        }
         else if (strcmp(argv[i], "--proxy") == 0)
         {
             open_proxy = true;
@@ -64,6 +69,10 @@ int main(int argc, char *argv[])
 #endif
 
     gv::GvsocConf conf = { .config_path=config_path };
+    if (config_cache_path != NULL)
+    {
+        conf.config_cache_path = config_cache_path;
+    }
     gv::Gvsoc *gvsoc = gv::gvsoc_new(&conf);
     gvsoc->open();
     gvsoc->start();
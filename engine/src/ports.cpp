@@ -20,6 +20,7 @@
  */
 
 #include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
 
 
 vp::MasterPort::MasterPort(vp::Component *owner)
@@ -88,3 +89,25 @@ void vp::MasterPort::bind_to_virtual(vp::Port *port)
     vp_assert_always(port != NULL, this->get_comp()->get_trace(), "Trying to bind master port to NULL\n");
     this->SlavePorts.push_back(port);
 }
+
+
+// Extensions are never given back to the system, they are kept in a per-thread free list so
+// that requests going through several components do not allocate in steady state
+static thread_local vp::IoReqExtension *io_req_ext_free_list = NULL;
+
+vp::IoReqExtension *vp::IoReqExtension::alloc()
+{
+    vp::IoReqExtension *ext = io_req_ext_free_list;
+    if (ext)
+    {
+        io_req_ext_free_list = ext->next;
+        return ext;
+    }
+    return new vp::IoReqExtension;
+}
+
+void vp::IoReqExtension::free(vp::IoReqExtension *ext)
+{
+    ext->next = io_req_ext_free_list;
+    io_req_ext_free_list = ext;
+}
@@ -96,6 +96,20 @@ double vp::BlockPower::get_average_power(double &dynamic_power, double &static_p
     return result;
 }
 
+void vp::BlockPower::get_report_energy(double &dynamic, double &leakage)
+{
+    dynamic = 0.0;
+    leakage = 0.0;
+
+    for (auto x : this->traces)
+    {
+        double trace_dynamic, trace_leakage;
+        x->get_report_energy(&trace_dynamic, &trace_leakage);
+        dynamic += trace_dynamic;
+        leakage += trace_leakage;
+    }
+}
+
 double vp::BlockPower::get_instant_power(double &dynamic_power, double &static_power)
 {
     double result = 0.0;
@@ -104,9 +118,11 @@ double vp::BlockPower::get_instant_power(double &dynamic_power, double &static_p
 
     for (auto x : this->traces)
     {
-        dynamic_power += x->instant_dynamic_power;
+        // Quantums which were only counted are not part of the instant power of the trace
+        double counted_power = x->get_counted_power();
+        dynamic_power += x->instant_dynamic_power + counted_power;
         static_power += x->instant_static_power;
-        result += x->current_power;
+        result += x->current_power + counted_power;
     }
 
     return result;
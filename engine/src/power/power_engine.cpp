@@ -21,12 +21,14 @@
 
 #include "vp/vp.hpp"
 #include "vp/trace/trace.hpp"
+#include "vp/power/power_sampler.hpp"
 
 
 
 void vp::PowerEngine::reg_trace(vp::PowerTrace *trace)
 {
     this->traces.push_back(trace);
+    trace->set_quantum_mode(this->quantum_mode);
 }
 
 
@@ -76,14 +78,82 @@ vp::PowerEngine::PowerEngine()
 }
 
 
-void vp::PowerEngine::init(vp::Block *top)
+void vp::PowerEngine::init(vp::Block *top, js::Config *config)
 {
     this->top = top;
+
+    std::string quantum_mode = config->get_child_str("power/quantum_mode");
+    if (quantum_mode == "immediate")
+    {
+        this->quantum_mode = vp::POWER_QUANTUM_IMMEDIATE;
+    }
+    else if (quantum_mode == "check")
+    {
+        this->quantum_mode = vp::POWER_QUANTUM_CHECK;
+    }
+    else if (quantum_mode != "" && quantum_mode != "count")
+    {
+        throw std::runtime_error("Invalid power quantum mode (mode: " + quantum_mode + ")");
+    }
+
+    // Traces may have been registered before
+    for (auto trace : this->traces)
+    {
+        trace->set_quantum_mode(this->quantum_mode);
+    }
+
+    // The sampler can be started from the configuration, in which case it starts with the
+    // simulation
+    js::Config *sampler_config = config->get("power/sampler");
+    if (sampler_config && sampler_config->get_child_bool("enabled"))
+    {
+        gv::PowerSamplerConfig sampler;
+        sampler.path = sampler_config->get_child_str("file");
+        sampler.format = sampler_config->get_child_str("format");
+        sampler.period = sampler_config->get_int("period");
+        sampler.clock = sampler_config->get_child_str("clock");
+
+        js::Config *blocks = sampler_config->get("blocks");
+        if (blocks)
+        {
+            for (auto x : blocks->get_elems())
+            {
+                sampler.blocks.push_back(x->get_str());
+            }
+        }
+
+        this->sampler = new PowerSampler(top, &sampler);
+    }
+}
+
+
+int vp::PowerEngine::sampler_start(gv::PowerSamplerConfig &config, std::string *error)
+{
+    if (this->sampler == NULL)
+    {
+        this->sampler = new PowerSampler(this->top);
+    }
+
+    return this->sampler->start(config, error);
+}
+
+
+void vp::PowerEngine::sampler_stop()
+{
+    if (this->sampler)
+    {
+        this->sampler->stop();
+    }
 }
 
 
 vp::PowerEngine::~PowerEngine()
 {
+    if (this->sampler)
+    {
+        this->sampler->stop();
+    }
+
     if (this->file)
     {
         fclose(this->file);
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <sstream>
+#include <stdarg.h>
+#include <vp/vp.hpp>
+#include <vp/trace/trace.hpp>
+#include <vp/power/power_sampler.hpp>
+
+
+static std::vector<std::string> split_path(const std::string &path)
+{
+    std::vector<std::string> tokens;
+    std::string token;
+    std::istringstream stream(path);
+    while (std::getline(stream, token, '/'))
+    {
+        if (token != "")
+        {
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+
+vp::PowerSampler::PowerSampler(vp::Block *top, gv::PowerSamplerConfig *config)
+    : vp::Block(top, "power_sampler"), top(top)
+{
+    this->time_event = new vp::TimeEvent(this, &PowerSampler::time_handler);
+
+    if (config)
+    {
+        this->config = *config;
+        this->start_on_reset = true;
+    }
+}
+
+vp::PowerSampler::~PowerSampler()
+{
+    this->stop();
+}
+
+void vp::PowerSampler::reset(bool active)
+{
+    if (!active)
+    {
+        // Only start once, if the system is reset again, the sampler keeps going
+        if (this->start_on_reset)
+        {
+            this->start_on_reset = false;
+            this->start(this->config);
+        }
+        else if (this->started && !this->time_event->is_enqueued() &&
+            (this->clock_event == NULL || !this->clock_event->is_enqueued()))
+        {
+            // Our events are cancelled when the system is reset
+            this->enqueue();
+        }
+    }
+}
+
+int vp::PowerSampler::config_error(std::string *error, const char *fmt, ...)
+{
+    char buffer[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, ap);
+    va_end(ap);
+
+    if (error)
+    {
+        *error = buffer;
+    }
+    else
+    {
+        this->get_trace()->fatal("%s\n", buffer);
+    }
+    return -1;
+}
+
+int vp::PowerSampler::start(gv::PowerSamplerConfig &config, std::string *error)
+{
+    this->stop();
+
+    if (&config != &this->config)
+    {
+        this->config = config;
+    }
+
+    if (this->config.period <= 0)
+    {
+        return this->config_error(error, "Invalid power sampler period (period: %ld)",
+            this->config.period);
+    }
+
+    if (this->config.format != "csv" && this->config.format != "bin")
+    {
+        return this->config_error(error, "Invalid power sampler format, should be csv or bin (format: %s)",
+            this->config.format.c_str());
+    }
+    this->is_binary = this->config.format == "bin";
+
+    this->blocks.clear();
+    if (this->config.blocks.size() == 0)
+    {
+        this->blocks.push_back(this->top);
+    }
+    for (std::string &path : this->config.blocks)
+    {
+        vp::Block *block = this->top->get_block_from_path(split_path(path));
+        if (block == NULL)
+        {
+            return this->config_error(error, "Invalid power sampler block (path: %s)", path.c_str());
+        }
+        this->blocks.push_back(block);
+    }
+
+    vp::Block *clock_block = NULL;
+    if (this->config.clock != "")
+    {
+        clock_block = this->top->get_block_from_path(split_path(this->config.clock));
+        if (clock_block == NULL || clock_block->clock.get_engine() == NULL)
+        {
+            return this->config_error(error, "Invalid power sampler clock domain (path: %s)",
+                this->config.clock.c_str());
+        }
+    }
+
+    this->file = fopen(this->config.path.c_str(), this->is_binary ? "wb" : "w");
+    if (this->file == NULL)
+    {
+        return this->config_error(error, "Failed to open power sampler file (path: %s, error: %s)",
+            this->config.path.c_str(), strerror(errno));
+    }
+
+    if (clock_block)
+    {
+        this->clock_event = new vp::ClockEvent(clock_block, this, &PowerSampler::clock_handler);
+    }
+
+    if (this->is_binary)
+    {
+        uint32_t version = VP_POWER_SAMPLER_VERSION;
+        uint32_t nb_blocks = this->blocks.size();
+        fwrite(VP_POWER_SAMPLER_MAGIC, 1, 8, this->file);
+        fwrite(&version, sizeof(version), 1, this->file);
+        fwrite(&nb_blocks, sizeof(nb_blocks), 1, this->file);
+        for (vp::Block *block : this->blocks)
+        {
+            std::string path = block->get_path();
+            uint32_t size = path.size();
+            fwrite(&size, sizeof(size), 1, this->file);
+            fwrite(path.c_str(), 1, size, this->file);
+        }
+        this->energies.resize(this->blocks.size() * 2);
+    }
+    else
+    {
+        fprintf(this->file, "Timestamp (ps)");
+        for (vp::Block *block : this->blocks)
+        {
+            fprintf(this->file, "; %s dynamic (pJ); %s leakage (pJ)", block->get_path().c_str(),
+                block->get_path().c_str());
+        }
+        fprintf(this->file, "\n");
+    }
+
+    this->started = true;
+    this->last_timestamp = -1;
+    this->enqueue();
+
+    return 0;
+}
+
+void vp::PowerSampler::stop()
+{
+    if (!this->started)
+    {
+        return;
+    }
+
+    this->started = false;
+
+    // Take a last sample so that the end of the window is always in the file
+    this->sample();
+
+    if (this->clock_event)
+    {
+        this->clock_event->cancel();
+        delete this->clock_event;
+        this->clock_event = NULL;
+    }
+    else
+    {
+        this->time_event->cancel();
+    }
+
+    fclose(this->file);
+    this->file = NULL;
+}
+
+void vp::PowerSampler::enqueue()
+{
+    if (this->clock_event)
+    {
+        this->clock_event->enqueue(this->config.period);
+    }
+    else
+    {
+        this->time_event->enqueue(this->config.period);
+    }
+}
+
+void vp::PowerSampler::sample()
+{
+    int64_t timestamp = this->time.get_time();
+
+    // The last sample may be taken at the same time as a periodic one
+    if (timestamp == this->last_timestamp)
+    {
+        return;
+    }
+    this->last_timestamp = timestamp;
+
+    if (this->is_binary)
+    {
+        for (size_t i=0; i<this->blocks.size(); i++)
+        {
+            this->blocks[i]->power.get_report_energy(this->energies[i*2], this->energies[i*2+1]);
+        }
+        fwrite(&timestamp, sizeof(timestamp), 1, this->file);
+        fwrite(this->energies.data(), sizeof(double), this->energies.size(), this->file);
+    }
+    else
+    {
+        fprintf(this->file, "%ld", timestamp);
+        for (vp::Block *block : this->blocks)
+        {
+            double dynamic, leakage;
+            block->power.get_report_energy(dynamic, leakage);
+            fprintf(this->file, "; %.12f; %.12f", dynamic, leakage);
+        }
+        fprintf(this->file, "\n");
+    }
+}
+
+void vp::PowerSampler::time_handler(vp::Block *__this, vp::TimeEvent *event)
+{
+    vp::PowerSampler *_this = (vp::PowerSampler *)__this;
+    _this->sample();
+    _this->enqueue();
+}
+
+void vp::PowerSampler::clock_handler(vp::Block *__this, vp::ClockEvent *event)
+{
+    vp::PowerSampler *_this = (vp::PowerSampler *)__this;
+    _this->sample();
+    _this->enqueue();
+}
@@ -32,6 +32,13 @@ static char vp_error[VP_ERROR_SIZE];
 
 void vp::PowerSource::set_frequency(double freq)
 {
+    // Frequency is propagated to all the sources of a clock domain, skip those which are
+    // already at this operating point
+    if (freq == this->current_freq)
+    {
+        return;
+    }
+
     bool is_on = this->is_on;
     if (is_on)
     {
@@ -46,6 +53,11 @@ void vp::PowerSource::set_frequency(double freq)
 
 void vp::PowerSource::set_voltage(double voltage)
 {
+    if (voltage == this->current_volt)
+    {
+        return;
+    }
+
     bool is_on = this->is_on;
     if (is_on)
     {
@@ -69,6 +81,12 @@ void vp::PowerSource::setup(double temp, double volt, double freq)
     // dynamic background power or leakage if they are defined, which is the case if they are not -1
     if (this->quantum != -1)
     {
+        // Quantums which were only counted must keep the energy of the previous quantum
+        this->quantum_cycle_energy += this->quantum_cycle_count * this->quantum;
+        this->quantum_cycle_count = 0;
+        this->quantum_count_energy += this->quantum_count * this->quantum;
+        this->quantum_count = 0;
+
         this->quantum = this->dyn_table->get(temp, volt, freq);
     }
     if (this->background_power != -1)
@@ -192,6 +210,8 @@ int vp::PowerSource::init(Block *top, std::string name, js::Config *source_confi
         }
     }
 
+    this->trace->sources.push_back(this);
+
     return 0;  
 }
 
@@ -33,248 +33,181 @@ double my_stod (std::string const& s) {
     return d;
 }
 
-vp::PowerLinearTable::PowerLinearTable(js::Config *config)
-{
-    // Extract the power table from json file for each temperature
-    for (auto &x : config->get_childs())
-    {
-        temp_tables.push_back(new PowerLinearTempTable(my_stod(x.first), x.second));
-    }
+// Number of operating points cached by each table
+#define POWER_TABLE_CACHE_SIZE 4
 
-    std::sort(this->temp_tables.begin(), this->temp_tables.end(),
-    [](vp::PowerLinearTempTable *a, vp::PowerLinearTempTable *b){ return a->get_temp() <= b->get_temp(); });
-}
 
 
-
-double vp::PowerLinearTable::get(double temp, double volt, double frequency)
+// Find the 2 points surrounding the specified one in a sorted axis. If the point is outside the
+// axis, or exactly on one of its points, both indexes are the same, so that we don't do any
+// estimation outside the given ranges
+static inline void power_table_find(const double *axis, int size, double x, int &low, int &high)
 {
-    int low_temp_index = -1, high_temp_index = -1;
+    int index = std::lower_bound(axis, axis + size, x) - axis;
 
-    // We need to estimate the actual power value using interpolation on the existing tables.
-    // We first estimate it for the 2 temperatures surrounding the requested temperature,
-    // and then do an interpolation from these 2 values.
-
-    // Go through the temperatures to find the one just below and the one
-    // just above
-    for (unsigned int i = 0; i < this->temp_tables.size(); i++)
+    if (index < size && axis[index] == x)
     {
-        if (this->temp_tables[i]->get_temp() == temp)
-        {
-            low_temp_index = high_temp_index = i;
-            break;
-        }
-
-        if (this->temp_tables[i]->get_temp() > temp)
-        {
-            high_temp_index = i;
-            break;
-        }
-
-        low_temp_index = i;
+        low = high = index;
+    }
+    else
+    {
+        high = index < size ? index : index - 1;
+        low = index > 0 ? index - 1 : index;
     }
+}
 
-    // If we didn't find lower and upper temperature, just take the limit so that we don't do
-    // any estimation outside the given ranges
-    if (high_temp_index == -1)
-        high_temp_index = low_temp_index;
 
-    if (low_temp_index == -1)
-        low_temp_index = high_temp_index;
 
+static inline double power_table_interpolate(double x, double low, double high,
+    double value_at_low, double value_at_high)
+{
+    double ratio = (x - low) / (high - low);
+    return (value_at_high - value_at_low) * ratio + value_at_low;
+}
 
-    double value;
 
-    if (high_temp_index == low_temp_index)
+
+// Extract the childs of a JSON table, sorted by their key
+static std::vector<std::pair<double, js::Config *>> power_table_childs(js::Config *config)
+{
+    std::vector<std::pair<double, js::Config *>> childs;
+    for (auto &x : config->get_childs())
     {
-        // Case where we were outside the given ranges or we found the exact temperature, just return the value at given 
-        // voltage and frequency.
-        value = this->temp_tables[low_temp_index]->get(volt, frequency);
+        childs.push_back(std::make_pair(my_stod(x.first), x.second));
     }
-    else
-    {
-        // Otherwise get the power numbers for the 2 temperatures
-        double low_temp = this->temp_tables[low_temp_index]->get_temp();
-        double high_temp = this->temp_tables[high_temp_index]->get_temp();
 
-        double value_at_low_temp = this->temp_tables[low_temp_index]->get(volt, frequency);
-        double value_at_high_temp = this->temp_tables[high_temp_index]->get(volt, frequency);
+    std::stable_sort(childs.begin(), childs.end(),
+        [](const std::pair<double, js::Config *> &a, const std::pair<double, js::Config *> &b)
+        { return a.first < b.first; });
 
-        // And do the interpolation
-        double temp_ratio = (temp - low_temp) / (high_temp - low_temp);
-        value = (value_at_high_temp - value_at_low_temp) * temp_ratio + value_at_low_temp;
-    }
-    return value;
+    return childs;
 }
 
 
 
-vp::PowerLinearTempTable::PowerLinearTempTable(double temp, js::Config *config)
+vp::PowerLinearTable::PowerLinearTable(js::Config *config)
 {
-    this->temp = temp;
-
-    for (auto &x : config->get_childs())
+    // Flatten the JSON tables, which are indexed by temperature, then voltage, then frequency,
+    // into arrays so that lookups do not need to go through several objects
+    for (auto &temp : power_table_childs(config))
     {
-        volt_tables.push_back(new PowerLinearVoltTable(my_stod(x.first), x.second));
+        this->temps.push_back(temp.first);
+        this->temp_volts.push_back(this->volts.size());
+
+        for (auto &volt : power_table_childs(temp.second))
+        {
+            this->volts.push_back(volt.first);
+            this->volt_freqs.push_back(this->freqs.size());
+
+            // Depending on frequency is currently not always supported, in which case the
+            // power value is given for any frequency, and is then the only point
+            js::Config *any = volt.second->get("any");
+            if (any != NULL)
+            {
+                this->freqs.push_back(0);
+                this->values.push_back(any->get_double());
+            }
+            else
+            {
+                for (auto &freq : power_table_childs(volt.second))
+                {
+                    this->freqs.push_back(freq.first);
+                    this->values.push_back(freq.second->get_double());
+                }
+            }
+        }
     }
 
-    std::sort(this->volt_tables.begin(), this->volt_tables.end(),
-    [](vp::PowerLinearVoltTable *a, vp::PowerLinearVoltTable *b){ return a->get_volt() <= b->get_volt(); });
+    this->temp_volts.push_back(this->volts.size());
+    this->volt_freqs.push_back(this->freqs.size());
+
+    this->cache.reserve(POWER_TABLE_CACHE_SIZE);
 }
 
 
 
-double vp::PowerLinearTempTable::get(double volt, double frequency)
+double vp::PowerLinearTable::get(double temp, double volt, double frequency)
 {
-    int low_index = -1, high_index = -1;
-
-    // We need to estimate the actual power value using interpolation on the existing tables.
-    // We first estimate it for the 2 voltages surrounding the requested voltage,
-    // and then do an interpolation from these 2 values.
-
-    // Go through the temperatures to find the one just below and the one
-    // just above
-    for (unsigned int i = 0; i < this->volt_tables.size(); i++)
+    // The power value only changes when the operating point changes, so check first the ones
+    // which were already resolved
+    for (OperatingPoint &point : this->cache)
     {
-        if (this->volt_tables[i]->get_volt() == volt)
-        {
-            low_index = high_index = i;
-            break;
-        }
-
-        if (this->volt_tables[i]->get_volt() > volt)
+        if (point.temp == temp && point.volt == volt && point.frequency == frequency)
         {
-            high_index = i;
-            break;
+            return point.value;
         }
-
-        low_index = i;
     }
 
-    // If we didn't find lower and upper voltage, just take the limit so that we don't do
-    // any estimation outside the given ranges
-    if (high_index == -1)
-        high_index = low_index;
+    double value = this->compute(temp, volt, frequency);
 
-    if (low_index == -1)
-        low_index = high_index;
-
-    double value;
-    if (high_index == low_index)
+    OperatingPoint point = { temp, volt, frequency, value };
+    if (this->cache.size() < POWER_TABLE_CACHE_SIZE)
     {
-        // Case where we were outside the given ranges or we found the exact voltage, just return the value at given 
-        // frequency.
-        value = this->volt_tables[low_index]->get(frequency);
+        this->cache.push_back(point);
     }
     else
     {
-        // Otherwise get the power numbers for the 2 voltages
-        double low_volt = this->volt_tables[low_index]->get_volt();
-        double high_volt = this->volt_tables[high_index]->get_volt();
-
-        double value_at_low_volt = this->volt_tables[low_index]->get(frequency);
-        double value_at_high_volt = this->volt_tables[high_index]->get(frequency);
-
-        // And do the interpolation
-        double volt_ratio = (volt - low_volt) / (high_volt - low_volt);
-        value = (value_at_high_volt - value_at_low_volt) * volt_ratio + value_at_low_volt;
+        this->cache[this->cache_next] = point;
+        this->cache_next = (this->cache_next + 1) % POWER_TABLE_CACHE_SIZE;
     }
+
     return value;
 }
 
 
 
-vp::PowerLinearVoltTable::PowerLinearVoltTable(double volt, js::Config *config)
+double vp::PowerLinearTable::compute(double temp, double volt, double frequency)
 {
-    this->volt = volt;
+    // We need to estimate the actual power value using interpolation on the existing tables.
+    // We first estimate it for the 2 temperatures surrounding the requested temperature,
+    // and then do an interpolation from these 2 values.
+    int low, high;
+    power_table_find(this->temps.data(), this->temps.size(), temp, low, high);
 
-    // Depending on frequency is currently not supported, so we'll just return
-    // the power value
-    for (auto &x : config->get_childs())
+    double value_at_low = this->get_at_temp(low, volt, frequency);
+    if (low == high)
     {
-        if (x.first == "any")
-        {
-            this->any = new PowerLinearFreqTable(0, x.second);
-        }
-        else
-        {
-            this->freq_tables.push_back(new PowerLinearFreqTable(my_stod(x.first), x.second));
-        }
+        return value_at_low;
     }
 
-    std::sort(this->freq_tables.begin(), this->freq_tables.end(),
-        [](vp::PowerLinearFreqTable *a, vp::PowerLinearFreqTable *b){ return a->get_freq() <= b->get_freq(); });
+    return power_table_interpolate(temp, this->temps[low], this->temps[high],
+        value_at_low, this->get_at_temp(high, volt, frequency));
 }
 
 
 
-double vp::PowerLinearVoltTable::get(double frequency)
+double vp::PowerLinearTable::get_at_temp(int temp_index, double volt, double frequency)
 {
-    if (this->any != NULL)
+    // Same as for temperatures, interpolate from the 2 voltages surrounding the requested one
+    int first = this->temp_volts[temp_index];
+    const double *axis = &this->volts[first];
+    int low, high;
+    power_table_find(axis, this->temp_volts[temp_index + 1] - first, volt, low, high);
+
+    double value_at_low = this->get_at_volt(first + low, frequency);
+    if (low == high)
     {
-        return this->any->get();
+        return value_at_low;
     }
 
-    int low_index = -1, high_index = -1;
-
-    // We need to estimate the actual power value using interpolation on the existing tables.
-    // We first estimate it for the 2 frequencies surrounding the requested voltage,
-    // and then do an interpolation from these 2 values.
-
-    // Go through the frequencies to find the one just below and the one
-    // just above
-    for (unsigned int i = 0; i < this->freq_tables.size(); i++)
-    {
-        if (this->freq_tables[i]->get_freq() == frequency)
-        {
-            low_index = high_index = i;
-            break;
-        }
-
-        if (this->freq_tables[i]->get_freq() > frequency)
-        {
-            high_index = i;
-            break;
-        }
+    return power_table_interpolate(volt, axis[low], axis[high],
+        value_at_low, this->get_at_volt(first + high, frequency));
+}
 
-        low_index = i;
-    }
 
-    // If we didn't find lower and upper voltage, just take the limit so that we don't do
-    // any estimation outside the given ranges
-    if (high_index == -1)
-        high_index = low_index;
 
-    if (low_index == -1)
-        low_index = high_index;
+double vp::PowerLinearTable::get_at_volt(int volt_index, double frequency)
+{
+    int first = this->volt_freqs[volt_index];
+    const double *axis = &this->freqs[first];
+    const double *values = &this->values[first];
+    int low, high;
+    power_table_find(axis, this->volt_freqs[volt_index + 1] - first, frequency, low, high);
 
-    double value;
-    if (high_index == low_index)
+    if (low == high)
     {
-        // Case where we were outside the given ranges or we found the exact voltage, just return the value at given 
-        // frequency.
-        value = this->freq_tables[low_index]->get();
+        return values[low];
     }
-    else
-    {
-        // Otherwise get the power numbers for the 2 frequencies
-        double low_freq = this->freq_tables[low_index]->get_freq();
-        double high_freq = this->freq_tables[high_index]->get_freq();
-
-        double value_at_low_freq = this->freq_tables[low_index]->get();
-        double value_at_high_freq = this->freq_tables[high_index]->get();
-
-        // And do the interpolation
-        double freq_ratio = (frequency - low_freq) / (high_freq - low_freq);
-        value = (value_at_high_freq - value_at_low_freq) * freq_ratio + value_at_low_freq;
-    }
-    return value;
-}
-
 
-
-vp::PowerLinearFreqTable::PowerLinearFreqTable(double freq, js::Config *config)
-: freq(freq)
-{
-    this->value = config->get_double();
+    return power_table_interpolate(frequency, axis[low], axis[high], values[low], values[high]);
 }
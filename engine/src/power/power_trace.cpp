@@ -46,6 +46,17 @@ int vp::PowerTrace::init(Block *top, std::string name, vp::PowerTrace *parent)
     }
 
     this->parent = parent;
+    if (parent)
+    {
+        parent->childs.push_back(this);
+    }
+
+    // Quantums of energy are accounted differently when VCD traces are active, this must be
+    // checked again everytime one of them is enabled or disabled
+    this->trace.register_callback([this]() { this->check_vcd_active(); });
+    this->dyn_trace.register_callback([this]() { this->check_vcd_active(); });
+    this->static_trace.register_callback([this]() { this->check_vcd_active(); });
+    this->check_vcd_active();
 
     this->trace.event_real(0);
     this->dyn_trace.event_real(0);
@@ -89,6 +100,9 @@ void vp::PowerTrace::report_start()
     // for power consumptions, include what has already be accounted
     // in the same cycle.
     this->report_dynamic_energy = this->get_quantum_energy_for_cycle();
+    this->report_counted_energy = this->get_counted_energy(true);
+    this->check_quantum_energy = this->report_dynamic_energy;
+    this->check_quantum_power_timestamp = this->top->time.get_time();
     this->report_leakage_energy = 0;
     this->report_start_timestamp = this->top->time.get_time();
 }
@@ -129,6 +143,154 @@ void vp::PowerTrace::dump(FILE *file)
 
 
 
+double vp::PowerTrace::get_counted_energy(bool before_cycle)
+{
+    double energy = 0;
+
+    for (PowerSource *source : this->sources)
+    {
+        energy += before_cycle ? source->get_quantum_energy_before_cycle() : source->get_quantum_energy();
+    }
+
+    // Quantums of child traces are also accounted to this trace, as it is done through
+    // inc_dynamic_power for the quantums accounted immediately
+    for (PowerTrace *child : this->childs)
+    {
+        energy += child->get_counted_parent_energy();
+    }
+
+    return energy;
+}
+
+
+
+double vp::PowerTrace::get_counted_parent_energy()
+{
+    double energy = 0;
+
+    for (PowerSource *source : this->sources)
+    {
+        energy += source->get_quantum_energy();
+
+        // Remove the part of the last cycle which is not yet accounted. Quantums are only
+        // counted when the trace has a clock.
+        if (source->quantum_cycle_timestamp != -1)
+        {
+            int64_t period = this->top->clock.get_period();
+            int64_t elapsed = this->top->time.get_time() - source->quantum_cycle_timestamp;
+            if (elapsed < period)
+            {
+                energy -= source->get_quantum_energy_last_cycle() * (period - elapsed) / period;
+            }
+        }
+    }
+
+    for (PowerTrace *child : this->childs)
+    {
+        energy += child->get_counted_parent_energy();
+    }
+
+    return energy;
+}
+
+
+
+double vp::PowerTrace::get_counted_power()
+{
+    // In check mode, the quantums are already part of the instant power
+    if (this->quantum_mode == vp::POWER_QUANTUM_CHECK)
+    {
+        return 0;
+    }
+
+    double power = 0;
+
+    for (PowerSource *source : this->sources)
+    {
+        // Quantums are only counted when the trace has a clock
+        if (source->quantum_cycle_timestamp != -1)
+        {
+            int64_t period = this->top->clock.get_period();
+            if (this->top->time.get_time() - source->quantum_cycle_timestamp < period)
+            {
+                power += source->get_quantum_energy_last_cycle() / period;
+            }
+        }
+    }
+
+    for (PowerTrace *child : this->childs)
+    {
+        power += child->get_counted_power();
+    }
+
+    return power;
+}
+
+
+
+void vp::PowerTrace::set_quantum_mode(PowerQuantumMode mode)
+{
+    this->quantum_mode = mode;
+    this->check_vcd_active();
+}
+
+
+
+void vp::PowerTrace::check_vcd_active()
+{
+    this->vcd_active = (this->parent && this->parent->vcd_active) ||
+        this->trace.get_event_active() || this->dyn_trace.get_event_active() ||
+        this->static_trace.get_event_active();
+
+    this->quantum_immediate = this->vcd_active || this->quantum_mode != vp::POWER_QUANTUM_COUNT;
+    this->quantum_counted = this->quantum_mode == vp::POWER_QUANTUM_CHECK ||
+        (this->quantum_mode == vp::POWER_QUANTUM_COUNT && !this->vcd_active);
+
+    for (PowerTrace *child : this->childs)
+    {
+        child->check_vcd_active();
+    }
+}
+
+
+
+void vp::PowerTrace::check_account_quantum_power()
+{
+    int64_t time = this->top->time.get_time();
+    this->check_quantum_energy += this->check_quantum_power * (time - this->check_quantum_power_timestamp);
+    this->check_quantum_power_timestamp = time;
+}
+
+
+
+void vp::PowerTrace::check_inc_quantum_power(double power_incr)
+{
+    this->check_account_quantum_power();
+    this->check_quantum_power += power_incr;
+
+    if (this->parent)
+    {
+        this->parent->check_inc_quantum_power(power_incr);
+    }
+}
+
+
+
+void vp::PowerTrace::check_counted_energy(double counted_energy)
+{
+    this->check_account_quantum_power();
+
+    double diff = counted_energy - this->check_quantum_energy;
+    double max = std::max(std::abs(counted_energy), std::abs(this->check_quantum_energy));
+    if (std::abs(diff) > max * 1e-9 + 1e-18)
+    {
+        this->trace.force_warning("Counted quantums of energy differ from accounted ones "
+            "(accounted: %.12e, counted: %.12e)\n", this->check_quantum_energy, counted_energy);
+    }
+}
+
+
+
 void vp::PowerTrace::dump_vcd_trace()
 {
     // To dump the VCD trace, we need to compute the instant power, since this is what is reported.
@@ -215,6 +377,10 @@ void vp::PowerTrace::inc_dynamic_energy(double quantum)
     double power = quantum / this->top->clock.get_period();
     this->quantum_power_for_cycle += power;
     this->report_dynamic_energy += quantum;
+    if (this->quantum_mode == vp::POWER_QUANTUM_CHECK)
+    {
+        this->check_quantum_energy += quantum;
+    }
 
     // Redump VCD trace since the instant power is impacted
     this->dump_vcd_trace();
@@ -222,6 +388,10 @@ void vp::PowerTrace::inc_dynamic_energy(double quantum)
     if (this->parent)
     {
         this->parent->inc_dynamic_power(power);
+        if (this->quantum_mode == vp::POWER_QUANTUM_CHECK)
+        {
+            this->parent->check_inc_quantum_power(power);
+        }
     }
 }
 
@@ -38,12 +38,14 @@
 #include <netinet/in.h>
 #include <poll.h>
 #include <signal.h>
-#include <regex>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/prctl.h>
 #include <vp/proxy.hpp>
 #include <vp/launcher.hpp>
+#include <vp/time/stop_condition.hpp>
 #include "vp/top.hpp"
 
 
@@ -60,64 +62,248 @@ static std::vector<std::string> split(const std::string& s, char delimiter)
 }
 
 
+static std::vector<std::string> split_words(const std::string &s)
+{
+    std::vector<std::string> words;
+    std::string word;
+    std::istringstream stream(s);
+    while (stream >> word)
+    {
+        words.push_back(word);
+    }
+    return words;
+}
+
+
+// Parse a stop condition, described as "pc:<path>:<pc>", "insn:<path>:<count>",
+// "mem:<path>:<addr>:<value>[:<mask>[:<size>]]", "wire:<path>:<port>" or "timeout:<duration>"
+static bool parse_stop_condition(const std::string &desc, gv::StopCondition &condition)
+{
+    std::vector<std::string> fields = split(desc, ':');
+    if (fields.size() == 0)
+    {
+        return false;
+    }
+
+    std::string type = fields[0];
+    if (type == "timeout" && fields.size() == 2)
+    {
+        condition.type = gv::Stop_condition_timeout;
+        condition.value = strtoull(fields[1].c_str(), NULL, 0);
+    }
+    else if ((type == "pc" || type == "insn") && fields.size() == 3)
+    {
+        condition.type = type == "pc" ? gv::Stop_condition_pc : gv::Stop_condition_insn;
+        condition.path = fields[1];
+        condition.value = strtoull(fields[2].c_str(), NULL, 0);
+    }
+    else if (type == "wire" && fields.size() == 3)
+    {
+        condition.type = gv::Stop_condition_wire;
+        condition.path = fields[1];
+        condition.port = fields[2];
+    }
+    else if (type == "mem" && fields.size() >= 4 && fields.size() <= 6)
+    {
+        condition.type = gv::Stop_condition_mem;
+        condition.path = fields[1];
+        condition.addr = strtoull(fields[2].c_str(), NULL, 0);
+        condition.value = strtoull(fields[3].c_str(), NULL, 0);
+        if (fields.size() >= 5)
+        {
+            condition.mask = strtoull(fields[4].c_str(), NULL, 0);
+        }
+        if (fields.size() == 6)
+        {
+            condition.size = strtol(fields[5].c_str(), NULL, 0);
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
 void gv::GvProxy::notify_stop(int64_t time)
 {
-    this->send_reply("req=-1;msg=stopped=" + std::to_string(time) + '\n');
+    this->run_until_end();
+    this->send_notify(PROXY_NOTIFY_STOPPED, time);
+}
+
+
+void gv::GvProxy::run_until_end()
+{
+    if (this->run_until_armed)
+    {
+        this->run_until_armed = false;
+        this->send_notify(PROXY_NOTIFY_CONDITION, this->engine->stop_conditions_get()->disarm());
+    }
 }
 
 void gv::GvProxy::notify_run(int64_t time)
 {
-    this->send_reply("req=-1;msg=running=" + std::to_string(time) + '\n');
+    this->send_notify(PROXY_NOTIFY_RUNNING, time);
 }
 
 
-void gv::GvProxy::send_reply(std::string msg)
+void gv::GvProxy::send_notify(ProxyNotify notify, int64_t value)
 {
     std::unique_lock<std::mutex> lock(this->mutex);
-    for (auto x: this->sockets)
+    for (ProxyConnection *conn: this->connections)
     {
-        dprintf(x, "%s", msg.c_str());
+        if (!conn->is_socket)
+        {
+            continue;
+        }
+
+        if (conn->is_binary)
+        {
+            ProxyFrame frame = {};
+            frame.cmd = PROXY_CMD_NOTIFY;
+            frame.flags = (uint16_t)notify;
+            if (notify == PROXY_NOTIFY_EXIT)
+            {
+                frame.status = value;
+                fwrite(&frame, sizeof(frame), 1, conn->reply_file);
+            }
+            else
+            {
+                frame.size = sizeof(value);
+                fwrite(&frame, sizeof(frame), 1, conn->reply_file);
+                fwrite(&value, sizeof(value), 1, conn->reply_file);
+            }
+        }
+        else if (notify == PROXY_NOTIFY_EXIT)
+        {
+            fprintf(conn->reply_file, "req=-1;exit=%ld\n", value);
+        }
+        else
+        {
+            fprintf(conn->reply_file, "req=-1;msg=%s=%ld\n",
+                notify == PROXY_NOTIFY_STOPPED ? "stopped" :
+                notify == PROXY_NOTIFY_RUNNING ? "running" : "condition", value);
+        }
+        fflush(conn->reply_file);
+    }
+    lock.unlock();
+}
+
+
+void gv::GvProxy::send_frame(ProxyConnection *conn, ProxyFrame *frame, uint8_t *payload)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    fwrite(frame, sizeof(ProxyFrame), 1, conn->reply_file);
+    if (frame->size)
+    {
+        fwrite(payload, 1, frame->size, conn->reply_file);
     }
+    fflush(conn->reply_file);
     lock.unlock();
 }
 
 
 bool gv::GvProxy::send_payload(FILE *reply_file, std::string req, uint8_t *payload, int size)
 {
-    fprintf(reply_file, "req=%s;payload=%d\n", req.c_str(), size);
+    std::unique_lock<std::mutex> lock(this->mutex);
+    ProxyConnection *reply_conn = NULL;
+    for (ProxyConnection *conn: this->connections)
+    {
+        if (conn->reply_file == reply_file)
+        {
+            reply_conn = conn;
+            break;
+        }
+    }
+
+    // The connection may have been closed since the component got the file, which is then
+    // released and must not be written anymore
+    if (reply_conn == NULL)
+    {
+        return true;
+    }
+
+    bool is_binary = reply_conn->is_binary;
+
+    if (is_binary)
+    {
+        ProxyFrame frame = {};
+        frame.size = size;
+        frame.req = strtoul(req.c_str(), NULL, 0);
+        frame.cmd = PROXY_CMD_PAYLOAD;
+        fwrite(&frame, sizeof(frame), 1, reply_file);
+    }
+    else
+    {
+        fprintf(reply_file, "req=%s;payload=%d\n", req.c_str(), size);
+    }
     int write_size = fwrite(payload, 1, size, reply_file);
     fflush(reply_file);
+    lock.unlock();
     return write_size != size;
 }
 
 
-void gv::GvProxy::proxy_loop(int socket_fd, int reply_fd)
+void gv::GvProxy::engine_exec(std::function<void()> callback)
+{
+    // Our requests come from a different thread, they are posted to the engine which executes
+    // them between two timestamps. In sync mode, the engine is already held by this thread.
+    if (this->is_async)
+    {
+        this->engine->post_sync(callback);
+    }
+    else
+    {
+        callback();
+    }
+}
+
+
+void gv::GvProxy::proxy_loop(ProxyConnection *conn)
 {
-    FILE *sock = fdopen(socket_fd, "r");
-    FILE *reply_sock = fdopen(reply_fd, "w");
     gv::GvsocLauncher *launcher = this->launcher;
-    vp::TimeEngine *engine = launcher->top_get()->get_time_engine();
 
     if (!this->is_async)
     {
-        engine->critical_enter();
+        this->engine->critical_enter();
     }
 
-    while(1)
+    this->text_loop(conn);
+
+    if (conn->is_binary)
     {
-        char line_array[1024];
+        this->binary_loop(conn);
+    }
 
-        if (!fgets(line_array, 1024, sock))
-        {
-            if (!this->is_async)
-            {
-                launcher->release();
-                engine->critical_notify();
-                engine->critical_exit();
-            }
-            return ;
-        }
+    this->shm_map(conn, 0, "");
+
+    if (!this->is_async)
+    {
+        launcher->release();
+        this->engine->critical_notify();
+        this->engine->critical_exit();
+    }
 
+    // The client is gone, release its connection so that sockets do not pile up
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->connections.erase(std::find(this->connections.begin(), this->connections.end(), conn));
+    lock.unlock();
+
+    fclose(conn->reply_file);
+    fclose(conn->req_file);
+    delete conn;
+}
+
+
+void gv::GvProxy::text_loop(ProxyConnection *conn)
+{
+    char *line_array = NULL;
+    size_t line_size = 0;
+
+    while(getline(&line_array, &line_size, conn->req_file) != -1)
+    {
         std::string line = std::string(line_array);
 
         int start = 0;
@@ -150,156 +336,483 @@ void gv::GvProxy::proxy_loop(int socket_fd, int reply_fd)
             }
         }
 
-        std::regex regex{R"([\s]+)"};
-        std::sregex_token_iterator it{cmd.begin(), cmd.end(), regex, -1};
-        std::vector<std::string> words{it, {}};
-        
+        std::vector<std::string> words = split_words(cmd);
+
         if (words.size() > 0)
         {
-            if (words[0] == "run")
+            if (words[0] == "binary")
             {
-                launcher->run();
+                // Switch to the binary protocol once the reply is sent
                 std::unique_lock<std::mutex> lock(this->mutex);
-                dprintf(reply_fd, "req=%s\n", req.c_str());
-                lock.unlock();
-            }
-            else if (words[0] == "step")
-            {
-                if (words.size() != 2)
+                if (words.size() == 2 && strtol(words[1].c_str(), NULL, 0) == GV_PROXY_BINARY_VERSION)
                 {
-                    fprintf(stderr, "This command requires 1 argument: step timestamp");
+                    fprintf(conn->reply_file, "req=%s;msg=%d\n", req.c_str(), GV_PROXY_BINARY_VERSION);
+                    conn->is_binary = true;
                 }
                 else
                 {
-                    int64_t duration = strtol(words[1].c_str(), NULL, 0);
-                    int64_t timestamp = engine->get_time() + duration;
-                    launcher->step(duration);
-                    std::unique_lock<std::mutex> lock(this->mutex);
-                    dprintf(reply_fd, "req=%s;msg=%ld\n", req.c_str(), timestamp);
-                    lock.unlock();
+                    fprintf(conn->reply_file, "req=%s;err=1;err_msg=unsupported binary protocol version\n",
+                        req.c_str());
                 }
+                fflush(conn->reply_file);
+                lock.unlock();
+
+                if (conn->is_binary)
+                {
+                    break;
+                }
+                continue;
+            }
+
+            std::string msg;
+            bool valid;
+            this->engine_exec([&]() {
+                valid = this->exec_cmd(conn, words, conn->req_file, req, msg);
+            });
+
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (!valid && msg != "")
+            {
+                fprintf(conn->reply_file, "req=%s;err=1;err_msg=%s\n", req.c_str(), msg.c_str());
             }
-            else if (words[0] == "stop")
+            else if (!valid)
             {
-                launcher->stop();
-                std::unique_lock<std::mutex> lock(this->mutex);
-                dprintf(reply_fd, "req=%s\n", req.c_str());
-                lock.unlock();
+                fprintf(conn->reply_file, "req=%s;err=1\n", req.c_str());
+            }
+            else if (msg == "")
+            {
+                fprintf(conn->reply_file, "req=%s\n", req.c_str());
+            }
+            else
+            {
+                fprintf(conn->reply_file, "req=%s;msg=%s\n", req.c_str(), msg.c_str());
+            }
+            fflush(conn->reply_file);
+            lock.unlock();
+        }
+    }
+
+    free(line_array);
+}
+
+
+void gv::GvProxy::binary_loop(ProxyConnection *conn)
+{
+    std::vector<uint8_t> payload;
+
+    while(1)
+    {
+        ProxyFrame frame;
+
+        if (fread(&frame, sizeof(frame), 1, conn->req_file) != 1)
+        {
+            return;
+        }
+
+        payload.resize(frame.size);
+        if (frame.size && fread(payload.data(), frame.size, 1, conn->req_file) != 1)
+        {
+            return;
+        }
+
+        // A batch is executed by the engine as a single command
+        this->engine_exec([&]() {
+            this->handle_frame(conn, &frame, payload.data(), NULL);
+        });
+    }
+}
+
+
+void gv::GvProxy::handle_frame(ProxyConnection *conn, ProxyFrame *frame, uint8_t *payload,
+    std::vector<uint8_t> *batch_reply)
+{
+    ProxyFrame reply = {};
+    reply.req = frame->req;
+    reply.cmd = PROXY_CMD_REPLY;
+    uint8_t *reply_payload = NULL;
+    std::string msg;
+    std::vector<uint8_t> replies;
+
+    switch (frame->cmd)
+    {
+        case PROXY_CMD_TEXT:
+        {
+            // Data following the command is given to the command as a file, like in text mode.
+            // The file is empty if there is no data, the command must never read the socket
+            // since it would consume the next frames.
+            static char no_data[1];
+            uint8_t *cmd_end = (uint8_t *)memchr(payload, 0, frame->size);
+            uint8_t *end = payload + frame->size;
+            std::string cmd((char *)payload, cmd_end ? cmd_end - payload : frame->size);
+            FILE *data_file;
+            if (cmd_end && cmd_end + 1 < end)
+            {
+                data_file = fmemopen(cmd_end + 1, end - cmd_end - 1, "r");
             }
-            else if (words[0] == "quit")
+            else
+            {
+                data_file = fmemopen(no_data, 0, "r");
+            }
+
+            std::vector<std::string> words = split_words(cmd);
+            bool valid = data_file != NULL && words.size() > 0 && this->exec_cmd(conn, words,
+                data_file, std::to_string(frame->req), msg);
+
+            if (data_file)
             {
-                if (this->is_async)
+                fclose(data_file);
+            }
+
+            reply.status = valid ? 0 : -1;
+            reply.size = msg.size();
+            reply_payload = (uint8_t *)msg.c_str();
+            break;
+        }
+
+        case PROXY_CMD_MEM_READ:
+        case PROXY_CMD_MEM_WRITE:
+        {
+            bool is_write = frame->cmd == PROXY_CMD_MEM_WRITE;
+            bool is_shm = frame->flags & PROXY_FLAG_SHM;
+            ProxyMemAccess *access = (ProxyMemAccess *)payload;
+            uint8_t *data;
+
+            if (frame->size < sizeof(ProxyMemAccess))
+            {
+                reply.status = -1;
+                break;
+            }
+
+            if (is_shm)
+            {
+                if (access->shm_offset > conn->shm_size ||
+                    access->size > conn->shm_size - access->shm_offset)
                 {
-                    engine->lock();
+                    reply.status = -1;
+                    break;
                 }
-                engine->quit(strtol(words[1].c_str(), NULL, 0));
-                if (this->is_async)
+                data = conn->shm + access->shm_offset;
+            }
+            else if (is_write)
+            {
+                if (access->size > frame->size - sizeof(ProxyMemAccess))
                 {
-                    engine->unlock();
+                    reply.status = -1;
+                    break;
                 }
-                std::unique_lock<std::mutex> lock(this->mutex);
-                dprintf(reply_fd, "req=%s;msg=quit\n", req.c_str());
-                lock.unlock();
+                data = payload + sizeof(ProxyMemAccess);
             }
             else
             {
-                // Before interacting with the engine, we must lock it since our requests will come
-                // from a different thread.
-                if (this->is_async)
+                // The data is sent back in the reply payload, whose size is on 32 bits
+                if (access->size > GV_PROXY_MAX_MEM_ACCESS)
                 {
-                    engine->lock();
+                    reply.status = -1;
+                    break;
                 }
+                conn->buffer.resize(access->size);
+                data = conn->buffer.data();
+            }
+
+            vp::Block *block = (vp::Block *)access->component;
+            reply.status = block->handle_proxy_mem_access(is_write, access->addr, access->size, data);
+
+            if (!is_write && !is_shm)
+            {
+                reply.size = access->size;
+                reply_payload = data;
+            }
+            break;
+        }
 
-                if (words[0] == "get_component")
+        case PROXY_CMD_SHM_MAP:
+        {
+            if (frame->size < sizeof(uint64_t))
+            {
+                reply.status = -1;
+                break;
+            }
+            uint64_t size = *(uint64_t *)payload;
+            std::string path((char *)payload + sizeof(uint64_t), frame->size - sizeof(uint64_t));
+            reply.status = this->shm_map(conn, size, path);
+            break;
+        }
+
+        case PROXY_CMD_BATCH:
+        {
+            uint8_t *current = payload;
+            uint8_t *end = payload + frame->size;
+            while (current < end)
+            {
+                ProxyFrame *cmd = (ProxyFrame *)current;
+                if (end - current < (long)sizeof(ProxyFrame) ||
+                    cmd->size > end - current - sizeof(ProxyFrame))
                 {
-                    vp::Block *comp = this->top->get_block_from_path(split(words[1], '/'));
-                    std::unique_lock<std::mutex> lock(this->mutex);
-                    if (comp)
-                    {
-                        dprintf(reply_fd, "req=%s;msg=%p\n", req.c_str(), comp);
-                    }
-                    else
-                    {
-                        dprintf(reply_fd, "req=%s;msg=0x0\n", req.c_str());
-                    }
-                    lock.unlock();
+                    reply.status = -1;
+                    break;
                 }
-                else if (words[0] == "component")
+                this->handle_frame(conn, cmd, current + sizeof(ProxyFrame), &replies);
+                current += sizeof(ProxyFrame) + cmd->size;
+            }
+
+            reply.cmd = PROXY_CMD_BATCH;
+            reply.size = replies.size();
+            reply_payload = replies.data();
+            break;
+        }
+
+        default:
+            fprintf(stderr, "Ignoring invalid binary command: %d\n", frame->cmd);
+            reply.status = -1;
+    }
+
+    if (batch_reply)
+    {
+        batch_reply->insert(batch_reply->end(), (uint8_t *)&reply, (uint8_t *)&reply + sizeof(reply));
+        batch_reply->insert(batch_reply->end(), reply_payload, reply_payload + reply.size);
+    }
+    else
+    {
+        this->send_frame(conn, &reply, reply_payload);
+    }
+}
+
+
+int gv::GvProxy::shm_map(ProxyConnection *conn, uint64_t size, std::string path)
+{
+    if (conn->shm)
+    {
+        munmap(conn->shm, conn->shm_size);
+        conn->shm = NULL;
+        conn->shm_size = 0;
+    }
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Failed to open shared memory (path: %s, error: %s)\n", path.c_str(),
+            strerror(errno));
+        return -1;
+    }
+
+    void *shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (shm == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map shared memory (path: %s, error: %s)\n", path.c_str(),
+            strerror(errno));
+        return -1;
+    }
+
+    conn->shm = (uint8_t *)shm;
+    conn->shm_size = size;
+
+    return 0;
+}
+
+
+bool gv::GvProxy::exec_cmd(ProxyConnection *conn, std::vector<std::string> &words, FILE *req_file,
+    std::string req, std::string &msg)
+{
+    gv::GvsocLauncher *launcher = this->launcher;
+    vp::TimeEngine *engine = this->engine;
+
+    if (words[0] == "run")
+    {
+        launcher->run();
+    }
+    else if (words[0] == "step")
+    {
+        if (words.size() != 2)
+        {
+            fprintf(stderr, "This command requires 1 argument: step timestamp");
+            return false;
+        }
+        int64_t duration = strtol(words[1].c_str(), NULL, 0);
+        int64_t timestamp = engine->get_time() + duration;
+        launcher->step(duration);
+        msg = std::to_string(timestamp);
+    }
+    else if (words[0] == "stop")
+    {
+        launcher->stop();
+    }
+    else if (words[0] == "run_until")
+    {
+        // The command returns once the conditions are armed. The condition which stopped the
+        // execution is notified once it is stopped.
+        std::vector<gv::StopCondition> conditions(words.size() - 1);
+        for (size_t i=1; i<words.size(); i++)
+        {
+            if (!parse_stop_condition(words[i], conditions[i-1]))
+            {
+                fprintf(stderr, "Invalid stop condition: %s\n", words[i].c_str());
+                return false;
+            }
+        }
+
+        vp::StopConditions *stop_conditions = engine->stop_conditions_get();
+        if (stop_conditions->arm(conditions))
+        {
+            return false;
+        }
+        this->run_until_armed = true;
+
+        if (stop_conditions->is_hit())
+        {
+            this->run_until_end();
+        }
+        else
+        {
+            launcher->run();
+
+            // In synchronous mode, the execution is over once run returns
+            if (!this->is_async)
+            {
+                this->run_until_end();
+            }
+        }
+    }
+    else if (words[0] == "quit")
+    {
+        engine->quit(words.size() > 1 ? strtol(words[1].c_str(), NULL, 0) : 0);
+        msg = "quit";
+    }
+    else
+    {
+        if (words[0] == "get_component" && words.size() == 2)
+        {
+            vp::Block *comp = this->top->get_block_from_path(split(words[1], '/'));
+            char ptr[32];
+            snprintf(ptr, sizeof(ptr), "%p", comp);
+            msg = comp ? ptr : "0x0";
+        }
+        else if (words[0] == "component" && words.size() >= 2)
+        {
+            vp::Component *comp = (vp::Component *)strtoll(words[1].c_str(), NULL, 0);
+            msg = comp->handle_command(this, req_file, conn->reply_file, {words.begin() + 2, words.end()}, req);
+        }
+        else if (words[0] == "trace" && words.size() == 2 && words[1] == "dump_recorder")
+        {
+            this->top->traces.get_trace_engine()->dump_recorder();
+        }
+        else if (words[0] == "trace")
+        {
+            if (words.size() != 3)
+            {
+                fprintf(stderr, "This command requires 2 arguments: trace [add|remove] regexp");
+                return false;
+            }
+
+            if (words[1] == "add")
+            {
+                this->top->traces.get_trace_engine()->add_trace_path(0, words[2]);
+                this->top->traces.get_trace_engine()->check_traces();
+            }
+            else if (words[1] == "level")
+            {
+                this->top->traces.get_trace_engine()->set_trace_level(words[2].c_str());
+                this->top->traces.get_trace_engine()->check_traces();
+            }
+            else
+            {
+                this->top->traces.get_trace_engine()->add_exclude_trace_path(0, words[2]);
+                this->top->traces.get_trace_engine()->check_traces();
+            }
+        }
+        else if (words[0] == "event")
+        {
+            if (words.size() != 3)
+            {
+                fprintf(stderr, "This command requires 2 arguments: event [add|remove] regexp");
+                return false;
+            }
+
+            // Events are enabled from their path, which is directly resolved from
+            // the trace path tree. Regular expressions can be given with
+            // add_regex and remove_regex and only trigger a check of the traces
+            // they match.
+            if (words[1] == "add")
+            {
+                this->top->traces.get_trace_engine()->conf_trace(1, words[2], 1);
+            }
+            else if (words[1] == "add_regex")
+            {
+                this->top->traces.get_trace_engine()->add_trace_path(1, words[2]);
+                this->top->traces.get_trace_engine()->check_traces();
+            }
+            else if (words[1] == "remove_regex")
+            {
+                this->top->traces.get_trace_engine()->add_exclude_trace_path(1, words[2]);
+                this->top->traces.get_trace_engine()->check_traces();
+            }
+            else
+            {
+                this->top->traces.get_trace_engine()->conf_trace(1, words[2], 0);
+            }
+        }
+        else if (words[0] == "power" && words.size() >= 2 && words[1] == "sampler_start")
+        {
+            // Sampler options are given as key=value pairs
+            gv::PowerSamplerConfig config;
+            for (auto x = words.begin() + 2; x != words.end(); x++)
+            {
+                std::string name = x->substr(0, x->find("="));
+                std::string value = x->substr(x->find("=") + 1);
+
+                if (name == "period")
                 {
-                    vp::Component *comp = (vp::Component *)strtoll(words[1].c_str(), NULL, 0);
-                    std::string retval = comp->handle_command(this, sock, reply_sock, {words.begin() + 2, words.end()}, req);
-                    std::unique_lock<std::mutex> lock(this->mutex);
-                    fprintf(reply_sock, "req=%s;msg=%s\n", req.c_str(), retval.c_str());
-                    fflush(reply_sock);
-                    lock.unlock();
+                    config.period = strtoll(value.c_str(), NULL, 0);
                 }
-                else if (words[0] == "trace")
+                else if (name == "format")
                 {
-                    if (words.size() != 3)
-                    {
-                        fprintf(stderr, "This command requires 2 arguments: trace [add|remove] regexp");
-                    }
-                    else
-                    {
-                        if (words[1] == "add")
-                        {
-                            this->top->traces.get_trace_engine()->add_trace_path(0, words[2]);
-                            this->top->traces.get_trace_engine()->check_traces();
-                        }
-                        else if (words[1] == "level")
-                        {
-                            this->top->traces.get_trace_engine()->set_trace_level(words[2].c_str());
-                            this->top->traces.get_trace_engine()->check_traces();
-                        }
-                        else
-                        {
-                            this->top->traces.get_trace_engine()->add_exclude_trace_path(0, words[2]);
-                            this->top->traces.get_trace_engine()->check_traces();
-                        }
-                        fprintf(reply_sock, "req=%s\n", req.c_str());
-                        fflush(reply_sock);
-                    }
+                    config.format = value;
                 }
-                else if (words[0] == "event")
+                else if (name == "file")
                 {
-                    if (words.size() != 3)
-                    {
-                        fprintf(stderr, "This command requires 2 arguments: event [add|remove] regexp");
-                    }
-                    else
-                    {
-                        if (words[1] == "add")
-                        {
-                            // TODO regular expressions are too slow for the profiler, should be moved
-                            // to a new command
-                            //this->top->traces.get_trace_engine()->add_trace_path(1, words[2]);
-                            //this->top->traces.get_trace_engine()->check_traces();
-                            this->top->traces.get_trace_engine()->conf_trace(1, words[2], 1);
-                        }
-                        else
-                        {
-                            //this->top->traces.get_trace_engine()->add_exclude_trace_path(1, words[2]);
-                            //this->top->traces.get_trace_engine()->check_traces();
-                            this->top->traces.get_trace_engine()->conf_trace(1, words[2], 0);
-                        }
-                        fprintf(reply_sock, "req=%s\n", req.c_str());
-                    }
+                    config.path = value;
                 }
-                else
+                else if (name == "clock")
                 {
-                    printf("Ignoring2 invalid command: %s\n", words[0].c_str());
+                    config.clock = value;
                 }
-                if (this->is_async)
+                else if (name == "block")
                 {
-                    engine->unlock();
+                    config.blocks.push_back(value);
                 }
             }
+            // The configuration comes from a remote client, an invalid one must not end the
+            // simulation
+            std::string error;
+            if (this->top->power.get_engine()->sampler_start(config, &error))
+            {
+                fprintf(stderr, "%s\n", error.c_str());
+                msg = error;
+                return false;
+            }
+        }
+        else if (words[0] == "power" && words.size() == 2 && words[1] == "sampler_stop")
+        {
+            this->top->power.get_engine()->sampler_stop();
+        }
+        else
+        {
+            printf("Ignoring invalid command: %s\n", words[0].c_str());
+            return false;
         }
     }
+
+    return true;
 }
 
 gv::GvProxy::GvProxy(vp::TimeEngine *engine, vp::Component *top, gv::GvsocLauncher *launcher, bool is_async, int req_pipe, int reply_pipe)
-  : top(top), launcher(launcher), req_pipe(req_pipe), reply_pipe(reply_pipe)
+  : engine(engine), top(top), launcher(launcher), req_pipe(req_pipe), reply_pipe(reply_pipe)
 {
     this->is_async = is_async;
     launcher->register_exec_notifier(this);
@@ -321,8 +834,19 @@ void gv::GvProxy::listener(void)
             return;
         }
 
-        this->sockets.push_back(client_fd);
-        this->loop_thread = new std::thread(&gv::GvProxy::proxy_loop, this, client_fd, client_fd);
+        ProxyConnection *conn = new ProxyConnection();
+        conn->req_fd = client_fd;
+        conn->req_file = fdopen(client_fd, "r");
+        // Use another descriptor for replies so that both files can be closed
+        conn->reply_fd = dup(client_fd);
+        conn->reply_file = fdopen(conn->reply_fd, "w");
+        conn->is_socket = true;
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->connections.push_back(conn);
+        lock.unlock();
+
+        this->loop_thread = new std::thread(&gv::GvProxy::proxy_loop, this, conn);
     }
 }
 
@@ -376,7 +900,15 @@ int gv::GvProxy::open(int port, int *out_port)
     }
     else
     {
-        this->loop_thread = new std::thread(&gv::GvProxy::proxy_loop, this, this->req_pipe, this->reply_pipe);
+        ProxyConnection *conn = new ProxyConnection();
+        conn->req_fd = this->req_pipe;
+        conn->reply_fd = this->reply_pipe;
+        conn->req_file = fdopen(this->req_pipe, "r");
+        conn->reply_file = fdopen(this->reply_pipe, "w");
+        conn->is_socket = false;
+        this->connections.push_back(conn);
+
+        this->loop_thread = new std::thread(&gv::GvProxy::proxy_loop, this, conn);
     }
 
     return 0;
@@ -386,9 +918,15 @@ int gv::GvProxy::open(int port, int *out_port)
 
 void gv::GvProxy::stop(int status)
 {
-    for (auto x: this->sockets)
+    this->send_notify(PROXY_NOTIFY_EXIT, status);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (ProxyConnection *conn: this->connections)
     {
-        dprintf(x, "req=-1;exit=%d\n", status);
-        shutdown(x, SHUT_RDWR);
+        if (conn->is_socket)
+        {
+            shutdown(conn->req_fd, SHUT_RDWR);
+        }
     }
+    lock.unlock();
 }
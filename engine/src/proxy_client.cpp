@@ -246,6 +246,11 @@ int64_t Gvsoc_proxy_client::step_until(int64_t duration)
     return 0;
 }
 
+int Gvsoc_proxy_client::run_until(std::vector<gv::StopCondition> &conditions)
+{
+    return -1;
+}
+
 gv::Io_binding *Gvsoc_proxy_client::io_bind(gv::Io_user *user, std::string comp_name, std::string itf_name)
 {
     return NULL;
@@ -439,3 +444,23 @@ gv::PowerReport *Gvsoc_proxy_client::report_get()
 {
     return NULL;
 }
+
+void Gvsoc_proxy_client::sampler_start(gv::PowerSamplerConfig &config)
+{
+    std::string command = "power sampler_start period=" + std::to_string(config.period) +
+        " format=" + config.format + " file=" + config.path;
+    if (config.clock != "")
+    {
+        command += " clock=" + config.clock;
+    }
+    for (std::string &block : config.blocks)
+    {
+        command += " block=" + block;
+    }
+    this->send_command(command);
+}
+
+void Gvsoc_proxy_client::sampler_stop()
+{
+    this->send_command("power sampler_stop");
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <stdio.h>
+#include <sstream>
+#include <vp/vp.hpp>
+#include <vp/time/stop_condition.hpp>
+
+
+static std::vector<std::string> split_path(const std::string &path)
+{
+    std::vector<std::string> tokens;
+    std::string token;
+    std::istringstream stream(path);
+    while (std::getline(stream, token, '/'))
+    {
+        if (token != "")
+        {
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+
+vp::StopCondition::StopCondition(StopConditions *engine, gv::StopCondition &config, int index)
+    : config(config), index(index), engine(engine)
+{
+}
+
+void vp::StopCondition::hit()
+{
+    this->engine->condition_hit(this);
+}
+
+void vp::MasterPort::watch_hit()
+{
+    this->watch_condition->hit();
+}
+
+
+vp::StopConditions::StopConditions(vp::Component *top)
+    : vp::Block(top, "stop_conditions"), top(top),
+    timeout_event(this, &StopConditions::timeout_handler)
+{
+}
+
+int vp::StopConditions::arm(std::vector<gv::StopCondition> &conditions)
+{
+    this->disarm();
+
+    int64_t timeout = -1;
+
+    for (size_t i=0; i<conditions.size(); i++)
+    {
+        gv::StopCondition &config = conditions[i];
+        StopCondition *condition = new StopCondition(this, config, i);
+        vp::Block *block = NULL;
+        vp::MasterPort *port = NULL;
+
+        this->conditions.push_back(condition);
+
+        if (config.type == gv::Stop_condition_timeout)
+        {
+            if (timeout == -1 || (int64_t)config.value < timeout)
+            {
+                timeout = config.value;
+                this->timeout_event.get_args()[0] = (void *)condition;
+            }
+        }
+        else
+        {
+            block = this->top->get_block_from_path(split_path(config.path));
+            if (block == NULL)
+            {
+                fprintf(stderr, "Invalid stop condition path (path: %s)\n",
+                    config.path.c_str());
+            }
+            else if (config.type == gv::Stop_condition_wire)
+            {
+                vp::Port *wire_port = block->is_component() ?
+                    ((vp::Component *)block)->get_port(config.port) : NULL;
+                if (wire_port == NULL || !wire_port->is_master() ||
+                    !((vp::MasterPort *)wire_port)->watch(condition))
+                {
+                    fprintf(stderr, "Invalid stop condition wire port (path: %s, port: %s)\n",
+                        config.path.c_str(), config.port.c_str());
+                    block = NULL;
+                }
+                else
+                {
+                    port = (vp::MasterPort *)wire_port;
+                }
+            }
+            else if (!block->stop_condition_arm(condition))
+            {
+                fprintf(stderr, "Stop condition not supported by component (path: %s, type: %d)\n",
+                    config.path.c_str(), config.type);
+                block = NULL;
+            }
+
+            if (block == NULL)
+            {
+                this->blocks.push_back(NULL);
+                this->ports.push_back(NULL);
+                this->disarm();
+                return -1;
+            }
+        }
+
+        this->blocks.push_back(port ? NULL : block);
+        this->ports.push_back(port);
+    }
+
+    if (timeout != -1 && this->hit_index == -1)
+    {
+        this->timeout_event.enqueue(timeout);
+    }
+
+    return 0;
+}
+
+int vp::StopConditions::disarm()
+{
+    for (size_t i=0; i<this->conditions.size(); i++)
+    {
+        if (this->blocks[i])
+        {
+            this->blocks[i]->stop_condition_disarm(this->conditions[i]);
+        }
+        else if (this->ports[i])
+        {
+            this->ports[i]->unwatch();
+        }
+        delete this->conditions[i];
+    }
+
+    this->conditions.clear();
+    this->blocks.clear();
+    this->ports.clear();
+    this->timeout_event.cancel();
+
+    int index = this->hit_index;
+    this->hit_index = -1;
+    return index;
+}
+
+void vp::StopConditions::condition_hit(StopCondition *condition)
+{
+    if (this->hit_index == -1)
+    {
+        this->hit_index = condition->index;
+        this->top->time.get_engine()->pause();
+    }
+}
+
+void vp::StopConditions::timeout_handler(vp::Block *__this, vp::TimeEvent *event)
+{
+    StopCondition *condition = (StopCondition *)event->get_args()[0];
+    condition->hit();
+}
@@ -22,6 +22,12 @@
 #include <vp/vp.hpp>
 #include "vp/time/time_engine.hpp"
 #include <vp/time/time_event.hpp>
+#include <vp/time/stop_condition.hpp>
+#include <sched.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 
 namespace vp
@@ -32,11 +38,14 @@ namespace vp
         Time_engine_stop_event(Component *top);
         int64_t step(int64_t duration);
         vp::TimeEvent *step_nofree(int64_t duration);
+        // Give back an event returned by step_nofree once it has been executed
+        void release(vp::TimeEvent *event);
 
     private:
         static void event_handler(vp::Block *__this, vp::TimeEvent *event);
         static void event_handler_nofree(vp::Block *__this, vp::TimeEvent *event);
         Component *top;
+        vp::Pool<vp::TimeEvent> events;
     };
 }
 
@@ -56,6 +65,7 @@ void vp::TimeEngine::init(vp::Component *top)
 {
     this->top = top;
     this->stop_event = new vp::Time_engine_stop_event(this->top);
+    this->stop_conditions = new vp::StopConditions(this->top);
 }
 
 int64_t vp::TimeEngine::exec()
@@ -152,6 +162,148 @@ int64_t vp::TimeEngine::exec()
     return time;
 }
 
+static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t value)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static inline void futex_wake(std::atomic<uint32_t> *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+void vp::TimeEngine::push_command(EngineCommand *command)
+{
+    EngineCommand *head = this->commands.load(std::memory_order_relaxed);
+    do
+    {
+        command->next = head;
+    } while (!this->commands.compare_exchange_weak(head, command));
+
+    // Make the engine leave its fast loop so that it handles the command at the end of the
+    // current timestamp
+    this->stop_req = true;
+
+    // If the engine is waiting, it has to be woken up. It owns the mutex except while it is
+    // in the condition wait, so only try to take it, and give up once the engine is awake
+    // since it will see the command anyway.
+    while (this->idle.load())
+    {
+        if (pthread_mutex_trylock(&this->mutex) == 0)
+        {
+            pthread_cond_broadcast(&this->cond);
+            pthread_mutex_unlock(&this->mutex);
+            break;
+        }
+        sched_yield();
+    }
+}
+
+void vp::TimeEngine::post(std::function<void()> callback)
+{
+    if (std::this_thread::get_id() == this->engine_thread)
+    {
+        callback();
+        return;
+    }
+
+    if (!this->is_async)
+    {
+        this->lock();
+        callback();
+        this->unlock();
+        return;
+    }
+
+    EngineCommand *command = new EngineCommand(callback);
+    command->is_allocated = true;
+    this->push_command(command);
+}
+
+void vp::TimeEngine::post_async(std::function<void()> callback)
+{
+    if (std::this_thread::get_id() == this->engine_thread)
+    {
+        callback();
+        return;
+    }
+
+    EngineCommand *command = new EngineCommand(callback);
+    command->is_allocated = true;
+    this->push_command(command);
+}
+
+void vp::TimeEngine::post_sync(std::function<void()> callback)
+{
+    if (std::this_thread::get_id() == this->engine_thread)
+    {
+        callback();
+        return;
+    }
+
+    if (!this->is_async)
+    {
+        this->lock();
+        callback();
+        this->unlock();
+        return;
+    }
+
+    EngineCommand command(callback);
+    this->push_command(&command);
+
+    while (command.done.load(std::memory_order_acquire) == 0)
+    {
+        futex_wait(&command.done, 0);
+    }
+}
+
+void vp::TimeEngine::exec_commands()
+{
+    EngineCommand *command = this->commands.exchange(NULL);
+
+    // The queue is a stack, reverse it to execute the commands in posting order
+    EngineCommand *first = NULL;
+    while (command)
+    {
+        EngineCommand *next = command->next;
+        command->next = first;
+        first = command;
+        command = next;
+    }
+
+    while (first)
+    {
+        EngineCommand *next = first->next;
+        first->callback();
+        if (first->is_allocated)
+        {
+            delete first;
+        }
+        else
+        {
+            // The posting thread may free the command as soon as it sees it done
+            first->done.store(1, std::memory_order_release);
+            futex_wake(&first->done);
+        }
+        first = next;
+    }
+}
+
+void vp::TimeEngine::critical_wait_commands()
+{
+    // The idle flag must be visible before checking the queue, so that a thread posting a
+    // command meanwhile either sees it and wakes us up, or has its command seen here.
+    this->idle.store(true);
+    if (this->commands.load() == NULL)
+    {
+        pthread_cond_wait(&this->cond, &this->mutex);
+    }
+    this->idle.store(false);
+
+    this->handle_commands();
+}
+
 void vp::TimeEngine::handle_locks()
 {
     while (this->lock_req > 0)
@@ -189,6 +341,7 @@ int64_t vp::TimeEngine::run_until(int64_t end_time)
             // This is the case once our event is not enqueued anymore
             if (!event->is_enqueued())
             {
+                this->stop_event->release(event);
                 return this->get_next_event_time();
             }
         }
@@ -199,12 +352,15 @@ int64_t vp::TimeEngine::run_until(int64_t end_time)
         // when locks are handled.
         this->stop_req = false;
 
+        this->handle_commands();
+
         // Checks locks since we may have been stopped by them
         this->handle_locks();
 
         // Leave only once our event is over
         if (!event->is_enqueued())
         {
+            this->stop_event->release(event);
             break;
         }
     }
@@ -227,10 +383,14 @@ int64_t vp::TimeEngine::run()
         // when locks are handled.
         this->stop_req = false;
 
-        // In case there is no more event, stall the engine until something happens.
-        if (time == -1)
+        // Commands posted meanwhile are executed now, they may enqueue new events
+        this->handle_commands();
+
+        // In case there is no more event, stall the engine until something happens, unless the
+        // last event paused it, like a stop condition.
+        if (this->first_client == NULL && !this->pause_req)
         {
-            pthread_cond_wait(&cond, &mutex);
+            this->critical_wait_commands();
         }
 
         // Checks locks since we may have been stopped by them
@@ -319,6 +479,13 @@ bool vp::TimeEngine::enqueue(vp::Block *client, int64_t full_time)
 
 void vp::TimeEngine::quit(int status)
 {
+    // Simulation is failing, the flight recorder will write what it kept once the engine
+    // is closed
+    if (status != 0)
+    {
+        this->top->traces.get_trace_engine()->request_recorder_dump();
+    }
+
     this->pause();
     this->stop_status = status;
     this->finished = true;
@@ -346,6 +513,7 @@ void vp::TimeEngine::pause()
 void vp::TimeEngine::flush()
 {
     this->top->flush_all();
+    this->top->traces.get_trace_engine()->flush_messages();
     fflush(NULL);
 }
 
@@ -362,13 +530,13 @@ void vp::TimeEngine::fatal(const char *fmt, ...)
 }
 
 vp::Time_engine_stop_event::Time_engine_stop_event(vp::Component *top)
-    : vp::Block(top, "stop_event"), top(top)
+    : vp::Block(top, "stop_event"), top(top), events("stop_event")
 {
 }
 
 int64_t vp::Time_engine_stop_event::step(int64_t time)
 {
-    vp::TimeEvent *event = new vp::TimeEvent(this);
+    vp::TimeEvent *event = this->events.alloc(this);
     event->set_callback(this->event_handler);
     event->enqueue(time - top->time.get_engine()->get_time());
     return 0;
@@ -376,17 +544,23 @@ int64_t vp::Time_engine_stop_event::step(int64_t time)
 
 vp::TimeEvent *vp::Time_engine_stop_event::step_nofree(int64_t time)
 {
-    vp::TimeEvent *event = new vp::TimeEvent(this);
+    vp::TimeEvent *event = this->events.alloc(this);
     event->set_callback(this->event_handler_nofree);
     event->enqueue(time - top->time.get_engine()->get_time());
     return event;
 }
 
+void vp::Time_engine_stop_event::release(vp::TimeEvent *event)
+{
+    this->events.free(event);
+}
+
 void vp::Time_engine_stop_event::event_handler(vp::Block *__this, vp::TimeEvent *event)
 {
     Time_engine_stop_event *_this = (Time_engine_stop_event *)__this;
     _this->top->time.get_engine()->pause();
     _this->top->time.get_engine()->retain_inc(1);
+    _this->events.free(event);
 }
 
 void vp::Time_engine_stop_event::event_handler_nofree(vp::Block *__this, vp::TimeEvent *event)
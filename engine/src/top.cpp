@@ -23,9 +23,9 @@
 #include <vp/vp.hpp>
 #include "vp/top.hpp"
 
-vp::Top::Top(std::string config_path, bool is_async)
+vp::Top::Top(std::string config_path, bool is_async, std::string config_cache_path)
 {
-    js::Config *js_config = js::import_config_from_file(config_path);
+    js::Config *js_config = js::import_config_from_file(config_path, config_cache_path);
     if (js_config == NULL)
     {
         throw std::invalid_argument("Invalid configuration.");
@@ -34,13 +34,14 @@ vp::Top::Top(std::string config_path, bool is_async)
     this->gv_config = js_config->get("target/gvsoc");
 
     this->time_engine = new vp::TimeEngine(this->gv_config);
+    this->time_engine->is_async = is_async;
     this->trace_engine = new vp::TraceEngine(this->gv_config);
     this->power_engine = new vp::PowerEngine();
 
     this->top_instance = vp::Component::load_component(js_config->get("**/target"), this->gv_config,
         NULL, "", this->time_engine, this->trace_engine, this->power_engine);
 
-    power_engine->init(this->top_instance);
+    power_engine->init(this->top_instance, this->gv_config);
     trace_engine->init(this->top_instance);
     time_engine->init(this->top_instance);
 }
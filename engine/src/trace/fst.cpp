@@ -24,6 +24,7 @@
 #include "vp/trace/event_dumper.hpp"
 #include <string.h>
 #include <stdexcept>
+#include <algorithm>
 
 vp::Fst_file::Fst_file(vp::Event_dumper *dumper, string path)
 {
@@ -33,6 +34,33 @@ vp::Fst_file::Fst_file(vp::Event_dumper *dumper, string path)
     throw std::invalid_argument("Error while opening FST file (path: " + path + ")\n");
   }
   fstWriterSetTimescale(this->writer, -12);
+
+  js::Config *config = dumper->get_config();
+
+  // Blocks of value changes are compressed with LZ4 by default, which is much faster than zlib
+  // for a slightly bigger file
+  string pack = config->get_child_str("**/events/fst/pack");
+  if (pack == "" || pack == "lz4")
+  {
+    fstWriterSetPackType(this->writer, FST_WR_PT_LZ4);
+  }
+  else if (pack == "fastlz")
+  {
+    fstWriterSetPackType(this->writer, FST_WR_PT_FASTLZ);
+  }
+  else if (pack == "zlib")
+  {
+    fstWriterSetPackType(this->writer, FST_WR_PT_ZLIB);
+  }
+  else
+  {
+    throw std::invalid_argument("Unknown FST pack type (name: " + pack + ")\n");
+  }
+
+  // Blocks are compressed and written by a separate thread, so that the dumper thread can
+  // keep on filling the next block
+  js::Config *parallel = config->get("**/events/fst/parallel");
+  fstWriterSetParallelMode(this->writer, parallel == NULL || parallel->get_bool());
 }
 
 
@@ -58,10 +86,8 @@ string vp::Fst_file::parse_path(string path, bool begin)
   return path.substr(start, end);
 }
 
-void vp::Fst_file::add_trace(string path, int id, int width, bool is_real, bool is_string)
+void vp::Fst_file::create_var(string name, int id, int width, bool is_real, bool is_string)
 {
-  string name = this->parse_path(path, true);
-
   fstHandle var;
   if (is_real)
   {
@@ -75,15 +101,115 @@ void vp::Fst_file::add_trace(string path, int id, int width, bool is_real, bool
   {
     var = fstWriterCreateVar(this->writer, FST_VT_VCD_WIRE, FST_VD_INOUT, width, name.c_str(), 0);
   }
-  this->vars.resize(id+1);
+
+  if ((int)this->vars.size() <= id)
+  {
+    this->vars.resize(id+1);
+    this->values.resize(id+1);
+    this->has_value.resize(id+1);
+  }
   this->vars[id] = var;
+}
 
-  this->parse_path(string(path), false);
+void vp::Fst_file::add_trace(string path, int id, int width, bool is_real, bool is_string)
+{
+  if (!this->header_dumped)
+  {
+    // Variables are only created when the first value is dumped, so that the scopes they
+    // share are opened only once
+    this->pending_vars.push_back({ path, id, width, is_real, is_string });
+  }
+  else
+  {
+    string name = this->parse_path(path, true);
+    this->create_var(name, id, width, is_real, is_string);
+    this->parse_path(path, false);
+  }
+}
+
+void vp::Fst_file::dump_header()
+{
+  this->header_dumped = true;
+
+  // Once sorted, all the variables of the same scope are contiguous, so that we can walk the
+  // scope tree by just comparing each path with the previous one
+  std::sort(this->pending_vars.begin(), this->pending_vars.end(),
+    [](const Fst_var &a, const Fst_var &b) { return a.path < b.path; });
+
+  std::vector<string> scopes;
+
+  for (Fst_var &var : this->pending_vars)
+  {
+    std::vector<string> path;
+    size_t start = 0;
+    size_t end;
+    while ((end = var.path.find('/', start)) != std::string::npos)
+    {
+      if (end != start)
+      {
+        path.push_back(var.path.substr(start, end - start));
+      }
+      start = end + 1;
+    }
+
+    size_t common = 0;
+    while (common < scopes.size() && common < path.size() && scopes[common] == path[common])
+    {
+      common++;
+    }
+
+    while (scopes.size() > common)
+    {
+      fstWriterSetUpscope(this->writer);
+      scopes.pop_back();
+    }
+
+    for (size_t i=common; i<path.size(); i++)
+    {
+      fstWriterSetScope(this->writer, FST_ST_VCD_MODULE, path[i].c_str(), NULL);
+      scopes.push_back(path[i]);
+    }
+
+    this->create_var(var.path.substr(start), var.id, var.width, var.is_real, var.is_string);
+  }
+
+  while (scopes.size() > 0)
+  {
+    fstWriterSetUpscope(this->writer);
+    scopes.pop_back();
+  }
+
+  this->pending_vars.clear();
 }
 
 void vp::Fst_file::dump(int64_t timestamp, int id, uint8_t *event, int width, bool is_real, bool is_string, uint8_t flags, uint8_t *flag_mask)
 {
-  fstWriterEmitTimeChange(this->writer, timestamp);
+  if (!this->header_dumped)
+  {
+    this->dump_header();
+  }
+
+  // Drop the value if it is the same as the last one dumped, since the trace engine forwards
+  // all the values, even when they do not change
+  int size = is_real ? 8 : is_string ? width : (width + 7) / 8;
+  std::vector<uint8_t> &value = this->values[id];
+  if (this->has_value[id] && (int)value.size() == size + 1 && value[size] == flags &&
+    memcmp(value.data(), event, size) == 0)
+  {
+    return;
+  }
+  value.resize(size + 1);
+  memcpy(value.data(), event, size);
+  value[size] = flags;
+  this->has_value[id] = true;
+
+  // All the value changes of the same timestamp are emitted after a single time change
+  if (timestamp != this->last_timestamp)
+  {
+    fstWriterEmitTimeChange(this->writer, timestamp);
+    this->last_timestamp = timestamp;
+  }
+
   if (is_real)
   {
     fstWriterEmitValueChange(this->writer, this->vars[id], event);
@@ -101,7 +227,7 @@ void vp::Fst_file::dump(int64_t timestamp, int id, uint8_t *event, int width, bo
       if (flags == 1)
         val[width - i - 1] = 'Z';
       else
-        val[width - i - 1] = '0' + (((*(uint32_t *)event) >> i) & 1);
+        val[width - i - 1] = '0' + ((event[i >> 3] >> (i & 7)) & 1);
     }
     fstWriterEmitValueChange(this->writer, this->vars[id], val);
   }
@@ -109,5 +235,9 @@ void vp::Fst_file::dump(int64_t timestamp, int id, uint8_t *event, int width, bo
 
 void vp::Fst_file::close()
 {
+  if (!this->header_dumped)
+  {
+    this->dump_header();
+  }
   fstWriterClose(this->writer);
 }
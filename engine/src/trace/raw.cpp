@@ -22,12 +22,16 @@
 #include "vp/vp.hpp"
 #include "vp/trace/event_dumper.hpp"
 #include <string.h>
-#include "raw/trace_dumper.hpp"
+#include "raw/trace_chunks.hpp"
 #include <stdexcept>
 
 vp::Raw_file::Raw_file(vp::Event_dumper *dumper, string path)
 {
-    trace_dumper_client *td = new trace_dumper_client(path);
+    // Events are written in compressed chunks with a time index, so that a time window can be
+    // extracted without reading the whole file
+    size_t chunk_size = dumper->get_config()->get_child_int("**/events/raw/chunk_size");
+    trace_chunks_writer *td = new trace_chunks_writer(path,
+        chunk_size ? chunk_size : TRACE_CHUNKS_DEFAULT_SIZE);
     this->dumper = td;
 
     if (td->open(ED_CONF_TIMESCALE_PS))
@@ -41,7 +45,7 @@ vp::Raw_file::Raw_file(vp::Event_dumper *dumper, string path)
 void vp::Raw_file::add_trace(string path, int id, int width, bool is_real, bool is_string)
 {
 
-    trace_dumper_client *td = (trace_dumper_client *)this->dumper;
+    trace_chunks_writer *td = (trace_chunks_writer *)this->dumper;
     ed_trace_type_e type;
 
     if (is_real)
@@ -58,20 +62,24 @@ void vp::Raw_file::add_trace(string path, int id, int width, bool is_real, bool
         type = ED_TRACE_BITFIELD;
     }
 
-    trace_dumper_trace *trace = td->reg_trace(path, id, type, width);
+    trace_chunks_trace *trace = td->reg_trace(path, id, type, width);
+    if (trace == NULL)
+    {
+        throw std::runtime_error("Error while writing RAW file (trace: " + path + ", error: " + strerror(errno) + ")\n");
+    }
 
     this->traces[id] = (void *)trace;
 }
 
 void vp::Raw_file::dump(int64_t timestamp, int id, uint8_t *event, int width, bool is_real, bool is_string, uint8_t flags, uint8_t *flag_mask)
 {
-    trace_dumper_trace *trace = (trace_dumper_trace *)this->traces[id];
+    trace_chunks_trace *trace = (trace_chunks_trace *)this->traces[id];
 
     trace->dump(timestamp, event, width);
 }
 
 void vp::Raw_file::close()
 {
-    trace_dumper_client *td = (trace_dumper_client *)this->dumper;
+    trace_chunks_writer *td = (trace_chunks_writer *)this->dumper;
     td->close();
 }
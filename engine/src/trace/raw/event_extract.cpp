@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+// Extracts a time window and a subset of the traces from a raw event file, either as text or
+// as a VCD file. Files written with the chunked format are read through their index, while files
+// written with the previous streaming format are read sequentially.
+
+#include "trace_chunks.hpp"
+#include <getopt.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <algorithm>
+#include <unordered_map>
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] <raw event file>\n"
+        "  --start=<time>   only extract values dumped at or after this timestamp\n"
+        "  --end=<time>     only extract values dumped at or before this timestamp\n"
+        "  --trace=<name>   only extract the traces whose path contains this string, can be\n"
+        "                   given several times\n"
+        "  --vcd            dump a VCD file instead of text\n"
+        "  --list           list the traces and chunks of the file\n", name);
+}
+
+
+// Reader for raw files written with the streaming format used before chunks were introduced.
+// These files have no index, so they are read once to get the traces, and once again to extract
+// the values.
+class legacy_reader
+{
+public:
+    legacy_reader(std::string filepath) : filepath(filepath) {}
+
+    int open()
+    {
+        trace_dumper_server server(this->filepath);
+        trace_packet packet;
+
+        if (server.open())
+            return -1;
+
+        while (server.get_packet(&packet) == 0)
+        {
+            if (packet.header.type == ED_TYPE_CONF)
+            {
+                this->timescale = (ed_conf_timescale_e)packet.conf.timescale;
+            }
+            else if (packet.header.type == ED_TYPE_REG_TRACE)
+            {
+                Trace *trace = packet.trace;
+                if (trace->id >= (int)this->traces.size())
+                    this->traces.resize(trace->id + 1);
+                this->traces[trace->id] = trace;
+            }
+        }
+
+        return 0;
+    }
+
+    std::vector<Trace *> &get_traces() { return this->traces; }
+    ed_conf_timescale_e get_timescale() { return this->timescale; }
+
+    int read(int64_t start, int64_t end, std::vector<int> trace_ids,
+        std::function<void(int64_t timestamp, Trace *trace, uint8_t *value, int size)> callback)
+    {
+        trace_dumper_server server(this->filepath);
+        trace_packet packet;
+        int64_t timestamp = 0;
+
+        if (server.open())
+            return -1;
+
+        while (server.get_packet(&packet) == 0)
+        {
+            if (packet.header.type == ED_TYPE_TIMESTAMP8 || packet.header.type == ED_TYPE_TIMESTAMP16 ||
+                packet.header.type == ED_TYPE_TIMESTAMP32 || packet.header.type == ED_TYPE_TIMESTAMP64)
+            {
+                timestamp = packet.timestamp;
+                if (timestamp > end)
+                    break;
+            }
+            else if (packet.header.type == ED_TYPE_TRACE || packet.header.type == ED_TYPE_TRACE_SET_0 ||
+                packet.header.type == ED_TYPE_TRACE_SET_1)
+            {
+                int id = packet.trace->id;
+                if (timestamp >= start && (trace_ids.size() == 0 ||
+                    std::find(trace_ids.begin(), trace_ids.end(), id) != trace_ids.end()))
+                {
+                    callback(timestamp, this->traces[id], packet.data, packet.size);
+                }
+            }
+        }
+
+        return 0;
+    }
+
+private:
+    std::string filepath;
+    ed_conf_timescale_e timescale = ED_CONF_TIMESCALE_PS;
+    std::vector<Trace *> traces;
+};
+
+
+static bool is_chunk_file(std::string path)
+{
+    char magic[8];
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return true;
+    bool result = fread(magic, 8, 1, file) == 1 && memcmp(magic, TRACE_CHUNKS_MAGIC, 8) == 0;
+    fclose(file);
+    return result;
+}
+
+
+static std::string vcd_id(int id)
+{
+    std::string result;
+    do
+    {
+        result += (char)('!' + id % 94);
+        id /= 94;
+    } while (id);
+    return result;
+}
+
+
+static void dump_value(FILE *output, Trace *trace, uint8_t *value, int size, bool vcd)
+{
+    if (trace->type == ED_TRACE_REAL)
+    {
+        fprintf(output, vcd ? "r%.16g " : "%.16g", *(double *)value);
+    }
+    else if (trace->type == ED_TRACE_VARLEN)
+    {
+        if (vcd)
+        {
+            // Strings are dumped as a sequence of 8 bits characters
+            fprintf(output, "b");
+            for (int i=0; i<size; i++)
+            {
+                for (int j=7; j>=0; j--)
+                    fputc('0' + ((value[i] >> j) & 1), output);
+            }
+            fprintf(output, " ");
+        }
+        else
+        {
+            fprintf(output, "%.*s", size, (char *)value);
+        }
+    }
+    else if (vcd)
+    {
+        if (trace->width > 1)
+            fprintf(output, "b");
+        for (int i=trace->width-1; i>=0; i--)
+            fputc('0' + ((value[i >> 3] >> (i & 7)) & 1), output);
+        if (trace->width > 1)
+            fprintf(output, " ");
+    }
+    else
+    {
+        fprintf(output, "0x");
+        for (int i=size-1; i>=0; i--)
+            fprintf(output, "%2.2x", value[i]);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    int64_t start = 0;
+    int64_t end = INT64_MAX;
+    std::vector<std::string> names;
+    bool vcd = false;
+    bool list = false;
+
+    static struct option options[] = {
+        { "start", required_argument, 0, 's' },
+        { "end",   required_argument, 0, 'e' },
+        { "trace", required_argument, 0, 't' },
+        { "vcd",   no_argument,       0, 'v' },
+        { "list",  no_argument,       0, 'l' },
+        { "help",  no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 's': start = strtoll(optarg, NULL, 0); break;
+            case 'e': end = strtoll(optarg, NULL, 0); break;
+            case 't': names.push_back(optarg); break;
+            case 'v': vcd = true; break;
+            case 'l': list = true; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    std::string path = argv[optind];
+    trace_chunks_reader reader(path);
+    legacy_reader old_reader(path);
+    bool is_legacy = !is_chunk_file(path);
+
+    errno = 0;
+    if (is_legacy ? old_reader.open() : reader.open())
+    {
+        fprintf(stderr, "Failed to open raw event file %s (error: %s)\n", path.c_str(),
+            errno ? strerror(errno) : "invalid file");
+        return -1;
+    }
+
+    std::vector<Trace *> &traces = is_legacy ? old_reader.get_traces() : reader.get_traces();
+    ed_conf_timescale_e timescale = is_legacy ? old_reader.get_timescale() : reader.get_timescale();
+    auto read = [&](std::vector<int> &trace_ids,
+        std::function<void(int64_t timestamp, Trace *trace, uint8_t *value, int size)> callback)
+    {
+        return is_legacy ? old_reader.read(start, end, trace_ids, callback) :
+            reader.read(start, end, trace_ids, callback);
+    };
+
+    if (list)
+    {
+        for (Trace *trace : traces)
+        {
+            // The width of variable-length traces is not significant, each value has its own size
+            if (trace && trace->type == ED_TRACE_VARLEN)
+                printf("Trace (id: %d, type: varlen, path: %s)\n", trace->id, trace->path.c_str());
+            else if (trace)
+                printf("Trace (id: %d, type: %s, width: %d, path: %s)\n", trace->id,
+                    trace->type == ED_TRACE_BITFIELD ? "bitfield" : "real",
+                    trace->width, trace->path.c_str());
+        }
+        // Files with the streaming format have no chunks
+        if (!is_legacy)
+        {
+            for (tc_index_entry_t &entry : reader.get_index())
+            {
+                printf("Chunk (start: %ld, end: %ld, offset: 0x%lx)\n", entry.start, entry.end, entry.offset);
+            }
+        }
+        return 0;
+    }
+
+    std::vector<int> trace_ids;
+    std::vector<Trace *> selected;
+    for (Trace *trace : traces)
+    {
+        if (trace == NULL)
+            continue;
+
+        bool match = names.size() == 0;
+        for (std::string &name : names)
+        {
+            if (trace->path.find(name) != std::string::npos)
+                match = true;
+        }
+
+        if (match)
+        {
+            trace_ids.push_back(trace->id);
+            selected.push_back(trace);
+        }
+    }
+
+    if (selected.size() == 0)
+    {
+        fprintf(stderr, "No trace selected\n");
+        return -1;
+    }
+
+    // The width of variable-length traces is the largest value they have in the window, since VCD
+    // variables have a fixed width. Shorter values are extended by the VCD reader.
+    std::unordered_map<int, int> varlen_widths;
+    if (vcd)
+    {
+        std::vector<int> varlen_ids;
+        for (Trace *trace : selected)
+        {
+            if (trace->type == ED_TRACE_VARLEN)
+            {
+                varlen_ids.push_back(trace->id);
+                varlen_widths[trace->id] = 8;
+            }
+        }
+
+        if (varlen_ids.size() > 0 && read(varlen_ids,
+            [&](int64_t timestamp, Trace *trace, uint8_t *value, int size)
+            {
+                varlen_widths[trace->id] = std::max(varlen_widths[trace->id], size * 8);
+            }))
+        {
+            fprintf(stderr, "Corrupted raw event file %s\n", path.c_str());
+            return -1;
+        }
+    }
+
+    if (vcd)
+    {
+        printf("$timescale 1%s $end\n", timescale == ED_CONF_TIMESCALE_PS ? "ps" : "ns");
+        for (Trace *trace : selected)
+        {
+            std::string name = trace->path;
+            int nb_scopes = 0;
+            size_t pos;
+            while ((pos = name.find('/')) != std::string::npos)
+            {
+                if (pos != 0)
+                {
+                    printf("$scope module %s $end\n", name.substr(0, pos).c_str());
+                    nb_scopes++;
+                }
+                name = name.substr(pos + 1);
+            }
+            printf("$var %s %d %s %s $end\n", trace->type == ED_TRACE_REAL ? "real" : "wire",
+                trace->type == ED_TRACE_VARLEN ? varlen_widths[trace->id] : trace->width,
+                vcd_id(trace->id).c_str(),
+                name.c_str());
+            for (int i=0; i<nb_scopes; i++)
+                printf("$upscope $end\n");
+        }
+        printf("$enddefinitions $end\n");
+    }
+
+    int64_t last_timestamp = -1;
+
+    int err = read(trace_ids,
+        [&](int64_t timestamp, Trace *trace, uint8_t *value, int size)
+        {
+            if (vcd)
+            {
+                if (timestamp != last_timestamp)
+                {
+                    printf("#%ld\n", timestamp);
+                    last_timestamp = timestamp;
+                }
+                dump_value(stdout, trace, value, size, true);
+                printf("%s\n", vcd_id(trace->id).c_str());
+            }
+            else
+            {
+                printf("%ld %s ", timestamp, trace->path.c_str());
+                dump_value(stdout, trace, value, size, false);
+                printf("\n");
+            }
+        });
+
+    if (err)
+    {
+        fprintf(stderr, "Corrupted raw event file %s\n", path.c_str());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,612 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include "trace_chunks.hpp"
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+
+
+static inline void tc_put_varint(std::vector<uint8_t> &buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer.push_back(value);
+}
+
+
+static inline void tc_put(std::vector<uint8_t> &buffer, void *data, size_t size)
+{
+    buffer.insert(buffer.end(), (uint8_t *)data, (uint8_t *)data + size);
+}
+
+
+// Timestamps should always increase but are encoded as signed values to be robust
+static inline uint64_t tc_zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+
+static inline int64_t tc_unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+// Reads from a buffer, and remembers if the buffer was too small so that corrupted chunks are
+// detected once at the end
+class tc_cursor
+{
+public:
+    tc_cursor(uint8_t *data, size_t size) : data(data), end(data + size) {}
+
+    uint64_t get_varint()
+    {
+        uint64_t value = 0;
+        int shift = 0;
+        while (this->data < this->end)
+        {
+            uint8_t byte = *this->data++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                return value;
+            }
+            shift += 7;
+        }
+        this->error = true;
+        return 0;
+    }
+
+    uint8_t *get(size_t size)
+    {
+        if (size > (size_t)(this->end - this->data))
+        {
+            this->error = true;
+            this->data = this->end;
+            return NULL;
+        }
+        uint8_t *result = this->data;
+        this->data += size;
+        return result;
+    }
+
+    uint8_t *data;
+    uint8_t *end;
+    bool error = false;
+};
+
+
+trace_chunks_trace::trace_chunks_trace(trace_chunks_writer *writer, int id, ed_trace_type_e type, int width)
+: id(id), type(type), width(width), writer(writer)
+{
+}
+
+
+void trace_chunks_trace::dump(int64_t timestamp, uint8_t *value, int width)
+{
+    size_t size = this->type == ED_TRACE_VARLEN ? width : (this->width + 7) / 8;
+
+    this->writer->account_event(this, timestamp, size);
+
+    tc_put_varint(this->timestamps, tc_zigzag(timestamp - this->last_timestamp));
+    this->last_timestamp = timestamp;
+
+    if (this->type == ED_TRACE_VARLEN)
+    {
+        tc_put_varint(this->values, size);
+        tc_put(this->values, value, size);
+    }
+    else
+    {
+        // Values are XORed with the previous ones so that the bits which do not change are zeros
+        // and are compressed efficiently
+        for (size_t i=0; i<size; i++)
+        {
+            uint8_t byte = value[i];
+
+            // Bits above the trace width are not significant
+            if (i == size - 1 && this->type == ED_TRACE_BITFIELD && (this->width & 7))
+            {
+                byte &= (1 << (this->width & 7)) - 1;
+            }
+
+            this->values.push_back(byte ^ this->last_value[i]);
+            this->last_value[i] = byte;
+        }
+    }
+
+    this->nb_events++;
+}
+
+
+trace_chunks_writer::trace_chunks_writer(std::string filepath, size_t chunk_size)
+: filepath(filepath), chunk_size(chunk_size)
+{
+}
+
+
+int trace_chunks_writer::open(ed_conf_timescale_e timescale)
+{
+    this->file = fopen(this->filepath.c_str(), "wb");
+    if (this->file == NULL)
+        return -1;
+
+    ed_conf_t conf = { .version=TRACE_CHUNKS_VERSION, .timescale=timescale };
+
+    if (fwrite(TRACE_CHUNKS_MAGIC, 8, 1, this->file) != 1)
+        return -1;
+
+    if (fwrite(&conf, sizeof(conf), 1, this->file) != 1)
+        return -1;
+
+    return 0;
+}
+
+
+void trace_chunks_writer::close()
+{
+    if (this->file == NULL)
+        return;
+
+    this->flush_chunk();
+
+    std::vector<uint8_t> payload;
+    uint32_t nb_chunks = this->index.size();
+    tc_put(payload, &this->nb_registrations, sizeof(this->nb_registrations));
+    tc_put(payload, this->registrations.data(), this->registrations.size());
+    tc_put(payload, &nb_chunks, sizeof(nb_chunks));
+    tc_put(payload, this->index.data(), this->index.size() * sizeof(tc_index_entry_t));
+
+    int64_t offset = this->write_block(TC_BLOCK_INDEX, payload);
+    if (offset != -1)
+    {
+        fwrite(&offset, sizeof(offset), 1, this->file);
+        fwrite(TRACE_CHUNKS_INDEX_MAGIC, 8, 1, this->file);
+    }
+
+    fclose(this->file);
+    this->file = NULL;
+}
+
+
+trace_chunks_trace *trace_chunks_writer::reg_trace(std::string path, uint32_t id, ed_trace_type_e type, uint32_t width)
+{
+    trace_chunks_trace *trace = new trace_chunks_trace(this, id, type, width);
+
+    this->traces.push_back(trace);
+
+    ed_reg_trace_t reg_trace = { .type=type, .width=width, .path_len=(uint32_t)path.size(), .id=id };
+    std::vector<uint8_t> payload;
+    tc_put(payload, &reg_trace, sizeof(reg_trace));
+    tc_put(payload, (void *)path.c_str(), path.size());
+
+    if (this->write_block(TC_BLOCK_REG_TRACE, payload) == -1)
+        return NULL;
+
+    this->registrations.insert(this->registrations.end(), payload.begin(), payload.end());
+    this->nb_registrations++;
+
+    return trace;
+}
+
+
+void trace_chunks_writer::account_event(trace_chunks_trace *trace, int64_t timestamp, size_t size)
+{
+    // Chunks are only closed between 2 timestamps, so that all the values of a timestamp are
+    // in the same chunk
+    if (this->chunk_raw_size >= this->chunk_size && timestamp != this->chunk_end)
+    {
+        this->flush_chunk();
+    }
+
+    if (this->chunk_events == 0)
+    {
+        this->chunk_start = timestamp;
+    }
+
+    if (trace->nb_events == 0)
+    {
+        this->active_traces.push_back(trace);
+        trace->last_timestamp = this->chunk_start;
+        trace->last_value.assign(trace->type == ED_TRACE_VARLEN ? 0 : size, 0);
+    }
+
+    this->chunk_end = std::max(this->chunk_end, timestamp);
+    this->chunk_events++;
+    this->chunk_raw_size += size + 2;
+}
+
+
+int trace_chunks_writer::flush_chunk()
+{
+    if (this->chunk_events == 0)
+        return 0;
+
+    std::vector<uint8_t> raw;
+
+    tc_put_varint(raw, this->active_traces.size());
+    for (trace_chunks_trace *trace : this->active_traces)
+    {
+        tc_put_varint(raw, trace->id);
+        tc_put_varint(raw, trace->nb_events);
+        tc_put_varint(raw, trace->timestamps.size());
+        tc_put(raw, trace->timestamps.data(), trace->timestamps.size());
+        tc_put_varint(raw, trace->values.size());
+        tc_put(raw, trace->values.data(), trace->values.size());
+
+        trace->nb_events = 0;
+        trace->timestamps.clear();
+        trace->values.clear();
+    }
+
+    tc_chunk_t chunk = { .start=this->chunk_start, .end=this->chunk_end,
+        .nb_events=this->chunk_events, .raw_size=(uint32_t)raw.size() };
+
+    // Favor speed over size, since this is done by the thread dumping the events
+    std::vector<uint8_t> payload(sizeof(chunk) + compressBound(raw.size()));
+    uLongf compressed_size = payload.size() - sizeof(chunk);
+    memcpy(payload.data(), &chunk, sizeof(chunk));
+    int err = compress2(payload.data() + sizeof(chunk), &compressed_size, raw.data(), raw.size(), 1);
+
+    this->active_traces.clear();
+    this->chunk_events = 0;
+    this->chunk_raw_size = 0;
+    this->chunk_end = -1;
+
+    if (err != Z_OK)
+        return -1;
+
+    payload.resize(sizeof(chunk) + compressed_size);
+
+    int64_t offset = this->write_block(TC_BLOCK_CHUNK, payload);
+    if (offset == -1)
+        return -1;
+
+    this->index.push_back({ .start=chunk.start, .end=chunk.end, .offset=(uint64_t)offset });
+
+    return 0;
+}
+
+
+int64_t trace_chunks_writer::write_block(tc_block_type_e type, std::vector<uint8_t> &payload)
+{
+    int64_t offset = ftello(this->file);
+    tc_block_t block = { .type=(uint8_t)type, .size=payload.size() };
+
+    if (fwrite(&block, sizeof(block), 1, this->file) != 1)
+        return -1;
+
+    if (payload.size() && fwrite(payload.data(), payload.size(), 1, this->file) != 1)
+        return -1;
+
+    return offset;
+}
+
+
+trace_chunks_reader::trace_chunks_reader(std::string filepath)
+: filepath(filepath)
+{
+}
+
+
+trace_chunks_reader::~trace_chunks_reader()
+{
+    if (this->file)
+        fclose(this->file);
+
+    for (Trace *trace : this->traces)
+    {
+        delete trace;
+    }
+}
+
+
+int trace_chunks_reader::open()
+{
+    this->file = fopen(this->filepath.c_str(), "rb");
+    if (this->file == NULL)
+        return -1;
+
+    char magic[8];
+    ed_conf_t conf;
+    if (fread(magic, 8, 1, this->file) != 1 || memcmp(magic, TRACE_CHUNKS_MAGIC, 8) != 0)
+        return -1;
+
+    if (fread(&conf, sizeof(conf), 1, this->file) != 1 || conf.version != TRACE_CHUNKS_VERSION)
+        return -1;
+
+    this->timescale = (ed_conf_timescale_e)conf.timescale;
+
+    uint64_t header_size = 8 + sizeof(conf);
+
+    // Go through the trailer if the file was properly closed, otherwise rebuild the index
+    if (fseeko(this->file, 0, SEEK_END) == 0 && ftello(this->file) >= (int64_t)(header_size + 16))
+    {
+        int64_t index_offset;
+        if (fseeko(this->file, -16, SEEK_END) == 0 &&
+            fread(&index_offset, 8, 1, this->file) == 1 &&
+            fread(magic, 8, 1, this->file) == 1 &&
+            memcmp(magic, TRACE_CHUNKS_INDEX_MAGIC, 8) == 0)
+        {
+            return this->read_index(index_offset);
+        }
+    }
+
+    return this->scan_blocks(header_size);
+}
+
+
+size_t trace_chunks_reader::reg_trace(uint8_t *payload, size_t size)
+{
+    ed_reg_trace_t reg_trace;
+
+    if (size < sizeof(reg_trace))
+        return 0;
+
+    memcpy(&reg_trace, payload, sizeof(reg_trace));
+
+    if (size < sizeof(reg_trace) + reg_trace.path_len)
+        return 0;
+
+    std::string path((char *)payload + sizeof(reg_trace), reg_trace.path_len);
+
+    if (reg_trace.id >= this->traces.size())
+    {
+        this->traces.resize(reg_trace.id + 1);
+    }
+    delete this->traces[reg_trace.id];
+    this->traces[reg_trace.id] = new Trace(path, reg_trace.id, reg_trace.type, reg_trace.width);
+
+    return sizeof(reg_trace) + reg_trace.path_len;
+}
+
+
+int trace_chunks_reader::read_index(uint64_t offset)
+{
+    tc_block_t block;
+
+    if (fseeko(this->file, offset, SEEK_SET) != 0 || fread(&block, sizeof(block), 1, this->file) != 1 ||
+        block.type != TC_BLOCK_INDEX)
+        return -1;
+
+    std::vector<uint8_t> payload(block.size);
+    if (block.size && fread(payload.data(), block.size, 1, this->file) != 1)
+        return -1;
+
+    tc_cursor cursor(payload.data(), payload.size());
+
+    uint32_t *nb_registrations = (uint32_t *)cursor.get(4);
+    for (uint32_t i=0; !cursor.error && i<*nb_registrations; i++)
+    {
+        size_t size = this->reg_trace(cursor.data, cursor.end - cursor.data);
+        if (size == 0)
+            return -1;
+        cursor.get(size);
+    }
+
+    uint32_t *nb_chunks = (uint32_t *)cursor.get(4);
+    if (cursor.error)
+        return -1;
+
+    tc_index_entry_t *entries = (tc_index_entry_t *)cursor.get(*nb_chunks * sizeof(tc_index_entry_t));
+    if (cursor.error)
+        return -1;
+
+    this->index.assign(entries, entries + *nb_chunks);
+
+    return 0;
+}
+
+
+int trace_chunks_reader::scan_blocks(uint64_t offset)
+{
+    if (fseeko(this->file, offset, SEEK_SET) != 0)
+        return -1;
+
+    while (1)
+    {
+        tc_block_t block;
+        int64_t block_offset = ftello(this->file);
+
+        // The last block can be incomplete if the simulation was killed, just ignore it
+        if (fread(&block, sizeof(block), 1, this->file) != 1)
+            break;
+
+        if (block.type == TC_BLOCK_REG_TRACE)
+        {
+            std::vector<uint8_t> payload(block.size);
+            if (fread(payload.data(), block.size, 1, this->file) != 1)
+                break;
+
+            if (this->reg_trace(payload.data(), payload.size()) == 0)
+                return -1;
+        }
+        else if (block.type == TC_BLOCK_CHUNK)
+        {
+            tc_chunk_t chunk;
+            if (block.size < sizeof(chunk) || fread(&chunk, sizeof(chunk), 1, this->file) != 1)
+                break;
+
+            if (fseeko(this->file, block.size - sizeof(chunk), SEEK_CUR) != 0)
+                break;
+
+            this->index.push_back({ .start=chunk.start, .end=chunk.end, .offset=(uint64_t)block_offset });
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // Drop the last chunk if it is truncated
+    if (this->index.size() > 0)
+    {
+        tc_index_entry_t &last = this->index.back();
+        std::vector<uint8_t> chunk;
+        if (this->read_chunk(&last, chunk))
+        {
+            this->index.pop_back();
+        }
+    }
+
+    return 0;
+}
+
+
+int trace_chunks_reader::read_chunk(tc_index_entry_t *entry, std::vector<uint8_t> &chunk)
+{
+    tc_block_t block;
+    tc_chunk_t header;
+
+    if (fseeko(this->file, entry->offset, SEEK_SET) != 0 ||
+        fread(&block, sizeof(block), 1, this->file) != 1 || block.type != TC_BLOCK_CHUNK ||
+        block.size < sizeof(header) || fread(&header, sizeof(header), 1, this->file) != 1)
+        return -1;
+
+    std::vector<uint8_t> compressed(block.size - sizeof(header));
+    if (compressed.size() && fread(compressed.data(), compressed.size(), 1, this->file) != 1)
+        return -1;
+
+    chunk.resize(header.raw_size);
+    uLongf size = header.raw_size;
+    if (uncompress(chunk.data(), &size, compressed.data(), compressed.size()) != Z_OK ||
+        size != header.raw_size)
+        return -1;
+
+    return 0;
+}
+
+
+int trace_chunks_reader::read(int64_t start, int64_t end, std::vector<int> trace_ids,
+    std::function<void(int64_t timestamp, Trace *trace, uint8_t *value, int size)> callback)
+{
+    class event
+    {
+    public:
+        int64_t timestamp;
+        Trace *trace;
+        size_t offset;
+        int size;
+    };
+
+    std::vector<bool> filter;
+    if (trace_ids.size() > 0)
+    {
+        filter.resize(this->traces.size());
+        for (int id : trace_ids)
+        {
+            if (id >= 0 && id < (int)filter.size())
+                filter[id] = true;
+        }
+    }
+
+    // Chunks do not overlap, so their end timestamps are sorted too
+    auto it = std::lower_bound(this->index.begin(), this->index.end(), start,
+        [](const tc_index_entry_t &entry, int64_t start) { return entry.end < start; });
+
+    std::vector<uint8_t> chunk;
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> last_value;
+    std::vector<event> events;
+
+    for (; it != this->index.end() && it->start <= end; it++)
+    {
+        if (this->read_chunk(&*it, chunk))
+            return -1;
+
+        values.clear();
+        events.clear();
+
+        tc_cursor cursor(chunk.data(), chunk.size());
+        uint64_t nb_traces = cursor.get_varint();
+
+        for (uint64_t i=0; !cursor.error && i<nb_traces; i++)
+        {
+            uint64_t id = cursor.get_varint();
+            uint64_t nb_events = cursor.get_varint();
+            uint64_t timestamps_size = cursor.get_varint();
+            tc_cursor timestamps(cursor.get(timestamps_size), timestamps_size);
+            uint64_t values_size = cursor.get_varint();
+            tc_cursor trace_values(cursor.get(values_size), values_size);
+
+            if (cursor.error || id >= this->traces.size() || this->traces[id] == NULL)
+                return -1;
+
+            if (filter.size() > 0 && !filter[id])
+                continue;
+
+            Trace *trace = this->traces[id];
+            int64_t timestamp = it->start;
+            int size = (trace->width + 7) / 8;
+            last_value.assign(size, 0);
+
+            for (uint64_t j=0; j<nb_events; j++)
+            {
+                timestamp += tc_unzigzag(timestamps.get_varint());
+
+                uint8_t *value;
+                if (trace->type == ED_TRACE_VARLEN)
+                {
+                    size = trace_values.get_varint();
+                    value = trace_values.get(size);
+                }
+                else
+                {
+                    uint8_t *delta = trace_values.get(size);
+                    if (trace_values.error)
+                        return -1;
+                    for (int k=0; k<size; k++)
+                    {
+                        last_value[k] ^= delta[k];
+                    }
+                    value = last_value.data();
+                }
+
+                if (timestamps.error || trace_values.error)
+                    return -1;
+
+                if (timestamp >= start && timestamp <= end)
+                {
+                    events.push_back({ timestamp, trace, values.size(), size });
+                    values.insert(values.end(), value, value + size);
+                }
+            }
+        }
+
+        if (cursor.error)
+            return -1;
+
+        std::stable_sort(events.begin(), events.end(),
+            [](const event &a, const event &b) { return a.timestamp < b.timestamp; });
+
+        for (event &event : events)
+        {
+            callback(event.timestamp, event.trace, values.data() + event.offset, event.size);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#ifndef __TRACE_CHUNKS_HPP__
+#define __TRACE_CHUNKS_HPP__
+
+#include "trace_dumper.hpp"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+/*
+ * Chunked event trace file.
+ *
+ * The file starts with a header, followed by a list of blocks, each one starting with a type
+ * and a size so that a reader can skip it:
+ * - trace registration: id, type, width and path of a trace. A trace is always registered before
+ *   the first chunk containing one of its values.
+ * - chunk: all the values dumped during a time window. Values are grouped per trace, with their
+ *   timestamps delta-encoded and their values XORed with the previous value of the same trace,
+ *   and the whole chunk is compressed. Each chunk can be decoded on its own.
+ * - index: all the trace registrations, and the start timestamp, end timestamp and file offset
+ *   of all the chunks, followed by a trailer giving the offset of the index, so that a reader can
+ *   directly go to the chunks of a time window. If the simulation did not close the file, a reader rebuilds the index by
+ *   walking the blocks, without decompressing them.
+ */
+
+#define TRACE_CHUNKS_MAGIC "GVEVTCK1"
+#define TRACE_CHUNKS_INDEX_MAGIC "GVEVTIDX"
+#define TRACE_CHUNKS_VERSION 1
+
+// Default amount of raw event data buffered before a chunk is compressed and written
+#define TRACE_CHUNKS_DEFAULT_SIZE (1 << 20)
+
+typedef enum
+{
+    TC_BLOCK_REG_TRACE = 0x1,
+    TC_BLOCK_CHUNK     = 0x2,
+    TC_BLOCK_INDEX     = 0x3,
+} tc_block_type_e;
+
+typedef struct
+{
+    uint8_t type;
+    uint64_t size;
+} __attribute__((packed)) tc_block_t;
+
+typedef struct
+{
+    int64_t start;
+    int64_t end;
+    uint32_t nb_events;
+    uint32_t raw_size;
+} __attribute__((packed)) tc_chunk_t;
+
+typedef struct
+{
+    int64_t start;
+    int64_t end;
+    uint64_t offset;
+} __attribute__((packed)) tc_index_entry_t;
+
+
+class trace_chunks_writer;
+
+class trace_chunks_trace
+{
+public:
+    trace_chunks_trace(trace_chunks_writer *writer, int id, ed_trace_type_e type, int width);
+
+    void dump(int64_t timestamp, uint8_t *value, int width);
+
+private:
+    friend class trace_chunks_writer;
+
+    int id;
+    ed_trace_type_e type;
+    int width;
+    trace_chunks_writer *writer;
+    // Events of the current chunk
+    int nb_events = 0;
+    int64_t last_timestamp;
+    std::vector<uint8_t> timestamps;
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> last_value;
+};
+
+
+class trace_chunks_writer
+{
+public:
+    trace_chunks_writer(std::string filepath, size_t chunk_size=TRACE_CHUNKS_DEFAULT_SIZE);
+
+    int open(ed_conf_timescale_e timescale=ED_CONF_TIMESCALE_PS);
+    void close();
+
+    trace_chunks_trace *reg_trace(std::string path, uint32_t id, ed_trace_type_e type, uint32_t width);
+
+private:
+    friend class trace_chunks_trace;
+
+    void account_event(trace_chunks_trace *trace, int64_t timestamp, size_t size);
+    int flush_chunk();
+    int64_t write_block(tc_block_type_e type, std::vector<uint8_t> &payload);
+
+    std::string filepath;
+    size_t chunk_size;
+    FILE *file = NULL;
+    std::vector<trace_chunks_trace *> traces;
+    // Traces having events in the current chunk
+    std::vector<trace_chunks_trace *> active_traces;
+    int64_t chunk_start = -1;
+    int64_t chunk_end = -1;
+    uint32_t chunk_events = 0;
+    size_t chunk_raw_size = 0;
+    std::vector<tc_index_entry_t> index;
+    // Registrations of all the traces, copied to the index
+    uint32_t nb_registrations = 0;
+    std::vector<uint8_t> registrations;
+};
+
+
+class trace_chunks_reader
+{
+public:
+    trace_chunks_reader(std::string filepath);
+    ~trace_chunks_reader();
+
+    int open();
+
+    // Traces registered in the file, indexed by ID. Unused IDs are NULL
+    std::vector<Trace *> &get_traces() { return this->traces; }
+    // Chunks of the file, sorted by start timestamp
+    std::vector<tc_index_entry_t> &get_index() { return this->index; }
+    ed_conf_timescale_e get_timescale() { return this->timescale; }
+
+    // Calls the callback for each value dumped between start and end (included), in timestamp
+    // order. If trace_ids is not empty, only the values of these traces are reported.
+    // Only the chunks overlapping the window are read.
+    int read(int64_t start, int64_t end, std::vector<int> trace_ids,
+        std::function<void(int64_t timestamp, Trace *trace, uint8_t *value, int size)> callback);
+
+private:
+    int scan_blocks(uint64_t offset);
+    int read_index(uint64_t offset);
+    int read_chunk(tc_index_entry_t *entry, std::vector<uint8_t> &chunk);
+    size_t reg_trace(uint8_t *payload, size_t size);
+
+    std::string filepath;
+    FILE *file = NULL;
+    ed_conf_timescale_e timescale;
+    std::vector<Trace *> traces;
+    std::vector<tc_index_entry_t> index;
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "vp/vp.hpp"
 #include "vp/trace/trace.hpp"
 #include "vp/trace/trace_engine.hpp"
+#include "vp/trace/vcd_shm.hpp"
 #include <string.h>
 #include <inttypes.h>
 
@@ -166,8 +167,27 @@ void vp::Trace::force_warning(vp::Trace::warning_type_e type, const char *fmt, .
 }
 
 
+void vp::Trace::msg_deferred(int level, const char *fmt, va_list ap)
+{
+    int64_t time = -1;
+    int64_t cycles = -1;
+    if (comp->clock.get_engine())
+    {
+        cycles = comp->clock.get_engine()->get_cycles();
+    }
+    if (comp->time.get_engine())
+    {
+        time = comp->time.get_engine()->get_time();
+    }
+
+    comp->traces.get_trace_engine()->get_logger()->log(this, level, time, cycles, fmt, ap);
+}
+
 void vp::Trace::dump_warning_header()
 {
+    // Warnings are directly written, make sure deferred messages are written before
+    comp->traces.get_trace_engine()->flush_messages();
+
     int max_trace_len = comp->traces.get_trace_engine()->get_max_path_len();
     int64_t cycles = 0;
     int64_t time = 0;
@@ -184,6 +204,10 @@ void vp::Trace::dump_warning_header()
 
 void vp::Trace::dump_fatal_header()
 {
+    comp->traces.get_trace_engine()->flush_messages();
+    // The process is about to exit, this is the last chance to get what the recorder kept
+    comp->traces.get_trace_engine()->dump_recorder(true);
+
     fprintf(this->trace_file, "[\033[31m%s\033[0m] ", path.c_str());
 }
 
@@ -218,18 +242,24 @@ char *vp::TraceEngine::get_event_buffer(int bytes)
             if ((unsigned int)(TRACE_EVENT_BUFFER_SIZE - current_buffer_size) > sizeof(vp::Trace *))
                 *(vp::Trace **)(current_buffer + current_buffer_size) = NULL;
 
-            ready_event_buffers.push_back(current_buffer);
-            current_buffer = NULL;
-
-            pthread_cond_broadcast(&cond);
+            this->push_event_buffer();
         }
 
-        while (event_buffers.size() == 0)
+        if (this->recorder && event_buffers.size() == 0 && recorded_event_buffers.size() != 0)
+        {
+            // The recorder never blocks, it just forgets the oldest events
+            current_buffer = recorded_event_buffers[0];
+            recorded_event_buffers.erase(recorded_event_buffers.begin());
+        }
+        else
         {
-            pthread_cond_wait(&cond, &mutex);
+            while (event_buffers.size() == 0)
+            {
+                pthread_cond_wait(&cond, &mutex);
+            }
+            current_buffer = event_buffers[0];
+            event_buffers.erase(event_buffers.begin());
         }
-        current_buffer = event_buffers[0];
-        event_buffers.erase(event_buffers.begin());
         current_buffer_size = 0;
         pthread_mutex_unlock(&mutex);
     }
@@ -241,16 +271,90 @@ char *vp::TraceEngine::get_event_buffer(int bytes)
     return result;
 }
 
+// Must be called with the mutex locked
+void vp::TraceEngine::push_event_buffer()
+{
+    if (this->recorder)
+    {
+        recorded_event_buffers.push_back(current_buffer);
+    }
+    else
+    {
+        ready_event_buffers.push_back(current_buffer);
+        pthread_cond_broadcast(&cond);
+    }
+    current_buffer = NULL;
+}
+
 vp::TraceEngine::~TraceEngine()
 {
+    if (this->recorder_dump_req)
+    {
+        this->dump_recorder();
+    }
+
+    delete this->logger;
+    this->logger = NULL;
+
     this->check_pending_events(-1);
     this->flush();
+    if (this->thread)
+    {
+        pthread_mutex_lock(&mutex);
+        this->end = 1;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+        this->thread->join();
+    }
+    delete this->vcd_shm;
+    fflush(NULL);
+}
+
+void vp::TraceEngine::dump_recorder(bool final)
+{
+    if (!this->recorder)
+    {
+        return;
+    }
+
+    if (this->logger)
+    {
+        this->logger->dump();
+    }
+
+    if (final)
+    {
+        this->check_pending_events(-1);
+    }
+    this->flush();
+
+    // Hand over all the recorded events to the VCD thread, as if they had just been dumped
     pthread_mutex_lock(&mutex);
-    this->end = 1;
+    for (char *buffer : recorded_event_buffers)
+    {
+        ready_event_buffers.push_back(buffer);
+    }
+    recorded_event_buffers.clear();
     pthread_cond_broadcast(&cond);
     pthread_mutex_unlock(&mutex);
-    this->thread->join();
-    fflush(NULL);
+
+    if (final && this->thread)
+    {
+        pthread_mutex_lock(&mutex);
+        this->end = 1;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+        this->thread->join();
+        this->thread = NULL;
+    }
+}
+
+void vp::TraceEngine::flush_messages()
+{
+    if (this->logger)
+    {
+        this->logger->flush();
+    }
 }
 
 void vp::TraceEngine::flush()
@@ -266,8 +370,7 @@ void vp::TraceEngine::flush()
         if (current_buffer)
         {
             *(vp::Trace **)(current_buffer + current_buffer_size) = NULL;
-            ready_event_buffers.push_back(current_buffer);
-            current_buffer = NULL;
+            this->push_event_buffer();
         }
         pthread_cond_broadcast(&cond);
         pthread_mutex_unlock(&mutex);
@@ -436,8 +539,25 @@ void vp::TraceEngine::flush_event_traces(int64_t timestamp)
     Event_trace *current = first_trace_to_dump;
     while (current)
     {
-        if (this->vcd_user)
+        // Batches have a single flag per value, values with bits in high impedance are delivered
+        // with their flag mask as bitfields
+        if (this->vcd_user && this->vcd_batch_size > 0 && !current->is_string && current->width <= 64 &&
+            (current->is_real || current->flags == 0))
         {
+            gv::Vcd_event event = { .timestamp=timestamp, .id=current->id, .flags=current->flags, .value=0 };
+            memcpy(&event.value, current->buffer, std::min(current->bytes, 8));
+            this->vcd_batch.push_back(event);
+
+            if ((int)this->vcd_batch.size() == this->vcd_batch_size)
+            {
+                this->flush_vcd_batch();
+            }
+        }
+        else if (this->vcd_user)
+        {
+            // Values which can not be batched must still be delivered after the pending ones
+            this->flush_vcd_batch();
+
             if (current->is_real)
             {
                 this->vcd_user->event_update_real(timestamp, current->id, *(double *)current->buffer);
@@ -446,6 +566,11 @@ void vp::TraceEngine::flush_event_traces(int64_t timestamp)
             {
                 this->vcd_user->event_update_string(timestamp, current->id, (const char *)current->buffer, current->flags);
             }
+            else if (current->width > 64 || (current->flags == 1 && this->vcd_batch_size > 0))
+            {
+                this->vcd_user->event_update_bitfield(timestamp, current->id, current->buffer,
+                    current->flags == 1 ? current->get_flags_mask() : NULL);
+            }
             else if (current->width > 8)
             {
                 if (current->width <= 16)
@@ -456,13 +581,9 @@ void vp::TraceEngine::flush_event_traces(int64_t timestamp)
                 {
                     this->vcd_user->event_update_logical(timestamp, current->id, *(uint32_t *)current->buffer, current->flags);
                 }
-                else if (current->width <= 64)
-                {
-                    this->vcd_user->event_update_logical(timestamp, current->id, *(uint64_t *)current->buffer, current->flags);
-                }
                 else
                 {
-                    // Use bitfield
+                    this->vcd_user->event_update_logical(timestamp, current->id, *(uint64_t *)current->buffer, current->flags);
                 }
 
             }
@@ -481,6 +602,20 @@ void vp::TraceEngine::flush_event_traces(int64_t timestamp)
         current = current->next;
     }
     first_trace_to_dump = NULL;
+
+    if (this->vcd_batch_per_timestamp)
+    {
+        this->flush_vcd_batch();
+    }
+}
+
+void vp::TraceEngine::flush_vcd_batch()
+{
+    if (this->vcd_batch.size() > 0)
+    {
+        this->vcd_user->event_update_batch(this->vcd_batch.data(), this->vcd_batch.size());
+        this->vcd_batch.clear();
+    }
 }
 
 
@@ -597,9 +732,21 @@ void vp::TraceEngine::vcd_routine()
         pthread_mutex_lock(&this->mutex);
         event_buffers.push_back(event_buffer_start);
         pthread_cond_broadcast(&cond);
+        bool idle = this->ready_event_buffers.size() == 0;
         pthread_mutex_unlock(&this->mutex);
+
+        // Don't keep a partial batch while waiting for the next buffer, since it could take
+        // a long time
+        if (idle && this->vcd_user)
+        {
+            this->flush_vcd_batch();
+        }
     }
 
     this->flush_event_traces(last_timestamp);
+    if (this->vcd_user)
+    {
+        this->flush_vcd_batch();
+    }
     event_dumper.close();
 }
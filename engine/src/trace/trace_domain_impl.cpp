@@ -22,12 +22,45 @@
 #include <vp/vp.hpp>
 #include <vp/itf/clk.hpp>
 #include <vp/trace/trace_engine.hpp>
+#include <vp/trace/vcd_shm.hpp>
 #include <vector>
 #include <thread>
 #include <set>
 #include <string.h>
+#include <algorithm>
 
 
+vp::trace_regex::trace_regex(std::string path, std::string file_path, bool is_path)
+    : is_path(is_path), path(path), file_path(file_path)
+{
+    this->is_literal = path.find_first_of(".[*^$\\") == std::string::npos;
+    this->regex = NULL;
+
+    if (!this->is_literal)
+    {
+        this->regex = new regex_t();
+        regcomp(this->regex, path.c_str(), 0);
+    }
+}
+
+vp::trace_regex::~trace_regex()
+{
+    if (this->regex)
+    {
+        regfree(this->regex);
+        delete this->regex;
+    }
+}
+
+bool vp::trace_regex::match(const std::string &full_path)
+{
+    if (this->is_literal)
+    {
+        return full_path.find(this->path) != std::string::npos;
+    }
+    return regexec(this->regex, full_path.c_str(), 0, NULL, 0) == 0;
+}
+
 void vp::TraceEngine::check_trace_active(vp::Trace *trace, int event)
 {
     std::string full_path = trace->get_full_path();
@@ -54,7 +87,7 @@ void vp::TraceEngine::check_trace_active(vp::Trace *trace, int event)
         {
             for (auto &x : events_path_regex)
             {
-                if ((x.second->is_path && x.second->path == full_path) || regexec(x.second->regex, full_path.c_str(), 0, NULL, 0) == 0)
+                if ((x.second->is_path && x.second->path == full_path) || x.second->match(full_path))
                 {
                     std::string file_path = x.second->file_path;
                     vp::Event_trace *event_trace;
@@ -72,7 +105,7 @@ void vp::TraceEngine::check_trace_active(vp::Trace *trace, int event)
 
         for (auto &x : this->events_exclude_path_regex)
         {
-            if (regexec(x.second->regex, full_path.c_str(), 0, NULL, 0) == 0)
+            if (x.second->match(full_path))
             {
                 trace->set_event_active(false);
             }
@@ -82,7 +115,7 @@ void vp::TraceEngine::check_trace_active(vp::Trace *trace, int event)
     {
         for (auto &x : this->trace_regexs)
         {
-            if (regexec(x.second->regex, full_path.c_str(), 0, NULL, 0) == 0)
+            if (x.second->match(full_path))
             {
                 std::string file_path = x.second->file_path;
                 if (file_path == "")
@@ -106,7 +139,7 @@ void vp::TraceEngine::check_trace_active(vp::Trace *trace, int event)
 
         for (auto &x : this->trace_exclude_regexs)
         {
-            if (regexec(x.second->regex, full_path.c_str(), 0, NULL, 0) == 0)
+            if (x.second->match(full_path))
             {
                 if (event)
                     trace->set_event_active(false);
@@ -117,9 +150,63 @@ void vp::TraceEngine::check_trace_active(vp::Trace *trace, int event)
     }
 }
 
+void vp::TraceEngine::get_matching_traces(trace_regex *regex, std::vector<vp::Trace *> &traces)
+{
+    if (regex->is_path)
+    {
+        auto it = this->traces_map.find(regex->path);
+        if (it != this->traces_map.end() && it->second != NULL)
+        {
+            traces.push_back(it->second);
+        }
+    }
+    else if (regex->is_literal && regex->path[0] == '/')
+    {
+        this->traces_tree.get_containing(regex->path, traces);
+    }
+    else
+    {
+        for (auto x : this->traces_array)
+        {
+            if (regex->match(x->get_full_path()))
+            {
+                traces.push_back(x);
+            }
+        }
+    }
+}
+
+void vp::TraceEngine::add_pending_path(std::string path, bool is_path)
+{
+    this->pending_paths.push_back(new trace_regex(path, "", is_path));
+}
+
 void vp::TraceEngine::check_traces()
 {
-    for (auto x : this->traces_array)
+    // Without any path change, all traces are checked again since the caller may want to undo
+    // activations done without paths
+    if (this->pending_paths.size() == 0)
+    {
+        for (auto x : this->traces_array)
+        {
+            this->check_trace_active(x, x->is_event);
+        }
+        return;
+    }
+
+    // Otherwise only the traces matched by the modified paths can change
+    std::vector<vp::Trace *> traces;
+    for (trace_regex *regex: this->pending_paths)
+    {
+        this->get_matching_traces(regex, traces);
+        delete regex;
+    }
+    this->pending_paths.clear();
+
+    std::sort(traces.begin(), traces.end());
+    traces.erase(std::unique(traces.begin(), traces.end()), traces.end());
+
+    for (auto x : traces)
     {
         this->check_trace_active(x, x->is_event);
     }
@@ -145,6 +232,7 @@ void vp::TraceEngine::reg_trace(vp::Trace *trace, int event, string path, string
     traces_map[full_path] = trace;
     trace->set_full_path(full_path);
     trace->is_event = event;
+    this->traces_tree.add(trace);
 
     trace->trace_file = stdout;
 
@@ -170,7 +258,19 @@ vp::TraceEngine::TraceEngine(js::Config *config)
     pthread_mutex_init(&mutex, NULL);
     pthread_cond_init(&cond, NULL);
 
-    for (int i = 0; i < TRACE_EVENT_NB_BUFFER; i++)
+    // In flight recorder mode, messages and events are kept in memory, in buffers whose total
+    // size is given in MB, and only written when the recorder is dumped.
+    this->recorder = config->get_child_bool("recorder/enabled");
+
+    int nb_event_buffers = TRACE_EVENT_NB_BUFFER;
+    if (this->recorder)
+    {
+        int events_size = config->get_child_int("recorder/events_size");
+        nb_event_buffers = std::max(nb_event_buffers,
+            (int)(((int64_t)events_size << 20) / TRACE_EVENT_BUFFER_SIZE) + 1);
+    }
+
+    for (int i = 0; i < nb_event_buffers; i++)
     {
         event_buffers.push_back(new char[TRACE_EVENT_BUFFER_SIZE]);
     }
@@ -219,6 +319,27 @@ vp::TraceEngine::TraceEngine(js::Config *config)
         this->active_events[x->get_str()] = std::string(file_path);
     }
 
+    js::Config *windows = config->get("traces/windows");
+    if (windows)
+    {
+        for (auto x : windows->get_elems())
+        {
+            this->windows.push_back(new TraceWindow(this, x));
+        }
+    }
+
+    // Events can be forwarded to another process through shared memory, instead of being
+    // dumped to files
+    std::string shm = config->get_child_str("events/shm/name");
+    if (shm != "")
+    {
+        int shm_size = config->get_child_int("events/shm/size");
+        int batch_size = config->get_child_int("events/shm/batch_size");
+        this->vcd_shm = new VcdShmUser(shm, (size_t)(shm_size ? shm_size : 16) << 20,
+            batch_size ? batch_size : 4096);
+        this->set_vcd_user(this->vcd_shm);
+    }
+
     this->werror = config->get_child_bool("werror");
     this->set_trace_level(config->get_child_str("traces/level").c_str());
 
@@ -238,11 +359,34 @@ vp::TraceEngine::TraceEngine(js::Config *config)
     {
         this->trace_format = TRACE_FORMAT_LONG;
     }
+
+    string backend = config->get_child_str("traces/backend");
+
+    if (this->recorder)
+    {
+        int messages_size = config->get_child_int("recorder/messages_size");
+        this->logger = new TraceLogger(this, TRACE_BACKEND_RECORDER, "",
+            (int)(((int64_t)messages_size << 20) / TRACE_LOGGER_CHUNK_SIZE));
+    }
+    else if (backend == "deferred")
+    {
+        this->logger = new TraceLogger(this, TRACE_BACKEND_DEFERRED, "");
+    }
+    else if (backend == "binary")
+    {
+        std::string binary_path = config->get_child_str("traces/binary_file");
+        if (binary_path == "")
+        {
+            binary_path = "traces.bin";
+        }
+        this->logger = new TraceLogger(this, TRACE_BACKEND_BINARY, binary_path);
+    }
 }
 
 void vp::TraceEngine::init(vp::Component *top)
 {
     this->top = top;
+    this->init_triggers();
     auto vcd_traces = config->get("events/traces");
 
     if (vcd_traces != NULL)
@@ -279,8 +423,6 @@ void vp::TraceEngine::start()
 
 void vp::TraceEngine::add_exclude_path(int events, const char *path)
 {
-    regex_t *regex = new regex_t();
-
     if (events)
     {
         char *delim = (char *)::index(path, '@');
@@ -296,7 +438,11 @@ void vp::TraceEngine::add_exclude_path(int events, const char *path)
         }
         else
         {
-            this->events_exclude_path_regex[path] = new trace_regex(path, regex, "");
+            if (this->events_exclude_path_regex.count(path) > 0)
+            {
+                delete this->events_exclude_path_regex[path];
+            }
+            this->events_exclude_path_regex[path] = new trace_regex(path, "");
         }
     }
     else
@@ -313,19 +459,21 @@ void vp::TraceEngine::add_exclude_path(int events, const char *path)
         }
         else
         {
-            this->trace_exclude_regexs[path] = new trace_regex(path, regex, "");
+            if (this->trace_exclude_regexs.count(path) > 0)
+            {
+                delete this->trace_exclude_regexs[path];
+            }
+            this->trace_exclude_regexs[path] = new trace_regex(path, "");
         }
     }
 
-    regcomp(regex, path, 0);
+    this->add_pending_path(path);
 }
 
 
 
 void vp::TraceEngine::add_path(int events, const char *path, bool is_path)
 {
-    regex_t *regex = new regex_t();
-
     if (events)
     {
         const char *file_path = "all.vcd";
@@ -342,7 +490,12 @@ void vp::TraceEngine::add_path(int events, const char *path, bool is_path)
             this->events_exclude_path_regex.erase(path);
         }
 
-        this->events_path_regex[path] = new trace_regex(path, regex, file_path, is_path);
+        if (this->events_path_regex.count(path) > 0)
+        {
+            delete this->events_path_regex[path];
+        }
+
+        this->events_path_regex[path] = new trace_regex(path, file_path, is_path);
     }
     else
     {
@@ -362,32 +515,48 @@ void vp::TraceEngine::add_path(int events, const char *path, bool is_path)
             this->trace_exclude_regexs.erase(path);
         }
 
-        this->trace_regexs[path] = new trace_regex(path, regex, file_path);
+        if (this->trace_regexs.count(path) > 0)
+        {
+            delete this->trace_regexs[path];
+        }
+
+        this->trace_regexs[path] = new trace_regex(path, file_path);
     }
 
-    regcomp(regex, path, 0);
+    this->add_pending_path(path, is_path);
 }
 
 void vp::TraceEngine::conf_trace(int event, std::string path_str, bool enabled)
 {
-    const char *file_path = "all.vcd";
-    const char *path = path_str.c_str();
-    char *delim = (char *)::index(path, '@');
+    std::string file_path = "all.vcd";
+    std::string path = path_str;
+    size_t delim = path_str.find('@');
 
-    if (delim)
+    if (delim != std::string::npos)
     {
-        *delim = 0;
-        file_path = delim + 1;
+        path = path_str.substr(0, delim);
+        file_path = path_str.substr(delim + 1);
     }
 
-    std::vector<vp::Trace *> traces;
-    this->top->get_trace_from_path(traces, path_str);
+    // Traces whose path starts with the specified one are taken into account, only if the
+    // block owning them is on the specified path.
+    std::vector<vp::Trace *> candidates, traces;
+    this->traces_tree.get_prefixed(path, candidates);
 
-    vp::Trace *trace = this->get_trace_from_path(path);
+    for (vp::Trace *trace: candidates)
+    {
+        std::string comp_path = trace->comp->get_path();
+        if (comp_path == "" || path.find(comp_path) == 0)
+        {
+            traces.push_back(trace);
+        }
+    }
 
-    if (trace != NULL)
+    auto it = this->traces_map.find(path);
+    if (it != this->traces_map.end() && it->second != NULL &&
+        std::find(traces.begin(), traces.end(), it->second) == traces.end())
     {
-        traces.push_back(trace);
+        traces.push_back(it->second);
     }
 
     for (vp::Trace *trace: traces)
@@ -424,6 +593,34 @@ void vp::TraceEngine::add_exclude_trace_path(int events, std::string path)
     this->add_exclude_path(events, path.c_str());
 }
 
+// Return the key under which a path given to add_path is stored, which is the path without
+// the file specified after the delimiter
+static std::string trace_path_key(int events, std::string path)
+{
+    return path.substr(0, path.find(events ? '@' : ':'));
+}
+
+bool vp::TraceEngine::has_trace_path(int events, std::string path)
+{
+    std::string key = trace_path_key(events, path);
+    return events ? this->events_path_regex.count(key) > 0 : this->trace_regexs.count(key) > 0;
+}
+
+void vp::TraceEngine::remove_trace_path(int events, std::string path)
+{
+    std::string key = trace_path_key(events, path);
+    std::unordered_map<std::string, trace_regex *> &regexs =
+        events ? this->events_path_regex : this->trace_regexs;
+
+    auto it = regexs.find(key);
+    if (it != regexs.end())
+    {
+        delete it->second;
+        regexs.erase(it);
+        this->add_pending_path(key);
+    }
+}
+
 void vp::TraceEngine::add_paths(int events, int nb_path, const char **paths)
 {
     for (int i = 0; i < nb_path; i++)
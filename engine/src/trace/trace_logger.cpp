@@ -0,0 +1,785 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/trace/trace_engine.hpp>
+#include <vp/trace/trace_logger.hpp>
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+
+/*
+ * Captured messages
+ *
+ * Each message is stored as a record header followed by one 8-bytes slot per argument of the
+ * format, including the '*' widths and precisions. Strings are stored as a slot containing
+ * their length (or -1 for NULL), followed by the characters padded to 8 bytes.
+ * The same layout is used for the arguments in the binary log.
+ */
+
+typedef struct
+{
+    vp::Trace *trace;
+    const char *fmt;
+    int64_t time;
+    int64_t cycles;
+    uint32_t size;
+    int32_t level;
+} trace_log_record_t;
+
+#define TRACE_LOG_MAX_STRING (1<<16)
+
+/*
+ * Binary log
+ *
+ * The file starts with the magic "GVTRLOG1", followed by 32 bits words for the version,
+ * the trace format (0 for long, 1 for short) and the maximum trace path length.
+ * It then contains a sequence of entries, each one starting with a byte giving its type:
+ * - TRACE_LOG_TRACE: 32 bits trace ID, 32 bits length, trace path
+ * - TRACE_LOG_FORMAT: 32 bits format ID, 32 bits length, format string
+ * - TRACE_LOG_MESSAGE: 32 bits trace ID, 32 bits format ID, 32 bits level,
+ *       64 bits time, 64 bits cycles, 32 bits arguments size, arguments
+ */
+
+#define TRACE_LOG_MAGIC   "GVTRLOG1"
+#define TRACE_LOG_VERSION 1
+
+enum trace_log_entry_e {
+    TRACE_LOG_TRACE = 1,
+    TRACE_LOG_FORMAT = 2,
+    TRACE_LOG_MESSAGE = 3
+};
+
+
+enum fmt_len_e {
+    FMT_LEN_NONE,
+    FMT_LEN_HH,
+    FMT_LEN_H,
+    FMT_LEN_L,
+    FMT_LEN_LL,
+    FMT_LEN_J,
+    FMT_LEN_Z,
+    FMT_LEN_T,
+    FMT_LEN_BIG_L
+};
+
+typedef struct
+{
+    // First character of the conversion, which is the '%'
+    const char *start;
+    // First character of the length modifier
+    const char *length;
+    // Character after the conversion
+    const char *end;
+    int nb_stars;
+    int length_type;
+    char conv;
+} fmt_spec_t;
+
+
+// Find the next conversion of a printf format, returns false if there is none
+static bool fmt_next(const char *fmt, fmt_spec_t *spec)
+{
+    const char *str = strchr(fmt, '%');
+    if (str == NULL)
+    {
+        return false;
+    }
+
+    spec->start = str++;
+    spec->nb_stars = 0;
+
+    while (*str && strchr("-+ #0'", *str))
+    {
+        str++;
+    }
+
+    if (*str == '*')
+    {
+        spec->nb_stars++;
+        str++;
+    }
+    else
+    {
+        while (isdigit(*str)) str++;
+    }
+
+    if (*str == '.')
+    {
+        str++;
+        if (*str == '*')
+        {
+            spec->nb_stars++;
+            str++;
+        }
+        else
+        {
+            while (isdigit(*str)) str++;
+        }
+    }
+
+    spec->length = str;
+    spec->length_type = FMT_LEN_NONE;
+
+    if (str[0] == 'h' && str[1] == 'h') { spec->length_type = FMT_LEN_HH; str += 2; }
+    else if (str[0] == 'h') { spec->length_type = FMT_LEN_H; str++; }
+    else if (str[0] == 'l' && str[1] == 'l') { spec->length_type = FMT_LEN_LL; str += 2; }
+    else if (str[0] == 'l') { spec->length_type = FMT_LEN_L; str++; }
+    else if (str[0] == 'q') { spec->length_type = FMT_LEN_LL; str++; }
+    else if (str[0] == 'j') { spec->length_type = FMT_LEN_J; str++; }
+    else if (str[0] == 'z') { spec->length_type = FMT_LEN_Z; str++; }
+    else if (str[0] == 't') { spec->length_type = FMT_LEN_T; str++; }
+    else if (str[0] == 'L') { spec->length_type = FMT_LEN_BIG_L; str++; }
+
+    spec->conv = *str;
+    if (*str)
+    {
+        str++;
+    }
+    spec->end = str;
+
+    return true;
+}
+
+static int64_t fmt_get_signed(va_list *ap, int length_type)
+{
+    switch (length_type)
+    {
+        case FMT_LEN_HH: return (signed char)va_arg(*ap, int);
+        case FMT_LEN_H: return (short)va_arg(*ap, int);
+        case FMT_LEN_L: return va_arg(*ap, long);
+        case FMT_LEN_LL: return va_arg(*ap, long long);
+        case FMT_LEN_J: return va_arg(*ap, intmax_t);
+        case FMT_LEN_Z: return va_arg(*ap, ssize_t);
+        case FMT_LEN_T: return va_arg(*ap, ptrdiff_t);
+        default: return va_arg(*ap, int);
+    }
+}
+
+static uint64_t fmt_get_unsigned(va_list *ap, int length_type)
+{
+    switch (length_type)
+    {
+        case FMT_LEN_HH: return (unsigned char)va_arg(*ap, unsigned int);
+        case FMT_LEN_H: return (unsigned short)va_arg(*ap, unsigned int);
+        case FMT_LEN_L: return va_arg(*ap, unsigned long);
+        case FMT_LEN_LL: return va_arg(*ap, unsigned long long);
+        case FMT_LEN_J: return va_arg(*ap, uintmax_t);
+        case FMT_LEN_Z: return va_arg(*ap, size_t);
+        case FMT_LEN_T: return va_arg(*ap, ptrdiff_t);
+        default: return va_arg(*ap, unsigned int);
+    }
+}
+
+static inline void fmt_put_slot(std::string &args, uint64_t value)
+{
+    args.append((char *)&value, sizeof(value));
+}
+
+// Copy the arguments of the format into the buffer, following the layout described above
+static void fmt_capture(const char *fmt, va_list *ap, std::string &args)
+{
+    fmt_spec_t spec;
+
+    while (fmt_next(fmt, &spec))
+    {
+        fmt = spec.end;
+
+        if (spec.conv == '%' || spec.conv == 0)
+        {
+            continue;
+        }
+
+        for (int i=0; i<spec.nb_stars; i++)
+        {
+            fmt_put_slot(args, (int64_t)va_arg(*ap, int));
+        }
+
+        switch (spec.conv)
+        {
+            case 'd': case 'i':
+                fmt_put_slot(args, fmt_get_signed(ap, spec.length_type));
+                break;
+
+            case 'u': case 'o': case 'x': case 'X':
+                fmt_put_slot(args, fmt_get_unsigned(ap, spec.length_type));
+                break;
+
+            case 'c':
+                fmt_put_slot(args, va_arg(*ap, int));
+                break;
+
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            {
+                double value;
+                if (spec.length_type == FMT_LEN_BIG_L)
+                {
+                    value = (double)va_arg(*ap, long double);
+                }
+                else
+                {
+                    value = va_arg(*ap, double);
+                }
+                fmt_put_slot(args, *(uint64_t *)&value);
+                break;
+            }
+
+            case 's':
+            {
+                const char *str = va_arg(*ap, const char *);
+                if (spec.length_type != FMT_LEN_NONE)
+                {
+                    // Wide strings are not supported, only the pointer is kept
+                    fmt_put_slot(args, (uint64_t)(uintptr_t)str);
+                }
+                else if (str == NULL)
+                {
+                    fmt_put_slot(args, (uint64_t)-1);
+                }
+                else
+                {
+                    size_t len = strnlen(str, TRACE_LOG_MAX_STRING);
+                    fmt_put_slot(args, len);
+                    args.append(str, len);
+                    args.append((8 - (len & 7)) & 7, 0);
+                }
+                break;
+            }
+
+            case 'p':
+                fmt_put_slot(args, (uint64_t)(uintptr_t)va_arg(*ap, void *));
+                break;
+
+            case 'n':
+                va_arg(*ap, void *);
+                break;
+        }
+    }
+}
+
+
+// Append to the string a single conversion with the specified value
+template<typename T> static void fmt_append(std::string &line, std::string &spec, int nb_stars,
+    int *stars, T value)
+{
+    char buffer[512];
+    int size;
+
+    if (nb_stars == 0)
+        size = snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+    else if (nb_stars == 1)
+        size = snprintf(buffer, sizeof(buffer), spec.c_str(), stars[0], value);
+    else
+        size = snprintf(buffer, sizeof(buffer), spec.c_str(), stars[0], stars[1], value);
+
+    if (size < 0)
+    {
+        return;
+    }
+
+    if (size < (int)sizeof(buffer))
+    {
+        line.append(buffer, size);
+        return;
+    }
+
+    std::vector<char> big_buffer(size + 1);
+    if (nb_stars == 0)
+        snprintf(big_buffer.data(), size + 1, spec.c_str(), value);
+    else if (nb_stars == 1)
+        snprintf(big_buffer.data(), size + 1, spec.c_str(), stars[0], value);
+    else
+        snprintf(big_buffer.data(), size + 1, spec.c_str(), stars[0], stars[1], value);
+    line.append(big_buffer.data(), size);
+}
+
+
+// Format the message from the captured arguments, which is the equivalent of vsnprintf
+static void fmt_format(std::string &line, const char *fmt, uint64_t *args)
+{
+    fmt_spec_t spec;
+    std::string spec_str;
+
+    while (fmt_next(fmt, &spec))
+    {
+        line.append(fmt, spec.start - fmt);
+        fmt = spec.end;
+
+        if (spec.conv == '%')
+        {
+            line.push_back('%');
+            continue;
+        }
+        if (spec.conv == 0)
+        {
+            continue;
+        }
+
+        int stars[2];
+        for (int i=0; i<spec.nb_stars; i++)
+        {
+            stars[i] = (int)(int64_t)*args++;
+        }
+
+        // Integers are all formatted as 64 bits since they have been captured with the proper
+        // sign extension.
+        spec_str.assign(spec.start, spec.length - spec.start);
+
+        switch (spec.conv)
+        {
+            case 'd': case 'i':
+                spec_str += "ll";
+                spec_str += spec.conv;
+                fmt_append(line, spec_str, spec.nb_stars, stars, (long long)*args++);
+                break;
+
+            case 'u': case 'o': case 'x': case 'X':
+                spec_str += "ll";
+                spec_str += spec.conv;
+                fmt_append(line, spec_str, spec.nb_stars, stars, (unsigned long long)*args++);
+                break;
+
+            case 'c':
+                spec_str += spec.conv;
+                fmt_append(line, spec_str, spec.nb_stars, stars, (int)*args++);
+                break;
+
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                spec_str += spec.conv;
+                fmt_append(line, spec_str, spec.nb_stars, stars, *(double *)args++);
+                break;
+
+            case 's':
+            {
+                if (spec.length_type != FMT_LEN_NONE)
+                {
+                    spec_str = "%p";
+                    fmt_append(line, spec_str, 0, stars, (void *)(uintptr_t)*args++);
+                    break;
+                }
+
+                uint64_t len = *args++;
+                spec_str += 's';
+                if (len == (uint64_t)-1)
+                {
+                    fmt_append(line, spec_str, spec.nb_stars, stars, (const char *)NULL);
+                }
+                else
+                {
+                    std::string str((char *)args, len);
+                    args += (len + 7) / 8;
+                    fmt_append(line, spec_str, spec.nb_stars, stars, str.c_str());
+                }
+                break;
+            }
+
+            case 'p':
+                spec_str += 'p';
+                fmt_append(line, spec_str, spec.nb_stars, stars, (void *)(uintptr_t)*args++);
+                break;
+
+            case 'n':
+                break;
+
+            default:
+                line.append(spec.start, spec.end - spec.start);
+                break;
+        }
+    }
+
+    line.append(fmt);
+}
+
+
+vp::TraceLogger::TraceLogger(TraceEngine *engine, int backend, std::string binary_path,
+    int nb_chunks)
+    : engine(engine), backend(backend), binary_path(binary_path)
+{
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->cond, NULL);
+
+    // The recorder needs at least one full chunk besides the one being filled
+    if (nb_chunks < 2)
+    {
+        nb_chunks = 2;
+    }
+
+    for (int i=0; i<nb_chunks; i++)
+    {
+        chunk_t *chunk = new chunk_t;
+        chunk->data = new char[TRACE_LOGGER_CHUNK_SIZE];
+        chunk->size = 0;
+        this->free_chunks.push_back(chunk);
+    }
+
+    // The file is opened here so that an error is reported to the caller and not raised in
+    // the writer thread. The header is written with the first record, once all traces are known.
+    if (this->backend == TRACE_BACKEND_BINARY)
+    {
+        this->binary_file = fopen(this->binary_path.c_str(), "wb");
+        if (this->binary_file == NULL)
+        {
+            throw std::runtime_error("Error while opening binary trace file (path: " +
+                this->binary_path + ", error: " + strerror(errno) + ")\n");
+        }
+    }
+
+    if (this->backend != TRACE_BACKEND_RECORDER)
+    {
+        this->thread = new std::thread(&TraceLogger::writer_routine, this);
+    }
+}
+
+vp::TraceLogger::~TraceLogger()
+{
+    this->flush();
+
+    if (this->thread)
+    {
+        pthread_mutex_lock(&this->mutex);
+        this->end = true;
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+        this->thread->join();
+    }
+
+    if (this->binary_file)
+    {
+        fclose(this->binary_file);
+    }
+}
+
+void vp::TraceLogger::log(vp::Trace *trace, int level, int64_t time, int64_t cycles,
+    const char *fmt, va_list ap)
+{
+    // The arguments are first captured in a per-thread buffer, since their size is only
+    // known after the format has been parsed.
+    static thread_local std::string args;
+    va_list ap_copy;
+
+    args.clear();
+    va_copy(ap_copy, ap);
+    fmt_capture(fmt, &ap_copy, args);
+    va_end(ap_copy);
+
+    trace_log_record_t record = {
+        .trace=trace, .fmt=fmt, .time=time, .cycles=cycles,
+        .size=(uint32_t)(sizeof(record) + args.size()), .level=level
+    };
+
+    if (record.size > TRACE_LOGGER_CHUNK_SIZE)
+    {
+        return;
+    }
+
+    while (this->current_lock.test_and_set(std::memory_order_acquire));
+
+    char *dest = this->alloc(record.size);
+    memcpy(dest, &record, sizeof(record));
+    memcpy(dest + sizeof(record), args.data(), args.size());
+
+    this->current_lock.clear(std::memory_order_release);
+}
+
+vp::TraceLogger::chunk_t *vp::TraceLogger::get_chunk()
+{
+    chunk_t *chunk;
+
+    pthread_mutex_lock(&this->mutex);
+    if (this->backend == TRACE_BACKEND_RECORDER && this->free_chunks.size() == 0)
+    {
+        // The recorder never blocks, it just forgets the oldest messages
+        chunk = this->ready_chunks.front();
+        this->ready_chunks.erase(this->ready_chunks.begin());
+        this->nb_dropped++;
+    }
+    else
+    {
+        while (this->free_chunks.size() == 0)
+        {
+            pthread_cond_wait(&this->cond, &this->mutex);
+        }
+        chunk = this->free_chunks.back();
+        this->free_chunks.pop_back();
+    }
+    pthread_mutex_unlock(&this->mutex);
+
+    chunk->size = 0;
+    return chunk;
+}
+
+void vp::TraceLogger::push_chunk()
+{
+    pthread_mutex_lock(&this->mutex);
+    this->ready_chunks.push_back(this->current);
+    this->current = NULL;
+    pthread_cond_broadcast(&this->cond);
+    pthread_mutex_unlock(&this->mutex);
+}
+
+char *vp::TraceLogger::alloc(size_t size)
+{
+    if (this->current && this->current->size + size > TRACE_LOGGER_CHUNK_SIZE)
+    {
+        this->push_chunk();
+    }
+
+    if (this->current == NULL)
+    {
+        this->current = this->get_chunk();
+    }
+
+    char *result = this->current->data + this->current->size;
+    this->current->size += size;
+    return result;
+}
+
+void vp::TraceLogger::flush()
+{
+    if (this->backend == TRACE_BACKEND_RECORDER)
+    {
+        return;
+    }
+
+    while (this->current_lock.test_and_set(std::memory_order_acquire));
+    if (this->current && this->current->size > 0)
+    {
+        this->push_chunk();
+    }
+    this->current_lock.clear(std::memory_order_release);
+
+    pthread_mutex_lock(&this->mutex);
+    while (this->ready_chunks.size() != 0 || this->nb_writing != 0)
+    {
+        pthread_cond_wait(&this->cond, &this->mutex);
+    }
+    pthread_mutex_unlock(&this->mutex);
+
+    if (this->binary_file)
+    {
+        fflush(this->binary_file);
+    }
+    fflush(NULL);
+}
+
+void vp::TraceLogger::dump()
+{
+    if (this->backend != TRACE_BACKEND_RECORDER)
+    {
+        return;
+    }
+
+    // Keep the current chunk locked during the dump so that messages emitted from other threads
+    // are not reordered.
+    while (this->current_lock.test_and_set(std::memory_order_acquire));
+
+    if (this->current && this->current->size > 0)
+    {
+        this->push_chunk();
+    }
+
+    pthread_mutex_lock(&this->mutex);
+    std::vector<chunk_t *> chunks = this->ready_chunks;
+    int nb_dropped = this->nb_dropped;
+    this->ready_chunks.clear();
+    this->nb_dropped = 0;
+    pthread_mutex_unlock(&this->mutex);
+
+    if (chunks.size() != 0)
+    {
+        fprintf(stdout, "[\033[31mRECORDER\033[0m] Dumping recorded trace messages%s\n",
+            nb_dropped ? " (older messages have been dropped)" : "");
+
+        for (chunk_t *chunk : chunks)
+        {
+            this->write_chunk(chunk);
+        }
+    }
+
+    pthread_mutex_lock(&this->mutex);
+    for (chunk_t *chunk : chunks)
+    {
+        this->free_chunks.push_back(chunk);
+    }
+    pthread_mutex_unlock(&this->mutex);
+
+    this->current_lock.clear(std::memory_order_release);
+
+    fflush(NULL);
+}
+
+void vp::TraceLogger::writer_routine()
+{
+    while (1)
+    {
+        pthread_mutex_lock(&this->mutex);
+
+        while (this->ready_chunks.size() == 0 && !this->end)
+        {
+            pthread_cond_wait(&this->cond, &this->mutex);
+        }
+
+        if (this->ready_chunks.size() == 0)
+        {
+            pthread_mutex_unlock(&this->mutex);
+            break;
+        }
+
+        chunk_t *chunk = this->ready_chunks.front();
+        this->ready_chunks.erase(this->ready_chunks.begin());
+        this->nb_writing++;
+
+        pthread_mutex_unlock(&this->mutex);
+
+        this->write_chunk(chunk);
+
+        pthread_mutex_lock(&this->mutex);
+        this->nb_writing--;
+        this->free_chunks.push_back(chunk);
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+    }
+}
+
+void vp::TraceLogger::write_chunk(chunk_t *chunk)
+{
+    size_t offset = 0;
+    while (offset < chunk->size)
+    {
+        char *record = chunk->data + offset;
+        if (this->backend == TRACE_BACKEND_BINARY)
+        {
+            this->write_binary_record(record);
+        }
+        else
+        {
+            this->format_record(record);
+        }
+        offset += ((trace_log_record_t *)record)->size;
+    }
+}
+
+void vp::TraceLogger::format_record(char *record_ptr)
+{
+    trace_log_record_t *record = (trace_log_record_t *)record_ptr;
+    vp::Trace *trace = record->trace;
+    char header[64];
+
+    this->line.clear();
+
+    // Same header as vp::Trace::dump_header
+    if (this->engine->get_format() == TRACE_FORMAT_SHORT)
+    {
+        snprintf(header, sizeof(header), "%" PRId64 "ps %" PRId64 " ", record->time, record->cycles);
+        this->line += header;
+    }
+    else
+    {
+        int max_trace_len = this->engine->get_max_path_len();
+        snprintf(header, sizeof(header), "%" PRId64 ": %" PRId64 ": [\033[34m", record->time,
+            record->cycles);
+        this->line += header;
+        this->line.append(trace->path, 0, max_trace_len);
+        if ((int)trace->path.size() < max_trace_len)
+        {
+            this->line.append(max_trace_len - trace->path.size(), ' ');
+        }
+        this->line += "\033[0m] ";
+    }
+
+    if (record->level == vp::Trace::LEVEL_ERROR)
+    {
+        this->line += "\033[31m";
+    }
+    else if (record->level == vp::Trace::LEVEL_WARNING)
+    {
+        this->line += "\033[33m";
+    }
+
+    fmt_format(this->line, record->fmt, (uint64_t *)(record_ptr + sizeof(trace_log_record_t)));
+
+    if (record->level == vp::Trace::LEVEL_ERROR || record->level == vp::Trace::LEVEL_WARNING)
+    {
+        this->line += "\033[0m";
+    }
+
+    fwrite(this->line.data(), 1, this->line.size(), trace->trace_file);
+}
+
+void vp::TraceLogger::write_binary_record(char *record_ptr)
+{
+    trace_log_record_t *record = (trace_log_record_t *)record_ptr;
+    vp::Trace *trace = record->trace;
+
+    if (!this->binary_header_done)
+    {
+        this->binary_header_done = true;
+        uint32_t header[] = { TRACE_LOG_VERSION, (uint32_t)this->engine->get_format(),
+            (uint32_t)this->engine->get_max_path_len() };
+        fwrite(TRACE_LOG_MAGIC, 1, 8, this->binary_file);
+        fwrite(header, 1, sizeof(header), this->binary_file);
+    }
+
+    if ((int)this->binary_traces.size() <= trace->id)
+    {
+        this->binary_traces.resize(trace->id + 1);
+    }
+
+    if (!this->binary_traces[trace->id])
+    {
+        this->binary_traces[trace->id] = true;
+        uint8_t type = TRACE_LOG_TRACE;
+        uint32_t desc[] = { (uint32_t)trace->id, (uint32_t)trace->path.size() };
+        fwrite(&type, 1, 1, this->binary_file);
+        fwrite(desc, 1, sizeof(desc), this->binary_file);
+        fwrite(trace->path.c_str(), 1, trace->path.size(), this->binary_file);
+    }
+
+    uint32_t fmt_id;
+    auto it = this->binary_formats.find(record->fmt);
+    if (it == this->binary_formats.end())
+    {
+        fmt_id = this->binary_formats.size();
+        this->binary_formats[record->fmt] = fmt_id;
+        uint8_t type = TRACE_LOG_FORMAT;
+        uint32_t desc[] = { fmt_id, (uint32_t)strlen(record->fmt) };
+        fwrite(&type, 1, 1, this->binary_file);
+        fwrite(desc, 1, sizeof(desc), this->binary_file);
+        fwrite(record->fmt, 1, desc[1], this->binary_file);
+    }
+    else
+    {
+        fmt_id = it->second;
+    }
+
+    uint8_t type = TRACE_LOG_MESSAGE;
+    uint32_t desc[] = { (uint32_t)trace->id, fmt_id, (uint32_t)record->level };
+    int64_t timestamps[] = { record->time, record->cycles };
+    uint32_t args_size = record->size - sizeof(trace_log_record_t);
+    fwrite(&type, 1, 1, this->binary_file);
+    fwrite(desc, 1, sizeof(desc), this->binary_file);
+    fwrite(timestamps, 1, sizeof(timestamps), this->binary_file);
+    fwrite(&args_size, 1, sizeof(args_size), this->binary_file);
+    fwrite(record_ptr + sizeof(trace_log_record_t), 1, args_size, this->binary_file);
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/trace/trace_engine.hpp>
+#include <algorithm>
+
+
+static std::vector<std::string> split_path(const std::string &path)
+{
+    std::vector<std::string> names;
+    size_t start = 0;
+    while (1)
+    {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos)
+        {
+            names.push_back(path.substr(start));
+            return names;
+        }
+        names.push_back(path.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+static inline bool starts_with(const std::string &str, const std::string &prefix)
+{
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+void vp::TracePathTree::add(vp::Trace *trace)
+{
+    std::vector<std::string> names = split_path(trace->get_full_path());
+    TracePathNode *node = &this->root;
+    int depth = 0;
+
+    for (std::string &name: names)
+    {
+        auto it = node->childs.find(name);
+        if (it == node->childs.end())
+        {
+            TracePathNode *child = new TracePathNode();
+            node->childs[name] = child;
+            // The first name is the one before the first '/', it can not be matched by a path
+            // starting with '/'.
+            if (depth > 0)
+            {
+                this->nodes[name].push_back(child);
+            }
+            node = child;
+        }
+        else
+        {
+            node = it->second;
+        }
+        depth++;
+    }
+
+    node->traces.push_back(trace);
+}
+
+void vp::TracePathTree::get_all(TracePathNode *node, std::vector<vp::Trace *> &traces)
+{
+    traces.insert(traces.end(), node->traces.begin(), node->traces.end());
+
+    for (auto &x: node->childs)
+    {
+        this->get_all(x.second, traces);
+    }
+}
+
+void vp::TracePathTree::get_from_node(TracePathNode *node, std::vector<std::string> &names,
+    size_t index, std::vector<vp::Trace *> &traces)
+{
+    // All names must match exactly except the last one which can be a prefix, since the path
+    // can stop in the middle of a name.
+    for (; index < names.size() - 1; index++)
+    {
+        auto it = node->childs.find(names[index]);
+        if (it == node->childs.end())
+        {
+            return;
+        }
+        node = it->second;
+    }
+
+    const std::string &last = names[index];
+    for (auto it = node->childs.lower_bound(last); it != node->childs.end() &&
+        starts_with(it->first, last); it++)
+    {
+        this->get_all(it->second, traces);
+    }
+}
+
+void vp::TracePathTree::get_prefixed(std::string path, std::vector<vp::Trace *> &traces)
+{
+    std::vector<std::string> names = split_path(path);
+    this->get_from_node(&this->root, names, 0, traces);
+}
+
+void vp::TracePathTree::get_containing(std::string path, std::vector<vp::Trace *> &traces)
+{
+    std::vector<std::string> names = split_path(path.substr(1));
+    size_t first_size = traces.size();
+
+    if (names.size() == 1)
+    {
+        // The path is a prefix of a single name, take all nodes starting with it
+        for (auto it = this->nodes.lower_bound(names[0]); it != this->nodes.end() &&
+            starts_with(it->first, names[0]); it++)
+        {
+            for (TracePathNode *node: it->second)
+            {
+                this->get_all(node, traces);
+            }
+        }
+    }
+    else
+    {
+        // Otherwise the first name must exactly match a node, the next ones are searched from it
+        auto it = this->nodes.find(names[0]);
+        if (it != this->nodes.end())
+        {
+            for (TracePathNode *node: it->second)
+            {
+                this->get_from_node(node, names, 1, traces);
+            }
+        }
+    }
+
+    // The path can be found several times in the same trace path
+    std::sort(traces.begin() + first_size, traces.end());
+    traces.erase(std::unique(traces.begin() + first_size, traces.end()), traces.end());
+}
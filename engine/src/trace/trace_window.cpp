@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/trace/trace_engine.hpp>
+#include <vp/time/time_event.hpp>
+
+
+namespace vp
+{
+    // Block executing the time triggers, since time events must belong to a block
+    class TraceTriggerTimer : public vp::Block
+    {
+    public:
+        TraceTriggerTimer(vp::Component *top, TraceEngine *engine);
+        void reset(bool active) override;
+
+    private:
+        static void event_handler(vp::Block *__this, vp::TimeEvent *event);
+
+        vp::Trace trace;
+        std::vector<TraceTrigger *> triggers;
+        std::vector<vp::TimeEvent *> events;
+    };
+}
+
+
+vp::TraceTrigger::TraceTrigger(TraceWindow *window, bool is_start, std::string desc)
+    : window(window), is_start(is_start)
+{
+    size_t first = desc.find(':');
+    size_t last = desc.rfind(':');
+
+    if (first == std::string::npos)
+    {
+        throw std::invalid_argument("Invalid trace trigger, should be <type>:<value> or "
+            "<type>:<path>:<value> (trigger: " + desc + ")");
+    }
+
+    this->type = desc.substr(0, first);
+    this->value = desc.substr(last + 1);
+
+    if (first != last)
+    {
+        this->path = desc.substr(first + 1, last - first - 1);
+
+        // Paths are compared to the component paths, which start with a '/'
+        if (this->path[0] != '/')
+        {
+            this->path = "/" + this->path;
+        }
+    }
+}
+
+bool vp::TraceTrigger::fire()
+{
+    if (this->done)
+    {
+        return true;
+    }
+
+    if (this->is_start)
+    {
+        this->window->open();
+    }
+    else
+    {
+        if (!this->window->is_open)
+        {
+            return false;
+        }
+        this->window->close();
+    }
+
+    this->done = true;
+
+    return true;
+}
+
+
+vp::TraceWindow::TraceWindow(TraceEngine *engine, js::Config *config)
+    : engine(engine)
+{
+    js::Config *traces = config->get("traces");
+    if (traces)
+    {
+        for (auto x : traces->get_elems())
+        {
+            this->traces.push_back(x->get_str());
+        }
+    }
+
+    js::Config *events = config->get("events");
+    if (events)
+    {
+        for (auto x : events->get_elems())
+        {
+            this->events.push_back(x->get_str());
+        }
+    }
+
+    std::string start = config->get_child_str("start");
+    if (start != "")
+    {
+        this->start = new TraceTrigger(this, true, start);
+    }
+
+    std::string stop = config->get_child_str("stop");
+    if (stop != "")
+    {
+        this->stop = new TraceTrigger(this, false, stop);
+    }
+
+    if (this->start == NULL)
+    {
+        this->open();
+    }
+}
+
+void vp::TraceWindow::open()
+{
+    if (this->is_open)
+    {
+        return;
+    }
+
+    this->is_open = true;
+
+    for (std::string &path : this->traces)
+    {
+        if (!this->engine->has_trace_path(0, path))
+        {
+            this->engine->add_trace_path(0, path);
+            this->added_traces.push_back(path);
+        }
+    }
+    for (std::string &path : this->events)
+    {
+        if (!this->engine->has_trace_path(1, path))
+        {
+            this->engine->add_trace_path(1, path);
+            this->added_events.push_back(path);
+        }
+    }
+    this->engine->check_traces();
+}
+
+void vp::TraceWindow::close()
+{
+    if (!this->is_open)
+    {
+        return;
+    }
+
+    this->is_open = false;
+
+    // Only the paths added by the window are removed, excluding them would also disable traces
+    // enabled by other means
+    for (std::string &path : this->added_traces)
+    {
+        this->engine->remove_trace_path(0, path);
+    }
+    for (std::string &path : this->added_events)
+    {
+        this->engine->remove_trace_path(1, path);
+    }
+    this->added_traces.clear();
+    this->added_events.clear();
+    this->engine->check_traces();
+}
+
+
+vp::TraceTriggerTimer::TraceTriggerTimer(vp::Component *top, TraceEngine *engine)
+    : vp::Block(top, "trace_trigger_timer")
+{
+    this->traces.new_trace("trace", &this->trace, vp::DEBUG);
+
+    for (TraceWindow *window : engine->windows)
+    {
+        for (TraceTrigger *trigger : { window->start, window->stop })
+        {
+            if (trigger && trigger->type == "time")
+            {
+                vp::TimeEvent *event = new vp::TimeEvent(this, &TraceTriggerTimer::event_handler);
+                event->get_args()[0] = (void *)trigger;
+                this->triggers.push_back(trigger);
+                this->events.push_back(event);
+            }
+        }
+    }
+}
+
+void vp::TraceTriggerTimer::reset(bool active)
+{
+    if (!active)
+    {
+        int64_t current_time = this->time.get_engine()->get_time();
+
+        for (size_t i=0; i<this->triggers.size(); i++)
+        {
+            TraceTrigger *trigger = this->triggers[i];
+            int64_t time = strtoll(trigger->value.c_str(), NULL, 0);
+
+            if (!trigger->done && !this->events[i]->is_enqueued())
+            {
+                this->events[i]->enqueue(std::max(time - current_time, (int64_t)0));
+            }
+        }
+    }
+}
+
+void vp::TraceTriggerTimer::event_handler(vp::Block *__this, vp::TimeEvent *event)
+{
+    TraceTriggerTimer *_this = (TraceTriggerTimer *)__this;
+    TraceTrigger *trigger = (TraceTrigger *)event->get_args()[0];
+
+    // Contrary to component triggers, a time trigger is not evaluated again, so a stop time
+    // reached before the window is opened can not be taken into account
+    if (!trigger->fire())
+    {
+        _this->trace.force_warning("Trace window stop time reached before the window was opened, "
+            "the window will not be closed (time: %s)\n", trigger->value.c_str());
+    }
+}
+
+
+void vp::TraceEngine::init_triggers()
+{
+    for (TraceWindow *window : this->windows)
+    {
+        if ((window->start && window->start->type == "time") ||
+            (window->stop && window->stop->type == "time"))
+        {
+            this->trigger_timer = new TraceTriggerTimer(this->top, this);
+            break;
+        }
+    }
+}
+
+std::vector<vp::TraceTrigger *> vp::TraceEngine::get_triggers(std::string path)
+{
+    std::vector<TraceTrigger *> result;
+
+    for (TraceWindow *window : this->windows)
+    {
+        for (TraceTrigger *trigger : { window->start, window->stop })
+        {
+            if (trigger && !trigger->done && trigger->path == path)
+            {
+                result.push_back(trigger);
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <vp/trace/vcd_shm.hpp>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+
+
+vp::VcdShmUser::VcdShmUser(std::string name, size_t size, int batch_size)
+    : name(name), batch_size(batch_size)
+{
+    size = (size + 7) & ~7;
+
+    // A full batch must always fit in the ring
+    if (size < (sizeof(gv::Vcd_shm_record) + batch_size * sizeof(gv::Vcd_event)) * 2)
+    {
+        throw std::invalid_argument("VCD shared memory is too small for batches (size: " +
+            std::to_string(size) + ", batch_size: " + std::to_string(batch_size) + ")");
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Error while opening VCD shared memory (name: " + name +
+            ", error: " + strerror(errno) + ")");
+    }
+
+    this->map_size = sizeof(gv::Vcd_shm_header) + size;
+
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, this->map_size) == 0)
+    {
+        map = mmap(NULL, this->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Error while mapping VCD shared memory (name: " + name +
+            ", error: " + strerror(errno) + ")");
+    }
+
+    this->header = (gv::Vcd_shm_header *)map;
+    this->ring = (uint8_t *)map + sizeof(gv::Vcd_shm_header);
+
+    this->header->version = GV_VCD_SHM_VERSION;
+    this->header->size = size;
+    this->header->head.store(0);
+    this->header->tail.store(0);
+    this->header->closed.store(0);
+    this->header->reader_closed.store(0);
+    this->header->reader_pid.store(0);
+    // Magic is written last so that the reader only sees a fully initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(this->header->magic, GV_VCD_SHM_MAGIC, 8);
+}
+
+vp::VcdShmUser::~VcdShmUser()
+{
+    this->close();
+    munmap(this->header, this->map_size);
+}
+
+void vp::VcdShmUser::close()
+{
+    if (!this->header->closed.load())
+    {
+        this->header->closed.store(1, std::memory_order_release);
+        // The reader can still map it until it is done, we just remove the name
+        shm_unlink(this->name.c_str());
+    }
+}
+
+bool vp::VcdShmUser::wait_space(size_t size)
+{
+    uint64_t head = this->header->head.load(std::memory_order_relaxed);
+    int iter = 0;
+
+    // Block the dumper thread until the reader makes room, so that no event is lost, unless the
+    // reader is gone, in which case nobody will ever make room
+    while (this->header->size - (head - this->header->tail.load(std::memory_order_acquire)) < size)
+    {
+        if ((iter++ & 0xff) == 0)
+        {
+            int32_t pid = this->header->reader_pid.load(std::memory_order_acquire);
+            if (this->header->reader_closed.load(std::memory_order_acquire) ||
+                (pid != 0 && kill(pid, 0) == -1 && errno == ESRCH))
+            {
+                fprintf(stderr, "VCD shared memory reader is gone, dropping next events (name: %s)\n",
+                    this->name.c_str());
+                this->reader_gone = true;
+                return false;
+            }
+        }
+        sched_yield();
+    }
+
+    return true;
+}
+
+void vp::VcdShmUser::write_record(gv::Vcd_shm_record_type type, void *data0, size_t size0,
+    void *data1, size_t size1)
+{
+    size_t payload_size = size0 + size1;
+    size_t size = sizeof(gv::Vcd_shm_record) + ((payload_size + 7) & ~7);
+
+    if (size > this->header->size || this->reader_gone)
+    {
+        return;
+    }
+
+    uint64_t head = this->header->head.load(std::memory_order_relaxed);
+    size_t offset = head % this->header->size;
+    size_t remaining = this->header->size - offset;
+
+    // Records are never split, the end of the ring is skipped if the record does not fit
+    if (remaining < size)
+    {
+        if (!this->wait_space(remaining))
+        {
+            return;
+        }
+        gv::Vcd_shm_record *pad = (gv::Vcd_shm_record *)&this->ring[offset];
+        pad->type = gv::Vcd_shm_record_pad;
+        pad->size = remaining - sizeof(gv::Vcd_shm_record);
+        head += remaining;
+        this->header->head.store(head, std::memory_order_release);
+        offset = 0;
+    }
+
+    if (!this->wait_space(size))
+    {
+        return;
+    }
+
+    gv::Vcd_shm_record *record = (gv::Vcd_shm_record *)&this->ring[offset];
+    record->type = type;
+    record->size = payload_size;
+    memcpy(record + 1, data0, size0);
+    if (size1)
+    {
+        memcpy((uint8_t *)(record + 1) + size0, data1, size1);
+    }
+
+    this->header->head.store(head + size, std::memory_order_release);
+}
+
+void vp::VcdShmUser::event_register(int id, std::string path, gv::Vcd_event_type type, int width)
+{
+    if ((int)this->widths.size() <= id)
+    {
+        this->widths.resize(id + 1);
+    }
+    this->widths[id] = width;
+
+    gv::Vcd_shm_register reg = { .id=id, .type=type, .width=width, .path_len=(int32_t)path.size() };
+    this->write_record(gv::Vcd_shm_record_register, &reg, sizeof(reg), (void *)path.c_str(), path.size());
+}
+
+void vp::VcdShmUser::event_update_logical(int64_t timestamp, int id, uint64_t value, int flags)
+{
+    gv::Vcd_event event = { .timestamp=timestamp, .id=id, .flags=flags, .value=value };
+    this->write_record(gv::Vcd_shm_record_events, &event, sizeof(event));
+}
+
+void vp::VcdShmUser::event_update_bitfield(int64_t timestamp, int id, uint8_t *value, uint8_t *flags)
+{
+    size_t bytes = (this->widths[id] + 7) / 8;
+    gv::Vcd_event event = { .timestamp=timestamp, .id=id, .flags=flags != NULL, .value=bytes };
+
+    this->bitfield.assign(value, value + bytes);
+    if (flags)
+    {
+        this->bitfield.insert(this->bitfield.end(), flags, flags + bytes);
+    }
+
+    this->write_record(gv::Vcd_shm_record_bitfield, &event, sizeof(event), this->bitfield.data(),
+        this->bitfield.size());
+}
+
+void vp::VcdShmUser::event_update_real(int64_t timestamp, int id, double value)
+{
+    gv::Vcd_event event = { .timestamp=timestamp, .id=id, .flags=0, .value=0 };
+    memcpy(&event.value, &value, sizeof(value));
+    this->write_record(gv::Vcd_shm_record_events, &event, sizeof(event));
+}
+
+void vp::VcdShmUser::event_update_string(int64_t timestamp, int id, const char *value, int flags)
+{
+    size_t len = strlen(value);
+    gv::Vcd_event event = { .timestamp=timestamp, .id=id, .flags=flags, .value=len };
+    this->write_record(gv::Vcd_shm_record_string, &event, sizeof(event), (void *)value, len);
+}
+
+void vp::VcdShmUser::event_update_batch(gv::Vcd_event *events, int nb_events)
+{
+    this->write_record(gv::Vcd_shm_record_events, events, nb_events * sizeof(gv::Vcd_event));
+}
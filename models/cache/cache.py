@@ -24,10 +24,17 @@ class Cache(st.Component):
     ----------
     size : int
         The size of the memory
+    nb_mshrs : int
+        Number of misses which can be pending at the same time. Requests hitting the cache are
+        still served while misses are pending.
+    replacement : str
+        Replacement policy, among "lfsr" (8 bits LFSR of GAP FC icache), "lru", "plru"
+        (tree pseudo-LRU) and "random".
     
     """
 
-    def __init__(self, parent, name, nb_sets_bits, nb_ways_bits, line_size_bits, refill_latency=0, refill_shift=0, nb_ports=1, add_offset=0):
+    def __init__(self, parent, name, nb_sets_bits, nb_ways_bits, line_size_bits, refill_latency=0, refill_shift=0, nb_ports=1, add_offset=0,
+            nb_mshrs=1, replacement='lfsr'):
 
         super(Cache, self).__init__(parent, name)
 
@@ -40,7 +47,9 @@ class Cache(st.Component):
             'nb_ports': nb_ports,
             'refill_latency': refill_latency,
             'add_offset': add_offset,
-            'refill_shift': refill_shift
+            'refill_shift': refill_shift,
+            'nb_mshrs': nb_mshrs,
+            'replacement': replacement
         })
 
 
@@ -49,13 +58,13 @@ class Cache(st.Component):
 
         if tree.get_view() != 'overview':
 
-            tree.add_trace(self, 'refill', 'refill', '[31:0]', tag='icache')
+            tree.add_trace(self, 'refill', 'refill', '[63:0]', tag='icache')
 
             for way in range(0, 1<<self.get_property('nb_ways_bits')):
                 tree.begin_group('way_%d' % way)
 
                 for line in range(0, 1<<self.get_property('nb_sets_bits')):
-                    tree.add_trace(self, 'tag_%d' % line, 'set_%d.line_%d' % (way, line), '[31:0]', tag='icache')
+                    tree.add_trace(self, 'tag_%d' % line, 'set_%d.line_%d' % (way, line), '[63:0]', tag='icache')
 
                 tree.end_group('way_%d' % way)
 
@@ -22,35 +22,86 @@
 #include <vp/vp.hpp>
 #include <vp/queue.hpp>
 #include <vp/itf/io.hpp>
-#include <vp/signal.hpp>
 #include <vector>
 #include <sstream>
 
+
+/*
+ * Non-blocking cache.
+ *
+ * Misses are tracked by MSHRs (miss status holding registers), so that several refills can be
+ * pending at the same time. Requests hitting a line which is not being refilled are served while
+ * refills are pending, and requests missing a line which is already being refilled are queued
+ * on its MSHR. A request is stalled only if all MSHRs are busy or if all the ways of its set are
+ * being refilled.
+ *
+ * Tags are kept in a separate contiguous array, indexed by set and then way, so that the ways of
+ * a set are compared in a loop that the compiler can vectorize. A tag is the full line address,
+ * which is also the key of MSHRs.
+ */
+
+
+// Tag of a line which does not hold any data
+#define CACHE_TAG_INVALID ((uint64_t)-1)
+
+
+typedef enum
+{
+    // 8 bits LFSR used on GAP FC icache
+    CACHE_REPL_LFSR,
+    CACHE_REPL_LRU,
+    CACHE_REPL_PLRU,
+    CACHE_REPL_RANDOM,
+} cache_repl_e;
+
+
 typedef struct
 {
-    uint32_t tag;
-    bool dirty;
     uint8_t *data;
     vp::Trace tag_event;
+    // Cycle where the data of the line is available, when it was refilled synchronously
     int64_t timestamp;
+    // True while the line is the target of a pending refill. It can then not be evicted.
+    bool refilling;
 } cache_line_t;
 
-class Cache : public vp::Component
+
+class CacheMshr
 {
+public:
+    // Request used to refill the line
+    vp::IoReq req;
+    // Tag of the line being refilled
+    uint64_t tag;
+    int line_index;
+    cache_line_t *line;
+    // True while the refill is pending
+    bool pending;
+    // True if the pending refill was dropped by a reset while its response is still expected.
+    // The MSHR can not be reused until then, since its request is still owned by the slave.
+    bool dropped;
+    // Cycle where the MSHR can start a new refill, when the refill was handled synchronously
+    int64_t ready;
+    // Requests waiting for the refill, the first one being the one which missed
+    vp::Queue *waiting_reqs;
+};
 
-    friend class CacheSet;
-    friend class CacheLine;
+
+class Cache : public vp::Component
+{
 
 public:
     Cache(vp::ComponentConf &conf);
 
+    void reset(bool active) override;
+    void stop() override;
+
     unsigned int nb_ways_bits = 2;
     unsigned int line_size_bits = 5;
     unsigned int nb_sets_bits = 352;
     unsigned int nb_ways;
     unsigned int nb_sets;
     unsigned int line_size;
-    unsigned int widthBits = 2;
     int nb_ports = 1;
 
     bool enabled = false;
@@ -66,33 +117,45 @@ private:
     vp::WireSlave<bool> flush_line_itf;
     vp::WireSlave<uint32_t> flush_line_addr_itf;
 
-    vp::IoReq refill_req;
-
     int refill_latency;
     int refill_shift;
-    uint32_t add_offset;
-    int64_t refill_timestamp;
+    uint64_t add_offset;
+
+    cache_repl_e repl_policy;
+    // State of the LFSR policy
+    uint8_t lfsr;
+    // State of the random policy
+    uint64_t random_state;
+    // Access counter of the LRU policy, and counter value of the last access of each line
+    uint64_t lru_counter;
+    std::vector<uint64_t> lru_stamps;
+    // Tree bits of the PLRU policy, one word per set
+    std::vector<uint64_t> plru_trees;
 
-    int64_t nextPacketStart;
-    unsigned int R1;
-    unsigned int R2;
-
-    uint8_t lru_out;
-
-    uint32_t line_offset_mask;
-    uint32_t line_index_mask;
     uint32_t flush_line_addr;
 
     vp::Trace refill_event;
     std::vector<vp::Trace> io_event;
+    vp::Trace hits_event;
+    vp::Trace misses_event;
+    vp::Trace evictions_event;
+
+    uint64_t nb_hits;
+    uint64_t nb_misses;
+    uint64_t nb_evictions;
 
-    vp::Queue refill_pending_reqs;
+    // Requests which could not get an MSHR or a way to refill
+    vp::Queue stalled_reqs;
+    // True while a stalled request is resumed, so that it keeps its place if it stalls again
+    bool resuming = false;
 
-    cache_line_t *lines;
+    std::vector<CacheMshr> mshrs;
+    int nb_pending_mshrs;
 
-    cache_line_t *refill_line;
-    uint32_t refill_tag;
-    vp::Signal<bool> pending_refill;
+    // Tags of all lines, indexed by set and then way
+    std::vector<uint64_t> tags;
+    std::vector<cache_line_t> lines;
+    std::vector<uint8_t> lines_data;
 
     vp::ClockEvent *fsm_event;
 
@@ -102,64 +165,260 @@ private:
     static void flush_line_addr_sync(vp::Block *_this, uint32_t addr);
 
     static vp::IoReqStatus req(vp::Block *__this, vp::IoReq *req, int port);
-    vp::IoReqStatus handle_req(vp::IoReq *req);
+    vp::IoReqStatus handle_req(vp::IoReq *req, bool *stalled);
     void check_state();
     static void fsm_handler(vp::Block *__this, vp::ClockEvent *event);
 
-    inline unsigned int getLineAddr(unsigned int addr) { return addr >> line_size_bits; }
-    inline unsigned int get_line_base(unsigned int addr) { return addr & ~((1 << line_size_bits) - 1); }
-    inline unsigned int get_tag(unsigned int addr) { return addr >> (line_size_bits + nb_sets_bits); }
-    inline unsigned int get_line_index(unsigned int addr) { return (addr >> (line_size_bits)) & ((1 << nb_sets_bits) - 1); }
-    inline unsigned int get_line_offset(unsigned int addr) { return addr & ((1 << line_size_bits) - 1); }
-    inline unsigned int getAddr(unsigned int index, unsigned int tag) { return (tag << (line_size_bits + nb_sets_bits)) | (index << line_size_bits); }
+    inline uint64_t get_line_base(uint64_t addr) { return addr & ~((uint64_t)line_size - 1); }
+    inline unsigned int get_line_index(uint64_t tag) { return tag & (nb_sets - 1); }
 
-    cache_line_t *refill(int line_index, unsigned int addr, unsigned int tag, vp::IoReq *req, bool *pending);
+    // Get the way holding the specified tag in a set, or -1 if there is none
+    inline int get_way(unsigned int line_index, uint64_t tag);
+    cache_line_t *refill(int line_index, uint64_t addr, uint64_t tag, vp::IoReq *req, bool *pending, bool *stalled);
     static void refill_response(vp::Block *__this, vp::IoReq *req);
-    cache_line_t *get_line(vp::IoReq *req, unsigned int *line_index, unsigned int *tag);
+    void access_line(vp::IoReq *req, cache_line_t *line);
+    CacheMshr *get_mshr(uint64_t tag);
+    CacheMshr *alloc_mshr();
+
+    // Replacement policy
+    int get_victim(unsigned int line_index);
+    void touch(unsigned int line_index, int way);
+    unsigned int step_lfsr();
+    void update_stats();
 
-    unsigned int stepLru();
-    bool ioReq(vp::IoReq *req, int i);
     void enable(bool enable);
     void flush();
-    void flush_line(unsigned int addr);
+    void flush_line(uint64_t addr);
 };
 
-void Cache::refill_response(vp::Block *__this, vp::IoReq *req)
+inline int Cache::get_way(unsigned int line_index, uint64_t tag)
 {
-    Cache *_this = (Cache *)__this;
+    uint64_t *set_tags = &this->tags[line_index * this->nb_ways];
+    int way = -1;
 
-    vp::IoReq *pending_req = (vp::IoReq *)_this->refill_pending_reqs.pop();
+    // No early exit, so that the comparisons can be vectorized
+    for (unsigned int i = 0; i < this->nb_ways; i++)
+    {
+        way = set_tags[i] == tag ? i : way;
+    }
+
+    return way;
+}
+
+CacheMshr *Cache::get_mshr(uint64_t tag)
+{
+    for (CacheMshr &mshr : this->mshrs)
+    {
+        if (mshr.pending && mshr.tag == tag)
+        {
+            return &mshr;
+        }
+    }
+    return NULL;
+}
+
+CacheMshr *Cache::alloc_mshr()
+{
+    // Take the MSHR which is free the earliest, so that synchronous refills are serialized
+    // on the MSHRs like asynchronous ones
+    CacheMshr *result = NULL;
+    for (CacheMshr &mshr : this->mshrs)
+    {
+        if (!mshr.pending && !mshr.dropped && (result == NULL || mshr.ready < result->ready))
+        {
+            result = &mshr;
+        }
+    }
+    return result;
+}
 
-    pending_req->restore();
-    uint8_t *data = pending_req->get_data();
-    bool is_write = req->get_is_write();
-    uint64_t size = pending_req->get_size();
+unsigned int Cache::step_lfsr()
+{
+    int linear_feedback = !(((this->lfsr >> 7) & 1) ^ ((this->lfsr >> 3) & 1) ^ ((this->lfsr >> 2) & 1) ^ ((this->lfsr >> 1) & 1)); // TAPS for XOR feedback
 
-    _this->trace.msg(vp::Trace::LEVEL_TRACE, "Received refill response (req: %p, is_write: %d, data: %p, size: 0x%x)\n",
-                     pending_req, is_write, data, size);
+    this->lfsr = (this->lfsr << 1) | (linear_feedback & 1);
 
-    _this->pending_refill.set(0);
+    return (this->lfsr >> 1) & (this->nb_ways - 1);
+}
 
-    if (data)
+int Cache::get_victim(unsigned int line_index)
+{
+    cache_line_t *set_lines = &this->lines[line_index * this->nb_ways];
+    int way;
+
+    if (this->repl_policy == CACHE_REPL_LFSR)
+    {
+        way = this->step_lfsr() % this->nb_ways;
+    }
+    else
     {
-        unsigned int line_index;
-        unsigned int tag;
-        cache_line_t *line = _this->refill_line;
+        // Invalid lines are always taken first, except with the LFSR which models a
+        // hardware policy
+        uint64_t *set_tags = &this->tags[line_index * this->nb_ways];
+        way = -1;
+        for (unsigned int i = 0; i < this->nb_ways; i++)
+        {
+            way = set_tags[i] == CACHE_TAG_INVALID && !set_lines[i].refilling ? i : way;
+        }
 
-        line->tag = _this->refill_tag;
+        if (way == -1)
+        {
+            switch (this->repl_policy)
+            {
+                case CACHE_REPL_LRU:
+                {
+                    uint64_t *stamps = &this->lru_stamps[line_index * this->nb_ways];
+                    way = 0;
+                    for (unsigned int i = 1; i < this->nb_ways; i++)
+                    {
+                        way = stamps[i] < stamps[way] ? i : way;
+                    }
+                    break;
+                }
+
+                case CACHE_REPL_PLRU:
+                {
+                    // Follow the tree bits from the root, each one points to the least recently
+                    // used half
+                    uint64_t tree = this->plru_trees[line_index];
+                    int node = 0;
+                    way = 0;
+                    for (unsigned int i = 0; i < this->nb_ways_bits; i++)
+                    {
+                        int bit = (tree >> node) & 1;
+                        way = (way << 1) | bit;
+                        node = 2 * node + 1 + bit;
+                    }
+                    break;
+                }
+
+                default:
+                {
+                    // xorshift64
+                    this->random_state ^= this->random_state << 13;
+                    this->random_state ^= this->random_state >> 7;
+                    this->random_state ^= this->random_state << 17;
+                    way = this->random_state & (this->nb_ways - 1);
+                    break;
+                }
+            }
+        }
+    }
 
-        if (!is_write)
+    // A line being refilled can not be evicted, take another one in this case
+    if (set_lines[way].refilling)
+    {
+        way = -1;
+        for (unsigned int i = 0; i < this->nb_ways; i++)
         {
-            memcpy(data, (void *)line->data, size);
+            if (!set_lines[i].refilling)
+            {
+                way = i;
+                break;
+            }
+        }
+    }
+
+    return way;
+}
+
+void Cache::touch(unsigned int line_index, int way)
+{
+    if (this->repl_policy == CACHE_REPL_LRU)
+    {
+        this->lru_stamps[line_index * this->nb_ways + way] = ++this->lru_counter;
+    }
+    else if (this->repl_policy == CACHE_REPL_PLRU)
+    {
+        // Make each tree bit on the path point to the other half
+        uint64_t tree = this->plru_trees[line_index];
+        int node = 0;
+        for (int i = this->nb_ways_bits - 1; i >= 0; i--)
+        {
+            int bit = (way >> i) & 1;
+            tree = (tree & ~(1ULL << node)) | ((uint64_t)!bit << node);
+            node = 2 * node + 1 + bit;
+        }
+        this->plru_trees[line_index] = tree;
+    }
+}
+
+void Cache::update_stats()
+{
+    this->hits_event.event((uint8_t *)&this->nb_hits);
+    this->misses_event.event((uint8_t *)&this->nb_misses);
+    this->evictions_event.event((uint8_t *)&this->nb_evictions);
+}
+
+void Cache::access_line(vp::IoReq *req, cache_line_t *line)
+{
+    uint8_t *data = req->get_data();
+    if (data)
+    {
+        uint8_t *line_data = line->data + (req->get_addr() & (this->line_size - 1));
+        if (!req->get_is_write())
+        {
+            memcpy(data, line_data, req->get_size());
         }
         else
         {
-            // hitLine->setDirty();
-            memcpy((void *)line->data, data, size);
+            memcpy(line_data, data, req->get_size());
+        }
+    }
+}
+
+void Cache::refill_response(vp::Block *__this, vp::IoReq *req)
+{
+    Cache *_this = (Cache *)__this;
+    CacheMshr *mshr = NULL;
+
+    for (CacheMshr &current : _this->mshrs)
+    {
+        if (&current.req == req)
+        {
+            mshr = &current;
+            break;
         }
     }
 
-    pending_req->get_resp_port()->resp(pending_req);
+    if (mshr == NULL)
+    {
+        _this->trace.force_warning("Received response for unknown refill request (req: %p)\n", req);
+        return;
+    }
+
+    // The refill was dropped by a reset, the line and the waiting requests do not exist anymore
+    if (mshr->dropped || !mshr->pending)
+    {
+        _this->trace.msg(vp::Trace::LEVEL_TRACE, "Ignoring stale refill response (tag: 0x%lx, line_index: %d)\n",
+                         mshr->tag, mshr->line_index);
+        mshr->dropped = false;
+        _this->check_state();
+        return;
+    }
+
+    _this->trace.msg(vp::Trace::LEVEL_TRACE, "Received refill response (tag: 0x%lx, line_index: %d)\n",
+                     mshr->tag, mshr->line_index);
+
+    cache_line_t *line = mshr->line;
+    _this->tags[line - _this->lines.data()] = mshr->tag;
+    line->refilling = false;
+    line->timestamp = -1;
+
+    mshr->pending = false;
+    _this->nb_pending_mshrs--;
+
+    while (!mshr->waiting_reqs->empty())
+    {
+        vp::IoReq *pending_req = (vp::IoReq *)mshr->waiting_reqs->pop();
+        pending_req->restore();
+
+        _this->trace.msg(vp::Trace::LEVEL_TRACE, "Replying to pending req (req: %p, is_write: %d, offset: 0x%lx, size: 0x%lx)\n",
+                         pending_req, pending_req->get_is_write(), pending_req->get_addr(), pending_req->get_size());
+
+        _this->access_line(pending_req, line);
+        pending_req->get_resp_port()->resp(pending_req);
+    }
 
     _this->check_state();
 }
@@ -167,16 +426,26 @@ void Cache::refill_response(vp::Block *__this, vp::IoReq *req)
 void Cache::fsm_handler(vp::Block *__this, vp::ClockEvent *event)
 {
     Cache *_this = (Cache *)__this;
-    if (!_this->pending_refill.get() && !_this->refill_pending_reqs.empty())
+    if (!_this->stalled_reqs.empty())
     {
-        vp::IoReq *req = (vp::IoReq *)_this->refill_pending_reqs.pop();
+        vp::IoReq *req = (vp::IoReq *)_this->stalled_reqs.pop();
         req->restore();
-        _this->trace.msg(vp::Trace::LEVEL_TRACE, "Resuming req (req: %p, is_write: %d, offset: 0x%x, size: 0x%x)\n",
+        _this->trace.msg(vp::Trace::LEVEL_TRACE, "Resuming req (req: %p, is_write: %d, offset: 0x%lx, size: 0x%lx)\n",
                          req, req->get_is_write(), req->get_addr(), req->get_size());
-        if (_this->handle_req(req) == vp::IO_REQ_OK)
+        bool stalled = false;
+        _this->resuming = true;
+        vp::IoReqStatus status = _this->handle_req(req, &stalled);
+        _this->resuming = false;
+        if (status == vp::IO_REQ_OK || status == vp::IO_REQ_INVALID)
         {
             req->get_resp_port()->resp(req);
         }
+
+        // If it is stalled again, we will be woken up by the next refill response
+        if (stalled)
+        {
+            return;
+        }
     }
 
     _this->check_state();
@@ -184,7 +453,7 @@ void Cache::fsm_handler(vp::Block *__this, vp::ClockEvent *event)
 
 void Cache::check_state()
 {
-    if (!this->pending_refill.get() && !this->refill_pending_reqs.empty())
+    if (!this->stalled_reqs.empty() && this->nb_pending_mshrs < (int)this->mshrs.size())
     {
         if (!this->fsm_event->is_enqueued())
         {
@@ -193,70 +462,76 @@ void Cache::check_state()
     }
 }
 
-cache_line_t *Cache::refill(int line_index, unsigned int addr, unsigned int tag, vp::IoReq *req, bool *pending)
+cache_line_t *Cache::refill(int line_index, uint64_t addr, uint64_t tag, vp::IoReq *req, bool *pending, bool *stalled)
 {
-    // The cache supports only 1 refill at the same time.
-    // If a refill occurs while another one is already pending, just enqueue the request and return.
-    if (this->pending_refill.get())
+    // Secondary miss, the request is handled when the pending refill is over
+    CacheMshr *mshr = this->get_mshr(tag);
+    if (mshr)
+    {
+        this->trace.msg(vp::Trace::LEVEL_DEBUG, "Line already being refilled (tag: 0x%lx)\n", tag);
+        req->save();
+        mshr->waiting_reqs->push_back(req);
+        *pending = true;
+        return NULL;
+    }
+
+    mshr = this->alloc_mshr();
+    int way = mshr ? this->get_victim(line_index) : -1;
+    if (way == -1)
     {
+        this->trace.msg(vp::Trace::LEVEL_DEBUG, "Stalling request, no MSHR or way available\n");
         req->save();
-        this->refill_pending_reqs.push_back(req);
+        if (this->resuming)
+            this->stalled_reqs.push_front(req);
+        else
+            this->stalled_reqs.push_back(req);
         *pending = true;
+        *stalled = true;
         return NULL;
     }
 
-    unsigned int refillWay;
+    this->nb_misses++;
+
+    unsigned int line_id = line_index * this->nb_ways + way;
+    cache_line_t *line = &this->lines[line_id];
 
-#if 1
-    refillWay = this->stepLru() % this->nb_ways;
-#else
-    int electedAge = 0;
-    int elected = -1;
-    // Go through all lines to find the oldest one
-    // At the same, decrease the age for everyone
-    for (int i = 0; i < 1 << cache->nb_ways_bits; i++)
+    if (this->tags[line_id] != CACHE_TAG_INVALID)
     {
-        if (elected == -1 || linesAge[i] < electedAge)
-        {
-            electedAge = linesAge[i];
-            elected = i;
-        }
-        if (linesAge[i])
-            linesAge[i]--;
+        this->nb_evictions++;
     }
-    // Set age of elected one to the max
-    linesAge[elected] = (1 << cache->nb_ways_bits) - 1;
-    refillWay = elected;
-#endif
+    this->tags[line_id] = CACHE_TAG_INVALID;
 
-    cache_line_t *line = &this->lines[line_index * this->nb_ways + refillWay];
+    this->update_stats();
+    this->touch(line_index, way);
 
-    uint32_t full_addr = (this->get_line_base(addr << this->refill_shift) + this->add_offset);
+    uint64_t full_addr = this->get_line_base(addr << this->refill_shift) + this->add_offset;
 
-    this->trace.msg(vp::Trace::LEVEL_DEBUG, "Refilling line (addr: 0x%x, index: %d)\n", full_addr, line_index);
-    // Flush the line in case it is dirty to copy it back outside
-    // flush();
+    this->trace.msg(vp::Trace::LEVEL_DEBUG, "Refilling line (addr: 0x%lx, index: %d, way: %d)\n", full_addr, line_index, way);
 
     line->tag_event.event((uint8_t *)&full_addr);
 
     // And get the data from outside
-    vp::IoReq *refill_req = &this->refill_req;
+    vp::IoReq *refill_req = &mshr->req;
     refill_req->init();
     refill_req->set_addr(full_addr);
     refill_req->set_is_write(false);
-    refill_req->set_size(1 << this->line_size_bits);
+    refill_req->set_size(this->line_size);
     refill_req->set_data(line->data);
 
+    mshr->tag = tag;
+    mshr->line_index = line_index;
+    mshr->line = line;
+
     vp::IoReqStatus err = this->refill_itf.req(refill_req);
     if (err != vp::IO_REQ_OK)
     {
         if (err == vp::IO_REQ_PENDING)
         {
             req->save();
-            this->refill_pending_reqs.push_front(req);
-            this->refill_line = line;
-            this->refill_tag = tag;
-            this->pending_refill.set(1);
+            mshr->waiting_reqs->push_back(req);
+            mshr->pending = true;
+            this->nb_pending_mshrs++;
+            line->refilling = true;
             *pending = true;
             return NULL;
         }
@@ -266,55 +541,47 @@ cache_line_t *Cache::refill(int line_index, unsigned int addr, unsigned int tag,
         }
     }
 
-    line->tag = tag;
+    this->tags[line_id] = tag;
 
     if (!req->is_debug())
     {
-        // This cache supports only one refill at the same time. Since we allow
-        // synchronous request responses, make sure we report the delay in the latency
-        // in case the cache is still supposed to be reilling a line.
+        // Synchronous refills are serialized on the MSHRs, so report the time the refill
+        // has to wait for an MSHR in the latency
+        int64_t cycles = this->clock.get_cycles();
         int64_t latency = 0;
-        if (this->clock.get_cycles() < this->refill_timestamp)
+        if (cycles < mshr->ready)
         {
-            latency += this->refill_timestamp - this->clock.get_cycles();
+            latency += mshr->ready - cycles;
         }
 
         latency += refill_req->get_full_latency() + this->refill_latency;
 
-        this->refill_timestamp = this->clock.get_cycles() + latency;
+        mshr->ready = cycles + latency;
 
         req->inc_latency(latency);
 
-        line->timestamp = this->clock.get_cycles() + latency;
+        line->timestamp = cycles + latency;
     }
 
     return line;
 }
 
-void Cache::flush_line(unsigned int addr)
+void Cache::flush_line(uint64_t addr)
 {
-    this->trace.msg(vp::Trace::LEVEL_INFO, "Flushing cache line (addr: 0x%x)\n", addr);
-    unsigned int tag = addr >> this->line_size_bits;
-    unsigned int line_index = this->get_line_index(addr);
-    for (int i = 0; i < this->nb_ways; i++)
+    this->trace.msg(vp::Trace::LEVEL_INFO, "Flushing cache line (addr: 0x%lx)\n", addr);
+    uint64_t tag = addr >> this->line_size_bits;
+    unsigned int line_index = this->get_line_index(tag);
+    int way = this->get_way(line_index, tag);
+    if (way != -1)
     {
-        cache_line_t *line = &this->lines[line_index * this->nb_ways + i];
-        if (line->tag == tag)
-            line->tag = -1;
+        this->tags[line_index * this->nb_ways + way] = CACHE_TAG_INVALID;
     }
 }
 
 void Cache::flush()
 {
     this->trace.msg(vp::Trace::LEVEL_INFO, "Flushing whole cache\n");
-    for (int i = 0; i < this->nb_sets; i++)
-    {
-        for (int j = 0; j < this->nb_ways; j++)
-        {
-            this->lines[i * this->nb_ways + j].tag = -1;
-            ;
-        }
-    }
+    std::fill(this->tags.begin(), this->tags.end(), CACHE_TAG_INVALID);
 
     if (this->flush_ack_itf.is_bound())
     {
@@ -331,57 +598,24 @@ void Cache::enable(bool enable)
         this->trace.msg(vp::Trace::LEVEL_INFO, "Disabling cache\n");
 }
 
-cache_line_t *Cache::get_line(vp::IoReq *req, unsigned int *line_index, unsigned int *tag)
+vp::IoReqStatus Cache::handle_req(vp::IoReq *req, bool *stalled)
 {
     uint64_t offset = req->get_addr();
-    uint8_t *data = req->get_data();
-    uint64_t size = req->get_size();
-    bool is_write = req->get_is_write();
-
-    unsigned int nb_sets = this->nb_sets;
-    unsigned int nb_ways = this->nb_ways;
-    unsigned int line_size = 1 << this->line_size_bits;
-
-    *tag = offset >> this->line_size_bits;
-    *line_index = *tag & (nb_sets - 1);
-    unsigned int line_offset = offset & (line_size - 1);
+    uint64_t tag = offset >> this->line_size_bits;
+    unsigned int line_index = this->get_line_index(tag);
 
-    cache_line_t *hit_line = NULL;
+    this->trace.msg(vp::Trace::LEVEL_TRACE, "Cache access (is_write: %d, offset: 0x%lx, size: 0x%lx, tag: 0x%lx, line_index: %d, line_offset: 0x%lx)\n",
+        req->get_is_write(), offset, req->get_size(), tag, line_index, offset & (this->line_size - 1));
 
-    this->trace.msg(vp::Trace::LEVEL_TRACE, "Cache access (is_write: %d, offset: 0x%x, size: 0x%x, tag: 0x%x, line_index: %d, line_offset: 0x%x)\n", is_write, offset, size, offset, *line_index, line_offset);
+    cache_line_t *hit_line;
+    int way = this->get_way(line_index, tag);
 
-    cache_line_t *line = &this->lines[*line_index * nb_ways];
-
-    for (int i = 0; i < nb_ways; i++)
-    {
-        if (line->tag == *tag)
-        {
-            this->trace.msg(vp::Trace::LEVEL_TRACE, "Cache hit (way: %d)\n", i);
-            hit_line = line;
-            break;
-        }
-        line++;
-    }
-
-    return hit_line;
-}
-
-vp::IoReqStatus Cache::handle_req(vp::IoReq *req)
-{
-    unsigned int line_index;
-    unsigned int tag;
-    uint64_t offset = req->get_addr();
-    uint8_t *data = req->get_data();
-    uint64_t size = req->get_size();
-    bool is_write = req->get_is_write();
-    cache_line_t *hit_line = this->get_line(req, &line_index, &tag);
-
-    if (hit_line == NULL)
+    if (way == -1)
     {
         this->trace.msg(vp::Trace::LEVEL_DEBUG, "Cache miss\n");
         this->refill_event.event((uint8_t *)&offset);
         bool pending = false;
-        hit_line = this->refill(line_index, offset, tag, req, &pending);
+        hit_line = this->refill(line_index, offset, tag, req, &pending, stalled);
         if (hit_line == NULL)
         {
             if (pending)
@@ -392,6 +626,14 @@ vp::IoReqStatus Cache::handle_req(vp::IoReq *req)
     }
     else
     {
+        this->trace.msg(vp::Trace::LEVEL_TRACE, "Cache hit (way: %d)\n", way);
+
+        hit_line = &this->lines[line_index * this->nb_ways + way];
+
+        this->nb_hits++;
+        this->hits_event.event((uint8_t *)&this->nb_hits);
+        this->touch(line_index, way);
+
         // In case we hit the line, the line might have been refilled synchronously.
         // If so we need to apply the time taken by the refill.
         if (!req->is_debug())
@@ -403,18 +645,7 @@ vp::IoReqStatus Cache::handle_req(vp::IoReq *req)
         }
     }
 
-    if (data)
-    {
-        if (!is_write)
-        {
-            memcpy(data, (void *)hit_line->data, size);
-        }
-        else
-        {
-            // hitLine->setDirty();
-            memcpy((void *)hit_line->data, data, size);
-        }
-    }
+    this->access_line(req, hit_line);
 
     return vp::IO_REQ_OK;
 }
@@ -424,11 +655,9 @@ vp::IoReqStatus Cache::req(vp::Block *__this, vp::IoReq *req, int port)
     Cache *_this = (Cache *)__this;
 
     uint64_t offset = req->get_addr();
-    uint8_t *data = req->get_data();
-    uint64_t size = req->get_size();
-    bool is_write = req->get_is_write();
 
-    _this->trace.msg(vp::Trace::LEVEL_TRACE, "Received req (req: %p, port: %d, is_write: %d, offset: 0x%x, size: 0x%x)\n", req, port, is_write, offset, size);
+    _this->trace.msg(vp::Trace::LEVEL_TRACE, "Received req (req: %p, port: %d, is_write: %d, offset: 0x%lx, size: 0x%lx)\n",
+        req, port, req->get_is_write(), offset, req->get_size());
 
     if (!_this->enabled)
     {
@@ -438,32 +667,8 @@ vp::IoReqStatus Cache::req(vp::Block *__this, vp::IoReq *req, int port)
 
     _this->io_event[port].event((uint8_t *)&offset);
 
-    return _this->handle_req(req);
-}
-
-unsigned int Cache::stepLru()
-{
-    if (1)
-    {
-        // 8 bits LFSR used on GAP FC icache
-        int linear_feedback = !(((this->lru_out >> 7) & 1) ^ ((this->lru_out >> 3) & 1) ^ ((this->lru_out >> 2) & 1) ^ ((this->lru_out >> 1) & 1)); // TAPS for XOR feedback
-
-        this->lru_out = (this->lru_out << 1) | (linear_feedback & 1);
-
-        int way = (this->lru_out >> 1) & (this->nb_ways - 1);
-
-        return way;
-    }
-    else
-    {
-        unsigned int b1 = (((R1 & 0x00000008) >> 3) ^ ((R1 & 0x00001000) >> 12) ^ ((R1 & 0x00004000) >> 14) ^ ((R1 & 0x00008000) >> 15)) & 1;
-        unsigned int b2 = (((R2 & 0x00000008) >> 3) ^ ((R2 & 0x00001000) >> 12) ^ ((R2 & 0x00004000) >> 14) ^ ((R2 & 0x00008000) >> 15)) & 1;
-        R1 <<= 1;
-        R1 |= b1;
-        R2 <<= 1;
-        R2 |= b2;
-        return (((R2 & 0x00010000) >> 15) | ((R1 & 0x00010000) >> 16));
-    }
+    bool stalled = false;
+    return _this->handle_req(req, &stalled);
 }
 
 void Cache::enable_sync(vp::Block *__this, bool active)
@@ -492,26 +697,97 @@ void Cache::flush_line_addr_sync(vp::Block *__this, uint32_t addr)
     _this->flush_line_addr = addr;
 }
 
+void Cache::reset(bool active)
+{
+    if (active)
+    {
+        // Pending refills are dropped by the reset
+        for (CacheMshr &mshr : this->mshrs)
+        {
+            if (mshr.pending)
+            {
+                mshr.line->refilling = false;
+                mshr.dropped = true;
+            }
+            mshr.pending = false;
+            mshr.ready = 0;
+        }
+        this->nb_pending_mshrs = 0;
+
+        for (cache_line_t &line : this->lines)
+        {
+            line.timestamp = -1;
+        }
+
+        this->lfsr = 0;
+        this->random_state = 0x9e3779b97f4a7c15ULL;
+
+        this->nb_hits = 0;
+        this->nb_misses = 0;
+        this->nb_evictions = 0;
+    }
+}
+
+void Cache::stop()
+{
+    this->trace.msg(vp::Trace::LEVEL_INFO, "Cache statistics (hits: %ld, misses: %ld, evictions: %ld)\n",
+        this->nb_hits, this->nb_misses, this->nb_evictions);
+}
+
 Cache::Cache(vp::ComponentConf &config)
-    : vp::Component(config), refill_pending_reqs(this, "refill_queue"), pending_refill(*this, "refill", 0)
+    : vp::Component(config), stalled_reqs(this, "stalled_queue")
 {
-    this->nb_ports = this->get_js_config()->get_child_int("nb_ports");
-    this->nb_sets_bits = this->get_js_config()->get_child_int("nb_sets_bits");
-    this->nb_ways_bits = this->get_js_config()->get_child_int("nb_ways_bits");
-    this->line_size_bits = this->get_js_config()->get_child_int("line_size_bits");
+    js::Config *js_config = this->get_js_config();
+
+    this->nb_ports = js_config->get_child_int("nb_ports");
+    this->nb_sets_bits = js_config->get_child_int("nb_sets_bits");
+    this->nb_ways_bits = js_config->get_child_int("nb_ways_bits");
+    this->line_size_bits = js_config->get_child_int("line_size_bits");
     this->nb_ways = 1 << this->nb_ways_bits;
     this->nb_sets = 1 << this->nb_sets_bits;
     this->line_size = 1 << this->line_size_bits;
-    this->refill_latency = this->get_js_config()->get_child_int("refill_latency");
-    this->refill_shift = this->get_js_config()->get_child_int("refill_shift");
-    this->add_offset = this->get_js_config()->get_child_int("add_offset");
+    this->refill_latency = js_config->get_child_int("refill_latency");
+    this->refill_shift = js_config->get_child_int("refill_shift");
+    this->add_offset = js_config->get_int("add_offset");
 
-    this->input_itf.resize(this->nb_ports);
+    this->traces.new_trace("trace", &this->trace, vp::DEBUG);
+
+    int nb_mshrs = 1;
+    js::Config *mshrs_config = js_config->get("nb_mshrs");
+    if (mshrs_config)
+    {
+        nb_mshrs = mshrs_config->get_int();
+    }
+
+    std::string policy = "lfsr";
+    js::Config *policy_config = js_config->get("replacement");
+    if (policy_config)
+    {
+        policy = policy_config->get_str();
+    }
 
-    this->R1 = 0xd3b6;
-    this->R2 = 0x7775;
+    if (policy == "lfsr")
+        this->repl_policy = CACHE_REPL_LFSR;
+    else if (policy == "lru")
+        this->repl_policy = CACHE_REPL_LRU;
+    else if (policy == "plru")
+        this->repl_policy = CACHE_REPL_PLRU;
+    else if (policy == "random")
+        this->repl_policy = CACHE_REPL_RANDOM;
+    else
+    {
+        this->trace.fatal("Invalid replacement policy (policy: %s)\n", policy.c_str());
+        return;
+    }
+
+    // PLRU tree bits of a set must fit a 64 bits word
+    if (nb_mshrs <= 0 || this->nb_ways_bits > 6)
+    {
+        this->trace.fatal("Invalid cache configuration (nb_mshrs: %d, nb_ways: %d)\n", nb_mshrs, this->nb_ways);
+        return;
+    }
 
-    this->lru_out = 0;
+    this->input_itf.resize(this->nb_ports);
 
     for (int i = 0; i < nb_ports; i++)
     {
@@ -521,8 +797,6 @@ Cache::Cache(vp::ComponentConf &config)
 
     this->new_slave_port("input", &this->input_itf[0]);
 
-    this->traces.new_trace("trace", &this->trace, vp::DEBUG);
-
     this->enable_itf.set_sync_meth(Cache::enable_sync);
     this->new_slave_port("enable", &this->enable_itf);
 
@@ -544,31 +818,54 @@ Cache::Cache(vp::ComponentConf &config)
 
     for (int i = 0; i < this->nb_ports; i++)
     {
-        traces.new_trace_event("port_" + std::to_string(i), &this->io_event[i], 32);
+        traces.new_trace_event("port_" + std::to_string(i), &this->io_event[i], 64);
+    }
+
+    traces.new_trace_event("refill", &this->refill_event, 64);
+    traces.new_trace_event("stats/hits", &this->hits_event, 64);
+    traces.new_trace_event("stats/misses", &this->misses_event, 64);
+    traces.new_trace_event("stats/evictions", &this->evictions_event, 64);
+
+    this->mshrs.resize(nb_mshrs);
+    for (int i = 0; i < nb_mshrs; i++)
+    {
+        this->mshrs[i].pending = false;
+        this->mshrs[i].dropped = false;
+        this->mshrs[i].ready = 0;
+        this->mshrs[i].waiting_reqs = new vp::Queue(this, "mshr_" + std::to_string(i));
     }
+    this->nb_pending_mshrs = 0;
 
-    traces.new_trace_event("refill", &this->refill_event, 32);
+    this->tags.resize(this->nb_sets * this->nb_ways, CACHE_TAG_INVALID);
+    this->lines.resize(this->nb_sets * this->nb_ways);
+    this->lines_data.resize(this->nb_sets * this->nb_ways * this->line_size);
 
-    lines = new cache_line_t[(1 << this->nb_sets_bits) * this->nb_ways];
-    for (int i = 0; i < 1 << this->nb_sets_bits; i++)
+    if (this->repl_policy == CACHE_REPL_LRU)
     {
-        for (int j = 0; j < this->nb_ways; j++)
+        this->lru_stamps.resize(this->nb_sets * this->nb_ways, 0);
+        this->lru_counter = 0;
+    }
+    else if (this->repl_policy == CACHE_REPL_PLRU)
+    {
+        this->plru_trees.resize(this->nb_sets, 0);
+    }
+
+    for (unsigned int i = 0; i < this->nb_sets; i++)
+    {
+        for (unsigned int j = 0; j < this->nb_ways; j++)
         {
-            cache_line_t *line = &lines[i * this->nb_ways + j];
+            cache_line_t *line = &this->lines[i * this->nb_ways + j];
             line->timestamp = -1;
-            line->tag = -1;
-            line->data = new uint8_t[1 << this->line_size_bits];
-            traces.new_trace_event("set_" + std::to_string(j) + "/line_" + std::to_string(i), &line->tag_event, 32);
+            line->refilling = false;
+            line->data = &this->lines_data[(i * this->nb_ways + j) * this->line_size];
+            traces.new_trace_event("set_" + std::to_string(j) + "/line_" + std::to_string(i), &line->tag_event, 64);
         }
     }
 
-    this->refill_timestamp = -1;
-    this->line_index_mask = (1 << this->nb_sets_bits) - 1;
-    this->line_offset_mask = (1 << this->line_size_bits) - 1;
-
     this->fsm_event = this->event_new(Cache::fsm_handler);
 
-    this->trace.msg(vp::Trace::LEVEL_INFO, "Instantiating cache (nb_sets: %d, nb_ways: %d, line_size: %d)\n", 1 << this->nb_sets_bits, this->nb_ways, 1 << this->line_size_bits);
+    this->trace.msg(vp::Trace::LEVEL_INFO, "Instantiating cache (nb_sets: %d, nb_ways: %d, line_size: %d, nb_mshrs: %d, replacement: %s)\n",
+        this->nb_sets, this->nb_ways, this->line_size, nb_mshrs, policy.c_str());
 }
 
 extern "C" vp::Component *gv_new(vp::ComponentConf &config)
@@ -255,9 +255,9 @@ void emulation::access(gv::Io_request *req)
     // MEMINFO
     else if (req->type == 7)
     {
-        this->time.get_engine()->lock();
-        this->meminfo[0].sync_back((void **)&req->data);
-        this->time.get_engine()->unlock();
+        this->time.get_engine()->post_sync([this, req]() {
+            this->meminfo[0].sync_back((void **)&req->data);
+        });
     }
     // CORE ID
     else if (req->type == 8)
@@ -283,9 +283,10 @@ void emulation::access(gv::Io_request *req)
         this->core_req.set_is_write(req->type == gv::Io_request_write);
         this->core_req.set_data(req->data);
 
-        this->time.get_engine()->lock();
-        int err = this->data.req(&this->core_req);
-        this->time.get_engine()->unlock();
+        int err;
+        this->time.get_engine()->post_sync([this, &err]() {
+            err = this->data.req(&this->core_req);
+        });
 
         if (err == vp::IO_REQ_OK || err == vp::IO_REQ_INVALID)
         {
@@ -313,9 +314,9 @@ void emulation::sync_state(std::unique_lock<std::mutex> &lock)
         this->pending_irq = -1;
 
         lock.unlock();
-        this->time.get_engine()->lock();
-        this->irq_ack_itf.sync(irq);
-        this->time.get_engine()->unlock();
+        this->time.get_engine()->post_sync([this, irq]() {
+            this->irq_ack_itf.sync(irq);
+        });
 
         if (handler)
         {
@@ -80,6 +80,8 @@ public:
     void start();
     void reset(bool active);
     virtual void target_open();
+    bool stop_condition_arm(vp::StopCondition *condition) override;
+    void stop_condition_disarm(vp::StopCondition *condition) override;
 
     Iss iss;
 
@@ -92,6 +92,11 @@ public:
     static void exec_instr(vp::Block *__this, vp::ClockEvent *event);
     static void exec_instr_untimed(vp::Block *__this, vp::ClockEvent *event);
     static void exec_instr_check_all(vp::Block *__this, vp::ClockEvent *event);
+    // Same as exec_instr_check_all but also counts instructions for trace triggers
+    static void exec_instr_trigger(vp::Block *__this, vp::ClockEvent *event);
+
+    // Handler installed when switching to full mode
+    vp::ClockEventMeth *full_mode_callback = &Exec::exec_instr_check_all;
 
     void hwloop_set_start(int index, iss_reg_t pc);
     void hwloop_set_end(int index, iss_reg_t pc);
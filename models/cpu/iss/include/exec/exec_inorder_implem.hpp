@@ -110,7 +110,8 @@ inline bool Exec::can_switch_to_fast_mode()
 #ifdef VP_TRACE_ACTIVE
     return false;
 #else
-    return !(this->iss.csr.pcmr & CSR_PCMR_ACTIVE);
+    return !(this->iss.csr.pcmr & CSR_PCMR_ACTIVE) &&
+        this->full_mode_callback == &Exec::exec_instr_check_all;
 #endif
 }
 
@@ -172,7 +173,7 @@ inline void Exec::insn_exec_power(iss_insn_t *insn)
 
 inline void Exec::switch_to_full_mode()
 {
-    this->instr_event->set_callback(&Exec::exec_instr_check_all);
+    this->instr_event->set_callback(this->full_mode_callback);
 }
 
 
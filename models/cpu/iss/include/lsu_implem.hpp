@@ -90,6 +90,9 @@ inline void Lsu::load_signed(iss_insn_t *insn, iss_addr_t addr, int size, int re
 
 inline void Lsu::store(iss_insn_t *insn, iss_addr_t addr, int size, int reg)
 {
+    // Checked here so that triggers are evaluated by both fast and performance handlers
+    this->iss.trace.trigger_check_write(addr, size);
+
     iss_addr_t phys_addr;
     if (this->iss.mmu.store_virt_to_phys(addr, phys_addr))
     {
@@ -192,6 +195,8 @@ inline void Lsu::load_float(iss_insn_t *insn, iss_addr_t addr, int size, int reg
 
 inline void Lsu::store_float(iss_insn_t *insn, iss_addr_t addr, int size, int reg)
 {
+    this->iss.trace.trigger_check_write(addr, size);
+
     iss_addr_t phys_addr;
     if (this->iss.mmu.store_virt_to_phys(addr, phys_addr))
     {
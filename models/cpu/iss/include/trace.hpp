@@ -38,13 +38,48 @@ public:
     void insn_trace_callback();
     void dump_debug_traces();
 
+    // Trace window triggers evaluated by this core. They only cost something while they are
+    // armed: PC triggers are stubs inserted on the instruction, instruction count triggers
+    // replace the instruction handler and write triggers are checked on stores.
+    void triggers_init();
+    void decode_insn(iss_insn_t *insn, iss_addr_t pc);
+    void trigger_check_pc(iss_addr_t pc);
+    inline void trigger_check_write(iss_addr_t addr, int size);
+    void trigger_insn_account();
+
+    // Stop conditions of run-until requests, evaluated like trace triggers, except that
+    // they are armed and disarmed while the simulation is running
+    bool stop_condition_arm(vp::StopCondition *condition);
+    void stop_condition_disarm(vp::StopCondition *condition);
+
     bool dump_trace_enabled;
 
     vp::Trace insn_trace;
     iss_insn_arg_t saved_args[ISS_MAX_DECODE_ARGS];
     int priv_mode;
 
+    std::vector<std::pair<iss_addr_t, vp::TraceTrigger *>> pc_triggers;
+    std::vector<std::pair<iss_addr_t, vp::TraceTrigger *>> write_triggers;
+    std::vector<std::pair<int64_t, vp::TraceTrigger *>> insn_triggers;
+    std::vector<std::pair<iss_addr_t, vp::StopCondition *>> pc_stop_conditions;
+    // Instruction count stop conditions, with the value of insn_count where they are met
+    std::vector<std::pair<int64_t, vp::StopCondition *>> insn_stop_conditions;
+    // Number of instructions executed while instruction count triggers or stop conditions
+    // are armed
+    int64_t insn_count = 0;
+
 private:
+    void trigger_write_hit(iss_addr_t addr, int size);
+    // Install or remove the instruction handler counting instructions
+    void insn_count_update();
 
     Iss &iss;
 };
+
+inline void Trace::trigger_check_write(iss_addr_t addr, int size)
+{
+    if (unlikely(this->write_triggers.size() != 0))
+    {
+        this->trigger_write_hit(addr, size);
+    }
+}
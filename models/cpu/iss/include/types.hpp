@@ -400,6 +400,8 @@ typedef struct iss_insn_s
     iss_reg_t (*stall_fast_handler)(Iss *, iss_insn_t *, iss_reg_t);
     iss_reg_t (*breakpoint_saved_handler)(Iss *, iss_insn_t *, iss_reg_t);
     iss_reg_t (*breakpoint_saved_fast_handler)(Iss *, iss_insn_t *, iss_reg_t);
+    iss_reg_t (*trigger_saved_handler)(Iss *, iss_insn_t *, iss_reg_t);
+    iss_reg_t (*trigger_saved_fast_handler)(Iss *, iss_insn_t *, iss_reg_t);
     int size;
     int nb_out_reg;
     int nb_in_reg;
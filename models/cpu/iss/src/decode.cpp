@@ -266,6 +266,7 @@ int Decode::decode_insn(iss_insn_t *insn, iss_reg_t pc, iss_opcode_t opcode, iss
 
     this->iss.gdbserver.decode_insn(insn, pc);
     this->iss.exec.decode_insn(insn, pc);
+    this->iss.trace.decode_insn(insn, pc);
 
     if (item->u.insn.resource_id != -1)
     {
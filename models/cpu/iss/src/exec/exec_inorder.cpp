@@ -306,6 +306,26 @@ void Exec::exec_instr_check_all(vp::Block *__this, vp::ClockEvent *event)
 
 
 
+void Exec::exec_instr_trigger(vp::Block *__this, vp::ClockEvent *event)
+{
+    Iss *iss = (Iss *)__this;
+    Exec *_this = &iss->exec;
+
+    // Once all instruction count triggers are over, go back to the normal handler
+    if (_this->full_mode_callback != &Exec::exec_instr_trigger)
+    {
+        _this->instr_event->set_callback(&Exec::exec_instr_check_all);
+        Exec::exec_instr_check_all(__this, event);
+        return;
+    }
+
+    Exec::exec_instr_check_all(__this, event);
+
+    iss->trace.trigger_insn_account();
+}
+
+
+
 void Exec::clock_sync(vp::Block *__this, bool active)
 {
     Exec *_this = (Exec *)__this;
@@ -60,6 +60,16 @@ void IssWrapper::reset(bool active)
 #endif
 }
 
+bool IssWrapper::stop_condition_arm(vp::StopCondition *condition)
+{
+    return this->iss.trace.stop_condition_arm(condition);
+}
+
+void IssWrapper::stop_condition_disarm(vp::StopCondition *condition)
+{
+    this->iss.trace.stop_condition_disarm(condition);
+}
+
 IssWrapper::IssWrapper(vp::ComponentConf &config)
     : vp::Component(config), iss(*this)
 {
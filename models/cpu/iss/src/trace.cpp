@@ -20,6 +20,7 @@
  */
 
 #include "cpu/iss/include/iss.hpp"
+#include <vp/time/stop_condition.hpp>
 #include <string.h>
 #include <algorithm>
 #include <vector>
@@ -41,6 +42,7 @@ void Trace::build()
         iss_register_debug_info(&this->iss, x->get_str().c_str());
     }
 
+    this->triggers_init();
 }
 
 void Trace::reset(bool active)
@@ -99,6 +101,26 @@ static iss_pc_info *get_pc_info(unsigned int base)
     return pc_info;
 }
 
+// Get the address of the first instruction of a function, from the debug info
+static int iss_trace_symbol_addr(const char *name, iss_addr_t *addr)
+{
+    bool found = false;
+
+    for (int i=0; i<PC_INFO_ARRAY_SIZE; i++)
+    {
+        for (iss_pc_info *pc_info = pc_infos[i]; pc_info; pc_info = pc_info->next)
+        {
+            if (strcmp(pc_info->func, name) == 0 && (!found || pc_info->base < *addr))
+            {
+                *addr = pc_info->base;
+                found = true;
+            }
+        }
+    }
+
+    return found ? 0 : -1;
+}
+
 int iss_trace_pc_info(iss_addr_t addr, const char **func, const char **inline_func, const char **file, int *line)
 {
     iss_pc_info *info = get_pc_info(addr);
@@ -548,7 +570,7 @@ void iss_trace_dump(Iss *iss, iss_insn_t *insn, iss_reg_t pc)
         iss_trace_dump_insn(iss, insn, pc, buffer, 1024, iss->trace.saved_args,
             iss->top.traces.get_trace_engine()->get_format() == TRACE_FORMAT_LONG, iss->trace.priv_mode, 0);
 
-        iss->trace.insn_trace.msg(buffer);
+        iss->trace.insn_trace.msg("%s", buffer);
     }
 }
 
@@ -628,3 +650,216 @@ void Trace::insn_trace_callback()
     // to flush the ISS instruction cache, as it keeps the state of the trace
     iss_cache_flush(&this->iss);
 }
+
+
+static iss_reg_t trigger_check_exec(Iss *iss, iss_insn_t *insn, iss_reg_t pc)
+{
+    iss->trace.trigger_check_pc(pc);
+    return insn->trigger_saved_handler(iss, insn, pc);
+}
+
+static iss_reg_t trigger_check_exec_fast(Iss *iss, iss_insn_t *insn, iss_reg_t pc)
+{
+    iss->trace.trigger_check_pc(pc);
+    return insn->trigger_saved_fast_handler(iss, insn, pc);
+}
+
+void Trace::triggers_init()
+{
+    for (vp::TraceTrigger *trigger : this->iss.top.traces.get_trace_engine()->get_triggers(
+        this->iss.top.get_path()))
+    {
+        if (trigger->type == "pc" || trigger->type == "write")
+        {
+            iss_addr_t addr;
+            const char *value = trigger->value.c_str();
+
+            if (isdigit(value[0]))
+            {
+                addr = strtoull(value, NULL, 0);
+            }
+            else if (iss_trace_symbol_addr(value, &addr))
+            {
+                this->iss.top.get_trace()->fatal("Unknown symbol in trace trigger (symbol: %s)\n",
+                    value);
+                return;
+            }
+
+            if (trigger->type == "pc")
+            {
+                this->pc_triggers.push_back(std::make_pair(addr, trigger));
+            }
+            else
+            {
+                this->write_triggers.push_back(std::make_pair(addr, trigger));
+            }
+        }
+        else if (trigger->type == "insn")
+        {
+            this->insn_triggers.push_back(std::make_pair(strtoll(trigger->value.c_str(), NULL, 0),
+                trigger));
+        }
+    }
+
+    this->insn_count_update();
+}
+
+void Trace::insn_count_update()
+{
+    if (this->insn_triggers.size() != 0 || this->insn_stop_conditions.size() != 0)
+    {
+        // Instructions are only counted with a dedicated handler installed while there are
+        // instruction count triggers.
+        this->iss.exec.full_mode_callback = &Exec::exec_instr_trigger;
+        this->iss.exec.switch_to_full_mode();
+    }
+    else
+    {
+        // The instruction handler will switch back to the normal one
+        this->iss.exec.full_mode_callback = &Exec::exec_instr_check_all;
+    }
+}
+
+void Trace::decode_insn(iss_insn_t *insn, iss_addr_t pc)
+{
+    bool stub = false;
+
+    for (auto &x : this->pc_triggers)
+    {
+        stub |= x.first == pc;
+    }
+
+    for (auto &x : this->pc_stop_conditions)
+    {
+        stub |= x.first == pc;
+    }
+
+    if (stub)
+    {
+        insn->trigger_saved_handler = insn->handler;
+        insn->trigger_saved_fast_handler = insn->fast_handler;
+        insn->handler = trigger_check_exec;
+        insn->fast_handler = trigger_check_exec_fast;
+    }
+}
+
+bool Trace::stop_condition_arm(vp::StopCondition *condition)
+{
+    if (condition->config.type == gv::Stop_condition_pc)
+    {
+        this->pc_stop_conditions.push_back(std::make_pair(condition->config.value, condition));
+        // Instructions are decoded again so that the stub is inserted
+        iss_cache_flush(&this->iss);
+    }
+    else if (condition->config.type == gv::Stop_condition_insn)
+    {
+        this->insn_stop_conditions.push_back(std::make_pair(
+            this->insn_count + condition->config.value, condition));
+        this->insn_count_update();
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void Trace::stop_condition_disarm(vp::StopCondition *condition)
+{
+    for (auto it = this->pc_stop_conditions.begin(); it != this->pc_stop_conditions.end(); ++it)
+    {
+        if (it->second == condition)
+        {
+            this->pc_stop_conditions.erase(it);
+            // Remove the stub
+            iss_cache_flush(&this->iss);
+            return;
+        }
+    }
+
+    for (auto it = this->insn_stop_conditions.begin(); it != this->insn_stop_conditions.end(); ++it)
+    {
+        if (it->second == condition)
+        {
+            this->insn_stop_conditions.erase(it);
+            this->insn_count_update();
+            return;
+        }
+    }
+}
+
+void Trace::trigger_check_pc(iss_addr_t pc)
+{
+    // The stub stays on the instruction until it is decoded again, the trigger is just removed
+    // once it is over.
+    auto it = this->pc_triggers.begin();
+    while (it != this->pc_triggers.end())
+    {
+        if (it->first == pc && it->second->fire())
+        {
+            it = this->pc_triggers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Stop conditions stay armed until the end of the run-until request
+    for (auto &x : this->pc_stop_conditions)
+    {
+        if (x.first == pc)
+        {
+            x.second->hit();
+        }
+    }
+}
+
+void Trace::trigger_write_hit(iss_addr_t addr, int size)
+{
+    auto it = this->write_triggers.begin();
+    while (it != this->write_triggers.end())
+    {
+        if (it->first >= addr && it->first < addr + size && it->second->fire())
+        {
+            it = this->write_triggers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void Trace::trigger_insn_account()
+{
+    this->insn_count++;
+
+    auto it = this->insn_triggers.begin();
+    while (it != this->insn_triggers.end())
+    {
+        if (this->insn_count >= it->first && it->second->fire())
+        {
+            it = this->insn_triggers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (auto &x : this->insn_stop_conditions)
+    {
+        if (this->insn_count >= x.first)
+        {
+            x.second->hit();
+        }
+    }
+
+    if (this->insn_triggers.size() == 0 && this->insn_stop_conditions.size() == 0)
+    {
+        // The instruction handler will switch back to the normal one
+        this->iss.exec.full_mode_callback = &Exec::exec_instr_check_all;
+    }
+}
@@ -76,9 +76,9 @@ Jtag::Jtag(vp::ComponentConf &config)
 void Jtag::set_jtag_pads(int tck, int tms, int tdi, int trst)
 {
     //fprintf(stderr, "PADS sync (tck: %d, tms: %d, tdi: %d, trst: %d)\n", tck, tms, tdi, trst);
-    this->time.get_engine()->lock();
-    this->jtag_itf.sync(tck, tdi, tms, trst);
-    this->time.get_engine()->unlock();
+    this->time.get_engine()->post_sync([this, tck, tdi, tms, trst]() {
+        this->jtag_itf.sync(tck, tdi, tms, trst);
+    });
 }
 
 
@@ -303,7 +303,11 @@ void Uart::handle_received_byte(uint8_t byte)
 {
     if (this->proxy_file)
     {
-        this->top->proxy->send_payload(this->proxy_file, std::to_string(this->req), &byte, 1);
+        // The proxy connection is gone, stop forwarding to it
+        if (this->top->proxy->send_payload(this->proxy_file, std::to_string(this->req), &byte, 1))
+        {
+            this->proxy_file = NULL;
+        }
     }
     else if (this->is_control)
     {
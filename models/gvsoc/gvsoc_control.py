@@ -18,6 +18,43 @@ import socket
 import threading
 import socket
 import os
+import struct
+
+# Binary protocol, see gv::ProxyFrame in the engine
+_PROXY_BINARY_VERSION = 1
+_PROXY_FRAME = struct.Struct('<IIHHi')
+_PROXY_MEM_ACCESS = struct.Struct('<QQQQ')
+_PROXY_CMD_TEXT = 1
+_PROXY_CMD_MEM_READ = 2
+_PROXY_CMD_MEM_WRITE = 3
+_PROXY_CMD_SHM_MAP = 4
+_PROXY_CMD_BATCH = 5
+_PROXY_CMD_REPLY = 16
+_PROXY_CMD_PAYLOAD = 17
+_PROXY_CMD_NOTIFY = 18
+_PROXY_NOTIFY_STOPPED = 0
+_PROXY_NOTIFY_RUNNING = 1
+_PROXY_NOTIFY_EXIT = 2
+_PROXY_NOTIFY_CONDITION = 3
+_PROXY_FLAG_SHM = 1
+# Memory accesses from this size go through the shared memory window, if it is opened
+_PROXY_SHM_THRESHOLD = 4096
+# Maximum size of a memory access going through the frame payload, see GV_PROXY_MAX_MEM_ACCESS
+_PROXY_MAX_MEM_ACCESS = 16*1024*1024
+
+# Shared memory of router proxies, see gv::Io_shm_header in the engine
+_IO_SHM_MAGIC = b'GVIOSHM\0'
+_IO_SHM_VERSION = 1
+_IO_SHM_HEADER = struct.Struct('<8sIIQI')
+_IO_SHM_HEADER_SIZE = 192
+_IO_SHM_CLOSED = 24
+_IO_SHM_REQ_RING = 64
+_IO_SHM_RSP_RING = 128
+_IO_SHM_RING_HEAD = 0
+_IO_SHM_RING_TAIL = 8
+_IO_SHM_RING_SEQ = 16
+_IO_SHM_RING_NB_WAITING = 20
+_IO_SHM_ENTRY = struct.Struct('<QQQQqII')
 
 
 
@@ -30,6 +67,9 @@ class Proxy(object):
         a string giving the hostname where the proxy is running
     :param port: int,
         the port where to connect
+    :param binary: bool,
+        True if the binary protocol should be used. It allows pipelining and batching commands,
+        and bulk memory accesses through a shared memory window.
     """
 
     class _Socket_proxy_reader_thread(threading.Thread):
@@ -44,7 +84,15 @@ class Proxy(object):
             self.payloads = {}
             self.running = False
             self.timestamp = 0
+            # Index of the condition which ended the last run_until command, None while it is
+            # pending
+            self.stop_condition = None
+            # Text requests which were replied with an error
+            self.errors = set()
             self.exit_callback = None
+            # Request switching the connection to the binary protocol
+            self.switch_req = None
+            self.binary = False
 
         def __quit(self, status):
             self.lock.acquire()
@@ -56,7 +104,64 @@ class Proxy(object):
                 os._exit(status)
                 exit(status)
 
+        def __recv(self, size):
+            data = bytearray()
+            while len(data) < size:
+                chunk = self.socket.recv(size - len(data))
+                if not chunk:
+                    raise EOFError()
+                data += chunk
+            return data
+
+        def __push_payload(self, req, payload):
+            callback = self.matches.get('%s' % req)
+            if callback is not None:
+                callback[0](payload, *callback[1], **callback[2])
+
+            else:
+                self.lock.acquire()
+                self.payloads[req] = payload
+                self.condition.notify_all()
+                self.lock.release()
+
         def run(self):
+            if self.__run_text():
+                self.__run_binary()
+
+        def __run_binary(self):
+            while True:
+                try:
+                    size, req, cmd, flags, status = _PROXY_FRAME.unpack(self.__recv(_PROXY_FRAME.size))
+                    payload = self.__recv(size)
+                except:
+                    return
+
+                if cmd == _PROXY_CMD_NOTIFY:
+                    if flags == _PROXY_NOTIFY_EXIT:
+                        self.__quit(status)
+                    else:
+                        timestamp, = struct.unpack('<q', payload)
+                        self.lock.acquire()
+                        if flags == _PROXY_NOTIFY_STOPPED:
+                            self.timestamp = timestamp
+                            self.running = False
+                        elif flags == _PROXY_NOTIFY_CONDITION:
+                            self.stop_condition = timestamp
+                        else:
+                            self.running = True
+                        self.condition.notify_all()
+                        self.lock.release()
+
+                elif cmd == _PROXY_CMD_PAYLOAD:
+                    self.__push_payload(req, payload)
+
+                else:
+                    self.lock.acquire()
+                    self.replies[req] = (status, payload)
+                    self.condition.notify_all()
+                    self.lock.release()
+
+        def __run_text(self):
             while True:
                 reply = ""
                 try:
@@ -70,11 +175,12 @@ class Proxy(object):
                             break
                 except:
                     # self.__quit(-1)
-                    return
+                    return False
 
                 req = None
                 is_stop = None
                 is_run = None
+                stop_condition = None
                 msg = ""
                 err = None
                 err_msg = None
@@ -91,6 +197,8 @@ class Proxy(object):
                             is_stop = int(value.split('=')[1])
                         elif msg.find('running') == 0:
                             is_run = int(value.split('=')[1])
+                        elif msg.find('condition') == 0:
+                            stop_condition = int(value.split('=')[1])
 
                     elif name == 'err':
                         err = value
@@ -99,22 +207,7 @@ class Proxy(object):
                         err_msg = value
 
                     elif name == 'payload':
-                        callback = self.matches.get('%s' % req)
-                        if callback is not None:
-                            callback[0](*callback[1], **callback[2])
-
-                        else:
-
-                            payload = bytearray()
-                            size = int(value)
-                            while len(payload) < size:
-                                response = self.socket.recv(size - len(payload))
-                                payload += response
-
-                            self.lock.acquire()
-                            self.payloads[req] = payload
-                            self.condition.notify_all()
-                            self.lock.release()
+                        self.__push_payload(req, self.__recv(int(value)))
 
                 if req is None:
                     raise RuntimeError('Unknown reply: ' + req)
@@ -126,9 +219,20 @@ class Proxy(object):
                     self.running = False
                 elif is_run is not None:
                     self.running = True
+                elif stop_condition is not None:
+                    self.stop_condition = stop_condition
 
+                if err is not None:
+                    self.errors.add(req)
                 self.replies[req] = msg
                 self.condition.notify_all()
+
+                # Everything after the reply to the switch request is in binary format
+                if req == self.switch_req and err is None:
+                    self.binary = True
+                    self.lock.release()
+                    return True
+
                 self.lock.release()
 
         def _get_payload(self, req):
@@ -173,6 +277,14 @@ class Proxy(object):
                 self.condition.wait()
             self.lock.release()
 
+        def wait_stop_condition(self):
+            self.lock.acquire()
+            while self.stop_condition is None:
+                self.condition.wait()
+            stop_condition = self.stop_condition
+            self.lock.release()
+            return stop_condition
+
 
         def register_callback(self, req, callback, *kargs, **kwargs):
             match = '%s' % req
@@ -199,8 +311,13 @@ class Proxy(object):
             self.lock.release()
 
 
-    def __init__(self, host: str = 'localhost', port: int = 42951):
+    def __init__(self, host: str = 'localhost', port: int = 42951, binary: bool = True):
         self.req_id = 0
+        self.binary = False
+        self.shm = None
+        self.shm_lock = threading.Lock()
+        # Requests sent without waiting for their reply, checked by sync
+        self.pending = []
 
         self.lock = threading.Lock()
 
@@ -210,6 +327,17 @@ class Proxy(object):
         self.reader = self._Socket_proxy_reader_thread(self.socket)
         self.reader.start()
 
+        if binary:
+            self.lock.acquire()
+            req = self.req_id
+            self.req_id += 1
+            self.reader.switch_req = req
+            self.socket.sendall(('req=%d;cmd=binary %d\n' % (req, _PROXY_BINARY_VERSION)).encode('ascii'))
+            self.lock.release()
+
+            self.reader.wait_reply(req)
+            self.binary = self.reader.binary
+
     def _get_req(self):
         self.lock.acquire()
         req = self.req_id
@@ -218,20 +346,155 @@ class Proxy(object):
 
         return req
 
-    def _send_cmd(self, cmd, wait_reply=True, keep_lock=False):
+    def _send_cmd(self, cmd, wait_reply=True, keep_lock=False, data=None):
+        if self.binary:
+            payload = cmd.encode('ascii')
+            if data is not None:
+                payload += b'\0' + bytes(data)
+            return self._send_frame(_PROXY_CMD_TEXT, payload, wait_reply=wait_reply,
+                keep_lock=keep_lock)
+
         self.lock.acquire()
         req = self.req_id
         self.req_id += 1
         self.socket.send(('req=%d;cmd=%s\n' % (req, cmd)).encode('ascii'))
+        if data is not None:
+            self.socket.sendall(data)
 
         if not keep_lock:
             self.lock.release()
 
         if wait_reply:
-            return self.reader.wait_reply(req)
+            return self._wait_reply(req)
         else:
             return req
 
+    @staticmethod
+    def _frame(req, cmd, payload=b'', flags=0):
+        return _PROXY_FRAME.pack(len(payload), req, cmd, flags, 0) + payload
+
+    def _send_frame(self, cmd, payload=b'', flags=0, wait_reply=True, keep_lock=False):
+        self.lock.acquire()
+        req = self.req_id
+        self.req_id += 1
+        self.socket.sendall(self._frame(req, cmd, payload, flags))
+
+        if not keep_lock:
+            self.lock.release()
+
+        if wait_reply:
+            return self._wait_reply(req, cmd)
+        else:
+            return req
+
+    def _wait_reply(self, req, cmd=_PROXY_CMD_TEXT):
+        reply = self.reader.wait_reply(req)
+        if not self.binary:
+            return reply
+
+        status, payload = reply
+        if status != 0:
+            raise RuntimeError("Proxy command failed with status %d" % status)
+        if cmd == _PROXY_CMD_TEXT:
+            return payload.decode('utf-8')
+        return payload
+
+    def _post_frame(self, cmd, payload=b'', flags=0):
+        req = self._send_frame(cmd, payload, flags, wait_reply=False)
+        self.pending.append((req, cmd))
+
+    def sync(self):
+        """Wait until all the commands sent without waiting for their reply are done.
+
+        Commands can be pipelined by not waiting for their reply, which is only possible
+        with the binary protocol.
+
+        :raises: RuntimeError, if one of the commands failed.
+        """
+        pending = self.pending
+        self.pending = []
+        error = None
+        for req, cmd in pending:
+            try:
+                self._wait_reply(req, cmd)
+            except RuntimeError as e:
+                error = e
+        if error is not None:
+            raise error
+
+    def batch(self):
+        """Create a batch of commands.
+
+        The commands added to the batch are sent in a single packet and executed in order by
+        GVSOC, which only needs to lock the engine once for all of them. This requires the
+        binary protocol.
+
+        :return: ProxyBatch, The batch of commands.
+        """
+        if not self.binary:
+            raise RuntimeError("Batches require the binary protocol")
+        return ProxyBatch(self)
+
+    def shm_open(self, size: int):
+        """Open a shared memory window for bulk memory accesses.
+
+        Once it is opened, memory accesses big enough go through this window instead of the
+        socket. This requires the binary protocol.
+
+        :param size: int, The size of the window in bytes.
+        """
+        from multiprocessing import shared_memory
+
+        if not self.binary:
+            raise RuntimeError("Shared memory requires the binary protocol")
+
+        self.shm_close()
+        shm = shared_memory.SharedMemory(create=True, size=size)
+        self._send_frame(_PROXY_CMD_SHM_MAP,
+            struct.pack('<Q', size) + ('/dev/shm/' + shm.name).encode('utf-8'))
+        self.shm = shm
+
+    def shm_close(self):
+        """Close the shared memory window.
+        """
+        if self.shm is not None:
+            self._send_frame(_PROXY_CMD_SHM_MAP, struct.pack('<Q', 0))
+            self.shm.close()
+            self.shm.unlink()
+            self.shm = None
+
+    def _mem_access(self, component, is_write, addr, size, values=None, wait=True):
+        cmd = _PROXY_CMD_MEM_WRITE if is_write else _PROXY_CMD_MEM_READ
+        use_shm = wait and self.shm is not None and size >= _PROXY_SHM_THRESHOLD and \
+            size <= self.shm.size
+
+        if not use_shm and size > _PROXY_MAX_MEM_ACCESS:
+            result = b''
+            for offset in range(0, size, _PROXY_MAX_MEM_ACCESS):
+                chunk_size = min(_PROXY_MAX_MEM_ACCESS, size - offset)
+                chunk = self._mem_access(component, is_write, addr + offset, chunk_size,
+                    values[offset:offset+chunk_size] if is_write else None, wait=wait)
+                if not is_write:
+                    result += chunk
+            return None if is_write else result
+
+        if not use_shm:
+            payload = _PROXY_MEM_ACCESS.pack(component, addr, size, 0)
+            if is_write:
+                payload += bytes(values)
+            if not wait:
+                self._post_frame(cmd, payload)
+                return None
+            return self._send_frame(cmd, payload)
+
+        with self.shm_lock:
+            if is_write:
+                self.shm.buf[0:size] = values
+            self._send_frame(cmd, _PROXY_MEM_ACCESS.pack(component, addr, size, 0),
+                flags=_PROXY_FLAG_SHM)
+            if not is_write:
+                return bytes(self.shm.buf[0:size])
+
     def _unlock_cmd(self):
         self.lock.release()
 
@@ -261,6 +524,7 @@ class Proxy(object):
 
         This will free resources and close threads so that simulation can properly exit.
         """
+        self.shm_close()
         self.socket.shutdown(socket.SHUT_WR)
         self.socket.close()
         self.reader.join()
@@ -290,21 +554,35 @@ class Proxy(object):
 
         self._send_cmd('trace level %s' % level)
 
-    def event_add(self, event: str):
+    def trace_dump_recorder(self):
+        """Write the trace messages and events kept in memory by the flight recorder.
+        """
+
+        self._send_cmd('trace dump_recorder')
+
+    def event_add(self, event: str, is_regex: bool = False):
         """Enable an event.
 
-        :param event: A regular expression used to enable events
+        :param event: The path of the events to enable
+        :param is_regex: True if the path is a regular expression
         """
 
-        self._send_cmd('event add %s' % event)
+        if is_regex:
+            self._send_cmd('event add_regex %s' % event)
+        else:
+            self._send_cmd('event add %s' % event)
 
-    def event_remove(self, event: str):
-        """Disable a trace.
+    def event_remove(self, event: str, is_regex: bool = False):
+        """Disable an event.
 
-        :param event: A regular expression used to enable events
+        :param event: The path of the events to disable
+        :param is_regex: True if the path is a regular expression
         """
 
-        self._send_cmd('event remove %s' % event)
+        if is_regex:
+            self._send_cmd('event remove_regex %s' % event)
+        else:
+            self._send_cmd('event remove %s' % event)
 
     def run(self, duration: int = None):
         """Starts execution.
@@ -322,6 +600,34 @@ class Proxy(object):
 
 
 
+    def run_until(self, conditions: list) -> int:
+        """Run execution until a condition is met.
+
+        The conditions are evaluated by GVSOC, which stops execution at the end of the timestamp
+        where one of them is met, so that there is no need to step execution and poll the
+        system. This blocks the caller until execution stops.
+
+        :param conditions: The conditions, as strings, which can be "pc:<core path>:<pc>",
+            "insn:<core path>:<number of instructions>",
+            "mem:<memory path>:<offset>:<value>[:<mask>[:<size>]]",
+            "wire:<component path>:<master port>" or "timeout:<duration in ps>"
+        :returns: The index of the condition which was met, or -1 if execution was stopped for
+            another reason
+        :raises RuntimeError: If one of the conditions is invalid
+        """
+
+        self.reader.stop_condition = None
+        cmd = 'run_until %s' % ' '.join(conditions)
+        if self.binary:
+            self._send_cmd(cmd)
+        else:
+            req = self._send_cmd(cmd, wait_reply=False)
+            self._wait_reply(req)
+            if req in self.reader.errors:
+                self.reader.errors.discard(req)
+                raise RuntimeError("Invalid stop conditions: %s" % conditions)
+        return self.reader.wait_stop_condition()
+
     def quit(self, status: int = 0):
         """Exit simulation.
 
@@ -351,6 +657,99 @@ class Proxy(object):
         self.reader.register_exit_callback(callback, *kargs, **kwargs)
 
 
+class ProxyBatch(object):
+    """
+    A class used to send a batch of commands in a single packet
+
+    It is returned by Proxy.batch. Commands are added to the batch and are only sent when the
+    batch is sent, either explicitly or when leaving the with statement using it.
+
+    :param proxy: The proxy object.
+    """
+
+    def __init__(self, proxy: Proxy):
+        self.proxy = proxy
+        self.frames = []
+        self.cmds = []
+        self.results = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if exc_type is None:
+            self.send()
+
+    def __add(self, cmd, payload):
+        self.frames.append(Proxy._frame(len(self.frames), cmd, payload))
+        self.cmds.append(cmd)
+
+    def cmd(self, cmd: str):
+        """Add a text command.
+
+        Its result is the reply message.
+
+        :param cmd: The command, with the same syntax as in the text protocol.
+        """
+        self.__add(_PROXY_CMD_TEXT, cmd.encode('ascii'))
+
+    def mem_write(self, router: 'Router', addr: int, values: bytes):
+        """Add a memory write.
+
+        Its result is None.
+
+        :param router: The router where the access is injected.
+        :param addr: The address of the access.
+        :param values: The sequence of bytes to be written, in little endian byte ordering.
+        """
+        self.__add(_PROXY_CMD_MEM_WRITE,
+            _PROXY_MEM_ACCESS.pack(int(router.component, 0), addr, len(values), 0) + bytes(values))
+
+    def mem_read(self, router: 'Router', addr: int, size: int):
+        """Add a memory read.
+
+        Its result is the sequence of bytes read.
+
+        :param router: The router where the access is injected.
+        :param addr: The address of the access.
+        :param size: The size of the access in bytes.
+        """
+        self.__add(_PROXY_CMD_MEM_READ, _PROXY_MEM_ACCESS.pack(int(router.component, 0), addr, size, 0))
+
+    def send(self) -> list:
+        """Send the batch and wait until all its commands are done.
+
+        :return: list, The result of each command, in the order they were added.
+
+        :raises: RuntimeError, if one of the commands failed.
+        """
+        payload = self.proxy._send_frame(_PROXY_CMD_BATCH, b''.join(self.frames))
+
+        self.results = []
+        offset = 0
+        while offset < len(payload):
+            size, req, cmd, flags, status = _PROXY_FRAME.unpack_from(payload, offset)
+            offset += _PROXY_FRAME.size
+            reply = payload[offset:offset + size]
+            offset += size
+
+            if status != 0:
+                raise RuntimeError("Proxy batch command %d failed with status %d" % (req, status))
+
+            if self.cmds[req] == _PROXY_CMD_TEXT:
+                self.results.append(bytes(reply).decode('utf-8'))
+            elif self.cmds[req] == _PROXY_CMD_MEM_READ:
+                self.results.append(bytes(reply))
+            else:
+                self.results.append(None)
+
+        self.frames = []
+        self.cmds = []
+
+        return self.results
+
+
+
 class Router(object):
     """
     A class used to inject memory accesses into a router
@@ -365,7 +764,7 @@ class Router(object):
 
 
 
-    def mem_write(self, addr: int, size: int, values: bytes):
+    def mem_write(self, addr: int, size: int, values: bytes, wait: bool = True):
         """Inject a memory write.
 
         The access is generated by the router where this class is connected and is
@@ -374,19 +773,17 @@ class Router(object):
         :param addr: The address of the access.
         :param size: The size of the access in bytes.
         :param values: The sequence of bytes to be written, in little endian byte ordering.
+        :param wait: False if the write should be pipelined without waiting for its completion,
+            in which case errors are reported by Proxy.sync. This requires the binary protocol.
 
         :raises: RuntimeError, if the access generates an error in the architecture.
         """
-        cmd = 'component %s mem_write 0x%x 0x%x' % (self.component, addr, size)
+        if self.proxy.binary:
+            self.proxy._mem_access(int(self.component, 0), True, addr, size, values, wait=wait)
+            return
 
-        # Since we need to send a command and right after the data,
-        # we have to keep the command queue locked to avoid mixing our data
-        # with another command
-        req = self.proxy._send_cmd(cmd, keep_lock=True, wait_reply=False)
-        self.proxy.socket.send(values)
-        self.proxy._unlock_cmd()
-
-        self.proxy.reader.wait_reply(req)
+        cmd = 'component %s mem_write 0x%x 0x%x' % (self.component, addr, size)
+        self.proxy._send_cmd(cmd, data=values)
 
     def mem_read(self, addr: int, size: int) -> bytes:
         """Inject a memory read.
@@ -402,6 +799,9 @@ class Router(object):
         :raises: RuntimeError, if the access generates an error in the architecture.
         """
 
+        if self.proxy.binary:
+            return self.proxy._mem_access(int(self.component, 0), False, addr, size)
+
         # Since we need to send a command and right after we receive the data,
         # we have to keep the command queue locked to avoid mixing our data
         # with another command
@@ -413,7 +813,7 @@ class Router(object):
 
         self.proxy._unlock_cmd()
 
-        self.proxy.reader.wait_reply(req)
+        self.proxy._wait_reply(req)
 
         return reply
 
@@ -451,6 +851,204 @@ class Router(object):
 
 
 
+class IoShm(object):
+    """
+    Client injecting memory-mapped requests through the shared memory of a router proxy.
+
+    The router proxy must be configured with the shm property. Requests refer to data in the
+    data area of the shared memory, which is directly accessed by the simulated system.
+
+    :param name: str, The name of the shared memory, as given to the router proxy.
+    """
+
+    def __init__(self, name: str):
+        import mmap
+
+        fd = os.open('/dev/shm/' + name.lstrip('/'), os.O_RDWR)
+        try:
+            magic, version, self.nb_entries, self.data_size, closed = \
+                _IO_SHM_HEADER.unpack(os.read(fd, _IO_SHM_HEADER.size))
+            if magic != _IO_SHM_MAGIC or version != _IO_SHM_VERSION:
+                raise RuntimeError('Invalid IO shared memory: %s' % name)
+
+            entries_size = 2 * self.nb_entries * _IO_SHM_ENTRY.size
+            self.data_offset = (_IO_SHM_HEADER_SIZE + entries_size + 63) & ~63
+            self.shm = mmap.mmap(fd, self.data_offset + self.data_size)
+        finally:
+            os.close(fd)
+
+        self.nb_pending = 0
+        self.next_id = 0
+        self.__futex_init()
+
+    def __futex_init(self):
+        import ctypes
+
+        libc = ctypes.CDLL(None, use_errno=True)
+        self.futex_syscall = libc.syscall
+        self.futex_nr = { 'x86_64': 202, 'aarch64': 98 }.get(os.uname().machine)
+        # This keeps a reference to the mapping, which must be released before closing it
+        self.futex_anchor = ctypes.c_char.from_buffer(self.shm)
+        self.futex_base = ctypes.addressof(self.futex_anchor)
+
+    def __futex(self, offset, op, value):
+        import ctypes
+
+        if self.futex_nr is not None:
+            self.futex_syscall(self.futex_nr, ctypes.c_void_p(self.futex_base + offset), op, value,
+                None, None, 0)
+
+    def __futex_inc_wake(self, offset):
+        import ctypes
+
+        # The sequence is also incremented by GVSOC, so it must be incremented atomically,
+        # otherwise an increment may be lost and a waiter may sleep on the value it already
+        # checked. FUTEX_WAKE_OP atomically adds 1 to the sequence and then wakes up its waiters.
+        # The atomic operation is also a full barrier, which makes the entries visible before.
+        futex_wake_op = 5
+        futex_op_add_1 = (1 << 28) | (1 << 12)
+        if self.futex_nr is not None:
+            self.futex_syscall(self.futex_nr, ctypes.c_void_p(self.futex_base + offset),
+                futex_wake_op, 0x7fffffff, None, ctypes.c_void_p(self.futex_base + offset),
+                futex_op_add_1)
+        else:
+            self.__set(offset, (self.__get(offset, '<I') + 1) & 0xffffffff, '<I')
+
+    def __get(self, offset, fmt='<Q'):
+        return struct.unpack_from(fmt, self.shm, offset)[0]
+
+    def __set(self, offset, value, fmt='<Q'):
+        struct.pack_into(fmt, self.shm, offset, value)
+
+    def write_data(self, offset: int, values: bytes):
+        """Write to the data area.
+
+        :param offset: int, The offset in the data area.
+        :param values: bytes, The data.
+        """
+        self.shm[self.data_offset + offset:self.data_offset + offset + len(values)] = values
+
+    def read_data(self, offset: int, size: int) -> bytes:
+        """Read from the data area.
+
+        :param offset: int, The offset in the data area.
+        :param size: int, The number of bytes.
+        :return: bytes, The data.
+        """
+        return bytes(self.shm[self.data_offset + offset:self.data_offset + offset + size])
+
+    def access(self, addr: int, size: int, is_write: bool, offset: int = 0, timestamp: int = -1,
+            id: int = None) -> int:
+        """Inject a memory-mapped request.
+
+        For writes, the data must be written to the data area before. For reads, the data is in
+        the data area once the response is received. The area must not be modified until then.
+
+        :param addr: int, The address of the access.
+        :param size: int, The size of the access.
+        :param is_write: bool, True for a write.
+        :param offset: int, The offset of the data in the data area.
+        :param timestamp: int, Time in picoseconds before which the request is not injected, or
+            -1 to inject it as soon as possible.
+        :param id: int, Identifier returned in the response, a new one is chosen if it is None.
+        :return: int, The identifier of the request.
+        :raises: RuntimeError, if too many requests are pending.
+        """
+        if self.nb_pending == self.nb_entries:
+            raise RuntimeError('Too many pending IO shared memory requests')
+
+        if id is None:
+            id = self.next_id
+            self.next_id += 1
+
+        ring = _IO_SHM_REQ_RING
+        head = self.__get(ring + _IO_SHM_RING_HEAD)
+        _IO_SHM_ENTRY.pack_into(self.shm,
+            _IO_SHM_HEADER_SIZE + (head % self.nb_entries) * _IO_SHM_ENTRY.size,
+            id, addr, size, offset, timestamp, 1 if is_write else 0, 0)
+        self.__set(ring + _IO_SHM_RING_HEAD, head + 1)
+        self.nb_pending += 1
+
+        # Wake up the router proxy thread, which checks the head again once woken up
+        self.__futex_inc_wake(ring + _IO_SHM_RING_SEQ)
+
+        return id
+
+    def get_response(self) -> tuple:
+        """Get the next response, if any.
+
+        :return: tuple, The identifier, the status (0 for success) and the time in picoseconds
+            at which the request was over, or None if there is no response.
+        """
+        ring = _IO_SHM_RSP_RING
+        tail = self.__get(ring + _IO_SHM_RING_TAIL)
+        if tail == self.__get(ring + _IO_SHM_RING_HEAD):
+            return None
+
+        id, addr, size, offset, timestamp, type, status = _IO_SHM_ENTRY.unpack_from(self.shm,
+            _IO_SHM_HEADER_SIZE + (self.nb_entries + tail % self.nb_entries) * _IO_SHM_ENTRY.size)
+        self.__set(ring + _IO_SHM_RING_TAIL, tail + 1)
+        self.nb_pending -= 1
+        return (id, status, timestamp)
+
+    def wait_response(self) -> tuple:
+        """Wait for the next response.
+
+        :return: tuple, Same as get_response.
+        :raises: RuntimeError, if the simulation is over.
+        """
+        ring = _IO_SHM_RSP_RING
+        while True:
+            seq = self.__get(ring + _IO_SHM_RING_SEQ, '<I')
+            rsp = self.get_response()
+            if rsp is not None:
+                return rsp
+            if self.__get(_IO_SHM_CLOSED, '<I') != 0:
+                raise RuntimeError('Simulation is over')
+
+            # We are the only one waiting for responses
+            self.__set(ring + _IO_SHM_RING_NB_WAITING, 1, '<I')
+            self.__futex(ring + _IO_SHM_RING_SEQ, 0, seq)
+            self.__set(ring + _IO_SHM_RING_NB_WAITING, 0, '<I')
+
+    def mem_write(self, addr: int, values: bytes, offset: int = 0):
+        """Write memory and wait until it is done.
+
+        No other request must be pending.
+
+        :param addr: int, The address of the access.
+        :param values: bytes, The data.
+        :param offset: int, The offset in the data area used for the data.
+        :raises: RuntimeError, if the access generates an error in the architecture.
+        """
+        self.write_data(offset, values)
+        self.access(addr, len(values), True, offset)
+        if self.wait_response()[1] != 0:
+            raise RuntimeError('Invalid access (addr: 0x%x, size: 0x%x)' % (addr, len(values)))
+
+    def mem_read(self, addr: int, size: int, offset: int = 0) -> bytes:
+        """Read memory and wait until it is done.
+
+        No other request must be pending.
+
+        :param addr: int, The address of the access.
+        :param size: int, The size of the access.
+        :param offset: int, The offset in the data area used for the data.
+        :return: bytes, The data.
+        :raises: RuntimeError, if the access generates an error in the architecture.
+        """
+        self.access(addr, size, False, offset)
+        if self.wait_response()[1] != 0:
+            raise RuntimeError('Invalid access (addr: 0x%x, size: 0x%x)' % (addr, size))
+        return self.read_data(offset, size)
+
+    def close(self):
+        """Close the shared memory.
+        """
+        del self.futex_anchor
+        self.shm.close()
+
+
 class Testbench(object):
     """Testbench class.
 
@@ -561,15 +1159,7 @@ class Testbench_uart(object):
         :raises: RuntimeError, if the access generates an error in the architecture.
         """
         cmd = 'component %s uart tx %d %d' % (self.testbench, self.id, len(values))
-
-        # Since we need to send a command and right after the data,
-        # we have to keep the command queue locked to avoid mixing our data
-        # with another command
-        req = self.proxy._send_cmd(cmd, keep_lock=True, wait_reply=False)
-        self.proxy.socket.send(values)
-        self.proxy._unlock_cmd()
-
-        self.proxy.reader.wait_reply(req)
+        self.proxy._send_cmd(cmd, data=values)
 
     def rx(self, size=None):
         """Read data from the uart.
@@ -623,11 +1213,10 @@ class Testbench_uart(object):
         self.proxy._send_cmd(cmd)
 
 
-    def __handle_rx(self):
+    def __handle_rx(self, reply):
         self.lock.acquire()
-        reply = self.proxy.socket.recv(1)
         if self.callback is not None:
-            self.callback[0](1, reply, *self.callback[1], **self.callback[2])
+            self.callback[0](len(reply), reply, *self.callback[1], **self.callback[2])
         else:
             self.pending_rx_bytes += reply
             self.condition.notify()
@@ -41,7 +41,21 @@ def gen_config(args, config, working_dir, runner=None):
     gvsoc_config.set('wunconnected-device', args.w_unconnected_device)
     gvsoc_config.set('wunconnected-padfun', args.w_unconnected_padfun)
 
-    for trace in args.traces:
+    if args.trace_start is not None or args.trace_stop is not None:
+        # Traces and events are only enabled between the start and stop triggers
+        gvsoc_config.set('traces/windows', {
+            'start': args.trace_start if args.trace_start is not None else '',
+            'stop': args.trace_stop if args.trace_stop is not None else '',
+            'traces': args.traces,
+            'events': args.events
+        })
+        trace_regexs = []
+        event_regexs = []
+    else:
+        trace_regexs = args.traces
+        event_regexs = args.events
+
+    for trace in trace_regexs:
         gvsoc_config.set('traces/include_regex', trace)
 
     if args.trace_level is not None:
@@ -50,11 +64,36 @@ def gen_config(args, config, working_dir, runner=None):
     if args.trace_format is not None:
         gvsoc_config.set('traces/format', args.trace_format)
 
+    if args.trace_backend is not None:
+        gvsoc_config.set('traces/backend', args.trace_backend)
+
+    if args.trace_recorder is not None:
+        gvsoc_config.set('recorder/enabled', True)
+        gvsoc_config.set('recorder/messages_size', args.trace_recorder)
+        gvsoc_config.set('recorder/events_size', args.trace_recorder)
+
+    if args.power_sampler is not None:
+        gvsoc_config.set('power/sampler/enabled', True)
+        gvsoc_config.set('power/sampler/period', args.power_sampler)
+        gvsoc_config.set('power/sampler/format', args.power_sampler_format)
+        gvsoc_config.set('power/sampler/file', 'power_samples.' + args.power_sampler_format)
+        if args.power_sampler_clock is not None:
+            gvsoc_config.set('power/sampler/clock', args.power_sampler_clock)
+        for block in args.power_sampler_blocks:
+            gvsoc_config.set('power/sampler/blocks', block)
+
+    if args.power_quantum_mode is not None:
+        gvsoc_config.set('power/quantum_mode', args.power_quantum_mode)
+
     if args.vcd:
         gvsoc_config.set('events/enabled', True)
         gvsoc_config.set('events/gen_gtkw', True)
 
-    for event in args.events:
+    if args.vcd_shm is not None:
+        gvsoc_config.set('events/enabled', True)
+        gvsoc_config.set('events/shm/name', args.vcd_shm)
+
+    for event in event_regexs:
         gvsoc_config.set('events/include_regex', event)
 
     for tag in args.event_tags:
@@ -71,6 +110,7 @@ def gen_config(args, config, working_dir, runner=None):
         gvsoc_config.get_bool('events/enabled') or \
         len(gvsoc_config.get('traces/include_regex')) != 0 or \
         len(gvsoc_config.get('events/include_regex')) != 0 or \
+        len(gvsoc_config.get('traces/windows')) != 0 or \
         args.gui
 
     gvsoc_config.set("debug-mode", debug_mode)
@@ -127,6 +167,15 @@ class Runner():
                         "include_regex": [],
                         "exclude_regex": [],
                         "format": "fst",
+                        "fst": {
+                            "pack": "lz4",
+                            "parallel": True
+                        },
+                        "shm": {
+                            "name": "",
+                            "size": 16,
+                            "batch_size": 4096
+                        },
                         "active": False,
                         "all": True,
                         "gtkw": False,
@@ -155,9 +204,30 @@ class Runner():
                     "traces": {
                         "level": "debug",
                         "format": "long",
+                        "backend": "direct",
+                        "binary_file": "traces.bin",
                         "enabled": False,
                         "include_regex": [],
-                        "exclude_regex": []
+                        "exclude_regex": [],
+                        "windows": []
+                    },
+
+                    "recorder": {
+                        "enabled": False,
+                        "messages_size": 16,
+                        "events_size": 16
+                    },
+
+                    "power": {
+                        "quantum_mode": "count",
+                        "sampler": {
+                            "enabled": False,
+                            "period": 0,
+                            "clock": "",
+                            "blocks": [],
+                            "format": "csv",
+                            "file": "power_samples.csv"
+                        }
                     }
                 }
             })
@@ -403,7 +473,8 @@ class Runner():
 
                 command = stub
 
-                command += [launcher, '--config=' + self.gvsoc_config_path]
+                command += [launcher, '--config=' + self.gvsoc_config_path,
+                    '--config-cache=' + self.gvsoc_config_path + '.cache']
 
             if True: #self.verbose:
                 print ('Launching GVSOC with command: ')
@@ -481,8 +552,45 @@ class Target(gapy.Target):
             parser.add_argument("--trace-format", dest="trace_format", default="long",
                 help="Specify trace format")
 
+            parser.add_argument("--trace-backend", dest="trace_backend", default=None,
+                choices=['direct', 'deferred', 'binary'],
+                help="Specify how trace messages are written: directly, formatted by a separate thread, or to a binary log")
+
+            parser.add_argument("--trace-start", dest="trace_start", default=None,
+                help="Only enable the traces and events once the specified trigger is met "
+                    "(time:<ps>, pc:<core>:<address or symbol>, insn:<core>:<count> or "
+                    "write:<core>:<address>)")
+
+            parser.add_argument("--trace-stop", dest="trace_stop", default=None,
+                help="Disable the traces and events enabled with --trace-start once the specified "
+                    "trigger is met")
+
+            parser.add_argument("--trace-recorder", dest="trace_recorder", default=None, type=int,
+                nargs='?', const=16, metavar="SIZE",
+                help="Keep the last SIZE MB of trace messages and events in memory and only write them on failure")
+
             parser.add_argument("--vcd", dest="vcd", action="store_true", help="Activate VCD traces")
 
+            parser.add_argument("--power-sampler", dest="power_sampler", default=None, type=int,
+                metavar="PERIOD",
+                help="Dump the energy consumed every PERIOD picoseconds, or cycles if --power-sampler-clock is given")
+
+            parser.add_argument("--power-sampler-clock", dest="power_sampler_clock", default=None,
+                help="Path of the component whose clock domain gives the power sampler period")
+
+            parser.add_argument("--power-sampler-block", dest="power_sampler_blocks", default=[],
+                action="append", help="Path of a component to be sampled by the power sampler")
+
+            parser.add_argument("--power-sampler-format", dest="power_sampler_format", default="csv",
+                choices=['csv', 'bin'], help="Format of the power sampler file")
+
+            parser.add_argument("--power-quantum-mode", dest="power_quantum_mode", default=None,
+                choices=['count', 'immediate', 'check'],
+                help="Select how quantums of energy are accounted, 'check' compares counted and immediately accounted quantums in reports")
+
+            parser.add_argument("--vcd-shm", dest="vcd_shm", default=None, metavar="NAME",
+                help="Send VCD events to another process through the POSIX shared memory NAME")
+
             parser.add_argument("--event", dest="events", default=[], action="append",
                 help="Specify gvsoc event (for VCD traces)")
 
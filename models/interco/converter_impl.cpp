@@ -106,6 +106,7 @@ void converter::event_handler(vp::Block *__this, vp::ClockEvent *event)
   {
     _this->ready_cycle = _this->clock.get_cycles() + req->get_latency() + 1;
     _this->ongoing_size -= req->get_size();
+    _this->out.req_del(req);
     if (_this->ongoing_size == 0)
     {
       vp::IoReq *req = _this->ongoing_req;
@@ -31,6 +31,8 @@ public:
 
     interleaver(vp::ComponentConf &conf);
 
+  void start();
+
   static vp::IoReqStatus req(vp::Block *__this, vp::IoReq *req);
 
 
@@ -39,6 +41,9 @@ public:
   static void response(vp::Block *__this, vp::IoReq *req);
 
 private:
+  // Send the specified aligned area as one burst per output
+  vp::IoReqStatus send_bursts(vp::IoReq *req, uint64_t offset, uint64_t size, uint8_t *data, int64_t *latency);
+
   vp::Trace     trace;
 
   vp::IoMaster **out;
@@ -51,6 +56,8 @@ private:
   int stage_bits;
   uint64_t offset_mask;
   uint64_t remove_offset;
+  // True if all outputs can receive bursts
+  bool burst_outputs = false;
 };
 
 interleaver::interleaver(vp::ComponentConf &config)
@@ -59,6 +66,7 @@ interleaver::interleaver(vp::ComponentConf &config)
   traces.new_trace("trace", &trace, vp::DEBUG);
 
   in.set_req_meth(&interleaver::req);
+  in.set_burst_support(true);
   new_slave_port("input", &in);
 
   nb_slaves = get_js_config()->get_child_int("nb_slaves");
@@ -89,14 +97,84 @@ interleaver::interleaver(vp::ComponentConf &config)
   {
     masters_in[i] = new vp::IoSlave();
     masters_in[i]->set_req_meth(&interleaver::req);
+    masters_in[i]->set_burst_support(true);
     new_slave_port("in_" + std::to_string(i), masters_in[i]);
   }
 
 }
 
+void interleaver::start()
+{
+  this->burst_outputs = true;
+  for (int i=0; i<nb_slaves; i++)
+  {
+    if (!this->out[i]->is_burst_supported())
+    {
+      this->burst_outputs = false;
+    }
+  }
+}
+
+vp::IoReqStatus interleaver::send_bursts(vp::IoReq *req, uint64_t offset, uint64_t size, uint8_t *data, int64_t *latency)
+{
+  int port_size = 1<<this->interleaving_bits;
+  int nb_outputs = 1<<this->stage_bits;
+  uint64_t nb_beats = (size + port_size - 1) / port_size;
+
+  // Consecutive beats going to the same output are contiguous on the output side, while their
+  // data is separated by a full round of outputs
+  for (int i=0; i<nb_outputs; i++)
+  {
+    uint64_t beat_offset = offset + (uint64_t)i * port_size;
+    int output_id = (beat_offset >> this->interleaving_bits) & (nb_outputs - 1);
+    uint64_t new_offset = (beat_offset & this->offset_mask) >> this->stage_bits;
+    uint64_t output_size = (nb_beats - i + nb_outputs - 1) / nb_outputs * port_size;
+    // The last beat may be partial
+    if ((uint64_t)i == (nb_beats - 1) % nb_outputs)
+    {
+      output_size -= nb_beats * port_size - size;
+    }
+
+    this->trace.msg("Forwarding interleaved burst (port: %d, offset: 0x%x, size: 0x%x)\n", output_id, new_offset, output_size);
+
+    req->set_addr(new_offset);
+    req->set_size(output_size);
+    req->set_data(data ? data + i * port_size : NULL);
+    req->set_latency(0);
+    req->set_burst(port_size, port_size, (int64_t)port_size * nb_outputs);
+
+    vp::IoReqStatus err = this->out[output_id]->req_forward(req);
+    req->clear_burst();
+
+    if (err != vp::IO_REQ_OK)
+    {
+      // Same limitation as for normal requests, only the last one can be asynchronous
+      if (err == vp::IO_REQ_PENDING && i == nb_outputs - 1)
+      {
+        return vp::IO_REQ_PENDING;
+      }
+      return vp::IO_REQ_INVALID;
+    }
+
+    int64_t req_latency = req->get_latency();
+    if (req_latency > *latency)
+    {
+      *latency = req_latency;
+    }
+  }
+
+  return vp::IO_REQ_OK;
+}
+
 vp::IoReqStatus interleaver::req(vp::Block *__this, vp::IoReq *req)
 {
   interleaver *_this = (interleaver *)__this;
+
+  if (req->is_burst())
+  {
+    return req->burst_split(_this, &interleaver::req);
+  }
+
   uint64_t offset = req->get_addr();
   bool is_write = req->get_is_write();
   uint64_t size = req->get_size();
@@ -116,7 +194,19 @@ vp::IoReqStatus interleaver::req(vp::Block *__this, vp::IoReq *req)
   offset -= _this->remove_offset;
 
   while(size) {
-    
+
+    // Once aligned, requests covering several times all outputs are sent as one burst
+    // per output instead of one request per beat
+    if (!align_size && _this->burst_outputs && size >= (uint64_t)port_size << (_this->stage_bits + 1))
+    {
+      vp::IoReqStatus err = _this->send_bursts(req, offset, size, data, &latency);
+      if (err != vp::IO_REQ_OK)
+      {
+        return err;
+      }
+      break;
+    }
+
     int loop_size = port_size;
     if (align_size) {
       loop_size = align_size;
@@ -94,6 +94,7 @@ public:
   router(vp::ComponentConf &conf);
 
   std::string handle_command(gv::GvProxy *proxy, FILE *req_file, FILE *reply_file, std::vector<std::string> args, std::string req);
+  int handle_proxy_mem_access(bool is_write, uint64_t addr, uint64_t size, uint8_t *data) override;
 
   static vp::IoReqStatus req(vp::Block *__this, vp::IoReq *req);
 
@@ -110,6 +111,11 @@ private:
   bool init = false;
 
   void init_entries();
+  // Get the entry where the specified address is routed, or NULL if it is invalid
+  MapEntry *get_entry(uint64_t offset);
+  // Tell if a burst can be forwarded as a whole, which is the case if it stays inside one
+  // entry whose target supports bursts
+  bool can_route_burst(vp::IoReq *req);
   MapEntry *firstMapEntry = NULL;
   MapEntry *defaultMapEntry = NULL;
   MapEntry *errorMapEntry = NULL;
@@ -121,6 +127,8 @@ private:
   int bandwidth = 0;
   int latency = 0;
   vp::IoReq proxy_req;
+  // Data of the memory accesses coming from text proxy commands, kept to avoid reallocations
+  std::vector<uint8_t> proxy_buffer;
 };
 
 router::router(vp::ComponentConf &config)
@@ -129,6 +137,7 @@ router::router(vp::ComponentConf &config)
   traces.new_trace("trace", &trace, vp::DEBUG);
 
   in.set_req_meth(&router::req);
+  in.set_burst_support(true);
   new_slave_port("input", &in);
 
   out.set_resp_meth(&router::response);
@@ -241,6 +250,53 @@ void MapEntry::insert(router *router)
   }
 }
 
+MapEntry *router::get_entry(uint64_t offset)
+{
+  MapEntry *entry = this->topMapEntry;
+
+  if (entry)
+  {
+    while (entry->left)
+    {
+      entry = offset >= entry->base ? entry->right : entry->left;
+    }
+
+    if (offset < entry->base || offset > entry->base + entry->size - 1)
+    {
+      entry = NULL;
+    }
+  }
+
+  if (!entry)
+  {
+    if (!this->errorMapEntry || offset < this->errorMapEntry->base ||
+      offset > this->errorMapEntry->base + this->errorMapEntry->size - 1)
+    {
+      entry = this->defaultMapEntry;
+    }
+  }
+
+  return entry;
+}
+
+bool router::can_route_burst(vp::IoReq *req)
+{
+  uint64_t offset = req->get_addr();
+  MapEntry *entry = this->get_entry(offset);
+
+  if (entry == NULL || entry != this->get_entry(offset + req->get_burst_span() - 1))
+  {
+    return false;
+  }
+
+  if (entry->port)
+  {
+    return this->out.is_burst_supported(entry->port);
+  }
+
+  return entry->itf && entry->itf->is_bound() && entry->itf->is_burst_supported();
+}
+
 vp::IoReqStatus router::req(vp::Block *__this, vp::IoReq *req)
 {
   router *_this = (router *)__this;
@@ -252,6 +308,13 @@ vp::IoReqStatus router::req(vp::Block *__this, vp::IoReq *req)
     _this->init_entries();
   }
 
+  if (req->is_burst() && !_this->can_route_burst(req))
+  {
+    _this->trace.msg(vp::Trace::LEVEL_TRACE, "Splitting burst (offset: 0x%llx, size: 0x%llx)\n",
+        req->get_addr(), req->get_size());
+    return req->burst_split(_this, &router::req);
+  }
+
   uint64_t offset = req->get_addr();
   uint64_t size = req->get_size();
   uint8_t *data = req->get_data();
@@ -440,7 +503,8 @@ std::string router::handle_command(gv::GvProxy *proxy, FILE *req_file, FILE *rep
         long long int addr = strtoll(args[1].c_str(), NULL, 0);
         long long int size = strtoll(args[2].c_str(), NULL, 0);
 
-        uint8_t *buffer = new uint8_t[size];
+        this->proxy_buffer.resize(size);
+        uint8_t *buffer = this->proxy_buffer.data();
 
         if (is_write)
         {
@@ -451,23 +515,13 @@ std::string router::handle_command(gv::GvProxy *proxy, FILE *req_file, FILE *rep
             }
         }
 
-        vp::IoReq *req = &this->proxy_req;
-        req->set_data((uint8_t *)buffer);
-        req->set_is_write(is_write);
-        req->set_size(size);
-        req->set_addr(addr);
-        req->set_debug(true);
-
-        vp::IoReqStatus result = router::req(this, req);
-        error |= result != vp::IO_REQ_OK;
+        error |= this->handle_proxy_mem_access(is_write, addr, size, buffer) != 0;
 
         if (!is_write)
         {
             error = proxy->send_payload(reply_file, cmd_req, buffer, size);
         }
 
-        delete[] buffer;
-
         return "err=" + std::to_string(error);
     }
     return "err=1";
@@ -475,6 +529,20 @@ std::string router::handle_command(gv::GvProxy *proxy, FILE *req_file, FILE *rep
 
 
 
+int router::handle_proxy_mem_access(bool is_write, uint64_t addr, uint64_t size, uint8_t *data)
+{
+    vp::IoReq *req = &this->proxy_req;
+    req->set_data(data);
+    req->set_is_write(is_write);
+    req->set_size(size);
+    req->set_addr(addr);
+    req->set_debug(true);
+
+    return router::req(this, req) == vp::IO_REQ_OK ? 0 : -1;
+}
+
+
+
 extern "C" vp::Component *gv_new(vp::ComponentConf &config)
 {
   return new router(config);
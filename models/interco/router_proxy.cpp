@@ -21,7 +21,44 @@
 #include <vp/vp.hpp>
 #include <vp/itf/io.hpp>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <queue>
 #include <gv/gvsoc.hpp>
+#include <gv/io_shm.hpp>
+
+
+// Request injected through shared memory, waiting for its timestamp
+class IoShmPending
+{
+public:
+    int64_t time;
+    // Reception order, to inject requests with the same timestamp in order
+    uint64_t seq;
+    gv::Io_shm_entry entry;
+};
+
+// Shared between the proxy and the drains posted to the engine, which can still be executed by
+// the engine thread while or after the proxy is stopped or destroyed
+class IoShmLiveness
+{
+public:
+    std::mutex mutex;
+    // Cleared when the proxy is stopped, the drains must then do nothing
+    bool alive = true;
+};
+
+class IoShmPendingCompare
+{
+public:
+    bool operator()(IoShmPending *a, IoShmPending *b)
+    {
+        return a->time > b->time || (a->time == b->time && a->seq > b->seq);
+    }
+};
 
 
 class Router_proxy : public vp::Component, public gv::Io_binding
@@ -30,6 +67,7 @@ class Router_proxy : public vp::Component, public gv::Io_binding
 public:
 
     Router_proxy(vp::ComponentConf &conf);
+    ~Router_proxy();
 
     void grant(gv::Io_request *req);
     void reply(gv::Io_request *req);
@@ -37,6 +75,8 @@ public:
 
     void *external_bind(std::string comp_name, std::string itf_name, void *handle);
 
+    void stop();
+
     static vp::IoReqStatus req(vp::Block *__this, vp::IoReq *req);
 
     static void grant(vp::Block *__this, vp::IoReq *req);
@@ -44,14 +84,50 @@ public:
     static void response(vp::Block *__this, vp::IoReq *req);
 
 private:
+    void shm_open(std::string name, uint32_t nb_entries, uint64_t data_size);
+    // Thread waiting for requests pushed by the other process
+    void shm_thread_routine();
+    // Executed by the engine to take the requests pushed by the other process
+    void shm_drain();
+    void shm_inject(gv::Io_shm_entry *entry);
+    void shm_reply(uint64_t id, gv::Io_request_status status, int64_t timestamp);
+    void shm_schedule();
+    static void shm_pending_handler(vp::Block *__this, vp::TimeEvent *event);
+
     vp::Trace     trace;
     vp::IoSlave  in;
     vp::IoMaster out;
     gv::Io_user   *user;
+    // Requests from the simulated system to the external user
+    vp::Pool<gv::Io_request> io_req_pool;
+    // Requests from the external user to the simulated system
+    vp::Pool<vp::IoReq> req_pool;
+
+    // Shared memory through which another process injects requests, NULL if not used
+    gv::Io_shm_header *shm = NULL;
+    std::string shm_name;
+    size_t shm_size;
+    gv::Io_shm_entry *shm_req_entries;
+    gv::Io_shm_entry *shm_rsp_entries;
+    uint8_t *shm_data;
+    std::thread *shm_thread = NULL;
+    // True when a drain is posted to the engine and not yet executed
+    std::atomic<bool> shm_drain_pending;
+    // Tells the posted drains if the proxy is still there, they keep a reference on it
+    std::shared_ptr<IoShmLiveness> shm_liveness;
+    // Requests whose timestamp is not yet reached
+    std::priority_queue<IoShmPending *, std::vector<IoShmPending *>, IoShmPendingCompare> shm_pendings;
+    vp::Pool<IoShmPending> shm_pending_pool;
+    uint64_t shm_seq = 0;
+    vp::TimeEvent shm_pending_event;
+    // Request denied by the slave, nothing else is injected until it is granted
+    vp::IoReq *shm_denied_req = NULL;
 };
 
 Router_proxy::Router_proxy(vp::ComponentConf &config)
-: vp::Component(config)
+: vp::Component(config), io_req_pool(this->get_path() + "/io_req"), req_pool(this->get_path() + "/req"),
+  shm_drain_pending(false), shm_pending_pool(this->get_path() + "/shm_pending"),
+  shm_pending_event(this, &Router_proxy::shm_pending_handler)
 {
     traces.new_trace("trace", &trace, vp::DEBUG);
 
@@ -62,13 +138,19 @@ Router_proxy::Router_proxy(vp::ComponentConf &config)
     out.set_grant_meth(&Router_proxy::grant);
     new_master_port("out", &out);
 
-
+    std::string shm_name = this->get_js_config()->get_child_str("shm");
+    if (shm_name != "")
+    {
+        this->shm_open(shm_name, this->get_js_config()->get_child_int("shm_entries"),
+            this->get_js_config()->get_child_int("shm_data_size"));
+    }
 }
 
 vp::IoReqStatus Router_proxy::req(vp::Block *__this, vp::IoReq *req)
 {
     Router_proxy *_this = (Router_proxy *)__this;
-    gv::Io_request *io_req = new gv::Io_request();
+    gv::Io_request *io_req = _this->io_req_pool.alloc();
+    *io_req = gv::Io_request();
     io_req->addr = req->get_addr();
     io_req->size = req->get_size();
     io_req->data = req->get_data();
@@ -83,6 +165,7 @@ vp::IoReqStatus Router_proxy::req(vp::Block *__this, vp::IoReq *req)
     // return the proper code
     if (io_req->replied)
     {
+        _this->io_req_pool.free(io_req);
         return vp::IO_REQ_OK;
     }
     else if (io_req->granted)
@@ -114,6 +197,15 @@ void Router_proxy::grant(vp::Block *__this, vp::IoReq *req)
 {
     Router_proxy *_this = (Router_proxy *)__this;
 
+    // Requests injected through shared memory are tagged with this component, they are now
+    // accepted and the following ones can be injected, the response will come later
+    if (*req->arg_get() == (void *)_this)
+    {
+        _this->shm_denied_req = NULL;
+        _this->shm_schedule();
+        return;
+    }
+
     gv::Io_request *io_req = (gv::Io_request *)req->arg_pop();
 
     _this->user->reply(io_req);
@@ -123,9 +215,23 @@ void Router_proxy::response(vp::Block *__this, vp::IoReq *req)
 {
     Router_proxy *_this = (Router_proxy *)__this;
 
-    gv::Io_request *io_req = (gv::Io_request *)req->arg_pop();
+    // Requests injected through shared memory are tagged with this component instead of an
+    // external request
+    void *arg = req->arg_pop();
+    if (arg == (void *)_this)
+    {
+        uint64_t id = (uint64_t)req->arg_pop();
+        gv::Io_request_status status = req->status == vp::IO_REQ_INVALID ? gv::Io_request_ko : gv::Io_request_ok;
+        _this->req_pool.free(req);
+        _this->shm_reply(id, status, _this->time.get_time());
+        return;
+    }
+
+    gv::Io_request *io_req = (gv::Io_request *)arg;
     io_req->retval = req->status == vp::IO_REQ_INVALID ? gv::Io_request_ko : gv::Io_request_ok;
 
+    _this->req_pool.free(req);
+
     _this->user->reply(io_req);
 }
 
@@ -135,11 +241,11 @@ void Router_proxy::grant(gv::Io_request *io_req)
     // the handling of the request.
     if (io_req->sent)
     {
-        // Asynchronous, just forward to the engine after locking
-        this->time.get_engine()->lock();
-        vp::IoReq *req = (vp::IoReq *)io_req->handle;
-        req->get_resp_port()->grant(req);
-        this->time.get_engine()->unlock();
+        // Asynchronous, just post it to the engine, the caller does not need to wait
+        this->time.get_engine()->post([io_req]() {
+            vp::IoReq *req = (vp::IoReq *)io_req->handle;
+            req->get_resp_port()->grant(req);
+        });
     }
     else
     {
@@ -154,12 +260,12 @@ void Router_proxy::reply(gv::Io_request *io_req)
     // the handling of the request.
     if (io_req->sent)
     {
-        // Asynchronous, just forward to the engine after locking
-        this->time.get_engine()->lock();
-        vp::IoReq *req = (vp::IoReq *)io_req->handle;
-        req->get_resp_port()->resp(req);
-        this->time.get_engine()->unlock();
-        delete io_req;
+        // Asynchronous, just post it to the engine, the caller does not need to wait
+        this->time.get_engine()->post([this, io_req]() {
+            vp::IoReq *req = (vp::IoReq *)io_req->handle;
+            req->get_resp_port()->resp(req);
+            this->io_req_pool.free(io_req);
+        });
     }
     else
     {
@@ -170,21 +276,267 @@ void Router_proxy::reply(gv::Io_request *io_req)
 
 void Router_proxy::access(gv::Io_request *io_req)
 {
-    this->time.get_engine()->lock();
-    vp::IoReq *req = new vp::IoReq();
+    // The caller may expect the reply to be received when we return, wait until the engine
+    // has executed it
+    this->time.get_engine()->post_sync([this, io_req]() {
+        vp::IoReq *req = this->req_pool.alloc();
+        req->init();
+        req->set_addr(io_req->addr);
+        req->set_size(io_req->size);
+        req->set_is_write(io_req->type == gv::Io_request_write);
+        req->set_data(io_req->data);
+        req->arg_push(io_req);
+
+        int err = this->out.req(req);
+        if (err == vp::IO_REQ_OK || err == vp::IO_REQ_INVALID)
+        {
+            this->response(this, req);
+        }
+    });
+}
+
+
+
+void Router_proxy::shm_open(std::string name, uint32_t nb_entries, uint64_t data_size)
+{
+    if (nb_entries == 0)
+    {
+        this->trace.fatal("IO shared memory must have at least one entry (name: %s)\n",
+            name.c_str());
+        return;
+    }
+
+    this->shm_name = name;
+    this->shm_size = gv::io_shm_size(nb_entries, data_size);
+
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd == -1)
+    {
+        this->trace.fatal("Error while opening IO shared memory (name: %s, error: %s)\n",
+            name.c_str(), strerror(errno));
+        return;
+    }
+
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, this->shm_size) == 0)
+    {
+        map = mmap(NULL, this->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        ::shm_unlink(name.c_str());
+        this->trace.fatal("Error while mapping IO shared memory (name: %s, error: %s)\n",
+            name.c_str(), strerror(errno));
+        return;
+    }
+
+    // The file is zero-filled, which is the initial state of the rings
+    this->shm = (gv::Io_shm_header *)map;
+    this->shm_req_entries = (gv::Io_shm_entry *)((uint8_t *)map + gv::io_shm_entries_offset());
+    this->shm_rsp_entries = this->shm_req_entries + nb_entries;
+    this->shm_data = (uint8_t *)map + gv::io_shm_data_offset(nb_entries);
+
+    this->shm->version = GV_IO_SHM_VERSION;
+    this->shm->nb_entries = nb_entries;
+    this->shm->data_size = data_size;
+    // Magic is written last so that the client only sees a fully initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(this->shm->magic, GV_IO_SHM_MAGIC, 8);
+
+    this->shm_liveness = std::make_shared<IoShmLiveness>();
+    this->shm_thread = new std::thread(&Router_proxy::shm_thread_routine, this);
+}
+
+Router_proxy::~Router_proxy()
+{
+    if (this->shm)
+    {
+        this->stop();
+        while (!this->shm_pendings.empty())
+        {
+            this->shm_pending_pool.free(this->shm_pendings.top());
+            this->shm_pendings.pop();
+        }
+        munmap(this->shm, this->shm_size);
+    }
+}
+
+void Router_proxy::stop()
+{
+    if (this->shm && !this->shm->closed.load())
+    {
+        this->shm->closed.store(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> guard(this->shm_liveness->mutex);
+            this->shm_liveness->alive = false;
+        }
+        // Wake up our thread and the client, which may be waiting for a response
+        gv::io_shm_ring_notify(&this->shm->req);
+        gv::io_shm_ring_notify(&this->shm->rsp);
+        this->shm_thread->join();
+        delete this->shm_thread;
+        this->shm_thread = NULL;
+        // The client can still map it until it is done, we just remove the name
+        ::shm_unlink(this->shm_name.c_str());
+    }
+}
+
+void Router_proxy::shm_thread_routine()
+{
+    std::shared_ptr<IoShmLiveness> liveness = this->shm_liveness;
+
+    while (!this->shm->closed.load(std::memory_order_acquire))
+    {
+        uint32_t seq = this->shm->req.seq.load();
+
+        // Only one drain is posted at a time, it takes all the requests available when it
+        // is executed, and notifies us when it is done so that we check again
+        if (!this->shm_drain_pending.load() &&
+            this->shm->req.head.load(std::memory_order_acquire) != this->shm->req.tail.load())
+        {
+            this->shm_drain_pending.store(true);
+            // The engine lock is never taken here, so that stop can join us with the engine
+            // locked
+            this->time.get_engine()->post_async([this, liveness]() {
+                std::lock_guard<std::mutex> guard(liveness->mutex);
+                if (liveness->alive)
+                {
+                    this->shm_drain();
+                }
+            });
+        }
+        else
+        {
+            gv::io_shm_ring_wait(&this->shm->req, seq);
+        }
+    }
+}
+
+void Router_proxy::shm_drain()
+{
+    this->shm_drain_pending.store(false);
+
+    uint32_t nb_entries = this->shm->nb_entries;
+    uint64_t tail = this->shm->req.tail.load(std::memory_order_relaxed);
+    uint64_t head = this->shm->req.head.load(std::memory_order_acquire);
+    int64_t time = this->time.get_time();
+
+    while (tail != head)
+    {
+        gv::Io_shm_entry *entry = &this->shm_req_entries[tail % nb_entries];
+        tail++;
+
+        // Requests are also kept in order behind a denied one, and behind the ones which were
+        // kept behind it and are not yet injected
+        if (entry->timestamp > time || this->shm_denied_req || !this->shm_pendings.empty())
+        {
+            IoShmPending *pending = this->shm_pending_pool.alloc();
+            pending->time = std::max(entry->timestamp, time);
+            pending->seq = this->shm_seq++;
+            pending->entry = *entry;
+            this->shm_pendings.push(pending);
+        }
+        else
+        {
+            this->shm_inject(entry);
+        }
+    }
+
+    this->shm->req.tail.store(tail, std::memory_order_release);
+
+    this->shm_schedule();
+
+    // Let the thread check again for requests pushed while we were draining
+    gv::io_shm_ring_notify(&this->shm->req);
+}
+
+void Router_proxy::shm_schedule()
+{
+    if (this->shm_pendings.empty() || this->shm_denied_req)
+    {
+        return;
+    }
+
+    // Requests kept behind a denied one may be late
+    int64_t time = std::max(this->shm_pendings.top()->time, this->time.get_time());
+    if (this->shm_pending_event.is_enqueued())
+    {
+        if (this->shm_pending_event.get_time() <= time)
+        {
+            return;
+        }
+        this->shm_pending_event.cancel();
+    }
+
+    this->shm_pending_event.enqueue(time - this->time.get_time());
+}
+
+void Router_proxy::shm_pending_handler(vp::Block *__this, vp::TimeEvent *event)
+{
+    Router_proxy *_this = (Router_proxy *)__this;
+    int64_t time = _this->time.get_time();
+
+    while (!_this->shm_pendings.empty() && _this->shm_pendings.top()->time <= time &&
+        !_this->shm_denied_req)
+    {
+        IoShmPending *pending = _this->shm_pendings.top();
+        _this->shm_pendings.pop();
+        _this->shm_inject(&pending->entry);
+        _this->shm_pending_pool.free(pending);
+    }
+
+    _this->shm_schedule();
+}
+
+void Router_proxy::shm_inject(gv::Io_shm_entry *entry)
+{
+    this->trace.msg(vp::Trace::LEVEL_TRACE, "Injecting request from shared memory "
+        "(id: %ld, addr: 0x%lx, size: 0x%lx, is_write: %d)\n",
+        entry->id, entry->addr, entry->size, entry->type == gv::Io_request_write);
+
+    // The data is accessed in place, it must be entirely inside the data area
+    if (entry->offset > this->shm->data_size || entry->size > this->shm->data_size - entry->offset)
+    {
+        this->shm_reply(entry->id, gv::Io_request_ko, this->time.get_time());
+        return;
+    }
+
+    vp::IoReq *req = this->req_pool.alloc();
     req->init();
-    req->set_addr(io_req->addr);
-    req->set_size(io_req->size);
-    req->set_is_write(io_req->type == gv::Io_request_write);
-    req->set_data(io_req->data);
-    req->arg_push(io_req);
+    req->set_addr(entry->addr);
+    req->set_size(entry->size);
+    req->set_is_write(entry->type == gv::Io_request_write);
+    req->set_data(this->shm_data + entry->offset);
+    req->arg_push((void *)entry->id);
+    req->arg_push((void *)this);
 
     int err = this->out.req(req);
     if (err == vp::IO_REQ_OK || err == vp::IO_REQ_INVALID)
     {
-        this->response(this, req);
+        int64_t timestamp = this->time.get_time() + req->get_full_latency() * this->clock.get_period();
+        req->arg_pop();
+        uint64_t id = (uint64_t)req->arg_pop();
+        this->req_pool.free(req);
+        this->shm_reply(id, err == vp::IO_REQ_OK ? gv::Io_request_ok : gv::Io_request_ko, timestamp);
+    }
+    else if (err == vp::IO_REQ_DENIED)
+    {
+        this->shm_denied_req = req;
     }
-    this->time.get_engine()->unlock();
+}
+
+void Router_proxy::shm_reply(uint64_t id, gv::Io_request_status status, int64_t timestamp)
+{
+    // The client never has more pending requests than entries, so there is always room
+    uint64_t head = this->shm->rsp.head.load(std::memory_order_relaxed);
+    gv::Io_shm_entry *entry = &this->shm_rsp_entries[head % this->shm->nb_entries];
+    entry->id = id;
+    entry->status = status;
+    entry->timestamp = timestamp;
+    this->shm->rsp.head.store(head + 1, std::memory_order_release);
+    gv::io_shm_ring_notify(&this->shm->rsp);
 }
 
 
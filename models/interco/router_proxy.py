@@ -18,7 +18,16 @@ import gvsoc.systree as st
 
 class Router_proxy(st.Component):
 
-    def __init__(self, parent, name):
+    def __init__(self, parent, name, shm=None, shm_entries=256, shm_data_size=1024*1024):
         super(Router_proxy, self).__init__(parent, name)
 
-        self.set_component('interco.router_proxy')
\ No newline at end of file
+        self.set_component('interco.router_proxy')
+
+        # When shm is set, another process can inject requests through a shared memory of this
+        # name, see gv/io_shm.hpp
+        if shm is not None:
+            self.add_properties({
+                'shm': shm,
+                'shm_entries': shm_entries,
+                'shm_data_size': shm_data_size
+            })
\ No newline at end of file
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+/*
+ * Analytical DRAM model.
+ *
+ * Instead of simulating each DRAM command, the controller state is updated when a request arrives
+ * and the request is immediately granted with the latency it would get on the DRAM, so that
+ * the cost per request stays low. The state is the open row and the timing constraints of each
+ * bank, the time where the data bus is free, the direction of the last transfer, and the time of
+ * the next refresh.
+ * All timings are in picoseconds and the requests are handled in their order of arrival.
+ * A request crossing page boundaries is split into one access per page, each one charged to the
+ * bank and row it falls into, and their data transfers are serialized on the data bus.
+ * Atomic operations are not supported and are rejected.
+ */
+
+
+class DramBank
+{
+public:
+    // Row currently in the row buffer, or -1 if the bank is precharged
+    int64_t open_row = -1;
+    // Time where the bank can receive a command, after a refresh
+    int64_t ready = 0;
+    // Time where the open row was activated
+    int64_t activate = 0;
+    // Time where the open row can be precharged
+    int64_t precharge_ready = 0;
+};
+
+
+class Dram : public vp::Component
+{
+
+public:
+    Dram(vp::ComponentConf &config);
+    ~Dram();
+
+    void reset(bool active);
+
+    static vp::IoReqStatus req(vp::Block *__this, vp::IoReq *req);
+
+private:
+    // Get a DRAM timing given in DRAM clock cycles, in picoseconds
+    int64_t get_timing(std::string name);
+    // Close all the banks if refreshes happened before the specified time
+    void refresh(int64_t time);
+    // Update the state of the bank and of the data bus for an access which does not cross a
+    // page, and return the time where its data transfer is over
+    int64_t access(int64_t time, uint64_t offset, uint64_t size, bool is_write);
+
+    vp::Trace trace;
+    vp::IoSlave in;
+
+    uint64_t size;
+    uint8_t *mem_data;
+
+    // Address mapping, from MSB to LSB: row, bank, column
+    uint64_t page_size;
+    int nb_banks;
+    // Number of bytes transferred per burst, and duration of the burst
+    int burst_bytes;
+    int64_t t_burst;
+
+    // DRAM clock period, in picoseconds
+    int64_t t_ck;
+    int64_t t_cl;
+    int64_t t_wl;
+    int64_t t_rcd;
+    int64_t t_rp;
+    int64_t t_ras;
+    int64_t t_wr;
+    int64_t t_wtr;
+    int64_t t_rtw;
+    int64_t t_rfc;
+    int64_t t_refi;
+
+    std::vector<DramBank> banks;
+    int64_t bus_ready;
+    bool last_is_write;
+    int64_t next_refresh;
+
+    // Statistics, reported through traces
+    int64_t nb_row_hits;
+    int64_t nb_row_misses;
+    int64_t nb_row_conflicts;
+};
+
+
+
+Dram::Dram(vp::ComponentConf &config)
+    : vp::Component(config)
+{
+    this->traces.new_trace("trace", &this->trace, vp::DEBUG);
+
+    this->in.set_req_meth(&Dram::req);
+    this->new_slave_port("input", &this->in);
+
+    js::Config *js_config = this->get_js_config();
+
+    this->size = js_config->get_int("size");
+    this->page_size = js_config->get_int("page_size");
+    this->nb_banks = js_config->get_child_int("nb_banks");
+
+    this->t_ck = js_config->get_int("t_ck");
+    this->t_cl = this->get_timing("cl");
+    this->t_wl = this->get_timing("wl");
+    this->t_rcd = this->get_timing("rcd");
+    this->t_rp = this->get_timing("rp");
+    this->t_ras = this->get_timing("ras");
+    this->t_wr = this->get_timing("wr");
+    this->t_wtr = this->get_timing("wtr");
+    this->t_rtw = this->get_timing("rtw");
+    this->t_rfc = this->get_timing("rfc");
+    this->t_refi = this->get_timing("refi");
+
+    // A burst transfers burst_length beats of the bus width, and data_rate beats per cycle
+    int burst_length = js_config->get_child_int("burst_length");
+    int data_rate = js_config->get_child_int("data_rate");
+    this->burst_bytes = burst_length * js_config->get_child_int("width") / 8;
+    this->t_burst = burst_length / data_rate * this->t_ck;
+
+    if (this->page_size == 0 || this->nb_banks == 0 || this->burst_bytes == 0 || this->t_ck == 0)
+    {
+        this->trace.fatal("Invalid DRAM configuration (page_size: %ld, nb_banks: %d, burst_bytes: %d, t_ck: %ld)\n",
+            this->page_size, this->nb_banks, this->burst_bytes, this->t_ck);
+        return;
+    }
+
+    this->banks.resize(this->nb_banks);
+
+    this->trace.msg("Building DRAM (size: 0x%lx, page_size: 0x%lx, nb_banks: %d, t_ck: %ld ps)\n",
+        this->size, this->page_size, this->nb_banks, this->t_ck);
+
+    // DRAM are usually huge, host pages are only allocated when they are first accessed
+    void *data = mmap(NULL, this->size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    this->mem_data = (uint8_t *)data;
+}
+
+
+
+Dram::~Dram()
+{
+    munmap(this->mem_data, this->size);
+}
+
+
+
+int64_t Dram::get_timing(std::string name)
+{
+    return this->get_js_config()->get_int("timings/" + name) * this->t_ck;
+}
+
+
+
+void Dram::reset(bool active)
+{
+    if (active)
+    {
+        for (DramBank &bank : this->banks)
+        {
+            bank = DramBank();
+        }
+        this->bus_ready = 0;
+        this->last_is_write = false;
+        this->next_refresh = this->t_refi;
+        this->nb_row_hits = 0;
+        this->nb_row_misses = 0;
+        this->nb_row_conflicts = 0;
+    }
+}
+
+
+
+void Dram::refresh(int64_t time)
+{
+    if (this->t_refi == 0 || time < this->next_refresh)
+    {
+        return;
+    }
+
+    // Several refreshes may have happened since the last request, only the last one matters
+    // since all banks are closed by a refresh
+    int64_t nb_refresh = (time - this->next_refresh) / this->t_refi + 1;
+    int64_t refresh_time = this->next_refresh + (nb_refresh - 1) * this->t_refi;
+    this->next_refresh += nb_refresh * this->t_refi;
+
+    this->trace.msg(vp::Trace::LEVEL_TRACE, "Refresh (time: %ld)\n", refresh_time);
+
+    for (DramBank &bank : this->banks)
+    {
+        bank.open_row = -1;
+        bank.ready = std::max(bank.precharge_ready, refresh_time) + this->t_rp + this->t_rfc;
+    }
+}
+
+
+
+int64_t Dram::access(int64_t time, uint64_t offset, uint64_t size, bool is_write)
+{
+    uint64_t page = offset / this->page_size;
+    DramBank &bank = this->banks[page % this->nb_banks];
+    int64_t row = page / this->nb_banks;
+
+    // Time where the column command can be sent, depending on the row buffer state
+    int64_t cmd_time = std::max(time, bank.ready);
+    if (bank.open_row == row)
+    {
+        this->nb_row_hits++;
+    }
+    else
+    {
+        if (bank.open_row == -1)
+        {
+            this->nb_row_misses++;
+        }
+        else
+        {
+            // The open row must be precharged first
+            this->nb_row_conflicts++;
+            cmd_time = std::max(cmd_time, bank.precharge_ready) + this->t_rp;
+        }
+
+        bank.open_row = row;
+        bank.activate = cmd_time;
+        cmd_time += this->t_rcd;
+    }
+
+    // The data bus must be turned around when the direction changes
+    int64_t bus_ready = this->bus_ready;
+    if (is_write != this->last_is_write)
+    {
+        bus_ready += is_write ? this->t_rtw : this->t_wtr;
+    }
+    this->last_is_write = is_write;
+
+    int64_t nb_bursts = (size + this->burst_bytes - 1) / this->burst_bytes;
+    int64_t data_start = std::max(cmd_time + (is_write ? this->t_wl : this->t_cl), bus_ready);
+    int64_t data_end = data_start + nb_bursts * this->t_burst;
+
+    this->bus_ready = data_end;
+    // The row can be precharged once the write data is stored, and not before the
+    // activation is old enough
+    bank.precharge_ready = std::max(bank.activate + this->t_ras,
+        std::max(bank.precharge_ready, is_write ? data_end + this->t_wr : data_end));
+
+    this->trace.msg(vp::Trace::LEVEL_TRACE, "DRAM access timing "
+        "(offset: 0x%lx, size: 0x%lx, bank: %ld, row: %ld, data_end: %ld)\n",
+        offset, size, page % this->nb_banks, row, data_end);
+
+    return data_end;
+}
+
+
+
+vp::IoReqStatus Dram::req(vp::Block *__this, vp::IoReq *req)
+{
+    Dram *_this = (Dram *)__this;
+
+    uint64_t offset = req->get_addr();
+    uint8_t *data = req->get_data();
+    uint64_t size = req->get_size();
+    bool is_write = req->get_is_write();
+
+    _this->trace.msg("DRAM access (offset: 0x%lx, size: 0x%lx, is_write: %d)\n", offset, size, is_write);
+
+    if (offset + size > _this->size)
+    {
+        _this->trace.force_warning("Received out-of-bound request (reqAddr: 0x%lx, reqSize: 0x%lx, memSize: 0x%lx)\n",
+            offset, size, _this->size);
+        return vp::IO_REQ_INVALID;
+    }
+
+    if (req->get_opcode() > vp::IoReqOpcode::WRITE)
+    {
+        _this->trace.force_warning("Received unsupported atomic operation\n");
+        return vp::IO_REQ_INVALID;
+    }
+
+    if (data)
+    {
+        if (is_write)
+        {
+            memcpy(&_this->mem_data[offset], data, size);
+        }
+        else
+        {
+            memcpy(data, &_this->mem_data[offset], size);
+        }
+    }
+
+    int64_t time = _this->time.get_time();
+
+    _this->refresh(time);
+
+    // Accesses are serialized on the data bus, so the last one is the last to finish
+    int64_t data_end = time;
+    uint64_t access_offset = offset;
+    uint64_t remaining = size;
+    while (remaining > 0)
+    {
+        uint64_t access_size = std::min(remaining,
+            _this->page_size - access_offset % _this->page_size);
+        data_end = _this->access(time, access_offset, access_size, is_write);
+        access_offset += access_size;
+        remaining -= access_size;
+    }
+
+    int64_t period = _this->clock.get_period();
+    if (period != 0)
+    {
+        int64_t latency = (data_end - time + period - 1) / period;
+        _this->trace.msg(vp::Trace::LEVEL_TRACE, "DRAM timing "
+            "(latency: %ld, hits: %ld, misses: %ld, conflicts: %ld)\n",
+            latency, _this->nb_row_hits, _this->nb_row_misses, _this->nb_row_conflicts);
+        req->inc_latency(latency);
+    }
+
+    return vp::IO_REQ_OK;
+}
+
+
+
+extern "C" vp::Component *gv_new(vp::ComponentConf &config)
+{
+    return new Dram(config);
+}
@@ -0,0 +1,138 @@
+#
+# Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and University of Bologna
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import json
+import gvsoc.systree
+
+
+# DDR4-2400 x16 device, in the DRAMSys memspec format
+default_memspec = {
+    "memspec": {
+        "memarchitecturespec": {
+            "burstLength": 8,
+            "dataRate": 2,
+            "nbrOfBanks": 16,
+            "nbrOfColumns": 1024,
+            "width": 16
+        },
+        "memtimingspec": {
+            "clkMhz": 1200,
+            "CL": 16,
+            "WL": 12,
+            "RCD": 16,
+            "RP": 16,
+            "RAS": 39,
+            "WR": 18,
+            "WTR_L": 9,
+            "RFC1": 313,
+            "REFI": 9360
+        }
+    }
+}
+
+
+class Dram(gvsoc.systree.Component):
+    """Analytical DRAM model
+
+    This models a DRAM with its controller, without going through SystemC.
+    Each request gets the latency it would have on the DRAM, which takes into account the row
+    buffer of each bank, the data bus occupancy, read/write turnarounds and refreshes. The
+    address is mapped to row, then bank, then column.
+    A request crossing page boundaries is charged to every bank and row it touches, with its
+    data transfers serialized on the data bus. Atomic operations are not supported and are
+    rejected as invalid requests.
+
+    Attributes
+    ----------
+    parent: gvsoc.systree.Component
+        The parent component where this one should be instantiated.
+    name: str
+        The name of the component within the parent space.
+    size: int
+        The size of the memory in bytes.
+    memspec: str
+        The path to a DRAMSys memory specification in JSON format. The timings are taken from
+        its memtimingspec section and the geometry from its memarchitecturespec section. A
+        DDR4-2400 device is modeled if it is not specified.
+    """
+    def __init__(self, parent: gvsoc.systree.Component, name: str, size: int, memspec: str=None):
+
+        super().__init__(parent, name)
+
+        self.add_sources(['memory/dram.cpp'])
+
+        if memspec is None:
+            spec = default_memspec['memspec']
+        else:
+            with open(memspec, 'r') as file:
+                spec = json.load(file)['memspec']
+
+        arch = spec['memarchitecturespec']
+        timings = spec['memtimingspec']
+
+        def get_timing(*names, default=0):
+            for name in names:
+                if timings.get(name) is not None:
+                    return timings[name]
+            return default
+
+        burst_length = arch['burstLength']
+        data_rate = arch['dataRate']
+        width = arch['width'] * arch.get('nbrOfDevicesOnDIMM', 1)
+
+        if timings.get('tCK') is not None:
+            t_ck = int(timings['tCK'] * 1000)
+        else:
+            t_ck = int(1000000 / timings['clkMhz'])
+
+        cl = get_timing('CL')
+        wl = get_timing('WL')
+
+        self.add_properties({
+            'size': size,
+            'page_size': arch['nbrOfColumns'] * width // 8,
+            'nb_banks': arch['nbrOfBanks'],
+            'width': width,
+            'burst_length': burst_length,
+            'data_rate': data_rate,
+            't_ck': t_ck,
+            'timings': {
+                'cl': cl,
+                'wl': wl,
+                'rcd': get_timing('RCD'),
+                'rp': get_timing('RP', 'RPpb'),
+                'ras': get_timing('RAS'),
+                'wr': get_timing('WR'),
+                'wtr': get_timing('WTR', 'WTR_L', 'WTR_S'),
+                # Usual read to write turnaround, when the memspec does not give it
+                'rtw': get_timing('RTW', default=cl + burst_length // data_rate + 2 - wl),
+                'rfc': get_timing('RFC', 'RFC1', 'RFCab'),
+                'refi': get_timing('REFI', 'REFI1', 'REFIab')
+            }
+        })
+
+    def i_INPUT(self) -> gvsoc.systree.SlaveItf:
+        """Returns the input port.
+
+        Incoming requests to be handled by the DRAM should be sent to this port.\n
+        It instantiates a port of type vp::IoSlave.\n
+
+        Returns
+        ----------
+        gvsoc.systree.SlaveItf
+            The slave interface
+        """
+        return gvsoc.systree.SlaveItf(self, 'input', signature='io')
@@ -22,8 +22,14 @@
 #include <vp/vp.hpp>
 #include <vp/itf/io.hpp>
 #include <vp/itf/wire.hpp>
+#include <vp/time/stop_condition.hpp>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
 
 
 class Memory : public vp::Component
@@ -31,12 +37,27 @@ class Memory : public vp::Component
 
 public:
     Memory(vp::ComponentConf &config);
+    ~Memory();
 
     void reset(bool active);
+    bool stop_condition_arm(vp::StopCondition *condition) override;
+    void stop_condition_disarm(vp::StopCondition *condition) override;
 
     static vp::IoReqStatus req(vp::Block *__this, vp::IoReq *req);
+    // Request handler used while the memory is instrumented
+    static vp::IoReqStatus req_instrumented(vp::Block *__this, vp::IoReq *req);
 
 private:
+    vp::IoReqStatus req_full(vp::IoReq *req);
+    // Handle a burst request, whose chunks are copied in one call
+    vp::IoReqStatus req_burst(vp::IoReq *req);
+    inline void account_bandwidth(vp::IoReq *req, uint64_t size);
+    inline void account_access_energy(bool is_write, uint64_t size);
+    // Check if requests can go through the fast path, which must be done everytime one of the
+    // features handled by the full path is enabled or disabled
+    void check_fast_req();
+    // Check the stop conditions of the words overlapping a write
+    void stop_conditions_check(uint64_t offset, uint64_t size);
     static void power_ctrl_sync(vp::Block *__this, bool value);
     static void meminfo_sync_back(vp::Block *__this, void **value);
     static void meminfo_sync(vp::Block *__this, void *value);
@@ -44,6 +65,11 @@ private:
     vp::IoReqStatus handle_read(uint64_t addr, uint64_t size, uint8_t *data);
     vp::IoReqStatus handle_atomic(uint64_t addr, uint64_t size, uint8_t *in_data, uint8_t *out_data,
         vp::IoReqOpcode opcode, int initiator);
+    uint8_t *sparse_alloc(uint64_t size);
+    void load_image();
+    // Read the stim file into the specified memory array
+    void read_stim_file(uint8_t *data);
+    void restore_image();
 
     vp::Trace trace;
     vp::IoSlave in;
@@ -55,6 +81,16 @@ private:
     uint8_t *mem_data;
     uint8_t *check_mem;
 
+    // True if the memory array is mapped on demand, page per page, instead of being fully
+    // allocated
+    bool sparse = false;
+    // True if the initial image must be restored when the memory is reset
+    bool reset_image = false;
+    bool first_reset = true;
+    // Memory array allocated by this model, since it can be replaced through meminfo
+    uint8_t *alloc_data;
+    std::string stim_file;
+
     int64_t next_packet_start;
 
     vp::WireSlave<bool> power_ctrl_itf;
@@ -74,8 +110,18 @@ private:
     vp::ClockEvent *power_event;
     int64_t last_access_timestamp;
 
-    // Load-reserved reservation table
-    std::map<uint64_t, uint64_t> res_table;
+    // True if the memory is on and no power trigger, access checking or stop condition is
+    // enabled, in which case plain reads and writes go through the fast path. Traces and power
+    // accounting are handled by switching to the instrumented request handler.
+    bool fast_req = false;
+
+    // Stop conditions on memory words. They are checked on writes received on the input port,
+    // writes done directly through the meminfo pointer are not seen.
+    std::vector<vp::StopCondition *> stop_conditions;
+
+    // Load-reserved reservation table, giving the reserved address for each initiator. The
+    // initiator is shifted by one, since requests without initiator have -1
+    std::vector<uint64_t> res_table;
 };
 
 
@@ -85,6 +131,8 @@ Memory::Memory(vp::ComponentConf &config)
 {
     traces.new_trace("trace", &trace, vp::DEBUG);
     in.set_req_meth(&Memory::req);
+    in.set_req_meth_instrumented(&Memory::req_instrumented);
+    in.set_burst_support(true);
     new_slave_port("input", &in);
 
     this->power_ctrl_itf.set_sync_meth(&Memory::power_ctrl_sync);
@@ -112,7 +160,17 @@ Memory::Memory(vp::ComponentConf &config)
 
     trace.msg("Building Memory (size: 0x%x, check: %d)\n", size, check);
 
-    if (align)
+    this->sparse = get_js_config()->get_child_bool("sparse");
+    this->reset_image = get_js_config()->get_child_bool("reset_image");
+
+    if (this->sparse)
+    {
+        // Host pages are only allocated when they are first accessed, so that huge memories
+        // only cost what the simulated software is using. They are then initialized to 0.
+        // Mappings are page-aligned, which covers the usual alignment constraints.
+        mem_data = this->sparse_alloc(size);
+    }
+    else if (align)
     {
         mem_data = (uint8_t *)aligned_alloc(align, size);
     }
@@ -121,148 +179,428 @@ Memory::Memory(vp::ComponentConf &config)
         mem_data = (uint8_t *)calloc(size, 1);
         if (mem_data == NULL) throw std::bad_alloc();
     }
+    this->alloc_data = mem_data;
 
     // Special option to check for uninitialized accesses
     if (check)
     {
-        check_mem = new uint8_t[(size + 7) / 8];
+        if (this->sparse)
+        {
+            check_mem = this->sparse_alloc((size + 7) / 8);
+        }
+        else
+        {
+            check_mem = new uint8_t[(size + 7) / 8];
+        }
     }
     else
     {
         check_mem = NULL;
     }
 
-    // Initialize the Memory with a special value to detect uninitialized
-    // variables
-    memset(mem_data, 0x57, size);
-
-    // Preload the Memory
     js::Config *stim_file_conf = this->get_js_config()->get("stim_file");
     if (stim_file_conf != NULL)
     {
-        string path = stim_file_conf->get_str();
-        if (path != "")
+        this->stim_file = stim_file_conf->get_str();
+    }
+
+    this->load_image();
+
+    // The advice must be given once the stim file is mapped, since the mapping replaces the
+    // one it was given to
+    if (this->sparse && get_js_config()->get_child_bool("hugepages"))
+    {
+        madvise(this->alloc_data, this->size, MADV_HUGEPAGE);
+    }
+
+    this->background_power.leakage_power_start();
+    this->background_power.dynamic_power_start();
+    this->last_access_timestamp = -1;
+}
+
+
+
+Memory::~Memory()
+{
+    if (this->sparse)
+    {
+        munmap(this->alloc_data, this->size);
+        if (this->check_mem)
         {
-            trace.msg("Preloading Memory with stimuli file (path: %s)\n", path.c_str());
+            munmap(this->check_mem, (this->size + 7) / 8);
+        }
+    }
+}
+
+
+
+uint8_t *Memory::sparse_alloc(uint64_t size)
+{
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    return (uint8_t *)data;
+}
+
+
+
+void Memory::load_image()
+{
+    if (!this->sparse)
+    {
+        // Initialize the Memory with a special value to detect uninitialized
+        // variables
+        memset(this->alloc_data, 0x57, this->size);
+    }
+
+    // Preload the Memory
+    if (this->stim_file == "")
+    {
+        return;
+    }
+
+    trace.msg("Preloading Memory with stimuli file (path: %s)\n", this->stim_file.c_str());
+
+    if (this->sparse)
+    {
+        // The file is mapped copy-on-write over the beginning of the memory, so that its pages
+        // are only read when they are accessed, and written pages stay private to the model
+        int fd = open(this->stim_file.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            this->trace.fatal("Unable to open stim file: %s, %s\n", this->stim_file.c_str(), strerror(errno));
+            return;
+        }
+
+        struct stat stat;
+        if (fstat(fd, &stat) == -1 || stat.st_size == 0)
+        {
+            ::close(fd);
+            this->trace.fatal("Failed to read stim file: %s, %s\n", this->stim_file.c_str(), strerror(errno));
+            return;
+        }
+
+        uint64_t map_size = std::min((uint64_t)stat.st_size, this->size);
+        if (mmap(this->alloc_data, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+            fd, 0) == MAP_FAILED)
+        {
+            ::close(fd);
+            this->trace.fatal("Failed to map stim file: %s, %s\n", this->stim_file.c_str(), strerror(errno));
+            return;
+        }
+
+        ::close(fd);
+    }
+    else
+    {
+        this->read_stim_file(this->alloc_data);
+    }
+}
+
+
+
+void Memory::read_stim_file(uint8_t *data)
+{
+    FILE *file = fopen(this->stim_file.c_str(), "rb");
+    if (file == NULL)
+    {
+        this->trace.fatal("Unable to open stim file: %s, %s\n", this->stim_file.c_str(), strerror(errno));
+        return;
+    }
+    if (fread(data, 1, size, file) == 0)
+    {
+        this->trace.fatal("Failed to read stim file: %s, %s\n", this->stim_file.c_str(), strerror(errno));
+        return;
+    }
+    fclose(file);
+}
+
+
+
+void Memory::restore_image()
+{
+    if (this->check_mem)
+    {
+        if (this->sparse)
+        {
+            madvise(this->check_mem, (this->size + 7) / 8, MADV_DONTNEED);
+        }
+        else
+        {
+            memset(this->check_mem, 0, (this->size + 7) / 8);
+        }
+    }
+
+    if (this->mem_data != this->alloc_data)
+    {
+        // The memory array was replaced through meminfo, the image is restored into the array
+        // in use, with the initial content of the memory type
+        memset(this->mem_data, this->sparse ? 0 : 0x57, this->size);
+        if (this->stim_file != "")
+        {
+            this->read_stim_file(this->mem_data);
+        }
+    }
+    else if (this->sparse)
+    {
+        // Dropping the pages makes them go back to 0, or to the content of the stim file for the
+        // pages where it is mapped, without having to write the whole memory
+        madvise(this->alloc_data, this->size, MADV_DONTNEED);
+    }
+    else
+    {
+        this->load_image();
+    }
+}
+
+
+
+void Memory::check_fast_req()
+{
+    this->fast_req = this->powered_up && this->check_mem == NULL && !this->power_trigger &&
+        this->stop_conditions.size() == 0;
+}
+
+
+
+inline void Memory::account_bandwidth(vp::IoReq *req, uint64_t size)
+{
+    // Impact the Memory bandwith on the packet
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+    int duration = MAX(size >> this->width_bits, 1);
+    req->set_duration(duration);
+    int64_t cycles = this->clock.get_cycles();
+    int64_t diff = this->next_packet_start - cycles;
+    if (diff > 0)
+    {
+        this->trace.msg("Delayed packet (latency: %ld)\n", diff);
+        req->inc_latency(diff);
+    }
+    this->next_packet_start = MAX(this->next_packet_start, cycles) + duration;
+}
+
+
 
-            FILE *file = fopen(path.c_str(), "rb");
-            if (file == NULL)
+vp::IoReqStatus Memory::req(vp::Block *__this, vp::IoReq *req)
+{
+    Memory *_this = (Memory *)__this;
+
+    if (unlikely(req->is_burst()))
+    {
+        return _this->req_burst(req);
+    }
+
+    if (likely(_this->fast_req))
+    {
+        uint64_t offset = req->get_addr();
+        uint8_t *data = req->get_data();
+        uint64_t size = req->get_size();
+        vp::IoReqOpcode opcode = req->get_opcode();
+
+        // Only plain reads and writes are handled here, anything else, including errors, goes
+        // through the full path
+        if (likely(opcode <= vp::IoReqOpcode::WRITE && offset + size <= _this->size))
+        {
+            if (_this->width_bits != 0)
             {
-                this->trace.fatal("Unable to open stim file: %s, %s\n", path.c_str(), strerror(errno));
-                return;
+                _this->account_bandwidth(req, size);
             }
-            if (fread(this->mem_data, 1, size, file) == 0)
+
+            if (data)
             {
-                this->trace.fatal("Failed to read stim file: %s, %s\n", path.c_str(), strerror(errno));
-                return;
+                if (opcode == vp::IoReqOpcode::READ)
+                {
+                    memcpy(data, &_this->mem_data[offset], size);
+                }
+                else
+                {
+                    memcpy(&_this->mem_data[offset], data, size);
+                }
             }
+            return vp::IO_REQ_OK;
         }
     }
 
-    this->background_power.leakage_power_start();
-    this->background_power.dynamic_power_start();
-    this->last_access_timestamp = -1;
+    return _this->req_full(req);
 }
 
 
 
-vp::IoReqStatus Memory::req(vp::Block *__this, vp::IoReq *req)
+inline void Memory::account_access_energy(bool is_write, uint64_t size)
 {
-    Memory *_this = (Memory *)__this;
+    this->last_access_timestamp = this->time.get_time();
+
+    if (is_write)
+    {
+        if (size == 1)
+            this->write_8_power.account_energy_quantum();
+        else if (size == 2)
+            this->write_16_power.account_energy_quantum();
+        else if (size == 4)
+            this->write_32_power.account_energy_quantum();
+    }
+    else
+    {
+        if (size == 1)
+            this->read_8_power.account_energy_quantum();
+        else if (size == 2)
+            this->read_16_power.account_energy_quantum();
+        else if (size == 4)
+            this->read_32_power.account_energy_quantum();
+    }
+}
+
 
+
+vp::IoReqStatus Memory::req_burst(vp::IoReq *req)
+{
     uint64_t offset = req->get_addr();
     uint8_t *data = req->get_data();
     uint64_t size = req->get_size();
+    uint64_t chunk = req->get_burst_chunk();
+    bool is_write = req->get_is_write();
 
-    if (!_this->powered_up)
+    if (!this->powered_up)
     {
-        _this->trace.force_warning("Accessing Memory while it is down (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
+        this->trace.force_warning("Accessing Memory while it is down (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, is_write);
         return vp::IO_REQ_INVALID;
     }
 
-    _this->trace.msg("Memory access (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
+    this->trace.msg("Memory burst access (offset: 0x%x, size: 0x%x, chunk: 0x%x, is_write: %d)\n", offset, size, chunk, is_write);
 
-    // Impact the Memory bandwith on the packet
-    if (_this->width_bits != 0)
+    if (req->get_opcode() > vp::IoReqOpcode::WRITE)
     {
-#define MAX(a, b) (((a) > (b)) ? (a) : (b))
-        int duration = MAX(size >> _this->width_bits, 1);
-        req->set_duration(duration);
-        int64_t cycles = _this->clock.get_cycles();
-        int64_t diff = _this->next_packet_start - cycles;
-        if (diff > 0)
-        {
-            _this->trace.msg("Delayed packet (latency: %ld)\n", diff);
-            req->inc_latency(diff);
-        }
-        _this->next_packet_start = MAX(_this->next_packet_start, cycles) + duration;
+        this->trace.force_warning("Received burst with atomic operation\n");
+        return vp::IO_REQ_INVALID;
+    }
+
+    if (offset + req->get_burst_span() > this->size)
+    {
+        this->trace.force_warning("Received out-of-bound burst (reqAddr: 0x%x, reqSpan: 0x%x, memSize: 0x%x)\n", offset, req->get_burst_span(), this->size);
+        return vp::IO_REQ_INVALID;
     }
 
-    if (_this->power.get_power_trace()->get_active())
+    // The burst occupies the memory like a single request of the same size
+    if (this->width_bits != 0)
     {
-        _this->last_access_timestamp = _this->time.get_time();
+        this->account_bandwidth(req, size);
+    }
 
-        if (req->get_is_write())
+    bool account_energy = this->power.get_power_trace()->get_active();
+    int64_t addr_stride = req->get_burst_addr_stride();
+    int64_t data_stride = req->get_burst_data_stride();
+
+    while (size)
+    {
+        uint64_t chunk_size = size < chunk ? size : chunk;
+
+        if (unlikely(account_energy))
         {
-            if (size == 1)
-                _this->write_8_power.account_energy_quantum();
-            else if (size == 2)
-                _this->write_16_power.account_energy_quantum();
-            else if (size == 4)
-                _this->write_32_power.account_energy_quantum();
+            this->account_access_energy(is_write, chunk_size);
         }
-        else
+
+        vp::IoReqStatus status = is_write ? this->handle_write(offset, chunk_size, data) :
+            this->handle_read(offset, chunk_size, data);
+        if (status != vp::IO_REQ_OK)
         {
-            if (size == 1)
-                _this->read_8_power.account_energy_quantum();
-            else if (size == 2)
-                _this->read_16_power.account_energy_quantum();
-            else if (size == 4)
-                _this->read_32_power.account_energy_quantum();
+            return status;
         }
+
+        size -= chunk_size;
+        offset += addr_stride;
+        if (data)
+        {
+            data += data_stride;
+        }
+    }
+
+    return vp::IO_REQ_OK;
+}
+
+
+
+vp::IoReqStatus Memory::req_instrumented(vp::Block *__this, vp::IoReq *req)
+{
+    Memory *_this = (Memory *)__this;
+
+    if (unlikely(req->is_burst()))
+    {
+        return _this->req_burst(req);
+    }
+
+    return _this->req_full(req);
+}
+
+
+
+vp::IoReqStatus Memory::req_full(vp::IoReq *req)
+{
+    uint64_t offset = req->get_addr();
+    uint8_t *data = req->get_data();
+    uint64_t size = req->get_size();
+
+    if (!this->powered_up)
+    {
+        this->trace.force_warning("Accessing Memory while it is down (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
+        return vp::IO_REQ_INVALID;
+    }
+
+    this->trace.msg("Memory access (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
+
+    if (this->width_bits != 0)
+    {
+        this->account_bandwidth(req, size);
+    }
+
+    if (this->power.get_power_trace()->get_active())
+    {
+        this->account_access_energy(req->get_is_write(), size);
     }
 
 #ifdef VP_TRACE_ACTIVE
-    if (_this->power_trigger)
+    if (this->power_trigger)
     {
         if (req->get_is_write() && size == 4 && offset == 0)
         {
             if (*(uint32_t *)data == 0xabbaabba)
             {
-                _this->power.get_engine()->start_capture();
+                this->power.get_engine()->start_capture();
             }
             else if (*(uint32_t *)data == 0xdeadcaca)
             {
                 static int measure_index = 0;
-                _this->power.get_engine()->stop_capture();
+                this->power.get_engine()->stop_capture();
                 double dynamic_power, static_power;
-                fprintf(stderr, "@power.measure_%d@%f@\n", measure_index++, _this->power.get_engine()->get_average_power(dynamic_power, static_power));
+                fprintf(stderr, "@power.measure_%d@%f@\n", measure_index++, this->power.get_engine()->get_average_power(dynamic_power, static_power));
             }
         }
     }
 #endif
 
-    if (offset + size > _this->size)
+    if (offset + size > this->size)
     {
-        _this->trace.force_warning("Received out-of-bound request (reqAddr: 0x%x, reqSize: 0x%x, memSize: 0x%x)\n", offset, size, _this->size);
+        this->trace.force_warning("Received out-of-bound request (reqAddr: 0x%x, reqSize: 0x%x, memSize: 0x%x)\n", offset, size, this->size);
         return vp::IO_REQ_INVALID;
     }
 
     if (req->get_opcode() == vp::IoReqOpcode::READ)
     {
-        return _this->handle_read(offset, size, data);
+        return this->handle_read(offset, size, data);
     }
     else if (req->get_opcode() == vp::IoReqOpcode::WRITE)
     {
-        return _this->handle_write(offset, size, data);
+        return this->handle_write(offset, size, data);
     }
     else
     {
 #ifdef CONFIG_ATOMICS
-        return _this->handle_atomic(offset, size, data, req->get_second_data(), req->get_opcode(),
+        return this->handle_atomic(offset, size, data, req->get_second_data(), req->get_opcode(),
             req->get_initiator());
 #else
-        _this->trace.force_warning("Received unsupported atomic operation\n");
+        this->trace.force_warning("Received unsupported atomic operation\n");
         return vp::IO_REQ_INVALID;
 #endif
     }
@@ -284,11 +622,65 @@ vp::IoReqStatus Memory::handle_write(uint64_t offset, uint64_t size, uint8_t *da
         memcpy((void *)&this->mem_data[offset], (void *)data, size);
     }
 
+    if (unlikely(this->stop_conditions.size() != 0))
+    {
+        this->stop_conditions_check(offset, size);
+    }
+
     return vp::IO_REQ_OK;
 }
 
 
 
+bool Memory::stop_condition_arm(vp::StopCondition *condition)
+{
+    gv::StopCondition &config = condition->config;
+
+    if (config.type != gv::Stop_condition_mem || config.size <= 0 || config.size > 8 ||
+        config.addr + config.size > this->size)
+    {
+        return false;
+    }
+
+    this->stop_conditions.push_back(condition);
+    this->check_fast_req();
+
+    // The word may already have the expected value
+    this->stop_conditions_check(config.addr, config.size);
+
+    return true;
+}
+
+
+
+void Memory::stop_condition_disarm(vp::StopCondition *condition)
+{
+    this->stop_conditions.erase(std::remove(this->stop_conditions.begin(),
+        this->stop_conditions.end(), condition), this->stop_conditions.end());
+    this->check_fast_req();
+}
+
+
+
+void Memory::stop_conditions_check(uint64_t offset, uint64_t size)
+{
+    for (vp::StopCondition *condition : this->stop_conditions)
+    {
+        gv::StopCondition &config = condition->config;
+        if (config.addr < offset + size && offset < config.addr + config.size)
+        {
+            uint64_t value = 0;
+            memcpy(&value, &this->mem_data[config.addr], config.size);
+            if ((value & config.mask) == (config.value & config.mask))
+            {
+                condition->hit();
+            }
+        }
+    }
+}
+
+
+
 vp::IoReqStatus Memory::handle_read(uint64_t offset, uint64_t size, uint8_t *data)
 {
     if (this->check_mem)
@@ -336,20 +728,26 @@ vp::IoReqStatus Memory::handle_atomic(uint64_t addr, uint64_t size, uint8_t *in_
         prev_val = get_signed_value(prev_val, size*8);
     }
 
+    unsigned int res_index = initiator + 1;
+    if (res_index >= this->res_table.size())
+    {
+        this->res_table.resize(res_index + 1, (uint64_t)-1);
+    }
+
     switch (opcode)
     {
         case vp::IoReqOpcode::LR:
-            this->res_table[initiator] = addr;
+            this->res_table[res_index] = addr;
             is_write = false;
             break;
         case vp::IoReqOpcode::SC:
-            if (this->res_table[initiator] == addr)
+            if (this->res_table[res_index] == addr)
             {
                 // Valid reservation --> clear all others as we are going to write
-                for (auto &it : this->res_table) {
-                    if (it.second >= addr && it.second < addr+size)
+                for (uint64_t &res_addr : this->res_table) {
+                    if (res_addr >= addr && res_addr < addr+size)
                     {
-                        it.second = -1;
+                        res_addr = -1;
                     }
                 }
                 result   = operand;
@@ -409,6 +807,14 @@ void Memory::reset(bool active)
     {
         this->next_packet_start = 0;
         this->powered_up = true;
+        this->check_fast_req();
+
+        // The image is already there for the first reset
+        if (this->reset_image && !this->first_reset)
+        {
+            this->restore_image();
+        }
+        this->first_reset = false;
     }
 }
 
@@ -418,6 +824,7 @@ void Memory::power_ctrl_sync(vp::Block *__this, bool value)
 {
     Memory *_this = (Memory *)__this;
     _this->powered_up = value;
+    _this->check_fast_req();
 }
 
 
@@ -46,10 +46,20 @@ class Memory(gvsoc.systree.Component):
     atomics: bool
         True if the memory should support riscv atomics. Since this is slowing down the model, it
         should be set to True only if needed.
+    sparse: bool
+        True if the memory should be allocated on demand, page per page, so that huge memories
+        only cost the host memory which is actually accessed. The memory is then initialized with
+        zeros instead of a pattern, and the stim file is mapped instead of being read.
+    hugepages: bool
+        True if the host should back a sparse memory with huge pages.
+    reset_image: bool
+        True if the memory content should go back to its initial image when the memory is reset.
+        This is much faster for sparse memories, since only the accessed pages are dropped.
     """
     def __init__(self, parent: gvsoc.systree.Component, name: str, size: int, width_log2: int=2,
             stim_file: str=None, power_trigger: bool=False,
-            align: int=0, atomics: bool=False):
+            align: int=0, atomics: bool=False, sparse: bool=False, hugepages: bool=False,
+            reset_image: bool=False):
 
         super().__init__(parent, name)
 
@@ -66,7 +76,10 @@ class Memory(gvsoc.systree.Component):
             'stim_file': stim_file,
             'power_trigger': power_trigger,
             'width_bits': width_log2,
-            'align': align
+            'align': align,
+            'sparse': sparse,
+            'hugepages': hugepages,
+            'reset_image': reset_image
         })
 
     def i_INPUT(self) -> gvsoc.systree.SlaveItf:
@@ -0,0 +1,1628 @@
+/*
+ * Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and
+ *                    University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, GreenWaves Technologies (germain.haugou@greenwaves-technologies.com)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
+#include <vp/itf/wire.hpp>
+#include <vp/itf/uart.hpp>
+#include <vp/itf/qspim.hpp>
+#include <vp/itf/i2s.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include <queue>
+
+
+/*
+ * Bridge between two gvsoc processes, each simulating one chip of a board.
+ *
+ * Each process instantiates a bridge, with the same interfaces, and the two bridges are
+ * connected through a Unix socket or through a pair of rings in shared memory. What a local
+ * model sends to an interface of the bridge is sent as a timestamped message to the other
+ * bridge, which replays it on the interface of the same name, after a fixed latency.
+ *
+ * The two processes are synchronized with a conservative scheme. Since a message sent at time T
+ * is received at T + latency, a bridge knowing that the other side is at time T can safely run
+ * until T + latency. Once it reaches this point, it sends its own time to the other side and
+ * blocks until the other side has moved forward. The latency is then the lookahead of the
+ * synchronization, the bigger it is, the less often the processes are synchronized.
+ *
+ * Since messages are only needed by the other side once it reaches a synchronization point,
+ * they are buffered and only flushed when the bridge synchronizes.
+ */
+
+
+// Time in milliseconds after which a bridge waiting for the other side executes the commands
+// posted to its engine, before waiting again
+#define CHIP_BRIDGE_WAIT_MS 10
+
+
+typedef enum
+{
+    // Time of the sender, sent when it reaches its synchronization point
+    CHIP_BRIDGE_SYNC,
+    // The sender is over and will not send anything anymore
+    CHIP_BRIDGE_END,
+    // IO request, args are request identifier, address, size, opcode, payload is the data
+    // for requests other than reads
+    CHIP_BRIDGE_IO_REQ,
+    // IO response, args are request identifier and status, payload is the read data
+    CHIP_BRIDGE_IO_RSP,
+    // Wire value, args are the value
+    CHIP_BRIDGE_WIRE,
+    // UART edge, args are data, sck, rtr and mask
+    CHIP_BRIDGE_UART,
+    // QSPI data edge, args are sck, data_0 to data_3 and mask
+    CHIP_BRIDGE_QSPIM,
+    // QSPI chip select, args are chip select and active
+    CHIP_BRIDGE_QSPIM_CS,
+    // I2S edge, args are sck, ws, sd and full_duplex
+    CHIP_BRIDGE_I2S,
+} ChipBridgeMsgType;
+
+
+// Message header, followed by size bytes of payload
+typedef struct
+{
+    uint32_t type;
+    // Index of the interface, which is the same on both sides
+    uint32_t itf;
+    // Time of the sender when the message was sent
+    int64_t time;
+    // Delay added to the latency when the message is replayed, for IO responses
+    int64_t delay;
+    uint64_t args[6];
+    uint64_t size;
+} ChipBridgeMsg;
+
+
+/*
+ * Byte stream between the two bridges.
+ * Writes can be buffered until the stream is flushed. Reads block until the requested bytes are
+ * received, and return false if the other side is gone.
+ */
+class ChipBridgeLink
+{
+public:
+    virtual ~ChipBridgeLink() {}
+    virtual bool write(const void *data, size_t size) = 0;
+    virtual bool flush() = 0;
+    virtual bool read(void *data, size_t size) = 0;
+    // Tell if bytes are ready to be read without blocking, waiting at most timeout_ms for them.
+    // Also returns true if the other side is gone, so that the next read reports it.
+    virtual bool poll(int timeout_ms=0) = 0;
+    // Tell the other side that nothing will be sent anymore
+    virtual void close() = 0;
+};
+
+
+class ChipBridgeSocketLink : public ChipBridgeLink
+{
+public:
+    ChipBridgeSocketLink(int fd) : fd(fd) {}
+    ~ChipBridgeSocketLink();
+    bool write(const void *data, size_t size) override;
+    bool flush() override;
+    bool read(void *data, size_t size) override;
+    bool poll(int timeout_ms=0) override;
+    void close() override;
+
+private:
+    // Receive what is available without blocking, to let the other side go on while it can't
+    // send to us. Returns false if the socket is broken.
+    bool rx_drain();
+
+    int fd;
+    std::vector<uint8_t> tx_buffer;
+    std::vector<uint8_t> rx_buffer;
+    // Position of the first byte not yet read in rx_buffer
+    size_t rx_pos = 0;
+    // True once the other side closed its write side
+    bool rx_closed = false;
+};
+
+
+/*
+ * Single producer single consumer ring, in shared memory.
+ * Head and tail are the total number of bytes written and read. Both sides sleep on the seq
+ * futex, which is incremented every time one of them moves its index, when the ring is full or
+ * empty.
+ */
+typedef struct
+{
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> seq;
+    // Number of sides sleeping on seq, to avoid waking up nobody
+    std::atomic<uint32_t> nb_waiting;
+} ChipBridgeRing;
+
+
+// Header at the beginning of the shared memory, followed by the 2 rings and their data
+typedef struct
+{
+    std::atomic<uint32_t> ready;
+    uint32_t ring_size;
+    // Set by the first side which closes the link, the other one then stops waiting
+    std::atomic<uint32_t> closed;
+    // Process of the server and of the client, to detect that one was killed without closing
+    std::atomic<int32_t> pid[2];
+} ChipBridgeShmHeader;
+
+
+class ChipBridgeShmLink : public ChipBridgeLink
+{
+public:
+    ChipBridgeShmLink(std::string name, bool server, uint8_t *shm, size_t shm_size);
+    ~ChipBridgeShmLink();
+    bool write(const void *data, size_t size) override;
+    bool flush() override;
+    bool read(void *data, size_t size) override;
+    bool poll(int timeout_ms=0) override;
+    void close() override;
+
+private:
+    static void ring_wait(ChipBridgeRing *ring, uint32_t seq, int64_t timeout_ns=100000000);
+    static void ring_notify(ChipBridgeRing *ring);
+    // Tell if the other side may still send or read something
+    bool peer_alive();
+    // Move what the other side sent to rx_buffer, to let it go on while our ring is full
+    void rx_drain();
+
+    std::string name;
+    bool server;
+    uint8_t *shm;
+    size_t shm_size;
+    ChipBridgeShmHeader *header;
+    uint64_t ring_size;
+    ChipBridgeRing *tx_ring;
+    ChipBridgeRing *rx_ring;
+    uint8_t *tx_data;
+    uint8_t *rx_data;
+    // Bytes written but not yet visible to the other side
+    uint64_t tx_head;
+    // Bytes received while waiting for room in the tx ring, read before the rx ring
+    std::vector<uint8_t> rx_buffer;
+    size_t rx_pos = 0;
+};
+
+
+class ChipBridge;
+
+
+// Message received from the other side, waiting for the time where it must be replayed
+class ChipBridgeDelivery
+{
+public:
+    int64_t time;
+    // Reception order, to replay messages with the same time in order
+    uint64_t seq;
+    ChipBridgeMsg msg;
+    std::vector<uint8_t> payload;
+};
+
+
+class ChipBridgeDeliveryCompare
+{
+public:
+    bool operator()(ChipBridgeDelivery *a, ChipBridgeDelivery *b)
+    {
+        return a->time > b->time || (a->time == b->time && a->seq > b->seq);
+    }
+};
+
+
+/*
+ * Interface of the bridge, which replays the messages received for it.
+ */
+class ChipBridgeItf
+{
+public:
+    ChipBridgeItf(ChipBridge *top, std::string name, int id, bool is_master)
+        : top(top), name(name), id(id), is_master(is_master) {}
+    virtual ~ChipBridgeItf() {}
+    virtual void deliver(ChipBridgeMsg *msg, uint8_t *payload) = 0;
+
+    ChipBridge *top;
+    std::string name;
+    int id;
+    // True if the bridge has a master port for this interface
+    bool is_master;
+};
+
+
+class ChipBridgeIoItf : public ChipBridgeItf
+{
+public:
+    ChipBridgeIoItf(ChipBridge *top, std::string name, int id, bool is_master);
+    ~ChipBridgeIoItf();
+    void deliver(ChipBridgeMsg *msg, uint8_t *payload) override;
+    // Send the response of a request received from the other side
+    void send_rsp(vp::IoReq *req, int64_t delay);
+    // Called when the request denied by our master port is granted
+    void grant(vp::IoReq *req);
+
+    vp::IoMaster master;
+    vp::IoSlave slave;
+
+private:
+    // Replay on our master port a request received from the other side
+    void replay_req(ChipBridgeMsg *msg, uint8_t *payload);
+
+    // Request denied by the slave, nothing else is replayed until it is granted
+    vp::IoReq *denied_req = NULL;
+    // Requests received while a request is denied, replayed in order once it is granted
+    std::queue<ChipBridgeDelivery *> held_reqs;
+};
+
+
+template<class T>
+class ChipBridgeWireItf : public ChipBridgeItf
+{
+public:
+    ChipBridgeWireItf(ChipBridge *top, std::string name, int id, bool is_master);
+    void deliver(ChipBridgeMsg *msg, uint8_t *payload) override;
+
+    vp::WireMaster<T> master;
+    vp::WireSlave<T> slave;
+};
+
+
+class ChipBridgeUartItf : public ChipBridgeItf
+{
+public:
+    ChipBridgeUartItf(ChipBridge *top, std::string name, int id, bool is_master);
+    void deliver(ChipBridgeMsg *msg, uint8_t *payload) override;
+
+    vp::UartMaster master;
+    vp::UartSlave slave;
+};
+
+
+class ChipBridgeQspimItf : public ChipBridgeItf
+{
+public:
+    ChipBridgeQspimItf(ChipBridge *top, std::string name, int id, bool is_master);
+    void deliver(ChipBridgeMsg *msg, uint8_t *payload) override;
+
+    vp::QspimMaster master;
+    vp::QspimSlave slave;
+};
+
+
+class ChipBridgeI2sItf : public ChipBridgeItf
+{
+public:
+    ChipBridgeI2sItf(ChipBridge *top, std::string name, int id, bool is_master);
+    void deliver(ChipBridgeMsg *msg, uint8_t *payload) override;
+
+    vp::I2sMaster master;
+    vp::I2sSlave slave;
+};
+
+
+class ChipBridge : public vp::Component
+{
+    friend class ChipBridgeIoItf;
+    template<class T> friend class ChipBridgeWireItf;
+    friend class ChipBridgeUartItf;
+    friend class ChipBridgeQspimItf;
+    friend class ChipBridgeI2sItf;
+
+public:
+    ChipBridge(vp::ComponentConf &config);
+    ~ChipBridge();
+
+    void start();
+    void stop();
+    void reset(bool active);
+
+    // Send a message to the other side, at the current time
+    void send(ChipBridgeMsg *msg, const uint8_t *payload=NULL);
+
+    vp::Trace trace;
+
+private:
+    void connect_socket();
+    void connect_shm();
+    // Send our time to the other side and wait until it is far enough to continue
+    void sync();
+    // Receive one message, return false if the other side is gone
+    bool receive();
+    // The other side is over, stop synchronizing with it
+    void peer_end();
+    // Schedule the replay of the first received message
+    void delivery_schedule();
+
+    static void sync_handler(vp::Block *__this, vp::TimeEvent *event);
+    static void delivery_handler(vp::Block *__this, vp::TimeEvent *event);
+
+    static vp::IoReqStatus io_req(vp::Block *__this, vp::IoReq *req, int id);
+    static void io_resp(vp::Block *__this, vp::IoReq *req);
+    static void io_grant(vp::Block *__this, vp::IoReq *req);
+    template<class T>
+    static void wire_sync(vp::Block *__this, T value, int id);
+    static void uart_sync(vp::Block *__this, int data, int id);
+    static void uart_sync_full(vp::Block *__this, int data, int sck, int rtr, unsigned int mask,
+        int id);
+    static void qspim_sync(vp::Block *__this, int sck, int data_0, int data_1, int data_2,
+        int data_3, int mask, int id);
+    static void qspim_cs_sync(vp::Block *__this, int cs, int active, int id);
+    static void i2s_sync(vp::Block *__this, int sck, int ws, int sd, bool full_duplex, int id);
+
+    std::string transport;
+    std::string path;
+    bool server;
+    int64_t latency;
+    int64_t connect_timeout;
+    size_t ring_size;
+
+    std::vector<ChipBridgeItf *> itfs;
+    ChipBridgeLink *link = NULL;
+
+    // Last time received from the other side, which can not send anything older
+    int64_t peer_time;
+    // True once the other side is over, in which case we run freely
+    bool peer_done;
+    // True once we are over, in which case nothing is sent anymore
+    bool done = false;
+
+    vp::TimeEvent sync_event;
+    vp::TimeEvent delivery_event;
+    std::priority_queue<ChipBridgeDelivery *, std::vector<ChipBridgeDelivery *>,
+        ChipBridgeDeliveryCompare> deliveries;
+    uint64_t delivery_seq = 0;
+};
+
+
+
+static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t value,
+    const struct timespec *timeout)
+{
+    // The futex is shared between processes, the private flavor can not be used
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static inline void futex_wake(std::atomic<uint32_t> *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+
+ChipBridgeSocketLink::~ChipBridgeSocketLink()
+{
+    ::close(this->fd);
+}
+
+bool ChipBridgeSocketLink::write(const void *data, size_t size)
+{
+    this->tx_buffer.insert(this->tx_buffer.end(), (uint8_t *)data, (uint8_t *)data + size);
+    return true;
+}
+
+bool ChipBridgeSocketLink::rx_drain()
+{
+    if (this->rx_pos == this->rx_buffer.size())
+    {
+        this->rx_buffer.clear();
+        this->rx_pos = 0;
+    }
+
+    size_t current = this->rx_buffer.size();
+    this->rx_buffer.resize(current + 65536);
+    ssize_t received = ::recv(this->fd, this->rx_buffer.data() + current, 65536, MSG_DONTWAIT);
+    this->rx_buffer.resize(current + std::max(received, (ssize_t)0));
+
+    if (received == 0)
+    {
+        this->rx_closed = true;
+    }
+    else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool ChipBridgeSocketLink::flush()
+{
+    size_t pos = 0;
+    while (pos < this->tx_buffer.size())
+    {
+        // The other side may also be flushing to us, and both sides would block forever in
+        // send if both socket buffers are full. What the other side sent is received while
+        // waiting so that it can always go on.
+        struct pollfd pfd = { .fd=this->fd, .events=POLLOUT, .revents=0 };
+        if (!this->rx_closed)
+        {
+            pfd.events |= POLLIN;
+        }
+
+        if (::poll(&pfd, 1, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        if ((pfd.revents & POLLIN) && !this->rx_drain())
+        {
+            return false;
+        }
+
+        if (pfd.revents & (POLLOUT | POLLERR | POLLHUP))
+        {
+            ssize_t size = ::send(this->fd, this->tx_buffer.data() + pos,
+                this->tx_buffer.size() - pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            {
+                continue;
+            }
+            if (size <= 0)
+            {
+                return false;
+            }
+            pos += size;
+        }
+    }
+    this->tx_buffer.clear();
+    return true;
+}
+
+bool ChipBridgeSocketLink::read(void *data, size_t size)
+{
+    uint8_t *dest = (uint8_t *)data;
+    while (size > 0)
+    {
+        if (this->rx_pos == this->rx_buffer.size())
+        {
+            if (this->rx_closed)
+            {
+                return false;
+            }
+
+            // Receive as much as possible to limit the number of system calls
+            this->rx_buffer.resize(65536);
+            ssize_t received = ::recv(this->fd, this->rx_buffer.data(), this->rx_buffer.size(), 0);
+            if (received <= 0)
+            {
+                this->rx_buffer.clear();
+                this->rx_pos = 0;
+                return false;
+            }
+            this->rx_buffer.resize(received);
+            this->rx_pos = 0;
+        }
+
+        size_t chunk = std::min(size, this->rx_buffer.size() - this->rx_pos);
+        memcpy(dest, this->rx_buffer.data() + this->rx_pos, chunk);
+        this->rx_pos += chunk;
+        dest += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool ChipBridgeSocketLink::poll(int timeout_ms)
+{
+    if (this->rx_pos != this->rx_buffer.size() || this->rx_closed)
+    {
+        return true;
+    }
+    struct pollfd pfd = { .fd=this->fd, .events=POLLIN, .revents=0 };
+    return ::poll(&pfd, 1, timeout_ms) > 0;
+}
+
+void ChipBridgeSocketLink::close()
+{
+    // The other side gets end of file once it has read everything
+    ::shutdown(this->fd, SHUT_WR);
+}
+
+
+
+ChipBridgeShmLink::ChipBridgeShmLink(std::string name, bool server, uint8_t *shm, size_t shm_size)
+    : name(name), server(server), shm(shm), shm_size(shm_size)
+{
+    this->header = (ChipBridgeShmHeader *)shm;
+    this->ring_size = this->header->ring_size;
+
+    ChipBridgeRing *rings = (ChipBridgeRing *)(shm + sizeof(ChipBridgeShmHeader));
+    uint8_t *data = (uint8_t *)&rings[2];
+
+    // The server sends on the first ring and the client on the second one
+    int tx = server ? 0 : 1;
+    this->tx_ring = &rings[tx];
+    this->rx_ring = &rings[1 - tx];
+    this->tx_data = data + tx * this->ring_size;
+    this->rx_data = data + (1 - tx) * this->ring_size;
+    this->tx_head = this->tx_ring->head.load();
+}
+
+ChipBridgeShmLink::~ChipBridgeShmLink()
+{
+    this->close();
+    munmap(this->shm, this->shm_size);
+    if (this->server)
+    {
+        shm_unlink(this->name.c_str());
+    }
+}
+
+void ChipBridgeShmLink::ring_wait(ChipBridgeRing *ring, uint32_t seq, int64_t timeout_ns)
+{
+    // A side killed without closing the link can not wake us up, so we regularly wake up to
+    // check if it is still there
+    struct timespec timeout = { .tv_sec=timeout_ns / 1000000000, .tv_nsec=timeout_ns % 1000000000 };
+    ring->nb_waiting.fetch_add(1);
+    futex_wait(&ring->seq, seq, &timeout);
+    ring->nb_waiting.fetch_sub(1);
+}
+
+void ChipBridgeShmLink::ring_notify(ChipBridgeRing *ring)
+{
+    ring->seq.fetch_add(1);
+    if (ring->nb_waiting.load() != 0)
+    {
+        futex_wake(&ring->seq);
+    }
+}
+
+bool ChipBridgeShmLink::peer_alive()
+{
+    if (this->header->closed.load())
+    {
+        return false;
+    }
+
+    int32_t pid = this->header->pid[this->server ? 1 : 0].load();
+    return pid == 0 || kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+void ChipBridgeShmLink::rx_drain()
+{
+    uint64_t tail = this->rx_ring->tail.load();
+    uint64_t head = this->rx_ring->head.load();
+    if (tail == head)
+    {
+        return;
+    }
+
+    while (tail != head)
+    {
+        uint64_t offset = tail % this->ring_size;
+        size_t chunk = std::min(head - tail, this->ring_size - offset);
+        this->rx_buffer.insert(this->rx_buffer.end(), this->rx_data + offset,
+            this->rx_data + offset + chunk);
+        tail += chunk;
+    }
+    this->rx_ring->tail.store(tail);
+    ring_notify(this->rx_ring);
+}
+
+bool ChipBridgeShmLink::write(const void *data, size_t size)
+{
+    const uint8_t *src = (const uint8_t *)data;
+    while (size > 0)
+    {
+        uint64_t free_size = this->ring_size - (this->tx_head - this->tx_ring->tail.load());
+        if (free_size == 0)
+        {
+            // Publish what we have so that the other side can make room. The other side may
+            // also be blocked on its own full ring, which is drained so that both sides can't
+            // wait for each other.
+            uint32_t seq = this->tx_ring->seq.load();
+            this->flush();
+            this->rx_drain();
+            if (this->ring_size - (this->tx_head - this->tx_ring->tail.load()) == 0)
+            {
+                if (!this->peer_alive())
+                {
+                    return false;
+                }
+                ring_wait(this->tx_ring, seq);
+            }
+            continue;
+        }
+
+        uint64_t offset = this->tx_head % this->ring_size;
+        size_t chunk = std::min((uint64_t)size, std::min(free_size, this->ring_size - offset));
+        memcpy(this->tx_data + offset, src, chunk);
+        this->tx_head += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool ChipBridgeShmLink::flush()
+{
+    if (this->tx_ring->head.load() != this->tx_head)
+    {
+        this->tx_ring->head.store(this->tx_head);
+        ring_notify(this->tx_ring);
+    }
+    return true;
+}
+
+bool ChipBridgeShmLink::read(void *data, size_t size)
+{
+    uint8_t *dest = (uint8_t *)data;
+
+    if (this->rx_pos != this->rx_buffer.size())
+    {
+        size_t chunk = std::min(size, this->rx_buffer.size() - this->rx_pos);
+        memcpy(dest, this->rx_buffer.data() + this->rx_pos, chunk);
+        this->rx_pos += chunk;
+        dest += chunk;
+        size -= chunk;
+        if (this->rx_pos == this->rx_buffer.size())
+        {
+            this->rx_buffer.clear();
+            this->rx_pos = 0;
+        }
+    }
+
+    while (size > 0)
+    {
+        uint64_t tail = this->rx_ring->tail.load();
+        uint64_t ready = this->rx_ring->head.load() - tail;
+        if (ready == 0)
+        {
+            // What the other side sent before closing must still be read
+            uint32_t seq = this->rx_ring->seq.load();
+            bool alive = this->peer_alive();
+            if (this->rx_ring->head.load() == tail)
+            {
+                if (!alive)
+                {
+                    return false;
+                }
+                ring_wait(this->rx_ring, seq);
+            }
+            continue;
+        }
+
+        uint64_t offset = tail % this->ring_size;
+        size_t chunk = std::min((uint64_t)size, std::min(ready, this->ring_size - offset));
+        memcpy(dest, this->rx_data + offset, chunk);
+        this->rx_ring->tail.store(tail + chunk);
+        ring_notify(this->rx_ring);
+        dest += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool ChipBridgeShmLink::poll(int timeout_ms)
+{
+    if (this->rx_pos != this->rx_buffer.size())
+    {
+        return true;
+    }
+
+    uint32_t seq = this->rx_ring->seq.load();
+    if (this->rx_ring->head.load() != this->rx_ring->tail.load() || !this->peer_alive())
+    {
+        return true;
+    }
+
+    if (timeout_ms == 0)
+    {
+        return false;
+    }
+
+    ring_wait(this->rx_ring, seq, (int64_t)timeout_ms * 1000000);
+    return this->rx_ring->head.load() != this->rx_ring->tail.load() || !this->peer_alive();
+}
+
+void ChipBridgeShmLink::close()
+{
+    if (this->header->closed.exchange(1) == 0)
+    {
+        // Wake up the other side wherever it is waiting
+        for (ChipBridgeRing *ring : { this->tx_ring, this->rx_ring })
+        {
+            ring->seq.fetch_add(1);
+            futex_wake(&ring->seq);
+        }
+    }
+}
+
+
+
+ChipBridgeIoItf::ChipBridgeIoItf(ChipBridge *top, std::string name, int id, bool is_master)
+    : ChipBridgeItf(top, name, id, is_master)
+{
+    if (is_master)
+    {
+        this->master.set_resp_meth(&ChipBridge::io_resp);
+        this->master.set_grant_meth(&ChipBridge::io_grant);
+        top->new_master_port(name, &this->master);
+    }
+    else
+    {
+        this->slave.set_req_meth_muxed(&ChipBridge::io_req, id);
+        top->new_slave_port(name, &this->slave);
+    }
+}
+
+ChipBridgeIoItf::~ChipBridgeIoItf()
+{
+    while (!this->held_reqs.empty())
+    {
+        delete this->held_reqs.front();
+        this->held_reqs.pop();
+    }
+}
+
+void ChipBridgeIoItf::deliver(ChipBridgeMsg *msg, uint8_t *payload)
+{
+    if (msg->type == CHIP_BRIDGE_IO_REQ)
+    {
+        if (this->denied_req)
+        {
+            ChipBridgeDelivery *held = new ChipBridgeDelivery();
+            held->msg = *msg;
+            held->payload.assign(payload, payload + msg->size);
+            this->held_reqs.push(held);
+        }
+        else
+        {
+            this->replay_req(msg, payload);
+        }
+    }
+    else
+    {
+        // Response to one of our requests
+        vp::IoReq *req = (vp::IoReq *)msg->args[0];
+        req->status = (vp::IoReqStatus)msg->args[1];
+        if (msg->size > 0)
+        {
+            uint8_t *data = req->get_opcode() == vp::READ ? req->get_data() : req->get_second_data();
+            if (data)
+            {
+                memcpy(data, payload, msg->size);
+            }
+        }
+        req->get_resp_port()->resp(req);
+    }
+}
+
+void ChipBridgeIoItf::replay_req(ChipBridgeMsg *msg, uint8_t *payload)
+{
+    // Request from the other side, replay it on our master port. The data is allocated here
+    // and the identifier of the remote request kept in the request arguments until the
+    // response is sent.
+    uint64_t size = msg->args[2];
+    vp::IoReqOpcode opcode = (vp::IoReqOpcode)msg->args[3];
+    uint8_t *data = new uint8_t[size * 2];
+    if (opcode != vp::READ)
+    {
+        memcpy(data, payload, size);
+    }
+
+    vp::IoReq *req = this->master.req_new(msg->args[1], data, size, false);
+    req->set_opcode(opcode);
+    req->set_second_data(data + size);
+    req->set_initiator((int)msg->args[4]);
+    req->arg_push((void *)msg->args[0]);
+    req->arg_push((void *)this);
+
+    vp::IoReqStatus status = this->master.req(req);
+    if (status == vp::IO_REQ_DENIED)
+    {
+        // The slave grants it later and then sends the response through io_resp
+        this->denied_req = req;
+    }
+    else if (status != vp::IO_REQ_PENDING)
+    {
+        // The bridge is not clocked, the latency in cycles of the slave can only be
+        // converted if a clock is bound to it
+        vp::ClockEngine *clock = this->top->clock.get_engine();
+        int64_t delay = clock ? req->get_full_latency() * clock->get_period() : 0;
+        req->arg_pop();
+        req->status = status;
+        this->send_rsp(req, delay);
+    }
+}
+
+void ChipBridgeIoItf::grant(vp::IoReq *req)
+{
+    if (req != this->denied_req)
+    {
+        return;
+    }
+
+    this->denied_req = NULL;
+
+    while (!this->held_reqs.empty() && this->denied_req == NULL)
+    {
+        ChipBridgeDelivery *held = this->held_reqs.front();
+        this->held_reqs.pop();
+        this->replay_req(&held->msg, held->payload.data());
+        delete held;
+    }
+}
+
+void ChipBridgeIoItf::send_rsp(vp::IoReq *req, int64_t delay)
+{
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_IO_RSP;
+    msg.itf = this->id;
+    msg.delay = delay;
+    msg.args[0] = (uint64_t)req->arg_pop();
+    msg.args[1] = req->status;
+
+    uint8_t *data = req->get_data();
+    if (req->get_opcode() == vp::READ)
+    {
+        msg.size = req->get_size();
+    }
+    else if (req->get_opcode() != vp::WRITE)
+    {
+        // Atomics return the old value through the second data
+        msg.size = req->get_size();
+        data = req->get_second_data();
+    }
+
+    this->top->send(&msg, data);
+
+    delete[] req->get_data();
+    this->master.req_del(req);
+}
+
+
+
+template<class T>
+ChipBridgeWireItf<T>::ChipBridgeWireItf(ChipBridge *top, std::string name, int id, bool is_master)
+    : ChipBridgeItf(top, name, id, is_master)
+{
+    if (is_master)
+    {
+        this->master.set_sync_meth_muxed(&ChipBridge::wire_sync<T>, id);
+        top->new_master_port(name, &this->master);
+    }
+    else
+    {
+        this->slave.set_sync_meth_muxed(&ChipBridge::wire_sync<T>, id);
+        top->new_slave_port(name, &this->slave);
+    }
+}
+
+template<class T>
+void ChipBridgeWireItf<T>::deliver(ChipBridgeMsg *msg, uint8_t *payload)
+{
+    if (this->is_master)
+    {
+        this->master.sync((T)msg->args[0]);
+    }
+    else
+    {
+        this->slave.sync((T)msg->args[0]);
+    }
+}
+
+
+
+ChipBridgeUartItf::ChipBridgeUartItf(ChipBridge *top, std::string name, int id, bool is_master)
+    : ChipBridgeItf(top, name, id, is_master)
+{
+    if (is_master)
+    {
+        this->master.set_sync_meth_muxed(&ChipBridge::uart_sync, id);
+        this->master.set_sync_full_meth_muxed(&ChipBridge::uart_sync_full, id);
+        top->new_master_port(name, &this->master);
+    }
+    else
+    {
+        this->slave.set_sync_meth_muxed(&ChipBridge::uart_sync, id);
+        this->slave.set_sync_full_meth_muxed(&ChipBridge::uart_sync_full, id);
+        top->new_slave_port(name, &this->slave);
+    }
+}
+
+void ChipBridgeUartItf::deliver(ChipBridgeMsg *msg, uint8_t *payload)
+{
+    if (this->is_master)
+    {
+        this->master.sync_full(msg->args[0], msg->args[1], msg->args[2], msg->args[3]);
+    }
+    else
+    {
+        this->slave.sync_full(msg->args[0], msg->args[1], msg->args[2], msg->args[3]);
+    }
+}
+
+
+
+ChipBridgeQspimItf::ChipBridgeQspimItf(ChipBridge *top, std::string name, int id, bool is_master)
+    : ChipBridgeItf(top, name, id, is_master)
+{
+    if (is_master)
+    {
+        this->master.set_sync_meth_muxed(&ChipBridge::qspim_sync, id);
+        top->new_master_port(name, &this->master);
+    }
+    else
+    {
+        this->slave.set_sync_meth_muxed(&ChipBridge::qspim_sync, id);
+        this->slave.set_cs_sync_meth_muxed(&ChipBridge::qspim_cs_sync, id);
+        top->new_slave_port(name, &this->slave);
+    }
+}
+
+void ChipBridgeQspimItf::deliver(ChipBridgeMsg *msg, uint8_t *payload)
+{
+    if (msg->type == CHIP_BRIDGE_QSPIM_CS)
+    {
+        // Chip selects only go from the controller to the device
+        if (this->is_master)
+        {
+            this->master.cs_sync(msg->args[0], msg->args[1]);
+        }
+    }
+    else if (this->is_master)
+    {
+        this->master.sync(msg->args[0], msg->args[1], msg->args[2], msg->args[3], msg->args[4],
+            msg->args[5]);
+    }
+    else
+    {
+        this->slave.sync(msg->args[0], msg->args[1], msg->args[2], msg->args[3], msg->args[4],
+            msg->args[5]);
+    }
+}
+
+
+
+ChipBridgeI2sItf::ChipBridgeI2sItf(ChipBridge *top, std::string name, int id, bool is_master)
+    : ChipBridgeItf(top, name, id, is_master)
+{
+    if (is_master)
+    {
+        this->master.set_sync_meth_muxed(&ChipBridge::i2s_sync, id);
+        top->new_master_port(name, &this->master);
+    }
+    else
+    {
+        this->slave.set_sync_meth_muxed(&ChipBridge::i2s_sync, id);
+        top->new_slave_port(name, &this->slave);
+    }
+}
+
+void ChipBridgeI2sItf::deliver(ChipBridgeMsg *msg, uint8_t *payload)
+{
+    if (this->is_master)
+    {
+        this->master.sync(msg->args[0], msg->args[1], msg->args[2], msg->args[3]);
+    }
+    else
+    {
+        this->slave.sync(msg->args[0], msg->args[1], msg->args[2], msg->args[3]);
+    }
+}
+
+
+
+ChipBridge::ChipBridge(vp::ComponentConf &config)
+    : vp::Component(config), sync_event(this, &ChipBridge::sync_handler),
+    delivery_event(this, &ChipBridge::delivery_handler)
+{
+    this->traces.new_trace("trace", &this->trace, vp::DEBUG);
+
+    js::Config *js_config = this->get_js_config();
+
+    this->transport = js_config->get_child_str("transport");
+    this->path = js_config->get_child_str("path");
+    this->server = js_config->get_child_bool("server");
+    this->latency = js_config->get_child_int("latency");
+    this->connect_timeout = js_config->get_child_int("connect_timeout");
+    this->ring_size = js_config->get_child_int("ring_size");
+
+    if (this->latency <= 0)
+    {
+        // The latency is the lookahead of the synchronization, the processes would be stuck
+        // without it
+        this->trace.fatal("Chip bridge latency must be strictly positive (latency: %ld)\n",
+            this->latency);
+        return;
+    }
+
+    js::Config *itfs = js_config->get("interfaces");
+    if (itfs)
+    {
+        for (auto &x : itfs->get_childs())
+        {
+            std::string name = x.first;
+            std::string type = x.second->get_child_str("type");
+            bool is_master = x.second->get_child_bool("is_master");
+            int id = this->itfs.size();
+            ChipBridgeItf *itf = NULL;
+
+            if (type == "io")
+            {
+                itf = new ChipBridgeIoItf(this, name, id, is_master);
+            }
+            else if (type == "wire<bool>")
+            {
+                itf = new ChipBridgeWireItf<bool>(this, name, id, is_master);
+            }
+            else if (type == "wire<int>")
+            {
+                itf = new ChipBridgeWireItf<int>(this, name, id, is_master);
+            }
+            else if (type == "wire<uint32_t>")
+            {
+                itf = new ChipBridgeWireItf<uint32_t>(this, name, id, is_master);
+            }
+            else if (type == "wire<uint64_t>")
+            {
+                itf = new ChipBridgeWireItf<uint64_t>(this, name, id, is_master);
+            }
+            else if (type == "uart")
+            {
+                itf = new ChipBridgeUartItf(this, name, id, is_master);
+            }
+            else if (type == "qspim")
+            {
+                itf = new ChipBridgeQspimItf(this, name, id, is_master);
+            }
+            else if (type == "i2s")
+            {
+                itf = new ChipBridgeI2sItf(this, name, id, is_master);
+            }
+            else
+            {
+                this->trace.fatal("Unknown chip bridge interface type (name: %s, type: %s)\n",
+                    name.c_str(), type.c_str());
+                return;
+            }
+
+            this->trace.msg("Adding interface (name: %s, type: %s, is_master: %d)\n",
+                name.c_str(), type.c_str(), is_master);
+
+            this->itfs.push_back(itf);
+        }
+    }
+}
+
+
+
+ChipBridge::~ChipBridge()
+{
+    delete this->link;
+    for (ChipBridgeItf *itf : this->itfs)
+    {
+        delete itf;
+    }
+}
+
+
+
+void ChipBridge::start()
+{
+    this->trace.msg("Connecting to other chip (transport: %s, path: %s, server: %d)\n",
+        this->transport.c_str(), this->path.c_str(), this->server);
+
+    if (this->transport == "shm")
+    {
+        this->connect_shm();
+    }
+    else
+    {
+        this->connect_socket();
+    }
+}
+
+
+
+void ChipBridge::connect_socket()
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (this->path.size() >= sizeof(addr.sun_path))
+    {
+        this->trace.fatal("Chip bridge socket path is too long (path: %s)\n", this->path.c_str());
+        return;
+    }
+    strcpy(addr.sun_path, this->path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        this->trace.fatal("Unable to create socket (error: %s)\n", strerror(errno));
+        return;
+    }
+
+    if (this->server)
+    {
+        unlink(this->path.c_str());
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0)
+        {
+            this->trace.fatal("Unable to listen on socket (path: %s, error: %s)\n",
+                this->path.c_str(), strerror(errno));
+            return;
+        }
+
+        int conn = accept(fd, NULL, NULL);
+        ::close(fd);
+        unlink(this->path.c_str());
+        if (conn < 0)
+        {
+            this->trace.fatal("Unable to accept connection (path: %s, error: %s)\n",
+                this->path.c_str(), strerror(errno));
+            return;
+        }
+        fd = conn;
+    }
+    else
+    {
+        // The other process may not be listening yet
+        int64_t retries = this->connect_timeout * 100;
+        while (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            if (retries-- <= 0)
+            {
+                this->trace.fatal("Unable to connect to other chip (path: %s, error: %s)\n",
+                    this->path.c_str(), strerror(errno));
+                return;
+            }
+            usleep(10000);
+        }
+    }
+
+    this->link = new ChipBridgeSocketLink(fd);
+}
+
+
+
+void ChipBridge::connect_shm()
+{
+    size_t shm_size = sizeof(ChipBridgeShmHeader) + 2 * sizeof(ChipBridgeRing) +
+        2 * this->ring_size;
+    int fd;
+
+    if (this->server)
+    {
+        shm_unlink(this->path.c_str());
+        fd = shm_open(this->path.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0 || ftruncate(fd, shm_size) < 0)
+        {
+            this->trace.fatal("Unable to create shared memory (name: %s, error: %s)\n",
+                this->path.c_str(), strerror(errno));
+            return;
+        }
+    }
+    else
+    {
+        // The other process may not have created it yet
+        int64_t retries = this->connect_timeout * 100;
+        while ((fd = shm_open(this->path.c_str(), O_RDWR, 0600)) < 0)
+        {
+            if (retries-- <= 0)
+            {
+                this->trace.fatal("Unable to open shared memory (name: %s, error: %s)\n",
+                    this->path.c_str(), strerror(errno));
+                return;
+            }
+            usleep(10000);
+        }
+    }
+
+    uint8_t *shm = (uint8_t *)mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (shm == MAP_FAILED)
+    {
+        this->trace.fatal("Unable to map shared memory (name: %s, error: %s)\n",
+            this->path.c_str(), strerror(errno));
+        return;
+    }
+
+    ChipBridgeShmHeader *header = (ChipBridgeShmHeader *)shm;
+    if (this->server)
+    {
+        // The file is zero-filled, which is the initial state of the rings
+        header->ring_size = this->ring_size;
+        header->pid[0].store(getpid());
+        header->ready.store(1);
+    }
+    else
+    {
+        int64_t retries = this->connect_timeout * 100;
+        while (header->ready.load() == 0)
+        {
+            if (retries-- <= 0)
+            {
+                this->trace.fatal("Shared memory not initialized by other chip (name: %s)\n",
+                    this->path.c_str());
+                return;
+            }
+            usleep(10000);
+        }
+        header->pid[1].store(getpid());
+    }
+
+    this->link = new ChipBridgeShmLink(this->path, this->server, shm, shm_size);
+}
+
+
+
+void ChipBridge::reset(bool active)
+{
+    if (active)
+    {
+        this->peer_time = 0;
+        this->peer_done = false;
+        this->sync_event.cancel();
+    }
+    else
+    {
+        // We can run until the other side would receive something from time 0
+        this->sync_event.enqueue(this->latency);
+    }
+}
+
+
+
+void ChipBridge::stop()
+{
+    if (this->link && !this->done)
+    {
+        ChipBridgeMsg msg = {};
+        msg.type = CHIP_BRIDGE_END;
+        this->send(&msg);
+        this->link->flush();
+        this->link->close();
+        this->done = true;
+    }
+}
+
+
+
+void ChipBridge::send(ChipBridgeMsg *msg, const uint8_t *payload)
+{
+    if (this->done || this->link == NULL)
+    {
+        return;
+    }
+
+    msg->time = this->time.get_time();
+
+    this->trace.msg(vp::Trace::LEVEL_TRACE, "Sending message (type: %d, itf: %d, time: %ld)\n",
+        msg->type, msg->itf, msg->time);
+
+    this->link->write(msg, sizeof(ChipBridgeMsg));
+    if (msg->size)
+    {
+        this->link->write(payload, msg->size);
+    }
+}
+
+
+
+void ChipBridge::sync_handler(vp::Block *__this, vp::TimeEvent *event)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    _this->sync();
+}
+
+
+
+void ChipBridge::sync()
+{
+    int64_t time = this->time.get_time();
+
+    // Our time also flushes everything sent since the last synchronization
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_SYNC;
+    this->send(&msg);
+    if (!this->link->flush())
+    {
+        this->peer_end();
+        return;
+    }
+
+    this->trace.msg(vp::Trace::LEVEL_TRACE, "Synchronizing (time: %ld, peer_time: %ld)\n",
+        time, this->peer_time);
+
+    // Wait until the other side is far enough so that nothing can be received before the next
+    // synchronization point. What is already there is also received, to go as far as possible.
+    while (!this->peer_done && (this->peer_time + this->latency <= time || this->link->poll()))
+    {
+        // The other side may be paused for a long time. Commands posted to our engine by other
+        // threads, like proxy commands, must still be executed meanwhile, otherwise they would
+        // wait for the other side too.
+        while (!this->link->poll(CHIP_BRIDGE_WAIT_MS))
+        {
+            this->time.get_engine()->handle_commands();
+        }
+
+        if (!this->receive())
+        {
+            this->peer_end();
+        }
+    }
+
+    if (!this->peer_done)
+    {
+        this->sync_event.enqueue(this->peer_time + this->latency - time);
+    }
+
+    this->delivery_schedule();
+}
+
+
+
+bool ChipBridge::receive()
+{
+    ChipBridgeDelivery *delivery = new ChipBridgeDelivery();
+    ChipBridgeMsg *msg = &delivery->msg;
+
+    if (!this->link->read(msg, sizeof(ChipBridgeMsg)))
+    {
+        delete delivery;
+        return false;
+    }
+
+    if (msg->size)
+    {
+        delivery->payload.resize(msg->size);
+        if (!this->link->read(delivery->payload.data(), msg->size))
+        {
+            delete delivery;
+            return false;
+        }
+    }
+
+    this->peer_time = msg->time;
+
+    if (msg->type == CHIP_BRIDGE_SYNC)
+    {
+        delete delivery;
+    }
+    else if (msg->type == CHIP_BRIDGE_END)
+    {
+        delete delivery;
+        this->peer_end();
+    }
+    else
+    {
+        delivery->time = msg->time + this->latency + msg->delay;
+        delivery->seq = this->delivery_seq++;
+        this->deliveries.push(delivery);
+    }
+
+    return true;
+}
+
+
+
+void ChipBridge::peer_end()
+{
+    if (!this->peer_done)
+    {
+        this->trace.msg("Other chip is over, stopping synchronization (time: %ld)\n",
+            this->time.get_time());
+        this->peer_done = true;
+        this->sync_event.cancel();
+    }
+}
+
+
+
+void ChipBridge::delivery_schedule()
+{
+    if (this->deliveries.empty())
+    {
+        return;
+    }
+
+    int64_t time = this->deliveries.top()->time;
+    if (this->delivery_event.is_enqueued())
+    {
+        if (this->delivery_event.get_time() <= time)
+        {
+            return;
+        }
+        this->delivery_event.cancel();
+    }
+
+    this->delivery_event.enqueue(time - this->time.get_time());
+}
+
+
+
+void ChipBridge::delivery_handler(vp::Block *__this, vp::TimeEvent *event)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    int64_t time = _this->time.get_time();
+
+    while (!_this->deliveries.empty() && _this->deliveries.top()->time <= time)
+    {
+        ChipBridgeDelivery *delivery = _this->deliveries.top();
+        _this->deliveries.pop();
+
+        ChipBridgeMsg *msg = &delivery->msg;
+        _this->trace.msg(vp::Trace::LEVEL_TRACE,
+            "Replaying message (type: %d, itf: %d, sent: %ld)\n",
+            msg->type, msg->itf, msg->time);
+
+        if (msg->itf < _this->itfs.size())
+        {
+            _this->itfs[msg->itf]->deliver(msg, delivery->payload.data());
+        }
+
+        delete delivery;
+    }
+
+    _this->delivery_schedule();
+}
+
+
+
+vp::IoReqStatus ChipBridge::io_req(vp::Block *__this, vp::IoReq *req, int id)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+
+    _this->trace.msg(vp::Trace::LEVEL_TRACE, "Forwarding request "
+        "(itf: %d, addr: 0x%lx, size: 0x%lx, opcode: %d)\n",
+        id, req->get_addr(), req->get_size(), req->get_opcode());
+
+    if (_this->done || _this->peer_done)
+    {
+        return vp::IO_REQ_INVALID;
+    }
+
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_IO_REQ;
+    msg.itf = id;
+    msg.args[0] = (uint64_t)req;
+    msg.args[1] = req->get_addr();
+    msg.args[2] = req->get_size();
+    msg.args[3] = req->get_opcode();
+    msg.args[4] = req->get_initiator();
+    msg.size = req->get_opcode() == vp::READ ? 0 : req->get_size();
+
+    _this->send(&msg, req->get_data());
+
+    return vp::IO_REQ_PENDING;
+}
+
+
+
+void ChipBridge::io_resp(vp::Block *__this, vp::IoReq *req)
+{
+    // The request keeps the interface it was sent from in its arguments
+    ChipBridgeIoItf *itf = (ChipBridgeIoItf *)req->arg_pop();
+    itf->send_rsp(req, 0);
+}
+
+
+
+void ChipBridge::io_grant(vp::Block *__this, vp::IoReq *req)
+{
+    // The request keeps the interface it was sent from as its last argument
+    ChipBridgeIoItf *itf = (ChipBridgeIoItf *)*req->arg_get();
+    itf->grant(req);
+}
+
+
+
+template<class T>
+void ChipBridge::wire_sync(vp::Block *__this, T value, int id)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_WIRE;
+    msg.itf = id;
+    msg.args[0] = (uint64_t)value;
+    _this->send(&msg);
+}
+
+
+
+void ChipBridge::uart_sync(vp::Block *__this, int data, int id)
+{
+    ChipBridge::uart_sync_full(__this, data, 0, 0, 1 << 0, id);
+}
+
+
+
+void ChipBridge::uart_sync_full(vp::Block *__this, int data, int sck, int rtr, unsigned int mask,
+    int id)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_UART;
+    msg.itf = id;
+    msg.args[0] = data;
+    msg.args[1] = sck;
+    msg.args[2] = rtr;
+    msg.args[3] = mask;
+    _this->send(&msg);
+}
+
+
+
+void ChipBridge::qspim_sync(vp::Block *__this, int sck, int data_0, int data_1, int data_2,
+    int data_3, int mask, int id)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_QSPIM;
+    msg.itf = id;
+    msg.args[0] = sck;
+    msg.args[1] = data_0;
+    msg.args[2] = data_1;
+    msg.args[3] = data_2;
+    msg.args[4] = data_3;
+    msg.args[5] = mask;
+    _this->send(&msg);
+}
+
+
+
+void ChipBridge::qspim_cs_sync(vp::Block *__this, int cs, int active, int id)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_QSPIM_CS;
+    msg.itf = id;
+    msg.args[0] = cs;
+    msg.args[1] = active;
+    _this->send(&msg);
+}
+
+
+
+void ChipBridge::i2s_sync(vp::Block *__this, int sck, int ws, int sd, bool full_duplex, int id)
+{
+    ChipBridge *_this = (ChipBridge *)__this;
+    ChipBridgeMsg msg = {};
+    msg.type = CHIP_BRIDGE_I2S;
+    msg.itf = id;
+    msg.args[0] = sck;
+    msg.args[1] = ws;
+    msg.args[2] = sd;
+    msg.args[3] = full_duplex;
+    _this->send(&msg);
+}
+
+
+
+extern "C" vp::Component *gv_new(vp::ComponentConf &config)
+{
+    return new ChipBridge(config);
+}
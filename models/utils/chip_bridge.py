@@ -0,0 +1,181 @@
+#
+# Copyright (C) 2020 GreenWaves Technologies, SAS, ETH Zurich and University of Bologna
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import gvsoc.systree
+
+class ChipBridge(gvsoc.systree.Component):
+    """Bridge to a chip simulated by another gvsoc process
+
+    This connects the interfaces of this component to the interfaces of the same names of a bridge
+    instantiated in another gvsoc process, so that a board made of several chips can be simulated
+    with one process per chip.
+    Everything sent to an interface is received by the other process after the specified latency.
+    The two processes are synchronized conservatively, each one can run ahead of the other one
+    by at most the latency, so a bigger latency means less frequent synchronizations.
+    Both bridges must declare the same interfaces with the same names, one side being the master
+    of the interface when the other one is the slave.
+
+    Attributes
+    ----------
+    parent: gvsoc.systree.Component
+        The parent component where this one should be instantiated.
+    name: str
+        The name of the component within the parent space.
+    path: str
+        Path of the Unix socket, or name of the shared memory, used to communicate with the other
+        process.
+    server: bool
+        True if this side creates the socket or the shared memory, the other side must then be
+        False.
+    latency: int
+        Latency in picoseconds of the link between the 2 chips. Must be strictly positive.
+    transport: str
+        'socket' to communicate through a Unix socket, or 'shm' through shared memory.
+    ring_size: int
+        Size in bytes of each of the 2 rings, when communicating through shared memory. It should
+        be big enough for what is sent during one latency, otherwise the 2 processes may block each
+        other.
+    connect_timeout: int
+        Time in seconds the client side waits for the server side to be there.
+    """
+    def __init__(self, parent: gvsoc.systree.Component, name: str, path: str, server: bool,
+            latency: int, transport: str='socket', ring_size: int=1024*1024,
+            connect_timeout: int=30):
+        super(ChipBridge, self).__init__(parent, name)
+
+        self.set_component('utils.chip_bridge')
+
+        if transport not in ['socket', 'shm']:
+            raise RuntimeError(f'Unknown chip bridge transport: {transport}')
+
+        self.add_properties({
+            'path': path,
+            'server': server,
+            'latency': latency,
+            'transport': transport,
+            'ring_size': ring_size,
+            'connect_timeout': connect_timeout,
+            'interfaces': {}
+        })
+
+    def __add_itf(self, name: str, type: str, is_master: bool):
+        self.get_property('interfaces')[name] = {
+            'type': type,
+            'is_master': is_master
+        }
+
+    def add_io(self, name: str, is_master: bool):
+        """Add a memory-mapped interface.
+
+        On the slave side, requests are forwarded to the other side, which sends them to its
+        master interface and sends back the response. Requests are always answered asynchronously
+        and bursts are not supported.
+        The bridge is not clocked. The latency reported in cycles by the component receiving the
+        requests on the master side is only added to the response if a clock is bound to the
+        clock port of the bridge, and is converted with its period.
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, which must be the same on both sides.
+        is_master: bool
+            True if this side has the master port, i.e. replays requests coming from the other side.
+        """
+        self.__add_itf(name, 'io', is_master)
+
+    def add_wire(self, name: str, is_master: bool, width: str='bool'):
+        """Add a wire interface.
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, which must be the same on both sides.
+        is_master: bool
+            True if this side has the master port.
+        width: str
+            Type of the wire, among 'bool', 'int', 'uint32_t' and 'uint64_t'.
+        """
+        self.__add_itf(name, f'wire<{width}>', is_master)
+
+    def add_uart(self, name: str, is_master: bool):
+        """Add a UART interface.
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, which must be the same on both sides.
+        is_master: bool
+            True if this side has the master port.
+        """
+        self.__add_itf(name, 'uart', is_master)
+
+    def add_qspim(self, name: str, is_master: bool):
+        """Add a QSPI interface.
+
+        Chip selects are only forwarded from the slave side, which is connected to the controller,
+        to the master side, which is connected to the device.
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, which must be the same on both sides.
+        is_master: bool
+            True if this side has the master port.
+        """
+        self.__add_itf(name, 'qspim', is_master)
+
+    def add_i2s(self, name: str, is_master: bool):
+        """Add an I2S interface.
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, which must be the same on both sides.
+        is_master: bool
+            True if this side has the master port.
+        """
+        self.__add_itf(name, 'i2s', is_master)
+
+    def i_ITF(self, name: str) -> gvsoc.systree.SlaveItf:
+        """Returns a slave interface.
+
+        Whatever is received on it is forwarded to the other side.\n
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, added with one of the add methods with is_master False.
+
+        Returns
+        ----------
+        gvsoc.systree.SlaveItf
+            The slave interface
+        """
+        return gvsoc.systree.SlaveItf(self, name)
+
+    def o_ITF(self, name: str, itf: gvsoc.systree.SlaveItf):
+        """Binds a master interface.
+
+        Whatever is received from the other side for this interface is sent to it.\n
+
+        Parameters
+        ----------
+        name: str
+            Name of the interface, added with one of the add methods with is_master True.
+        itf: gvsoc.systree.SlaveItf
+            Slave interface
+        """
+        self.itf_bind(name, itf)